@@ -0,0 +1,188 @@
+//===========================================================================
+// BENCHCHIRP.CXX
+// Times the 2-D Chirp resample of a phantom slice onto the scan matrix,
+// for the geometries of the phantoms/ and sequences/ directories.  The
+// passes are those of MRI_Phantom::_chirp_fourier_resample.
+//
+// The convolution lengths chosen by MRI_FFT_Plan::get_fast_length are
+// timed by default.  Run again with MRISIM_FFT=pow2 for the power of
+// two lengths to compare:
+//
+//    benchchirp
+//    MRISIM_FFT=pow2 benchchirp
+//===========================================================================
+
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+#include <iostream>
+#include <iomanip>
+#include "../chirp.h"
+#include "../mrimatrix.h"
+
+using namespace std;
+
+// Timed calls of each trial are repeated until the trial takes this long
+#define BENCH_TRIAL_SECONDS 0.2
+#define BENCH_TRIALS        5
+
+//---------------------------------------------------------------------------
+// Geometries
+// In-plane phantom size (1 mm voxels), scan matrix and field of view.
+// avgbrain_53 is 172x220 in-plane; the sequences scan a 256 mm field of
+// view at a matrix of 64, 128, 256 or 512.  The last two are a
+// BrainWeb-sized phantom and a small phantom, for other geometries.
+//---------------------------------------------------------------------------
+
+struct Geometry {
+   const char   *name;
+   unsigned int in_cols, in_rows;
+   unsigned int out_cols, out_rows;
+   double       fov;
+};
+
+static const Geometry geometries[] = {
+   {"avgbrain_53",  172, 220,  64,  64, 256.0},
+   {"avgbrain_53",  172, 220, 128, 128, 256.0},
+   {"avgbrain_53",  172, 220, 256, 256, 256.0},
+   {"avgbrain_53",  172, 220, 512, 512, 256.0},
+   {"brainweb",     181, 217, 180, 180, 180.0},
+   {"small",        100, 100, 160, 160, 160.0}
+};
+
+#define NGEOMETRIES (sizeof(geometries)/sizeof(geometries[0]))
+
+//---------------------------------------------------------------------------
+// now
+// Returns the time of day in seconds.
+//---------------------------------------------------------------------------
+
+static double now(void) {
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + 1.0e-6*tv.tv_usec;
+}
+
+//---------------------------------------------------------------------------
+// new_chirp
+// Returns the Chirp_Algorithm resampling in_length 1 mm voxels onto
+// out_length samples of a field of view, as MRI_Phantom does.
+//---------------------------------------------------------------------------
+
+static Chirp_Algorithm *new_chirp(unsigned int in_length,
+                                  unsigned int out_length, double fov) {
+
+   const double w_step    = 2*M_PI/fov;
+   const double w_initial = -w_step*(double)out_length/2.0;
+
+   return new Chirp_Algorithm(in_length, out_length, w_initial, w_step);
+
+}
+
+//---------------------------------------------------------------------------
+// time_resample
+// Returns the best time of one 2-D resample, in milliseconds: the real
+// rows of the slice, then the complex columns of the result, transformed
+// as rows between two transposes.
+//---------------------------------------------------------------------------
+
+static double time_resample(const Chirp_Algorithm& row_chirp,
+                            const Chirp_Algorithm& col_chirp,
+                            const MRI_Float_Matrix& slice,
+                            MRI_FComplex_Matrix& tmp_slice,
+                            MRI_FComplex_Matrix& tmp_trans,
+                            MRI_FComplex_Matrix& raw_trans,
+                            MRI_FComplex_Matrix& raw_slice,
+                            double work[]) {
+
+   double       best = 0.0, start, elapsed;
+   unsigned int trial, ncalls;
+
+   for(trial=0; trial<BENCH_TRIALS; trial++){
+      ncalls = 0;
+      start  = now();
+      do {
+         row_chirp.apply_rows(0, slice.get_nrows(),
+                              slice.row_ptr(0), slice.get_col_stride(),
+                              tmp_slice.row_ptr(0),
+                              tmp_slice.get_col_stride(), work);
+         tmp_slice.transpose(tmp_trans);
+         col_chirp.apply_rows(1, tmp_trans.get_nrows(),
+                              tmp_trans.row_ptr(0),
+                              tmp_trans.get_col_stride(),
+                              raw_trans.row_ptr(0),
+                              raw_trans.get_col_stride(), work);
+         raw_trans.transpose(raw_slice);
+         ncalls++;
+         elapsed = now() - start;
+      } while (elapsed < BENCH_TRIAL_SECONDS);
+
+      elapsed = 1.0e3*elapsed/ncalls;
+      if (trial == 0 || elapsed < best) best = elapsed;
+   }
+   return best;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   const char *env = getenv("MRISIM_FFT");
+
+   cout << "Chirp resample, FFT lengths: "
+        << ((env != NULL) ? env : "fast") << endl
+        << endl
+        << "Phantom      Slice     Matrix    Row FFT  Col FFT  Time (ms)"
+        << endl
+        << "-----------  -------   -------   -------  -------  ---------"
+        << endl;
+
+   unsigned int igeom, i;
+   for(igeom=0; igeom<NGEOMETRIES; igeom++){
+
+      const Geometry& g = geometries[igeom];
+
+      Chirp_Algorithm *row_chirp = new_chirp(g.in_cols, g.out_cols, g.fov);
+      Chirp_Algorithm *col_chirp = new_chirp(g.in_rows, g.out_rows, g.fov);
+
+      const unsigned int nwork =
+         ((row_chirp->get_batch_workspace_length() >
+           col_chirp->get_batch_workspace_length()) ?
+          row_chirp->get_batch_workspace_length() :
+          col_chirp->get_batch_workspace_length());
+
+      // The rows are resampled into complex rows of out_cols elements
+      MRI_Float_Matrix    slice(g.in_rows, g.in_cols);
+      MRI_FComplex_Matrix tmp_slice(g.in_rows, g.out_cols);
+      MRI_FComplex_Matrix tmp_trans(g.out_cols, g.in_rows);
+      MRI_FComplex_Matrix raw_trans(g.out_cols, g.out_rows);
+      MRI_FComplex_Matrix raw_slice(g.out_rows, g.out_cols);
+      double              *work = new double[nwork];
+
+      for(i=0; i<g.in_rows*g.in_cols; i++){
+         slice.row_ptr(0)[i] = 1.0 + 0.001*(i%997);
+      }
+
+      double t = time_resample(*row_chirp, *col_chirp, slice, tmp_slice,
+                               tmp_trans, raw_trans, raw_slice, work);
+
+      cout << setw(11) << left << g.name << "  "
+           << setw(3) << right << g.in_cols << "x"
+           << setw(3) << left << g.in_rows << "   "
+           << setw(3) << right << g.out_cols << "x"
+           << setw(3) << left << g.out_rows << "   "
+           << setw(7) << right << row_chirp->get_fft_length() << "  "
+           << setw(7) << right << col_chirp->get_fft_length() << "  "
+           << setw(9) << right << fixed << setprecision(2) << t << endl;
+
+      delete[] work;
+      delete row_chirp;
+      delete col_chirp;
+   }
+
+   return 0;
+
+}
@@ -0,0 +1,177 @@
+//===========================================================================
+// BENCHSIMD.CXX
+// Times the MRI_SIMD element-wise kernels on 256x256 and 512x512 slices.
+//
+// The kernels of the best instruction set are timed by default.  Run
+// again with MRISIM_SIMD=none (or sse2, avx2) for the plain C++ loops
+// (or a lower instruction set) to compare:
+//
+//    benchsimd
+//    MRISIM_SIMD=none benchsimd
+//===========================================================================
+
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+#include <iostream>
+#include <iomanip>
+#include "../mrisimd.h"
+
+using namespace std;
+
+// Timed calls of each trial are repeated until the trial takes this long
+#define BENCH_TRIAL_SECONDS 0.05
+#define BENCH_TRIALS        5
+
+enum Kernel {SCALE_F, SAXPY_F, SAXPY_D, REAL_MUL_CF, COMPLEX_MUL_CF,
+             COMPLEX_SAXPY_CF, NKERNELS};
+
+static const char *kernel_name[NKERNELS] = {
+   "scale         float",
+   "saxpy         float",
+   "saxpy         double",
+   "real_mul      complex",
+   "complex_mul   complex",
+   "complex_saxpy complex"
+};
+
+//---------------------------------------------------------------------------
+// now
+// Returns the time of day in seconds.
+//---------------------------------------------------------------------------
+
+static double now(void) {
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + 1.0e-6*tv.tv_usec;
+}
+
+//---------------------------------------------------------------------------
+// run_kernel
+// Applies a kernel once to slices of n elements.  The factors of the
+// in place kernels have unit magnitude, so the values neither overflow
+// nor become denormal over many calls.
+//---------------------------------------------------------------------------
+
+static void run_kernel(Kernel kernel, unsigned int n,
+                       float xf[], const float yf[], const float yr[],
+                       float zf[],
+                       double xd[], const double yd[], double zd[]) {
+
+   switch (kernel) {
+      case SCALE_F:
+         MRI_SIMD::scale(xf, -1.0, n);
+         break;
+      case SAXPY_F:
+         MRI_SIMD::saxpy(zf, 0.5, xf, yf, n);
+         break;
+      case SAXPY_D:
+         MRI_SIMD::saxpy(zd, 0.5, xd, yd, n);
+         break;
+      case REAL_MUL_CF:
+         MRI_SIMD::real_mul(xf, yr, n);
+         break;
+      case COMPLEX_MUL_CF:
+         MRI_SIMD::complex_mul(xf, yf, n);
+         break;
+      case COMPLEX_SAXPY_CF:
+         MRI_SIMD::complex_saxpy(zf, 0.5, 0.25, xf, yf, n);
+         break;
+      default:
+         break;
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// time_kernel
+// Returns the best time of one call of a kernel, in microseconds.
+//---------------------------------------------------------------------------
+
+static double time_kernel(Kernel kernel, unsigned int n,
+                          float xf[], const float yf[], const float yr[],
+                          float zf[],
+                          double xd[], const double yd[], double zd[]) {
+
+   double       best = 0.0, start, elapsed;
+   unsigned int trial, ncalls, call;
+
+   for(trial=0; trial<BENCH_TRIALS; trial++){
+      ncalls = 0;
+      start  = now();
+      do {
+         for(call=0; call<16; call++){
+            run_kernel(kernel, n, xf, yf, yr, zf, xd, yd, zd);
+         }
+         ncalls += 16;
+         elapsed = now() - start;
+      } while (elapsed < BENCH_TRIAL_SECONDS);
+
+      elapsed = 1.0e6*elapsed/ncalls;
+      if (trial == 0 || elapsed < best) best = elapsed;
+   }
+   return best;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   const unsigned int sizes[2] = {256, 512};
+
+   cout << "MRI_SIMD kernels: " << MRI_SIMD::get_level_name() << endl
+        << endl
+        << "Kernel                  Slice     Time (us)" << endl
+        << "----------------------- -------   ---------" << endl;
+
+   unsigned int isize, ikernel, i;
+   for(isize=0; isize<2; isize++){
+
+      // Complex slices hold 2 values per element
+      const unsigned int n = sizes[isize]*sizes[isize];
+
+      float  *xf = new float[2*n];
+      float  *yf = new float[2*n];
+      float  *yr = new float[n];
+      float  *zf = new float[2*n];
+      double *xd = new double[n];
+      double *yd = new double[n];
+      double *zd = new double[n];
+
+      for(ikernel=0; ikernel<NKERNELS; ikernel++){
+         for(i=0; i<n; i++){
+            xf[2*i]   = 1.0 + 0.001*(i%997);
+            xf[2*i+1] = 0.5 - 0.001*(i%991);
+            yf[2*i]   = cos(0.01*i);
+            yf[2*i+1] = sin(0.01*i);
+            yr[i]     = ((i%2 == 0) ? 1.0 : -1.0);
+            zf[2*i]   = 0.0;
+            zf[2*i+1] = 0.0;
+            xd[i]     = xf[i];
+            yd[i]     = yf[i];
+            zd[i]     = 0.0;
+         }
+
+         double t = time_kernel((Kernel)ikernel, n, xf, yf, yr, zf,
+                                xd, yd, zd);
+         cout << setw(23) << left << kernel_name[ikernel] << " "
+              << setw(3) << right << sizes[isize] << "x"
+              << setw(3) << left << sizes[isize] << "   "
+              << setw(9) << right << fixed << setprecision(1) << t << endl;
+      }
+
+      delete[] xf;
+      delete[] yf;
+      delete[] yr;
+      delete[] zf;
+      delete[] xd;
+      delete[] yd;
+      delete[] zd;
+   }
+
+   return 0;
+
+}
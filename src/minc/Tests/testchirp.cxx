@@ -0,0 +1,428 @@
+//===========================================================================
+// TESTCHIRP.CXX
+// Checks Chirp_Algorithm::apply against a direct evaluation of the DFT
+// samples in long double, apply_rows against apply, one vector at a
+// time, for real and complex input, and the real pairs of apply_rows
+// against complex input.  apply_rows and apply_columns are also checked
+// against the direct DFT in both precisions of
+// MRI_FFT_Plan::set_precision.  Exits with a non-zero status if any
+// check fails.
+//===========================================================================
+
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include "../chirp.h"
+
+using namespace std;
+
+// Allowed error relative to the largest output element: the input and
+// output are floats
+#define TOLERANCE_APPLY 5.0e-7
+
+// Allowed error relative to the largest output element when the chirp
+// is computed in float
+#define TOLERANCE_SINGLE 1.0e-6
+
+// Vectors of the batch checks, more than two blocks and a partial one,
+// and the extra elements between vectors
+#define TEST_NVEC (2*CHIRP_BLOCK + 3)
+#define TEST_PAD  3
+
+//---------------------------------------------------------------------------
+// Cases
+// Input and output lengths and frequencies: the phantom to scan matrix
+// resamples of MRI_Phantom (field of view 256 mm at 1 mm voxels), an
+// output that is not symmetric about zero, and complex output weights.
+//---------------------------------------------------------------------------
+
+struct Chirp_Case {
+   int    in_length, out_length;
+   double w_initial, w_step;
+   int    weighted;
+};
+
+static const Chirp_Case cases[] = {
+   {172,  64, -M_PI/4.0,              2*M_PI/256.0, FALSE},
+   {220, 256, -M_PI,                  2*M_PI/256.0, FALSE},
+   {181, 180, -M_PI,                  2*M_PI/180.0, FALSE},
+   { 37,  50, -0.3,                   0.021,        FALSE},
+   {100, 160, -M_PI,                  2*M_PI/160.0, TRUE}
+};
+
+#define NCASES (sizeof(cases)/sizeof(cases[0]))
+
+//---------------------------------------------------------------------------
+// fill_input
+// Fills n complex elements, stride elements apart, with a deterministic
+// signal, different for each seed.  The imaginary parts are zero for
+// real input.
+//---------------------------------------------------------------------------
+
+static void fill_input(float x[], int n, unsigned int stride,
+                       int complex_input, unsigned int seed) {
+
+   int i;
+   for(i=0; i<n; i++){
+      x[2*i*stride]   = 1.0 + sin(0.23*(i+1) + seed) + 0.001*((i*13) % 97);
+      x[2*i*stride+1] = complex_input ? cos(0.71*(i+1) - seed) : 0.0;
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// new_weight
+// Returns complex output weights of out_length samples: a smooth window
+// with a linear phase, as for a shifted field of view.
+//---------------------------------------------------------------------------
+
+static double *new_weight(int out_length) {
+
+   double *weight = new double[2*out_length];
+   double window;
+   int    k;
+   for(k=0; k<out_length; k++){
+      window        = 0.54 - 0.46*cos(2*M_PI*k/(out_length-1));
+      weight[2*k]   = window*cos(0.3*k);
+      weight[2*k+1] = window*sin(0.3*k);
+   }
+   return weight;
+
+}
+
+//---------------------------------------------------------------------------
+// direct_chirp
+// Returns the out_length DFT samples along exp(-j*(w_initial+k*w_step))
+// of in_length complex elements, computed in long double.
+//---------------------------------------------------------------------------
+
+static void direct_chirp(const Chirp_Case& c, const double weight[],
+                         const float in[], double out[]) {
+
+   int k, n;
+   for(k=0; k<c.out_length; k++){
+      const long double w = (long double)c.w_initial +
+                            (long double)k*c.w_step;
+      long double re = 0.0L, im = 0.0L;
+      for(n=0; n<c.in_length; n++){
+         const long double cs = cosl(w*n), sn = -sinl(w*n);
+         re += in[2*n]*cs - in[2*n+1]*sn;
+         im += in[2*n]*sn + in[2*n+1]*cs;
+      }
+      const double wr = (weight != NULL) ? weight[2*k]   : 1.0;
+      const double wi = (weight != NULL) ? weight[2*k+1] : 0.0;
+      out[2*k]   = (double)(wr*re - wi*im);
+      out[2*k+1] = (double)(wr*im + wi*re);
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// relative_error
+// Returns the largest difference of n complex elements, over the largest
+// element of the reference.
+//---------------------------------------------------------------------------
+
+static double relative_error(const float x[], const double ref[], int n) {
+
+   double error = 0.0, scale = 0.0, d;
+   int    i;
+
+   for(i=0; i<2*n; i++){
+      d = fabs(x[i] - ref[i]);
+      if (d > error) error = d;
+      if (fabs(ref[i]) > scale) scale = fabs(ref[i]);
+   }
+   return (scale > 0.0) ? error/scale : error;
+
+}
+
+//---------------------------------------------------------------------------
+// check_apply
+// Returns TRUE if apply gives the direct DFT samples of one complex and
+// one real vector.
+//---------------------------------------------------------------------------
+
+static int check_apply(const Chirp_Algorithm& chirp, const Chirp_Case& c,
+                       const double weight[]) {
+
+   float  *in   = new float[2*c.in_length];
+   float  *real = new float[c.in_length];
+   float  *out  = new float[2*c.out_length];
+   double *ref  = new double[2*c.out_length];
+   double *work = new double[chirp.get_workspace_length()];
+   int    good  = TRUE;
+   int    i;
+
+   fill_input(in, c.in_length, 1, TRUE, 1);
+   direct_chirp(c, weight, in, ref);
+   chirp.apply(TRUE, in, 1, out, 1, work);
+   if (relative_error(out, ref, c.out_length) > TOLERANCE_APPLY) {
+      cerr << c.in_length << " -> " << c.out_length
+           << ": complex apply is wrong" << endl;
+      good = FALSE;
+   }
+
+   fill_input(in, c.in_length, 1, FALSE, 2);
+   for(i=0; i<c.in_length; i++) real[i] = in[2*i];
+   direct_chirp(c, weight, in, ref);
+   chirp.apply(FALSE, real, 1, out, 1, work);
+   if (relative_error(out, ref, c.out_length) > TOLERANCE_APPLY) {
+      cerr << c.in_length << " -> " << c.out_length
+           << ": real apply is wrong" << endl;
+      good = FALSE;
+   }
+
+   delete[] in;
+   delete[] real;
+   delete[] out;
+   delete[] ref;
+   delete[] work;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_rows
+// Returns TRUE if apply_rows gives, for each of nvec vectors, the result
+// of apply to that vector alone.
+//---------------------------------------------------------------------------
+
+static int check_rows(const Chirp_Algorithm& chirp, const Chirp_Case& c,
+                      int complex_input, unsigned int nvec) {
+
+   const unsigned int in_dist  = c.in_length + TEST_PAD;
+   const unsigned int out_dist = c.out_length + TEST_PAD;
+   const unsigned int nfloat   = complex_input ? 2 : 1;
+   float  *in    = new float[nfloat*in_dist*nvec];
+   float  *vec   = new float[2*c.in_length];
+   float  *out   = new float[2*out_dist*nvec];
+   float  *one   = new float[2*c.out_length];
+   double *ref   = new double[2*c.out_length];
+   double *work  = new double[chirp.get_batch_workspace_length()];
+   int    good   = TRUE;
+   unsigned int v;
+   int    i;
+
+   for(v=0; v<nvec; v++){
+      fill_input(vec, c.in_length, 1, complex_input, 10 + v);
+      for(i=0; i<c.in_length; i++){
+         if (complex_input) {
+            in[2*(in_dist*v + i)]     = vec[2*i];
+            in[2*(in_dist*v + i) + 1] = vec[2*i+1];
+         } else {
+            in[in_dist*v + i] = vec[2*i];
+         }
+      }
+   }
+
+   chirp.apply_rows(complex_input, nvec, in, in_dist, out, out_dist, work);
+
+   for(v=0; v<nvec; v++){
+      chirp.apply(complex_input, in + nfloat*in_dist*v, 1, one, 1, work);
+      for(i=0; i<2*c.out_length; i++) ref[i] = one[i];
+      if (relative_error(out + 2*out_dist*v, ref, c.out_length) >
+          TOLERANCE_APPLY) {
+         cerr << c.in_length << " -> " << c.out_length << ": "
+              << (complex_input ? "complex" : "real") << " row " << v
+              << " of " << nvec << " differs from apply" << endl;
+         good = FALSE;
+      }
+   }
+
+   delete[] in;
+   delete[] vec;
+   delete[] out;
+   delete[] one;
+   delete[] ref;
+   delete[] work;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_pairs
+// Returns TRUE if apply_rows gives the same result for nvec real vectors
+// as for the same vectors stored as complex with zero imaginary parts.
+// Real vectors are transformed in pairs when the output frequencies are
+// symmetric about zero, and complex vectors never are, so the two take
+// different paths; an odd nvec leaves the last vector unpaired.
+//---------------------------------------------------------------------------
+
+static int check_pairs(const Chirp_Algorithm& chirp, const Chirp_Case& c,
+                       unsigned int nvec) {
+
+   float  *real  = new float[c.in_length*nvec];
+   float  *cmplx = new float[2*c.in_length*nvec];
+   float  *out   = new float[2*c.out_length*nvec];
+   float  *out_c = new float[2*c.out_length*nvec];
+   double *ref   = new double[2*c.out_length];
+   double *work  = new double[chirp.get_batch_workspace_length()];
+   int    good   = TRUE;
+   unsigned int v;
+   int    i;
+
+   for(v=0; v<nvec; v++){
+      fill_input(cmplx + 2*c.in_length*v, c.in_length, 1, FALSE, 20 + v);
+      for(i=0; i<c.in_length; i++){
+         real[c.in_length*v + i] = cmplx[2*(c.in_length*v + i)];
+      }
+   }
+
+   chirp.apply_rows(FALSE, nvec, real, c.in_length,
+                    out, c.out_length, work);
+   chirp.apply_rows(TRUE, nvec, cmplx, c.in_length,
+                    out_c, c.out_length, work);
+
+   for(v=0; v<nvec; v++){
+      for(i=0; i<2*c.out_length; i++) ref[i] = out_c[2*c.out_length*v + i];
+      if (relative_error(out + 2*c.out_length*v, ref, c.out_length) >
+          TOLERANCE_APPLY) {
+         cerr << c.in_length << " -> " << c.out_length << ": real row "
+              << v << " of " << nvec << " differs from complex" << endl;
+         good = FALSE;
+      }
+   }
+
+   delete[] real;
+   delete[] cmplx;
+   delete[] out;
+   delete[] out_c;
+   delete[] ref;
+   delete[] work;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_precision
+// Returns TRUE if apply_rows, for real and complex rows, and
+// apply_columns give the direct DFT samples of TEST_NVEC vectors, in the
+// precision set by set_precision.
+//---------------------------------------------------------------------------
+
+static int check_precision(const Chirp_Algorithm& chirp,
+                           const Chirp_Case& c, const double weight[]) {
+
+   const double tolerance =
+      ((MRI_FFT_Plan::get_precision() == MRI_FFT_Plan::SINGLE_PRECISION) ?
+       TOLERANCE_SINGLE : TOLERANCE_APPLY);
+   const char *name =
+      ((MRI_FFT_Plan::get_precision() == MRI_FFT_Plan::SINGLE_PRECISION) ?
+       "single" : "double");
+   float  *vec   = new float[2*c.in_length];
+   float  *real  = new float[c.in_length*TEST_NVEC];
+   float  *cmplx = new float[2*c.in_length*TEST_NVEC];
+   float  *cols  = new float[2*c.in_length*TEST_NVEC];
+   float  *out_r = new float[2*c.out_length*TEST_NVEC];
+   float  *out_c = new float[2*c.out_length*TEST_NVEC];
+   float  *out_t = new float[2*c.out_length*TEST_NVEC];
+   float  *col   = new float[2*c.out_length];
+   double *ref_r = new double[2*c.out_length*TEST_NVEC];
+   double *ref_c = new double[2*c.out_length*TEST_NVEC];
+   double *work  = new double[chirp.get_batch_workspace_length()];
+   int    good   = TRUE;
+   unsigned int v;
+   int    i;
+
+   for(v=0; v<TEST_NVEC; v++){
+      fill_input(vec, c.in_length, 1, FALSE, 30 + v);
+      direct_chirp(c, weight, vec, ref_r + 2*c.out_length*v);
+      for(i=0; i<c.in_length; i++) real[c.in_length*v + i] = vec[2*i];
+
+      fill_input(vec, c.in_length, 1, TRUE, 40 + v);
+      direct_chirp(c, weight, vec, ref_c + 2*c.out_length*v);
+      for(i=0; i<c.in_length; i++){
+         cmplx[2*(c.in_length*v + i)]     = vec[2*i];
+         cmplx[2*(c.in_length*v + i) + 1] = vec[2*i+1];
+         cols[2*(TEST_NVEC*i + v)]        = vec[2*i];
+         cols[2*(TEST_NVEC*i + v) + 1]    = vec[2*i+1];
+      }
+   }
+
+   chirp.apply_rows(FALSE, TEST_NVEC, real, c.in_length,
+                    out_r, c.out_length, work);
+   chirp.apply_rows(TRUE, TEST_NVEC, cmplx, c.in_length,
+                    out_c, c.out_length, work);
+   chirp.apply_columns(TEST_NVEC, cols, out_t, work);
+
+   for(v=0; v<TEST_NVEC; v++){
+      if (relative_error(out_r + 2*c.out_length*v, ref_r + 2*c.out_length*v,
+                         c.out_length) > tolerance) {
+         cerr << c.in_length << " -> " << c.out_length << ": " << name
+              << " precision real row " << v << " is wrong" << endl;
+         good = FALSE;
+      }
+      if (relative_error(out_c + 2*c.out_length*v, ref_c + 2*c.out_length*v,
+                         c.out_length) > tolerance) {
+         cerr << c.in_length << " -> " << c.out_length << ": " << name
+              << " precision complex row " << v << " is wrong" << endl;
+         good = FALSE;
+      }
+      for(i=0; i<c.out_length; i++){
+         col[2*i]   = out_t[2*(TEST_NVEC*i + v)];
+         col[2*i+1] = out_t[2*(TEST_NVEC*i + v) + 1];
+      }
+      if (relative_error(col, ref_c + 2*c.out_length*v, c.out_length) >
+          tolerance) {
+         cerr << c.in_length << " -> " << c.out_length << ": " << name
+              << " precision column " << v << " is wrong" << endl;
+         good = FALSE;
+      }
+   }
+
+   delete[] vec;
+   delete[] real;
+   delete[] cmplx;
+   delete[] cols;
+   delete[] out_r;
+   delete[] out_c;
+   delete[] out_t;
+   delete[] col;
+   delete[] ref_r;
+   delete[] ref_c;
+   delete[] work;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   const unsigned int nvecs[] = {1, 2, CHIRP_BLOCK, TEST_NVEC};
+   int          good = TRUE;
+   unsigned int icase, in, complex_input;
+
+   for(icase=0; icase<NCASES; icase++){
+      const Chirp_Case& c = cases[icase];
+      double *weight = c.weighted ? new_weight(c.out_length) : NULL;
+      Chirp_Algorithm chirp(c.in_length, c.out_length,
+                            c.w_initial, c.w_step, weight);
+
+      if (!check_apply(chirp, c, weight)) good = FALSE;
+      for(complex_input=0; complex_input<2; complex_input++){
+         for(in=0; in<sizeof(nvecs)/sizeof(nvecs[0]); in++){
+            if (!check_rows(chirp, c, complex_input, nvecs[in])) {
+               good = FALSE;
+            }
+         }
+      }
+      for(in=0; in<sizeof(nvecs)/sizeof(nvecs[0]); in++){
+         if (!check_pairs(chirp, c, nvecs[in])) good = FALSE;
+      }
+
+      if (!check_precision(chirp, c, weight)) good = FALSE;
+      MRI_FFT_Plan::set_precision(MRI_FFT_Plan::SINGLE_PRECISION);
+      if (!check_precision(chirp, c, weight)) good = FALSE;
+      MRI_FFT_Plan::set_precision(MRI_FFT_Plan::DOUBLE_PRECISION);
+      delete[] weight;
+   }
+
+   cout << "Chirp_Algorithm, " << NCASES << " cases: "
+        << (good ? "PASS" : "FAIL") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
@@ -0,0 +1,378 @@
+//===========================================================================
+// TESTFFT.CXX
+// Checks MRI_FFT_Plan and MRI_Real_FFT_Plan against a direct DFT in long
+// double, for every valid length up to TEST_MAX_LENGTH: one vector in
+// both directions, batches of rows and columns, and the real transforms.
+// The float transforms are checked in both precisions of
+// MRI_FFT_Plan::set_precision.  Exits with a non-zero status if any
+// check fails.
+//===========================================================================
+
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include "../mrifft.h"
+
+using namespace std;
+
+#define TEST_MAX_LENGTH 1024
+
+// Allowed error relative to the largest output element: of the double
+// transforms, of float data transformed in double, and of float data
+// transformed in float
+#define TOLERANCE_DOUBLE 1.0e-14
+#define TOLERANCE_FLOAT  2.0e-7
+#define TOLERANCE_SINGLE 1.0e-6
+
+// Vectors of the batch checks, and the extra complex elements between
+// them, so that rows are not contiguous
+#define TEST_NVEC 3
+#define TEST_PAD  5
+
+//---------------------------------------------------------------------------
+// fill_input
+// Fills n complex elements with a deterministic signal of all
+// frequencies, different for each seed.
+//---------------------------------------------------------------------------
+
+static void fill_input(double x[], unsigned int n, unsigned int seed) {
+
+   unsigned int i;
+   for(i=0; i<n; i++){
+      x[2*i]   = sin(0.37*(i+1) + seed) + 0.01*((i*7919 + seed) % 101);
+      x[2*i+1] = cos(0.91*(i+1) - seed) - 0.02*((i*104729) % 53);
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// direct_dft
+// Returns in out the unnormalized DFT of n complex elements, computed in
+// long double from a table of the n roots of unity.
+//---------------------------------------------------------------------------
+
+static void direct_dft(const double in[], double out[], unsigned int n,
+                       MRI_FFT_Plan::Direction direction) {
+
+   const long double two_pi = 6.283185307179586476925286766559L;
+   long double       *c = new long double[n];
+   long double       *s = new long double[n];
+   unsigned int      j, k, m;
+
+   for(m=0; m<n; m++){
+      c[m] = cosl(two_pi*m/n);
+      s[m] = (int)direction*sinl(two_pi*m/n);
+   }
+
+   for(k=0; k<n; k++){
+      long double re = 0.0L, im = 0.0L;
+      for(j=0, m=0; j<n; j++, m=(m+k)%n){
+         re += in[2*j]*c[m] - in[2*j+1]*s[m];
+         im += in[2*j]*s[m] + in[2*j+1]*c[m];
+      }
+      out[2*k]   = (double)re;
+      out[2*k+1] = (double)im;
+   }
+
+   delete[] c;
+   delete[] s;
+
+}
+
+//---------------------------------------------------------------------------
+// relative_error
+// Returns the largest difference of n complex elements, over the largest
+// element of the reference.  Elements are dist doubles apart in x.
+//---------------------------------------------------------------------------
+
+static double relative_error(const double x[], unsigned int dist,
+                             const double ref[], unsigned int n) {
+
+   double       error = 0.0, scale = 0.0, d;
+   unsigned int i, p;
+
+   for(i=0; i<n; i++){
+      for(p=0; p<2; p++){
+         d = fabs(x[i*dist+p] - ref[2*i+p]);
+         if (d > error) error = d;
+         if (fabs(ref[2*i+p]) > scale) scale = fabs(ref[2*i+p]);
+      }
+   }
+   return (scale > 0.0) ? error/scale : error;
+
+}
+
+static double relative_error(const float x[], unsigned int dist,
+                             const double ref[], unsigned int n) {
+
+   double       *y = new double[2*n];
+   unsigned int i;
+
+   for(i=0; i<n; i++){
+      y[2*i]   = x[i*dist];
+      y[2*i+1] = x[i*dist+1];
+   }
+   const double error = relative_error(y, 2, ref, n);
+
+   delete[] y;
+   return error;
+
+}
+
+//---------------------------------------------------------------------------
+// check_vector
+// Returns TRUE if one vector of length n is transformed correctly in
+// both directions, and forward then inverse gives n times the input.
+//---------------------------------------------------------------------------
+
+static int check_vector(const MRI_FFT_Plan& plan, unsigned int n) {
+
+   double *in  = new double[2*n];
+   double *ref = new double[2*n];
+   double *x   = new double[2*n];
+   int    good = TRUE;
+   unsigned int i;
+
+   fill_input(in, n, n);
+
+   for(i=0; i<2*n; i++) x[i] = in[i];
+   direct_dft(in, ref, n, MRI_FFT_Plan::FORWARD);
+   plan.forward(x);
+   if (relative_error(x, 2, ref, n) > TOLERANCE_DOUBLE) {
+      cerr << "Length " << n << ": forward transform is wrong" << endl;
+      good = FALSE;
+   }
+
+   plan.inverse(x);
+   for(i=0; i<2*n; i++) ref[i] = n*in[i];
+   if (relative_error(x, 2, ref, n) > TOLERANCE_DOUBLE) {
+      cerr << "Length " << n << ": inverse does not undo forward" << endl;
+      good = FALSE;
+   }
+
+   for(i=0; i<2*n; i++) x[i] = in[i];
+   direct_dft(in, ref, n, MRI_FFT_Plan::INVERSE);
+   plan.inverse(x);
+   if (relative_error(x, 2, ref, n) > TOLERANCE_DOUBLE) {
+      cerr << "Length " << n << ": inverse transform is wrong" << endl;
+      good = FALSE;
+   }
+
+   delete[] in;
+   delete[] ref;
+   delete[] x;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_batches
+// Returns TRUE if transform_rows and transform_columns give the DFT of
+// each of TEST_NVEC vectors of length n.
+//---------------------------------------------------------------------------
+
+static int check_batches(const MRI_FFT_Plan& plan, unsigned int n) {
+
+   const unsigned int dist   = n + TEST_PAD;
+   const unsigned int stride = TEST_NVEC + TEST_PAD;
+   double *in   = new double[2*n];
+   double *ref  = new double[2*n*TEST_NVEC];
+   double *rows = new double[2*dist*TEST_NVEC];
+   double *cols = new double[2*stride*n];
+   double *work = new double[plan.get_workspace_length()];
+   int    good  = TRUE;
+   unsigned int v, i;
+
+   for(v=0; v<TEST_NVEC; v++){
+      fill_input(in, n, 1000*v + n);
+      direct_dft(in, ref + 2*n*v, n, MRI_FFT_Plan::FORWARD);
+      for(i=0; i<n; i++){
+         rows[2*(dist*v + i)]     = in[2*i];
+         rows[2*(dist*v + i) + 1] = in[2*i+1];
+         cols[2*(stride*i + v)]     = in[2*i];
+         cols[2*(stride*i + v) + 1] = in[2*i+1];
+      }
+   }
+
+   plan.transform_rows(rows, TEST_NVEC, dist, MRI_FFT_Plan::FORWARD);
+   plan.transform_columns(cols, TEST_NVEC, stride, MRI_FFT_Plan::FORWARD,
+                          work);
+
+   for(v=0; v<TEST_NVEC; v++){
+      if (relative_error(rows + 2*dist*v, 2, ref + 2*n*v, n) >
+          TOLERANCE_DOUBLE) {
+         cerr << "Length " << n << ": row " << v << " is wrong" << endl;
+         good = FALSE;
+      }
+      if (relative_error(cols + 2*v, 2*stride, ref + 2*n*v, n) >
+          TOLERANCE_DOUBLE) {
+         cerr << "Length " << n << ": column " << v << " is wrong" << endl;
+         good = FALSE;
+      }
+   }
+
+   delete[] in;
+   delete[] ref;
+   delete[] rows;
+   delete[] cols;
+   delete[] work;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_real
+// Returns TRUE if the real transform of even length n gives the
+// non-negative frequencies of the DFT, and its inverse n times the input.
+//---------------------------------------------------------------------------
+
+static int check_real(unsigned int n) {
+
+   const MRI_Real_FFT_Plan *plan = MRI_Real_FFT_Plan::get(n);
+   double *in   = new double[2*n];
+   double *ref  = new double[2*n];
+   double *real = new double[n];
+   double *freq = new double[2*(n/2+1)];
+   double *back = new double[n];
+   int    good  = TRUE;
+   unsigned int i;
+
+   fill_input(in, n, 7*n);
+   for(i=0; i<n; i++){
+      in[2*i+1] = 0.0;
+      real[i]   = in[2*i];
+   }
+   direct_dft(in, ref, n, MRI_FFT_Plan::FORWARD);
+
+   plan->forward(real, freq);
+   if (relative_error(freq, 2, ref, n/2+1) > TOLERANCE_DOUBLE) {
+      cerr << "Length " << n << ": real forward transform is wrong" << endl;
+      good = FALSE;
+   }
+
+   plan->inverse(freq, back);
+   for(i=0; i<n; i++){
+      ref[2*i]   = n*real[i];
+      ref[2*i+1] = 0.0;
+      in[2*i]    = back[i];
+      in[2*i+1]  = 0.0;
+   }
+   if (relative_error(in, 2, ref, n) > TOLERANCE_DOUBLE) {
+      cerr << "Length " << n << ": real inverse does not undo forward"
+           << endl;
+      good = FALSE;
+   }
+
+   delete[] in;
+   delete[] ref;
+   delete[] real;
+   delete[] freq;
+   delete[] back;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_float
+// Returns TRUE if the float transforms give the DFT of TEST_NVEC float
+// vectors of length n: one vector, computed in float, and batches of
+// rows and columns, computed in the precision set by set_precision.
+// The reference is the DFT of the input rounded to float.
+//---------------------------------------------------------------------------
+
+static int check_float(const MRI_FFT_Plan& plan, unsigned int n) {
+
+   const unsigned int dist   = n + TEST_PAD;
+   const unsigned int stride = TEST_NVEC + TEST_PAD;
+   const double tolerance =
+      ((MRI_FFT_Plan::get_precision() == MRI_FFT_Plan::SINGLE_PRECISION) ?
+       TOLERANCE_SINGLE : TOLERANCE_FLOAT);
+   double *in   = new double[2*n];
+   double *ref  = new double[2*n*TEST_NVEC];
+   float  *x    = new float[2*n];
+   float  *rows = new float[2*dist*TEST_NVEC];
+   float  *cols = new float[2*stride*n];
+   double *work = new double[plan.get_workspace_length()];
+   int    good  = TRUE;
+   unsigned int v, i;
+
+   for(v=0; v<TEST_NVEC; v++){
+      fill_input(in, n, 2000*v + n);
+      for(i=0; i<2*n; i++) in[i] = (float)in[i];
+      direct_dft(in, ref + 2*n*v, n, MRI_FFT_Plan::FORWARD);
+      for(i=0; i<n; i++){
+         rows[2*(dist*v + i)]     = in[2*i];
+         rows[2*(dist*v + i) + 1] = in[2*i+1];
+         cols[2*(stride*i + v)]     = in[2*i];
+         cols[2*(stride*i + v) + 1] = in[2*i+1];
+      }
+   }
+
+   for(i=0; i<2*n; i++) x[i] = rows[i];
+   plan.forward(x);
+   if (relative_error(x, 2, ref, n) > TOLERANCE_SINGLE) {
+      cerr << "Length " << n << ": float forward transform is wrong"
+           << endl;
+      good = FALSE;
+   }
+
+   plan.transform_rows(rows, TEST_NVEC, dist, MRI_FFT_Plan::FORWARD, work);
+   plan.transform_columns(cols, TEST_NVEC, stride, MRI_FFT_Plan::FORWARD,
+                          work);
+
+   for(v=0; v<TEST_NVEC; v++){
+      if (relative_error(rows + 2*dist*v, 2, ref + 2*n*v, n) > tolerance) {
+         cerr << "Length " << n << ": float row " << v << " is wrong"
+              << endl;
+         good = FALSE;
+      }
+      if (relative_error(cols + 2*v, 2*stride, ref + 2*n*v, n) >
+          tolerance) {
+         cerr << "Length " << n << ": float column " << v << " is wrong"
+              << endl;
+         good = FALSE;
+      }
+   }
+
+   delete[] in;
+   delete[] ref;
+   delete[] x;
+   delete[] rows;
+   delete[] cols;
+   delete[] work;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   int          good = TRUE;
+   unsigned int n, nlengths = 0;
+
+   for(n=1; n<=TEST_MAX_LENGTH; n++){
+      if (!MRI_FFT_Plan::is_valid_length(n)) continue;
+      nlengths++;
+
+      const MRI_FFT_Plan *plan = MRI_FFT_Plan::get(n);
+      if (!check_vector(*plan, n))  good = FALSE;
+      if (!check_batches(*plan, n)) good = FALSE;
+
+      MRI_FFT_Plan::set_precision(MRI_FFT_Plan::DOUBLE_PRECISION);
+      if (!check_float(*plan, n)) good = FALSE;
+      MRI_FFT_Plan::set_precision(MRI_FFT_Plan::SINGLE_PRECISION);
+      if (!check_float(*plan, n)) good = FALSE;
+      MRI_FFT_Plan::set_precision(MRI_FFT_Plan::DOUBLE_PRECISION);
+
+      if (n%2 == 0 && MRI_FFT_Plan::is_valid_length(n/2) &&
+          !check_real(n)) good = FALSE;
+   }
+
+   cout << "MRI_FFT_Plan, " << nlengths << " lengths up to "
+        << TEST_MAX_LENGTH << ": " << (good ? "PASS" : "FAIL") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
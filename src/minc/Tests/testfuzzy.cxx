@@ -0,0 +1,254 @@
+//===========================================================================
+// TESTFUZZY.CXX
+// Checks the runs that Fuzzy_Label_Phantom finds in fuzzy label slices,
+// and that mixing the tissues over their runs gives, bit for bit, the
+// dense weighted average over every element, for real and complex
+// slices.  Exits with a non-zero status if any check fails.
+//===========================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <mrisim/fuzzy_phantom.h>
+
+using namespace std;
+
+// Tissues of the phantom, the first being background
+#define TEST_NTISSUES 6
+
+// Random slices of each size
+#define TEST_NSLICES 50
+
+//---------------------------------------------------------------------------
+// Test_Phantom
+// A Fuzzy_Phantom whose run finding and mixing are accessible.
+//---------------------------------------------------------------------------
+
+class Test_Phantom : public Fuzzy_Phantom {
+   public:
+      Test_Phantom(unsigned int n_tissue_classes) :
+         Phantom(n_tissue_classes), Fuzzy_Phantom(n_tissue_classes) {}
+
+      using Fuzzy_Label_Phantom::_find_spans;
+      using Fuzzy_Label_Phantom::_mix_tissues;
+};
+
+//---------------------------------------------------------------------------
+// Slice sizes
+// Rows and columns: less than a mixing tile, an odd number of tiles with
+// a partial last tile, and a single row.
+//---------------------------------------------------------------------------
+
+static const unsigned int sizes[][2] = {
+   {  3,   7},
+   {217, 181},
+   {  1, 600}
+};
+
+#define NSIZES (sizeof(sizes)/sizeof(sizes[0]))
+
+//---------------------------------------------------------------------------
+// next_random
+// Returns the next value in [0,1) of a linear congruential generator.
+//---------------------------------------------------------------------------
+
+static double next_random(unsigned long& state) {
+
+   state = (state*1103515245UL + 12345UL) & 0x7fffffffUL;
+   return (double)state/2147483648.0;
+
+}
+
+//---------------------------------------------------------------------------
+// fill_labels
+// Fills the fractions of nelements voxels for each tissue.  Tissues
+// other than background hold fractions over runs of random lengths
+// separated by zero gaps both shorter and longer than LABEL_SPAN_GAP,
+// with isolated zeros inside the runs; the last tissue is absent from
+// every other slice.  Background takes what the other tissues leave, so
+// every voxel has a nonzero total.
+//---------------------------------------------------------------------------
+
+static void fill_labels(float *label[], unsigned int nelements,
+                        unsigned int islice, unsigned long& state) {
+
+   unsigned int itissue, n, length;
+   int          inside;
+
+   for (itissue=1; itissue<TEST_NTISSUES; itissue++){
+      inside = (next_random(state) < 0.5);
+      n      = 0;
+      while (n < nelements) {
+         length = 1 + (unsigned int)(next_random(state)*3*LABEL_SPAN_GAP);
+         for (; length>0 && n<nelements; length--, n++){
+            label[itissue][n] = (inside && next_random(state) > 0.05) ?
+                                0.2*next_random(state) : 0.0;
+         }
+         inside = !inside;
+      }
+      if (itissue == TEST_NTISSUES-1 && islice % 2 == 0) {
+         for (n=0; n<nelements; n++) label[itissue][n] = 0.0;
+      }
+   }
+
+   for (n=0; n<nelements; n++){
+      label[0][n] = 1.0;
+      for (itissue=1; itissue<TEST_NTISSUES; itissue++){
+         label[0][n] -= label[itissue][n];
+      }
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// check_spans
+// Returns TRUE if the runs of a label slice are in order, begin and end
+// on nonzero fractions, are LABEL_SPAN_GAP or more zeros apart, and hold
+// every nonzero fraction.
+//---------------------------------------------------------------------------
+
+static int check_spans(const Fuzzy_Label_Slice& slice,
+                       unsigned int nelements) {
+
+   unsigned int k, n, begin, end, covered = 0;
+   int          good = TRUE;
+
+   for (k=0; k<slice.nspans; k++){
+      begin = slice.span[2*k];
+      end   = slice.span[2*k+1];
+      if (begin >= end || end > nelements ||
+          slice.label[begin] == 0.0 || slice.label[end-1] == 0.0 ||
+          (k > 0 && begin < slice.span[2*k-1] + LABEL_SPAN_GAP)) {
+         good = FALSE;
+      }
+      for (n=covered; n<begin && n<nelements; n++){
+         if (slice.label[n] != 0.0) good = FALSE;
+      }
+      covered = end;
+   }
+   for (n=covered; n<nelements; n++){
+      if (slice.label[n] != 0.0) good = FALSE;
+   }
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_mix
+// Returns TRUE if the real and complex mixes over the runs of the label
+// slices equal the dense mixes, accumulated in the same order.
+//---------------------------------------------------------------------------
+
+static int check_mix(const Test_Phantom& phantom,
+                     const Fuzzy_Label_Slice label_slice[],
+                     unsigned int nrows, unsigned int ncols,
+                     const double real[], const double imag[]) {
+
+   const unsigned int nelements = nrows*ncols;
+   Real_Slice    real_slice(nrows, ncols);
+   Complex_Slice complex_slice(nrows, ncols);
+   float         *dense   = new float[nelements];
+   float         *dense_c = new float[2*nelements];
+   float         acc, re, im, sum;
+   unsigned int  itissue, n;
+   int           good;
+
+   for (n=0; n<nelements; n++){
+      acc = re = im = sum = 0.0;
+      for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+         acc += label_slice[itissue].label[n] * real[itissue];
+         re  += label_slice[itissue].label[n] * real[itissue];
+         im  += label_slice[itissue].label[n] * imag[itissue];
+         sum += label_slice[itissue].label[n];
+      }
+      dense[n]       = acc / sum;
+      dense_c[2*n]   = re / sum;
+      dense_c[2*n+1] = im / sum;
+   }
+
+   phantom._mix_tissues(label_slice, real, real_slice);
+   phantom._mix_tissues(label_slice, real, imag, complex_slice);
+
+   good = (memcmp(real_slice.row_ptr(0), dense,
+                  nelements*sizeof(float)) == 0 &&
+           memcmp(complex_slice.row_ptr(0), dense_c,
+                  2*nelements*sizeof(float)) == 0);
+
+   delete[] dense;
+   delete[] dense_c;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   Test_Phantom      phantom(TEST_NTISSUES);
+   float             *label[TEST_NTISSUES];
+   Fuzzy_Label_Slice label_slice[TEST_NTISSUES];
+   double            real[TEST_NTISSUES], imag[TEST_NTISSUES];
+   unsigned long     state = 1;
+   unsigned int      isize, islice, itissue, nelements;
+   int               good  = TRUE;
+
+   for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+      phantom.install_tissue(new Tissue(500.0 + 200.0*itissue,
+                                        50.0 + 20.0*itissue,
+                                        30.0 + 10.0*itissue, 0.7),
+                             itissue);
+      real[itissue] = 100.0*next_random(state);
+      imag[itissue] = 100.0*next_random(state) - 50.0;
+   }
+
+   if (phantom.get_num_tissues() != TEST_NTISSUES) {
+      cerr << "Installed " << phantom.get_num_tissues() << " of "
+           << TEST_NTISSUES << " tissues" << endl;
+      return EXIT_FAILURE;
+   }
+
+   for (isize=0; isize<NSIZES; isize++){
+      nelements = sizes[isize][0]*sizes[isize][1];
+      for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+         label[itissue] = new float[nelements];
+      }
+
+      for (islice=0; islice<TEST_NSLICES; islice++){
+         fill_labels(label, nelements, islice, state);
+
+         for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+            label_slice[itissue].label = label[itissue];
+            Test_Phantom::_find_spans(label_slice[itissue], nelements);
+            if (!check_spans(label_slice[itissue], nelements)) {
+               cerr << sizes[isize][0] << "x" << sizes[isize][1]
+                    << " slice " << islice << ": runs of tissue "
+                    << itissue << " are wrong" << endl;
+               good = FALSE;
+            }
+         }
+
+         if (!check_mix(phantom, label_slice, sizes[isize][0],
+                        sizes[isize][1], real, imag)) {
+            cerr << sizes[isize][0] << "x" << sizes[isize][1]
+                 << " slice " << islice << ": mix by runs differs from "
+                 << "the dense mix" << endl;
+            good = FALSE;
+         }
+
+         for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+            delete[] label_slice[itissue].span;
+         }
+      }
+
+      for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+         delete[] label[itissue];
+      }
+   }
+
+   cout << "Fuzzy_Label_Phantom, " << NSIZES*TEST_NSLICES << " slices: "
+        << (good ? "PASS" : "FAIL") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
@@ -0,0 +1,334 @@
+//===========================================================================
+// TESTPACKED.CXX
+// Checks Packed_Label_File: the tissues that pack_slice keeps for each
+// voxel against a direct selection of the largest fractions, and that a
+// packed phantom written to a file is read back unchanged, with each
+// slice on an aligned chunk.  Also checks that missing, foreign and
+// truncated files are refused.  Exits with a non-zero status if any
+// check fails.
+//===========================================================================
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <mrisim/packed_label_file.h>
+
+using namespace std;
+
+// Tissues of the phantom, with labels that are not consecutive
+#define TEST_NTISSUES 9
+
+static const Label labels[TEST_NTISSUES] = {0, 1, 2, 3, 5, 8, 13, 21, 34};
+
+// Volume of the file round trip: a slice is not a multiple of the
+// chunk alignment
+#define TEST_NSLICES 3
+#define TEST_NROWS   37
+#define TEST_NCOLS   29
+
+#define TEST_NELEMENTS (TEST_NROWS*TEST_NCOLS)
+
+//---------------------------------------------------------------------------
+// next_random
+// Returns the next value in [0,1) of a linear congruential generator.
+//---------------------------------------------------------------------------
+
+static double next_random(unsigned long& state) {
+
+   state = (state*1103515245UL + 12345UL) & 0x7fffffffUL;
+   return (double)state/2147483648.0;
+
+}
+
+//---------------------------------------------------------------------------
+// fill_fractions
+// Fills the fractions of nelements voxels for each tissue.  About half
+// are zero, a few negative, and some repeat the fraction of the tissue
+// before so that there are ties; every 17th voxel is empty.
+//---------------------------------------------------------------------------
+
+static void fill_fractions(float *fraction[], unsigned int nelements,
+                           unsigned long& state) {
+
+   unsigned int itissue, n;
+   double       r;
+
+   for (n=0; n<nelements; n++){
+      for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+         r = next_random(state);
+         if (n % 17 == 0 || r < 0.5) {
+            fraction[itissue][n] = 0.0;
+         } else if (r < 0.55) {
+            fraction[itissue][n] = -0.1;
+         } else if (r < 0.65 && itissue > 0) {
+            fraction[itissue][n] = fraction[itissue-1][n];
+         } else {
+            fraction[itissue][n] = next_random(state);
+         }
+      }
+      // A fraction too small to quantize above zero
+      if (n % 23 == 1) fraction[TEST_NTISSUES-1][n] = 1.0e-4;
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// check_pack
+// Returns TRUE if pack_slice keeps, for each voxel, the ntop largest
+// positive fractions, largest first and the lower tissue first among
+// equals, quantized so that the largest is 255, with the entries left
+// over and those quantized to zero unused.
+//---------------------------------------------------------------------------
+
+static int check_pack(unsigned int ntop, const float *const fraction[],
+                      unsigned int nelements) {
+
+   Packed_Label *slice = new Packed_Label[nelements*ntop];
+   int          used[TEST_NTISSUES];
+   unsigned int n, j, itissue, best, quantized;
+   float        largest;
+   int          good = TRUE;
+
+   Packed_Label_File::pack_slice(ntop, TEST_NTISSUES, labels, fraction,
+                                 nelements, slice);
+
+   for (n=0; n<nelements; n++){
+      for (itissue=0; itissue<TEST_NTISSUES; itissue++) used[itissue] = 0;
+      largest = 0.0;
+
+      for (j=0; j<ntop; j++){
+         best = TEST_NTISSUES;
+         for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+            if (!used[itissue] && fraction[itissue][n] > 0.0 &&
+                (best == TEST_NTISSUES ||
+                 fraction[itissue][n] > fraction[best][n])) {
+               best = itissue;
+            }
+         }
+         quantized = 0;
+         if (best < TEST_NTISSUES) {
+            used[best] = 1;
+            if (j == 0) largest = fraction[best][n];
+            quantized = (unsigned int)(255.0*fraction[best][n]/largest +
+                                       0.5);
+         }
+
+         const Packed_Label& entry = slice[n*ntop + j];
+         if ((quantized > 0 && (entry.label != labels[best] ||
+                                entry.fraction != quantized)) ||
+             (quantized == 0 && (entry.label != 0 ||
+                                 entry.fraction != 0))) {
+            cerr << "ntop " << ntop << ", voxel " << n << ": entry " << j
+                 << " is wrong" << endl;
+            good = FALSE;
+         }
+      }
+   }
+
+   delete[] slice;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// new_volume_info
+// Returns the volume information of the test phantom.
+//---------------------------------------------------------------------------
+
+static Volume_Info new_volume_info(void) {
+
+   static const char *names[3] = {"zspace", "yspace", "xspace"};
+   Volume_Info info;
+   int         i;
+
+   memset(&info, 0, sizeof(info));
+   info.number_of_dimensions = 3;
+   info.length[SLICE]  = TEST_NSLICES;
+   info.length[ROW]    = TEST_NROWS;
+   info.length[COLUMN] = TEST_NCOLS;
+   for (i=0; i<3; i++){
+      info.axes[i]  = i;
+      info.step[i]  = 0.5 + i;
+      info.start[i] = -90.0 + 3.0*i;
+      strcpy(info.dimension_names[i], names[i]);
+   }
+   return info;
+
+}
+
+//---------------------------------------------------------------------------
+// check_file
+// Returns TRUE if a packed phantom written to path is read back with the
+// same header and slices, and truncated or foreign copies are refused.
+//---------------------------------------------------------------------------
+
+static int check_file(const char *path, unsigned int ntop,
+                      float *fraction[], unsigned long& state) {
+
+   const Volume_Info info = new_volume_info();
+   Packed_Label      *slice[TEST_NSLICES];
+   Packed_Label_File writer, reader;
+   unsigned int      islice, n;
+   int               good = TRUE;
+
+   // --- Write --- //
+
+   for (islice=0; islice<TEST_NSLICES; islice++){
+      fill_fractions(fraction, TEST_NELEMENTS, state);
+      slice[islice] = new Packed_Label[TEST_NELEMENTS*ntop];
+      Packed_Label_File::pack_slice(ntop, TEST_NTISSUES, labels, fraction,
+                                    TEST_NELEMENTS, slice[islice]);
+   }
+
+   if (!writer.create(path, ntop, TEST_NTISSUES, labels, info)) {
+      cerr << "Cannot create " << path << endl;
+      good = FALSE;
+   }
+   for (islice=0; good && islice<TEST_NSLICES; islice++){
+      writer.write_slice(slice[islice]);
+   }
+   if (good && !writer.finish()) {
+      cerr << "Cannot write " << path << endl;
+      good = FALSE;
+   }
+
+   // --- Read back --- //
+
+   if (good && !reader.open(path)) {
+      cerr << "Cannot open " << path << endl;
+      good = FALSE;
+   }
+   if (good) {
+      const Volume_Info& read_info = reader.get_volume_info();
+      int same_header = (reader.get_ntop() == ntop &&
+                         reader.get_ntissues() == TEST_NTISSUES &&
+                         reader.get_slice_bytes() ==
+                            TEST_NELEMENTS*ntop*sizeof(Packed_Label));
+      int same_info   = (read_info.number_of_dimensions == 3);
+      for (n=0; same_header && n<TEST_NTISSUES; n++){
+         if (reader.get_tissue_label(n) != labels[n]) same_header = FALSE;
+      }
+      for (n=0; n<3; n++){
+         if (read_info.length[n] != info.length[n] ||
+             read_info.step[n]   != info.step[n]   ||
+             read_info.start[n]  != info.start[n]  ||
+             strcmp(read_info.dimension_names[n],
+                    info.dimension_names[n]) != 0) {
+            same_info = FALSE;
+         }
+      }
+      if (!same_header) {
+         cerr << "ntop " << ntop << ": header read back is wrong" << endl;
+         good = FALSE;
+      }
+      if (!same_info) {
+         cerr << "ntop " << ntop << ": volume information read back "
+              << "is wrong" << endl;
+         good = FALSE;
+      }
+      for (islice=0; islice<TEST_NSLICES; islice++){
+         const Packed_Label *read = reader.get_slice(islice);
+         if ((unsigned long)read % PACKED_LABEL_ALIGN != 0 ||
+             memcmp(read, slice[islice],
+                    TEST_NELEMENTS*ntop*sizeof(Packed_Label)) != 0) {
+            cerr << "ntop " << ntop << ": slice " << islice
+                 << " read back is wrong" << endl;
+            good = FALSE;
+         }
+      }
+      reader.close();
+   }
+
+   // --- Files that must be refused --- //
+   // A foreign first byte, then, once restored, one byte short, then
+   // removed.
+
+   if (good) {
+      struct stat st;
+      FILE        *fp;
+
+      if ((fp = fopen(path, "r+b")) != NULL) {
+         fputc('X', fp);
+         fclose(fp);
+      }
+      if (reader.open(path)) {
+         cerr << "Opened a file with a foreign header" << endl;
+         good = FALSE;
+      }
+      if ((fp = fopen(path, "r+b")) != NULL) {
+         fputc('M', fp);
+         fclose(fp);
+      }
+      if (!reader.open(path)) {
+         cerr << "Cannot open " << path << " once restored" << endl;
+         good = FALSE;
+      }
+      reader.close();
+
+      if (stat(path, &st) != 0 || truncate(path, st.st_size-1) != 0 ||
+          reader.open(path)) {
+         cerr << "Opened a truncated file" << endl;
+         good = FALSE;
+      }
+      unlink(path);
+      if (reader.open(path)) {
+         cerr << "Opened a missing file" << endl;
+         good = FALSE;
+      }
+   }
+
+   for (islice=0; islice<TEST_NSLICES; islice++){
+      delete[] slice[islice];
+   }
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   static const unsigned int ntops[] = {1, 3, PACKED_LABEL_TOP,
+                                        TEST_NTISSUES+2};
+   const unsigned int nntops = sizeof(ntops)/sizeof(ntops[0]);
+   float         *fraction[TEST_NTISSUES];
+   unsigned long state = 1;
+   unsigned int  itissue, i;
+   int           good  = TRUE;
+   char          path[] = "/tmp/testpacked.XXXXXX";
+   int           fd;
+
+   for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+      fraction[itissue] = new float[TEST_NELEMENTS];
+   }
+
+   for (i=0; i<nntops; i++){
+      fill_fractions(fraction, TEST_NELEMENTS, state);
+      if (!check_pack(ntops[i], fraction, TEST_NELEMENTS)) good = FALSE;
+   }
+
+   if ((fd = mkstemp(path)) < 0) {
+      cerr << "Cannot make a file name from " << path << endl;
+      good = FALSE;
+   } else {
+      close(fd);
+      for (i=0; i<nntops; i++){
+         if (!check_file(path, ntops[i], fraction, state)) good = FALSE;
+      }
+      unlink(path);
+   }
+
+   for (itissue=0; itissue<TEST_NTISSUES; itissue++){
+      delete[] fraction[itissue];
+   }
+
+   cout << "Packed_Label_File, " << nntops << " sizes of voxel: "
+        << (good ? "PASS" : "FAIL") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
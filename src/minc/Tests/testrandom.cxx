@@ -0,0 +1,179 @@
+//===========================================================================
+// TESTRANDOM.CXX
+// Checks MRI_Random against the Philox4x32-10 known-answer vectors of
+// Random123, and checks that gaussian_fill gives the same normals in a
+// batch, through the kernels of the best instruction set, as one counter
+// at a time, through the plain C++ code.  Exits with a non-zero status
+// if any check fails.
+//
+// Run again with MRISIM_SIMD=avx2 (or sse2, none) to check the kernels
+// of a lower instruction set:
+//
+//    testrandom
+//    MRISIM_SIMD=sse2 testrandom
+//===========================================================================
+
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include "../mrirandom.h"
+#include "../mrisimd.h"
+
+using namespace std;
+
+// Counters filled by the batch checks: not a multiple of any vector
+// width, so that the kernels leave a tail to the C++ code.
+#define FILL_LENGTH 1003
+
+// Counters of the moment check, and the allowed error of the mean and
+// variance (several standard errors).
+#define MOMENT_LENGTH    65536
+#define MOMENT_TOLERANCE 0.02
+
+//---------------------------------------------------------------------------
+// Known-answer vectors
+// Counter, key (low word first) and the four output words, from the
+// kat_vectors file of Random123.
+//---------------------------------------------------------------------------
+
+struct Known_Answer {
+   unsigned int counter[4];
+   unsigned int key[2];
+   unsigned int out[4];
+};
+
+static const Known_Answer known_answers[] = {
+   {{0x00000000, 0x00000000, 0x00000000, 0x00000000},
+    {0x00000000, 0x00000000},
+    {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+   {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+    {0xffffffff, 0xffffffff},
+    {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+   {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+    {0xa4093822, 0x299f31d0},
+    {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}}
+};
+
+#define NKNOWN_ANSWERS (sizeof(known_answers)/sizeof(known_answers[0]))
+
+// Keys and first counters of the batch checks
+static const unsigned long long fill_keys[] = {
+   0ULL, 12345ULL, 0xFFFFFFFFFFFFFFFFULL
+};
+static const unsigned int fill_counters[][4] = {
+   {0, 0, 0, 0}, {7, 3, 0, 0}, {0xFFFFFF00U, 1, 2, 3}
+};
+
+#define NFILLS (sizeof(fill_keys)/sizeof(fill_keys[0]))
+
+//---------------------------------------------------------------------------
+// check_known_answers
+// Returns the number of known-answer vectors block() gets wrong.
+//---------------------------------------------------------------------------
+
+static int check_known_answers(void) {
+
+   int          nfailed = 0;
+   unsigned int iv, out[4];
+
+   for(iv=0; iv<NKNOWN_ANSWERS; iv++){
+      const Known_Answer& v = known_answers[iv];
+      MRI_Random random(((unsigned long long)v.key[1] << 32) | v.key[0]);
+
+      random.block(v.counter, out);
+      if (out[0] != v.out[0] || out[1] != v.out[1] ||
+          out[2] != v.out[2] || out[3] != v.out[3]) {
+         cerr << "Known answer " << iv << ": block() is wrong" << endl;
+         nfailed++;
+      }
+   }
+   return nfailed;
+
+}
+
+//---------------------------------------------------------------------------
+// check_fill
+// Returns the number of pairs of a batch that differ from the pair of
+// their counter alone.  The batch goes through the vector kernels and
+// the single pair through the C++ code, which must agree bit for bit.
+//---------------------------------------------------------------------------
+
+static int check_fill(unsigned long long key, const unsigned int counter[4]) {
+
+   MRI_Random   random(key);
+   double       *batch = new double[2*FILL_LENGTH];
+   unsigned int ctr[4] = {counter[0], counter[1], counter[2], counter[3]};
+   unsigned int i;
+   double       n1, n2;
+   int          nfailed = 0;
+
+   random.gaussian_fill(counter, FILL_LENGTH, batch);
+   for(i=0; i<FILL_LENGTH; i++, ctr[0]++){
+      random.gaussian_pair(ctr, n1, n2);
+      if (n1 != batch[2*i] || n2 != batch[2*i+1]) nfailed++;
+   }
+   if (nfailed > 0) {
+      cerr << "Batch of key " << key << ": " << nfailed
+           << " pairs differ" << endl;
+   }
+
+   delete[] batch;
+   return nfailed;
+
+}
+
+//---------------------------------------------------------------------------
+// check_moments
+// Returns TRUE (1) if the mean and variance of a batch of normals are
+// close to 0 and 1.
+//---------------------------------------------------------------------------
+
+static int check_moments(void) {
+
+   MRI_Random   random(2011);
+   unsigned int counter[4] = {0, 0, 0, 0};
+   double       *batch = new double[2*MOMENT_LENGTH];
+   double       sum = 0.0, sum2 = 0.0;
+   unsigned int i;
+
+   random.gaussian_fill(counter, MOMENT_LENGTH, batch);
+   for(i=0; i<2*MOMENT_LENGTH; i++){
+      sum  += batch[i];
+      sum2 += batch[i]*batch[i];
+   }
+   delete[] batch;
+
+   const double mean     = sum/(2*MOMENT_LENGTH);
+   const double variance = sum2/(2*MOMENT_LENGTH) - mean*mean;
+
+   if (fabs(mean) > MOMENT_TOLERANCE ||
+       fabs(variance - 1.0) > MOMENT_TOLERANCE) {
+      cerr << "Normals have mean " << mean << " and variance "
+           << variance << endl;
+      return 0;
+   }
+   return 1;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   int          good = 1;
+   unsigned int ifill;
+
+   cout << "MRI_Random, SIMD level: " << MRI_SIMD::get_level_name() << endl;
+
+   if (check_known_answers() != 0) good = 0;
+   for(ifill=0; ifill<NFILLS; ifill++){
+      if (check_fill(fill_keys[ifill], fill_counters[ifill]) != 0) good = 0;
+   }
+   if (!check_moments()) good = 0;
+
+   cout << (good ? "PASS" : "FAIL") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
@@ -0,0 +1,243 @@
+//===========================================================================
+// TESTRESAMPLE.CXX
+// Checks the FFT and direct paths of Resample_DFT against the weighted
+// Chirp_Algorithm they replace, for real rows and complex columns.
+// Exits with a non-zero status if any check fails.
+//===========================================================================
+
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include "../chirp.h"
+#include <mrisim/resample_dft.h>
+
+using namespace std;
+
+// Allowed error relative to the largest output element: the input and
+// output are floats
+#define TOLERANCE_RESAMPLE 5.0e-7
+
+// Rows and columns of the batch checks: partial and whole blocks
+#define TEST_NROWS 11
+#define TEST_NCOLS (FFT_COLUMN_BLOCK + 3)
+#define TEST_PAD   3
+
+//---------------------------------------------------------------------------
+// Cases
+// Phantom and scan matrix sizes and field of view at 1 mm voxels, with
+// the frequencies of MRI_Phantom.  The first are bins of an FFT of the
+// field of view; the fourth folds a phantom longer than the FFT; the
+// last field of view (2 x 127) is not a valid FFT length, so only the
+// direct path applies.
+//---------------------------------------------------------------------------
+
+struct Resample_Case {
+   unsigned int in_length, out_length;
+   double       fov;
+};
+
+static const Resample_Case cases[] = {
+   {172,  64, 256.0},
+   {220, 256, 256.0},
+   {181, 180, 180.0},
+   {300,  64, 256.0},
+   {100, 160, 160.0},
+   { 50,  30, 254.0}
+};
+
+#define NCASES (sizeof(cases)/sizeof(cases[0]))
+
+//---------------------------------------------------------------------------
+// fill_input
+// Fills n floats, stride apart, with a deterministic signal, different
+// for each seed.
+//---------------------------------------------------------------------------
+
+static void fill_input(float x[], unsigned int n, unsigned int stride,
+                       unsigned int seed) {
+
+   unsigned int i;
+   for(i=0; i<n; i++){
+      x[i*stride] = 1.0 + sin(0.23*(i+1) + seed) + 0.001*((i*13) % 97);
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// new_weight
+// Returns complex output weights of out_length samples: a smooth window
+// with a linear phase, as for a shifted field of view.
+//---------------------------------------------------------------------------
+
+static double *new_weight(unsigned int out_length) {
+
+   double       *weight = new double[2*out_length];
+   double       window;
+   unsigned int k;
+   for(k=0; k<out_length; k++){
+      window        = 0.54 - 0.46*cos(2*M_PI*k/(out_length-1));
+      weight[2*k]   = window*cos(0.3*k);
+      weight[2*k+1] = window*sin(0.3*k);
+   }
+   return weight;
+
+}
+
+//---------------------------------------------------------------------------
+// relative_error
+// Returns the largest difference of n complex elements, stride complex
+// elements apart in both, over the largest element of the reference.
+//---------------------------------------------------------------------------
+
+static double relative_error(const float x[], const float ref[],
+                             unsigned int n, unsigned int stride) {
+
+   double       error = 0.0, scale = 0.0, d;
+   unsigned int i, p;
+
+   for(i=0; i<n; i++){
+      for(p=0; p<2; p++){
+         d = fabs(x[2*i*stride+p] - ref[2*i*stride+p]);
+         if (d > error) error = d;
+         if (fabs(ref[2*i*stride+p]) > scale) scale = fabs(ref[2*i*stride+p]);
+      }
+   }
+   return (scale > 0.0) ? error/scale : error;
+
+}
+
+//---------------------------------------------------------------------------
+// check_rows
+// Returns TRUE if transform_rows gives the chirp DFT of each of
+// TEST_NROWS real rows.
+//---------------------------------------------------------------------------
+
+static int check_rows(const Resample_DFT& dft, const Chirp_Algorithm& chirp,
+                      const char *name) {
+
+   const unsigned int in_length  = dft.get_input_length();
+   const unsigned int out_length = dft.get_output_length();
+   const unsigned int in_dist    = in_length + TEST_PAD;
+   const unsigned int out_dist   = out_length + TEST_PAD;
+   float  *in    = new float[in_dist*TEST_NROWS];
+   float  *out   = new float[2*out_dist*TEST_NROWS];
+   float  *ref   = new float[2*out_length];
+   double *work  = new double[dft.get_workspace_length(0)];
+   double *cwork = new double[chirp.get_workspace_length()];
+   int    good   = TRUE;
+   unsigned int v;
+
+   for(v=0; v<TEST_NROWS; v++){
+      fill_input(in + in_dist*v, in_length, 1, v);
+   }
+   dft.transform_rows(TEST_NROWS, in, in_dist, out, out_dist, work);
+
+   for(v=0; v<TEST_NROWS; v++){
+      chirp.apply(FALSE, in + in_dist*v, 1, ref, 1, cwork);
+      if (relative_error(out + 2*out_dist*v, ref, out_length, 1) >
+          TOLERANCE_RESAMPLE) {
+         cerr << in_length << " -> " << out_length << ": " << name
+              << " row " << v << " differs from the chirp" << endl;
+         good = FALSE;
+      }
+   }
+
+   delete[] in;
+   delete[] out;
+   delete[] ref;
+   delete[] work;
+   delete[] cwork;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_columns
+// Returns TRUE if transform_columns gives the chirp DFT of each of
+// TEST_NCOLS complex columns.
+//---------------------------------------------------------------------------
+
+static int check_columns(const Resample_DFT& dft,
+                         const Chirp_Algorithm& chirp, const char *name) {
+
+   const unsigned int in_length  = dft.get_input_length();
+   const unsigned int out_length = dft.get_output_length();
+   float  *in    = new float[2*in_length*TEST_NCOLS];
+   float  *out   = new float[2*out_length*TEST_NCOLS];
+   float  *ref   = new float[2*out_length*TEST_NCOLS];
+   double *work  = new double[dft.get_workspace_length(TEST_NCOLS)];
+   double *cwork = new double[chirp.get_workspace_length()];
+   int    good   = TRUE;
+   unsigned int c;
+
+   for(c=0; c<TEST_NCOLS; c++){
+      fill_input(in + 2*c,     in_length, 2*TEST_NCOLS, 2*c);
+      fill_input(in + 2*c + 1, in_length, 2*TEST_NCOLS, 2*c + 1);
+   }
+   dft.transform_columns(TEST_NCOLS, in, out, work);
+
+   for(c=0; c<TEST_NCOLS; c++){
+      chirp.apply(TRUE, in + 2*c, TEST_NCOLS, ref + 2*c, TEST_NCOLS, cwork);
+      if (relative_error(out + 2*c, ref + 2*c, out_length, TEST_NCOLS) >
+          TOLERANCE_RESAMPLE) {
+         cerr << in_length << " -> " << out_length << ": " << name
+              << " column " << c << " differs from the chirp" << endl;
+         good = FALSE;
+      }
+   }
+
+   delete[] in;
+   delete[] out;
+   delete[] ref;
+   delete[] work;
+   delete[] cwork;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   int          good = TRUE;
+   unsigned int icase, nfft = 0;
+
+   for(icase=0; icase<NCASES; icase++){
+      const Resample_Case& c = cases[icase];
+      const double w_step    = 2*M_PI/c.fov;
+      const double w_initial = -w_step*(double)c.out_length/2.0;
+      double       *weight   = new_weight(c.out_length);
+
+      Chirp_Algorithm chirp(c.in_length, c.out_length,
+                            w_initial, w_step, weight);
+
+      Resample_DFT direct(RESAMPLE_DIRECT, c.in_length, c.out_length,
+                          w_initial, w_step, weight);
+      if (!check_rows(direct, chirp, "direct"))    good = FALSE;
+      if (!check_columns(direct, chirp, "direct")) good = FALSE;
+
+      if (Resample_DFT::get_fft_length(w_initial, w_step) != 0) {
+         Resample_DFT fft(RESAMPLE_FFT, c.in_length, c.out_length,
+                          w_initial, w_step, weight);
+         if (!check_rows(fft, chirp, "FFT"))    good = FALSE;
+         if (!check_columns(fft, chirp, "FFT")) good = FALSE;
+         nfft++;
+      }
+
+      delete[] weight;
+   }
+
+   // Only the last case should be left to the direct DFT
+   if (nfft != NCASES-1) {
+      cerr << "FFT path used for " << nfft << " of " << NCASES
+           << " cases" << endl;
+      good = FALSE;
+   }
+
+   cout << "Resample_DFT, " << NCASES << " cases: "
+        << (good ? "PASS" : "FAIL") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
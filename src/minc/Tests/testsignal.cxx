@@ -0,0 +1,291 @@
+//===========================================================================
+// TESTSIGNAL.CXX
+// Checks Tissue_Signal_Cache: that the key changes with each parameter
+// the signals depend on, that entries are found only for their key and
+// number of signals, and that a saved signal cache file is loaded back
+// bit for bit by a process that has not simulated the tissues, with
+// truncated, foreign and missing files handled.  Exits with a non-zero
+// status if any check fails.
+//===========================================================================
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <iostream>
+#include <mrisim/signal_cache.h>
+
+using namespace std;
+
+// Entries of the cache file, and their numbers of signals: a tissue
+// alone, and with the flip angle errors of a transmit map
+#define TEST_NENTRIES 3
+
+static const unsigned int nvalues[TEST_NENTRIES] = {1, 9, 33};
+
+//---------------------------------------------------------------------------
+// fill_signals
+// Fills the I and Q signals of an entry with values that differ for
+// each entry and each seed.
+//---------------------------------------------------------------------------
+
+static void fill_signals(unsigned int ientry, unsigned int seed,
+                         double real[], double imag[]) {
+
+   unsigned int n;
+   for (n=0; n<nvalues[ientry]; n++){
+      real[n] = 1000.0/(1.0 + n + ientry) + 0.1*seed;
+      imag[n] = -1.0/(3.0 + n*ientry) - 0.01*seed;
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// entry_key
+// Returns the key of an entry: a tissue of its own for the entry, with
+// nvalues-1 flip angle errors.
+//---------------------------------------------------------------------------
+
+static unsigned long long entry_key(unsigned int ientry) {
+
+   double       flip_error[64];
+   unsigned int n;
+   Tissue       tissue(800.0 + ientry, 80.0, 60.0, 0.8);
+
+   for (n=0; n+1<nvalues[ientry]; n++){
+      flip_error[n] = 0.8 + 0.05*n;
+   }
+   return Tissue_Signal_Cache::make_key("test sequence", SIGNAL_QUICK_MODEL,
+                                        tissue, nvalues[ientry]-1,
+                                        flip_error);
+
+}
+
+//---------------------------------------------------------------------------
+// check_keys
+// Returns TRUE if the key is the same for the same parameters and
+// differs when any one of them changes.
+//---------------------------------------------------------------------------
+
+static int check_keys(void) {
+
+   const double flip_error[2]  = {0.9, 1.1};
+   const double other_error[2] = {0.9, 1.2};
+   const Tissue tissue(1000.0, 100.0, 70.0, 0.9);
+   unsigned long long key[9];
+   unsigned int       i, j;
+   int                good = TRUE;
+
+   key[0] = Tissue_Signal_Cache::make_key("se 2000 80", SIGNAL_QUICK_MODEL,
+                                          tissue, 2, flip_error);
+   key[1] = Tissue_Signal_Cache::make_key("se 2000 90", SIGNAL_QUICK_MODEL,
+                                          tissue, 2, flip_error);
+   key[2] = Tissue_Signal_Cache::make_key("se 2000 80",
+                                          SIGNAL_ISOCHROMAT_MODEL,
+                                          tissue, 2, flip_error);
+   key[3] = Tissue_Signal_Cache::make_key("se 2000 80", SIGNAL_QUICK_MODEL,
+                                          Tissue(1001.0, 100.0, 70.0, 0.9),
+                                          2, flip_error);
+   key[4] = Tissue_Signal_Cache::make_key("se 2000 80", SIGNAL_QUICK_MODEL,
+                                          Tissue(1000.0, 101.0, 70.0, 0.9),
+                                          2, flip_error);
+   key[5] = Tissue_Signal_Cache::make_key("se 2000 80", SIGNAL_QUICK_MODEL,
+                                          Tissue(1000.0, 100.0, 71.0, 0.9),
+                                          2, flip_error);
+   key[6] = Tissue_Signal_Cache::make_key("se 2000 80", SIGNAL_QUICK_MODEL,
+                                          Tissue(1000.0, 100.0, 70.0, 0.8),
+                                          2, flip_error);
+   key[7] = Tissue_Signal_Cache::make_key("se 2000 80", SIGNAL_QUICK_MODEL,
+                                          tissue, 2, other_error);
+   key[8] = Tissue_Signal_Cache::make_key("se 2000 80", SIGNAL_QUICK_MODEL,
+                                          tissue, 0, NULL);
+
+   if (Tissue_Signal_Cache::make_key("se 2000 80", SIGNAL_QUICK_MODEL,
+                                     Tissue(tissue), 2, flip_error) !=
+       key[0]) {
+      cerr << "The key differs for the same parameters" << endl;
+      good = FALSE;
+   }
+   for (i=0; i<9; i++){
+      for (j=0; j<i; j++){
+         if (key[i] == key[j]) {
+            cerr << "Keys " << j << " and " << i << " are the same" << endl;
+            good = FALSE;
+         }
+      }
+   }
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// check_entry
+// Returns TRUE if the entry is found with the signals of the seed, bit
+// for bit, and not found with another number of signals.
+//---------------------------------------------------------------------------
+
+static int check_entry(unsigned int ientry, unsigned int seed) {
+
+   double real[64], imag[64], ref_real[64], ref_imag[64];
+
+   fill_signals(ientry, seed, ref_real, ref_imag);
+   return (Tissue_Signal_Cache::find(entry_key(ientry), nvalues[ientry],
+                                     real, imag) &&
+           memcmp(real, ref_real, nvalues[ientry]*sizeof(double)) == 0 &&
+           memcmp(imag, ref_imag, nvalues[ientry]*sizeof(double)) == 0 &&
+           !Tissue_Signal_Cache::find(entry_key(ientry),
+                                      nvalues[ientry]+1, real, imag));
+
+}
+
+//---------------------------------------------------------------------------
+// save_in_child
+// Adds the entries in a child process and saves them to path, so that
+// this process has to load them.  Returns FALSE if the child fails.
+//---------------------------------------------------------------------------
+
+static int save_in_child(const char *path) {
+
+   double       real[64], imag[64];
+   unsigned int ientry;
+   int          status;
+   pid_t        pid;
+
+   if ((pid = fork()) < 0) {
+      return FALSE;
+   }
+   if (pid == 0) {
+      for (ientry=0; ientry<TEST_NENTRIES; ientry++){
+         fill_signals(ientry, 1, real, imag);
+         Tissue_Signal_Cache::add(entry_key(ientry), nvalues[ientry],
+                                  real, imag);
+      }
+      _exit(Tissue_Signal_Cache::save(path) ? EXIT_SUCCESS : EXIT_FAILURE);
+   }
+
+   return (waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+           WEXITSTATUS(status) == EXIT_SUCCESS);
+
+}
+
+//---------------------------------------------------------------------------
+// check_file
+// Returns TRUE if the entries saved by another process are loaded back,
+// those before the damaged record of a truncated file first, and an
+// entry already in the registry is kept.  Missing and foreign files are
+// not loaded.
+//---------------------------------------------------------------------------
+
+static int check_file(const char *path) {
+
+   double       real[64], imag[64];
+   unsigned int ientry;
+   int          good = TRUE;
+   struct stat  st;
+   FILE         *fp;
+
+   if (!save_in_child(path)) {
+      cerr << "Cannot save " << path << endl;
+      return FALSE;
+   }
+
+   // --- Missing and foreign files --- //
+
+   if (Tissue_Signal_Cache::load("/nonexistent/signal.cache") != -1) {
+      cerr << "Loaded a missing file" << endl;
+      good = FALSE;
+   }
+   if ((fp = fopen(path, "r+b")) != NULL) {
+      fputc('X', fp);
+      fclose(fp);
+   }
+   if (Tissue_Signal_Cache::load(path) != -1) {
+      cerr << "Loaded a file with a foreign header" << endl;
+      good = FALSE;
+   }
+   if ((fp = fopen(path, "r+b")) != NULL) {
+      fputc('M', fp);
+      fclose(fp);
+   }
+
+   // --- An entry of this process is kept over the file's --- //
+
+   fill_signals(2, 2, real, imag);
+   Tissue_Signal_Cache::add(entry_key(2), nvalues[2], real, imag);
+   if (!Tissue_Signal_Cache::changed()) {
+      cerr << "No change recorded after an entry was added" << endl;
+      good = FALSE;
+   }
+
+   // --- A truncated file, then the whole file --- //
+   // Entries are saved newest first: entry 2, kept from this process,
+   // entry 1, then entry 0 in the damaged record.
+
+   if (stat(path, &st) != 0 || truncate(path, st.st_size-1) != 0 ||
+       Tissue_Signal_Cache::load(path) != 1 ||
+       Tissue_Signal_Cache::find(entry_key(0), nvalues[0], real, imag)) {
+      cerr << "Loaded the wrong entries from a truncated file" << endl;
+      good = FALSE;
+   }
+   if (Tissue_Signal_Cache::changed()) {
+      cerr << "Change recorded after a load" << endl;
+      good = FALSE;
+   }
+
+   if (!save_in_child(path) || Tissue_Signal_Cache::load(path) != 1) {
+      cerr << "Loaded the wrong entries from the whole file" << endl;
+      good = FALSE;
+   }
+   for (ientry=0; ientry<TEST_NENTRIES; ientry++){
+      if (!check_entry(ientry, (ientry == 2) ? 2 : 1)) {
+         cerr << "Entry " << ientry << " is wrong after loading" << endl;
+         good = FALSE;
+      }
+   }
+   if (Tissue_Signal_Cache::load(path) != 0) {
+      cerr << "Loaded entries already in the registry" << endl;
+      good = FALSE;
+   }
+
+   // --- Adding an entry again changes nothing --- //
+
+   fill_signals(1, 3, real, imag);
+   Tissue_Signal_Cache::add(entry_key(1), nvalues[1], real, imag);
+   if (Tissue_Signal_Cache::changed() || !check_entry(1, 1)) {
+      cerr << "Entry 1 replaced when added again" << endl;
+      good = FALSE;
+   }
+
+   unlink(path);
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   char path[] = "/tmp/testsignal.XXXXXX";
+   int  good   = TRUE;
+   int  fd;
+
+   if (!check_keys()) good = FALSE;
+
+   if ((fd = mkstemp(path)) < 0) {
+      cerr << "Cannot make a file name from " << path << endl;
+      good = FALSE;
+   } else {
+      close(fd);
+      if (!check_file(path)) good = FALSE;
+      unlink(path);
+   }
+
+   cout << "Tissue_Signal_Cache, " << TEST_NENTRIES << " entries: "
+        << (good ? "PASS" : "FAIL") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
@@ -0,0 +1,243 @@
+//===========================================================================
+// TESTSLAB.CXX
+// Checks Slab_Encoder against a direct evaluation of its encode and
+// decode sums in long double, for slabs whose passes are computed by
+// Chirp DFTs, FFTs and direct DFTs, and checks that slabs tiling the
+// field of view reconstruct a slowly varying object at the partitions.
+// Exits with a non-zero status if any check fails.
+//===========================================================================
+
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <mrisim/slab_encoder.h>
+
+using namespace std;
+
+// Allowed error relative to the largest partition value: the slab is
+// held in floats
+#define TOLERANCE_ENCODE 5.0e-7
+
+// Allowed error of the reconstruction of the object
+#define TOLERANCE_RECON  1.0e-6
+
+// Columns of the slab (in-plane k-space samples)
+#define TEST_NCOLS 5
+
+//---------------------------------------------------------------------------
+// Slabs
+// Phantom slices (count, position of the first, spacing) and partitions
+// (likewise), in mm.  The methods chosen for the encode and decode
+// passes are, in order: FFT and FFT, FFT and FFT, Chirp and Chirp, FFT
+// and direct, direct and direct.  The first, third and fourth tile the
+// field of view with slices.
+//---------------------------------------------------------------------------
+
+struct Slab_Case {
+   unsigned int in_length;
+   double       in_start, in_step;
+   unsigned int out_length;
+   double       out_start, out_step;
+};
+
+static const Slab_Case cases[] = {
+   { 32,  0.0, 1.0,  16, 0.0, 2.0},
+   {181, -0.5, 1.0, 180, 0.0, 1.0},
+   {181,  0.0, 1.0, 181, 0.0, 1.0},
+   { 20,  0.3, 1.5,  12, 1.0, 2.5},
+   { 10,  0.0, 0.7,   6, 0.1, 1.1}
+};
+
+#define NCASES (sizeof(cases)/sizeof(cases[0]))
+
+//---------------------------------------------------------------------------
+// object
+// Returns the object at z for column col of a slab with a field of view
+// fov: a constant and the lowest frequency, of amplitude gain/2, times a
+// complex factor that differs between columns.
+//---------------------------------------------------------------------------
+
+static void object(double z, double fov, unsigned int col, double gain,
+                   double& re, double& im) {
+
+   const double value = 1.0 + 0.5*gain*cos(2.0*M_PI*z/fov + 0.3);
+   re = value*cos(0.7*col);
+   im = value*sin(0.7*col);
+
+}
+
+//---------------------------------------------------------------------------
+// direct_encode
+// Returns in out the partitions of the slab of in, out_length x ncols,
+// by the sums of Slab_Encoder in long double: the weighted DFT of the
+// slices at the kz samples, and the inverse DFT at the partitions.
+//---------------------------------------------------------------------------
+
+static void direct_encode(const Slab_Case& c, unsigned int ncols,
+                          const float in[], double out[]) {
+
+   const long double two_pi = 6.283185307179586476925286766559L;
+   const double      fov    = c.out_length*c.out_step;
+   const unsigned int half  = c.out_length/2;
+   long double  *s_re = new long double[c.out_length*ncols];
+   long double  *s_im = new long double[c.out_length*ncols];
+   unsigned int m, n, p, col;
+
+   for(m=0; m<c.out_length; m++){
+      const long double kz = ((double)m - (double)half)/fov;
+      const long double x  = kz*c.in_step;
+      const long double sinc = (x != 0.0L) ?
+                               sinl(two_pi/2*x)/(two_pi/2*x) : 1.0L;
+      const long double amplitude = c.in_step/fov*sinc*sinc;
+
+      for(col=0; col<ncols; col++){
+         long double re = 0.0L, im = 0.0L;
+         for(n=0; n<c.in_length; n++){
+            const long double a  = -two_pi*kz*(c.in_start + n*c.in_step);
+            const float      *xn = in + 2*(n*ncols + col);
+            re += xn[0]*cosl(a) - xn[1]*sinl(a);
+            im += xn[0]*sinl(a) + xn[1]*cosl(a);
+         }
+         s_re[m*ncols + col] = amplitude*re;
+         s_im[m*ncols + col] = amplitude*im;
+      }
+   }
+
+   for(p=0; p<c.out_length; p++){
+      for(col=0; col<ncols; col++){
+         long double re = 0.0L, im = 0.0L;
+         for(m=0; m<c.out_length; m++){
+            const long double kz = ((double)m - (double)half)/fov;
+            const long double a  = two_pi*kz*(c.out_start + p*c.out_step);
+            re += s_re[m*ncols + col]*cosl(a) - s_im[m*ncols + col]*sinl(a);
+            im += s_re[m*ncols + col]*sinl(a) + s_im[m*ncols + col]*cosl(a);
+         }
+         out[2*(p*ncols + col)]     = (double)re;
+         out[2*(p*ncols + col) + 1] = (double)im;
+      }
+   }
+
+   delete[] s_re;
+   delete[] s_im;
+
+}
+
+//---------------------------------------------------------------------------
+// encode_object
+// Fills the slices of a slab with the object, and encodes them.  Returns
+// the Slab_Encoder, and in data the partition rows.
+//---------------------------------------------------------------------------
+
+static Slab_Encoder *encode_object(const Slab_Case& c, float in[],
+                                   float data[]) {
+
+   const double fov = c.out_length*c.out_step;
+   const unsigned int nrows = (c.in_length > c.out_length) ?
+                              c.in_length : c.out_length;
+   unsigned int n, col;
+   double re, im;
+
+   Slab_Encoder *encoder = new Slab_Encoder(c.in_length, c.in_start,
+                                            c.in_step, c.out_length,
+                                            c.out_start, c.out_step);
+   float  *kz   = new float[2*c.out_length*TEST_NCOLS];
+   double *work = new double[encoder->get_workspace_length(TEST_NCOLS)];
+
+   for(n=0; n<nrows*2*TEST_NCOLS; n++) data[n] = 0.0;
+   for(n=0; n<c.in_length; n++){
+      for(col=0; col<TEST_NCOLS; col++){
+         object(c.in_start + n*c.in_step, fov, col, 1.0, re, im);
+         in[2*(n*TEST_NCOLS + col)]     = data[2*(n*TEST_NCOLS + col)]     = re;
+         in[2*(n*TEST_NCOLS + col) + 1] = data[2*(n*TEST_NCOLS + col) + 1] = im;
+      }
+   }
+
+   encoder->encode(TEST_NCOLS, data, kz, work);
+
+   delete[] kz;
+   delete[] work;
+   return encoder;
+
+}
+
+//---------------------------------------------------------------------------
+// check_slab
+// Returns TRUE if the partitions of a slab match the direct sums, and,
+// for a slab tiling the field of view, the object.  The linear
+// interpolation between slices attenuates the frequency 1/FOV of the
+// object by sinc^2(in_step/FOV); the constant is kept.
+//---------------------------------------------------------------------------
+
+static int check_slab(const Slab_Case& c) {
+
+   const double fov = c.out_length*c.out_step;
+   const unsigned int nrows = (c.in_length > c.out_length) ?
+                              c.in_length : c.out_length;
+   const int tiled = (fabs(c.in_length*c.in_step - fov) < 1.0e-9*fov);
+   const double sinc = sin(M_PI*c.in_step/fov)/(M_PI*c.in_step/fov);
+   float  *in   = new float[2*c.in_length*TEST_NCOLS];
+   float  *data = new float[2*nrows*TEST_NCOLS];
+   double *ref  = new double[2*c.out_length*TEST_NCOLS];
+   double error = 0.0, recon_error = 0.0, scale = 0.0;
+   double re, im;
+   unsigned int p, col, i;
+   int    good  = TRUE;
+
+   Slab_Encoder *encoder = encode_object(c, in, data);
+   direct_encode(c, TEST_NCOLS, in, ref);
+
+   for(p=0; p<c.out_length; p++){
+      const float *row = data + 2*encoder->get_partition_row(p)*TEST_NCOLS;
+      for(col=0; col<TEST_NCOLS; col++){
+         object(c.out_start + p*c.out_step, fov, col, sinc*sinc, re, im);
+         for(i=0; i<2; i++){
+            const double y = row[2*col + i];
+            const double r = ref[2*(p*TEST_NCOLS + col) + i];
+            if (fabs(y - r) > error) error = fabs(y - r);
+            if (fabs(y - ((i == 0) ? re : im)) > recon_error) {
+               recon_error = fabs(y - ((i == 0) ? re : im));
+            }
+            if (fabs(r) > scale) scale = fabs(r);
+         }
+      }
+   }
+
+   if (error > TOLERANCE_ENCODE*scale) {
+      cerr << c.in_length << " slices -> " << c.out_length
+           << " partitions: differ from the direct sums by "
+           << error/scale << endl;
+      good = FALSE;
+   }
+   if (tiled && recon_error > TOLERANCE_RECON) {
+      cerr << c.in_length << " slices -> " << c.out_length
+           << " partitions: object reconstructed with error "
+           << recon_error << endl;
+      good = FALSE;
+   }
+
+   delete encoder;
+   delete[] in;
+   delete[] data;
+   delete[] ref;
+   return good;
+
+}
+
+//---------------------------------------------------------------------------
+// main
+//---------------------------------------------------------------------------
+
+int main(void) {
+
+   int          good = TRUE;
+   unsigned int icase;
+
+   for(icase=0; icase<NCASES; icase++){
+      if (!check_slab(cases[icase])) good = FALSE;
+   }
+
+   cout << "Slab_Encoder, " << NCASES << " slabs: "
+        << (good ? "PASS" : "FAIL") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
@@ -21,6 +21,7 @@
 #include <math.h>
 #include <string.h>
 #include "chirp.h"
+#include "mriprofile.h"
 
 //===========================================================================
 // Chirp_Algorithm
@@ -43,43 +44,30 @@
 Chirp_Algorithm::Chirp_Algorithm(int in_length, 
                                  int out_length,
                                  double w_initial,
-                                 double w_step) 
+                                 double w_step,
+                                 const double out_weight[]) 
    : _in_length(in_length), _out_length(out_length), 
      _w_initial(w_initial), _w_step(w_step) {
 
 #ifdef DEBUG
+   // The output frequencies may lie anywhere, but must not wrap around
+   // onto each other
    assert(w_initial >= -M_PI);
    assert(w_initial <= M_PI);
-   assert(w_initial + out_length*w_step >= w_initial);
-   assert(w_initial + out_length*w_step <= M_PI);
+   assert(w_step > 0.0);
+   assert((out_length-1)*w_step < 2.0*M_PI);
 #endif
 
-   // --- Compute filter lengths --- //
-
-   int chirp_length = ((in_length > out_length) ?
-                        2*in_length-1 : in_length+out_length-1);
-   int filt_length  = (in_length+out_length-1);
-
-   _fft_length = _next_power_of_two(filt_length);
-
-   const int offset = 2*(_in_length-1);
-
-   // --- Allocate filters --- //
-   // Filters are complex arrays arranged as 
-   // {real0, imag0, real1, imag1, ... } 
-
-   _chirp     = new double[2*chirp_length];
-   _chirp_fft = new double[2*_fft_length];
-   _tmp       = new double[2*_fft_length];
-   _prefilter = new double[2*_in_length];
+   _allocate();
 
-   _chirp_delay_zero = &(_chirp[offset]);
-   _tmp_no_alias     = &(_tmp[offset]);
+   const int chirp_length = _chirp_length;
+   const int filt_length  = (in_length+_conv_length-1);
+   const int offset       = 2*(_in_length-1);
 
    // --- Compute chirp filter --- //
 
    // h[n] = exp(j*w_step)^(n^2/2) 
-   // Chirp filter = h[n] n = -(in_length-1), ..., out_length-1 
+   // Chirp filter = h[n] n = -(in_length-1), ..., _conv_length-1 
 
    int n;
    double angle;
@@ -99,7 +87,7 @@ Chirp_Algorithm::Chirp_Algorithm(int in_length,
    for(n=2*filt_length; n<2*_fft_length; n++){
       _chirp_fft[n] = 0.0;
    }
-   four1( _chirp_fft-1, _fft_length, -1);
+   _fft_plan->forward(_chirp_fft);
 
    // --- Compute pre-filter --- //
 
@@ -119,6 +107,165 @@ Chirp_Algorithm::Chirp_Algorithm(int in_length,
       _prefilter[n+1] = tempr * filti + tempi * filtr;
    }
 
+   // --- Compute post-filters --- //
+
+   // Postchirp c[k] = h[k]^(-1) / _fft_length
+   // k = 0, 1, ..., _conv_length-1
+   // Note: 1/h[k] is the complex conjugate, stored in the zero delay
+   // chirp filter.
+
+   for(n=0; n<2*_conv_length; n+=2){
+      _postchirp[n]   = _chirp_delay_zero[n]   / _fft_length;
+      _postchirp[n+1] = _chirp_delay_zero[n+1] / _fft_length;
+   }
+
+   // Postfilter q[k] = c[k] * weight[k]
+   // k = 0, 1, ..., _out_length-1
+   // Folds the output weighting and the inverse FFT normalization into
+   // the one multiply that applies the chirp.  The weight is also kept
+   // on its own for real input pairs, which are separated before they
+   // are weighted.
+
+   for(n=0; n<2*_out_length; n+=2){
+      _weight[n]   = ((out_weight != NULL) ? out_weight[n]   : 1.0);
+      _weight[n+1] = ((out_weight != NULL) ? out_weight[n+1] : 0.0);
+
+      tempr = _weight[n];
+      tempi = _weight[n+1];
+      filtr = _postchirp[n];
+      filti = _postchirp[n+1];
+      _postfilter[n]   = tempr * filtr - tempi * filti;
+      _postfilter[n+1] = tempr * filti + tempi * filtr;
+   }
+
+   _single_precision_filters();
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm default constructor
+// Used by read; the lengths and filters are filled in from the file.
+//---------------------------------------------------------------------------
+
+Chirp_Algorithm::Chirp_Algorithm()
+   : _in_length(0), _out_length(0), _w_initial(0.0), _w_step(0.0) {
+
+   _chirp      = NULL;
+   _chirp_fft  = NULL;
+   _prefilter  = NULL;
+   _postfilter = NULL;
+   _postchirp  = NULL;
+   _weight     = NULL;
+
+   _chirp_fft_f  = NULL;
+   _prefilter_f  = NULL;
+   _postfilter_f = NULL;
+   _postchirp_f  = NULL;
+   _weight_f     = NULL;
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_allocate
+// Computes the filter lengths from the input and output lengths and
+// allocates the filters.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_allocate(void) {
+
+   // --- Real input pairs --- //
+   // The DFT of real data at -w is the complex conjugate of the DFT at w.
+   // When the output frequencies are symmetric about zero, output k and
+   // output _out_length-k lie at opposite frequencies, so the DFTs of
+   // two real vectors can be separated from the DFT of one complex
+   // vector holding them as real and imaginary parts.  Output k = 0 needs
+   // the frequency of output _out_length, so the convolution gives one
+   // more output than is returned.
+
+   _real_pairs  = _has_real_pairs(_out_length, _w_initial, _w_step);
+   _conv_length = (_real_pairs ? _out_length+1 : _out_length);
+
+   // --- Compute filter lengths --- //
+
+   _chirp_length = ((_in_length > _conv_length) ?
+                    2*_in_length-1 : _in_length+_conv_length-1);
+
+   _fft_length = MRI_FFT_Plan::get_fast_length(_in_length+_conv_length-1);
+   _fft_plan   = MRI_FFT_Plan::get(_fft_length);
+
+   // --- Allocate filters --- //
+   // Filters are complex arrays arranged as 
+   // {real0, imag0, real1, imag1, ... } 
+
+   _chirp      = new double[2*_chirp_length];
+   _chirp_fft  = new double[2*_fft_length];
+   _prefilter  = new double[2*_in_length];
+   _postfilter = new double[2*_out_length];
+   _postchirp  = new double[2*_conv_length];
+   _weight     = new double[2*_out_length];
+
+   _chirp_fft_f  = new float[2*_fft_length];
+   _prefilter_f  = new float[2*_in_length];
+   _postfilter_f = new float[2*_out_length];
+   _postchirp_f  = new float[2*_conv_length];
+   _weight_f     = new float[2*_out_length];
+
+   _chirp_delay_zero = &(_chirp[2*(_in_length-1)]);
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_single_precision_filters
+// Rounds the filters used by apply_rows and apply_columns to float for
+// the single precision path.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_single_precision_filters(void) {
+
+   int n;
+
+   for(n=0; n<2*_fft_length; n++)  _chirp_fft_f[n]  = (float)_chirp_fft[n];
+   for(n=0; n<2*_in_length; n++)   _prefilter_f[n]  = (float)_prefilter[n];
+   for(n=0; n<2*_out_length; n++)  _postfilter_f[n] = (float)_postfilter[n];
+   for(n=0; n<2*_conv_length; n++) _postchirp_f[n]  = (float)_postchirp[n];
+   for(n=0; n<2*_out_length; n++)  _weight_f[n]     = (float)_weight[n];
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_has_real_pairs
+// Returns TRUE if the output frequencies are symmetric about zero, so
+// that real vectors can be transformed in pairs.
+//---------------------------------------------------------------------------
+
+int Chirp_Algorithm::_has_real_pairs(int out_length,
+                                     double w_initial, double w_step) {
+   return (fabs(2.0*w_initial + out_length*w_step) <=
+           1.0e-9*fabs(out_length*w_step));
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::get_cost
+// Estimated time of the Chirp DFT of one vector by apply_rows: the
+// forward and inverse FFTs and the pre-filter, convolution and
+// post-filter multiplies.  Real vectors transformed in pairs cost half
+// as much each.
+//---------------------------------------------------------------------------
+
+double Chirp_Algorithm::get_cost(int in_length, int out_length,
+                                 double w_initial, double w_step,
+                                 int complex_input) {
+
+   const int real_pairs  = _has_real_pairs(out_length, w_initial, w_step);
+   const int conv_length = (real_pairs ? out_length+1 : out_length);
+   const unsigned int fft_length =
+      MRI_FFT_Plan::get_fast_length(in_length+conv_length-1);
+
+   double cost = 2.0*MRI_FFT_Plan::get_cost(fft_length) +
+                 FFT_COST_POINTWISE*(in_length + fft_length + out_length);
+
+   return ((!complex_input && real_pairs) ? 0.5*cost : cost);
+
 }
 
 //---------------------------------------------------------------------------
@@ -128,22 +275,511 @@ Chirp_Algorithm::Chirp_Algorithm(int in_length,
 Chirp_Algorithm::~Chirp_Algorithm() {
    delete[] _chirp;
    delete[] _chirp_fft;
-   delete[] _tmp;
    delete[] _prefilter;
+   delete[] _postfilter;
+   delete[] _postchirp;
+   delete[] _weight;
+   delete[] _chirp_fft_f;
+   delete[] _prefilter_f;
+   delete[] _postfilter_f;
+   delete[] _postchirp_f;
+   delete[] _weight_f;
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::write
+// Writes the lengths, frequencies and filters to a binary file in the
+// native byte order.  Returns FALSE (0) if the write failed.
+//---------------------------------------------------------------------------
+
+int Chirp_Algorithm::write(FILE *fp) const {
+
+   int    lengths[3] = {_in_length, _out_length, _fft_length};
+   double freqs[2]   = {_w_initial, _w_step};
+
+   return (fwrite(lengths, sizeof(int), 3, fp) == 3 &&
+           fwrite(freqs, sizeof(double), 2, fp) == 2 &&
+           fwrite(_chirp, sizeof(double), 2*_chirp_length, fp) ==
+              (size_t)(2*_chirp_length) &&
+           fwrite(_chirp_fft, sizeof(double), 2*_fft_length, fp) ==
+              (size_t)(2*_fft_length) &&
+           fwrite(_prefilter, sizeof(double), 2*_in_length, fp) ==
+              (size_t)(2*_in_length) &&
+           fwrite(_postfilter, sizeof(double), 2*_out_length, fp) ==
+              (size_t)(2*_out_length) &&
+           fwrite(_postchirp, sizeof(double), 2*_conv_length, fp) ==
+              (size_t)(2*_conv_length) &&
+           fwrite(_weight, sizeof(double), 2*_out_length, fp) ==
+              (size_t)(2*_out_length));
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::read
+// Reads filters written by Chirp_Algorithm::write.  Returns a new
+// Chirp_Algorithm, which becomes the property of the caller, or NULL if
+// the file does not hold a complete, consistent record.
+//---------------------------------------------------------------------------
+
+Chirp_Algorithm *Chirp_Algorithm::read(FILE *fp) {
+
+   int    lengths[3];
+   double freqs[2];
+
+   if (fread(lengths, sizeof(int), 3, fp) != 3 ||
+       fread(freqs, sizeof(double), 2, fp) != 2) {
+      return NULL;
+   }
+   if (lengths[0] < 1 || lengths[1] < 1 ||
+       lengths[0] > CHIRP_MAX_LENGTH || lengths[1] > CHIRP_MAX_LENGTH ||
+       lengths[2] < lengths[0]+lengths[1]-1 ||
+       lengths[2] > 2*(lengths[0]+lengths[1])) {
+      return NULL;
+   }
+
+   Chirp_Algorithm *chirp = new Chirp_Algorithm;
+   chirp->_in_length  = lengths[0];
+   chirp->_out_length = lengths[1];
+   chirp->_w_initial  = freqs[0];
+   chirp->_w_step     = freqs[1];
+   chirp->_allocate();
+
+   if (chirp->_fft_length != lengths[2] ||
+       fread(chirp->_chirp, sizeof(double), 2*chirp->_chirp_length, fp) !=
+          (size_t)(2*chirp->_chirp_length) ||
+       fread(chirp->_chirp_fft, sizeof(double), 2*chirp->_fft_length, fp) !=
+          (size_t)(2*chirp->_fft_length) ||
+       fread(chirp->_prefilter, sizeof(double), 2*chirp->_in_length, fp) !=
+          (size_t)(2*chirp->_in_length) ||
+       fread(chirp->_postfilter, sizeof(double), 2*chirp->_out_length, fp)
+          != (size_t)(2*chirp->_out_length) ||
+       fread(chirp->_postchirp, sizeof(double), 2*chirp->_conv_length, fp)
+          != (size_t)(2*chirp->_conv_length) ||
+       fread(chirp->_weight, sizeof(double), 2*chirp->_out_length, fp)
+          != (size_t)(2*chirp->_out_length)) {
+      delete chirp;
+      return NULL;
+   }
+
+   chirp->_single_precision_filters();
+   return chirp;
+
 }
 
 //---------------------------------------------------------------------------
 // Chirp_Algorithm::apply
+// Applies the Chirp DFT using the caller's work space, which must hold
+// get_workspace_length() doubles.  The filters are only read, so
+// several threads may share one Chirp_Algorithm.
 //---------------------------------------------------------------------------
 
 void Chirp_Algorithm::apply(int complex_input,
                             const float in[],  unsigned int in_stride,
-                            float out[],       unsigned int out_stride) {
+                            float out[],       unsigned int out_stride,
+                            double work[]) const {
+
+   _premultiply(complex_input, in, in_stride, work);
+
+   _fft_plan->forward(work);
+   _convolve(work);
+   _fft_plan->inverse(work);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, 2);
+
+   _postmultiply(work, out, out_stride);
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::apply_rows
+// Applies the Chirp DFT to nvec vectors of contiguous elements.  Blocks
+// of CHIRP_BLOCK vectors are pre-filtered together, passed through the
+// FFT plan as one batch and post-filtered, so the filters and the plan
+// stay in cache across the block.  Distances are in elements, as for
+// the strides of apply.  Real vectors are transformed in pairs when the
+// output frequencies allow it.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::apply_rows(int complex_input, unsigned int nvec,
+                                 const float in[],  unsigned int in_dist,
+                                 float out[],       unsigned int out_dist,
+                                 double work[]) const {
+
+   if (!complex_input && _real_pairs) {
+      _apply_real_pairs(nvec, in, in_dist, out, out_dist, work);
+      return;
+   }
+
+   const unsigned int in_step  = (complex_input ? 2*in_dist : in_dist);
+   const unsigned int out_step = 2*out_dist;
+   const int single = (MRI_FFT_Plan::get_precision() ==
+                       MRI_FFT_Plan::SINGLE_PRECISION);
+
+   unsigned int first, nblock;
+
+   for(first=0; first<nvec; first+=nblock){
+      nblock = ((nvec-first < CHIRP_BLOCK) ? nvec-first : CHIRP_BLOCK);
+
+      if (single) {
+         _apply_block(complex_input, nblock, &(in[first*in_step]), in_step, 1,
+                      &(out[first*out_step]), out_step, 1, (float *)work);
+      } else {
+         _apply_block(complex_input, nblock, &(in[first*in_step]), in_step, 1,
+                      &(out[first*out_step]), out_step, 1, work);
+      }
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::apply_columns
+// As apply_rows for complex vectors, but the vectors are the columns of
+// a matrix: element n of column c is element n*ncols+c.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::apply_columns(unsigned int ncols,
+                                    const float in[], float out[],
+                                    double work[]) const {
+
+   const int single = (MRI_FFT_Plan::get_precision() ==
+                       MRI_FFT_Plan::SINGLE_PRECISION);
+
+   unsigned int first, nblock;
+
+   for(first=0; first<ncols; first+=nblock){
+      nblock = ((ncols-first < CHIRP_BLOCK) ? ncols-first : CHIRP_BLOCK);
+
+      if (single) {
+         _apply_block(TRUE, nblock, &(in[2*first]), 2, ncols,
+                      &(out[2*first]), 2, ncols, (float *)work);
+      } else {
+         _apply_block(TRUE, nblock, &(in[2*first]), 2, ncols,
+                      &(out[2*first]), 2, ncols, work);
+      }
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_apply_block
+// Applies the Chirp DFT to one block of at most CHIRP_BLOCK vectors:
+// vector n starts at in[n*in_dist] and out[n*out_dist], in floats, and
+// its elements are in_stride and out_stride elements apart.  The
+// vectors are pre-filtered together, passed through the FFT plan as one
+// batch and post-filtered, so the filters and the plan stay in cache
+// across the block.  The float version computes in single precision.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_apply_block(int complex_input, unsigned int nblock,
+                                   const float in[], unsigned int in_dist,
+                                   unsigned int in_stride,
+                                   float out[], unsigned int out_dist,
+                                   unsigned int out_stride,
+                                   double work[]) const {
+
+   const unsigned int length = 2*_fft_length;
+
+   unsigned int n;
+
+   for(n=0; n<nblock; n++){
+      _premultiply(complex_input, &(in[n*in_dist]), in_stride,
+                   &(work[n*length]));
+   }
+
+   _fft_plan->transform_rows(work, nblock, _fft_length,
+                             MRI_FFT_Plan::FORWARD);
+   for(n=0; n<nblock; n++){
+      _convolve(&(work[n*length]));
+   }
+   _fft_plan->transform_rows(work, nblock, _fft_length,
+                             MRI_FFT_Plan::INVERSE);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, 2*nblock);
+
+   for(n=0; n<nblock; n++){
+      _postmultiply(&(work[n*length]), &(out[n*out_dist]), out_stride);
+   }
+
+}
+
+void Chirp_Algorithm::_apply_block(int complex_input, unsigned int nblock,
+                                   const float in[], unsigned int in_dist,
+                                   unsigned int in_stride,
+                                   float out[], unsigned int out_dist,
+                                   unsigned int out_stride,
+                                   float work[]) const {
+
+   const unsigned int length = 2*_fft_length;
+
+   unsigned int n;
+
+   for(n=0; n<nblock; n++){
+      _premultiply(complex_input, &(in[n*in_dist]), in_stride,
+                   &(work[n*length]));
+   }
+
+   for(n=0; n<nblock; n++){
+      _fft_plan->forward(&(work[n*length]));
+      _convolve(&(work[n*length]));
+      _fft_plan->inverse(&(work[n*length]));
+   }
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, 2*nblock);
+
+   for(n=0; n<nblock; n++){
+      _postmultiply(&(work[n*length]), &(out[n*out_dist]), out_stride);
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_apply_real_pairs
+// Applies the Chirp DFT to nvec real vectors, two at a time: vector 2m
+// is the real part and vector 2m+1 the imaginary part of one complex
+// vector, which halves the number of FFTs.  An odd last vector is
+// transformed with a zero imaginary part.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_apply_real_pairs(unsigned int nvec,
+                                        const float in[], unsigned int in_dist,
+                                        float out[], unsigned int out_dist,
+                                        double work[]) const {
+
+   const int single = (MRI_FFT_Plan::get_precision() ==
+                       MRI_FFT_Plan::SINGLE_PRECISION);
+
+   unsigned int first, nblock;
+
+   for(first=0; first<nvec; first+=nblock){
+      nblock = ((nvec-first < 2*CHIRP_BLOCK) ? nvec-first : 2*CHIRP_BLOCK);
+
+      if (single) {
+         _apply_pair_block(nblock, &(in[first*in_dist]), in_dist,
+                           &(out[2*first*out_dist]), out_dist,
+                           (float *)work);
+      } else {
+         _apply_pair_block(nblock, &(in[first*in_dist]), in_dist,
+                           &(out[2*first*out_dist]), out_dist, work);
+      }
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_apply_pair_block
+// Applies the Chirp DFT to one block of at most 2*CHIRP_BLOCK real
+// vectors, as pairs.  The float version computes in single precision.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_apply_pair_block(unsigned int nvec,
+                                        const float in[], unsigned int in_dist,
+                                        float out[], unsigned int out_dist,
+                                        double work[]) const {
+
+   const unsigned int length = 2*_fft_length;
+   const unsigned int npairs = (nvec+1)/2;
+
+   unsigned int n, v;
+
+   for(n=0; n<npairs; n++){
+      v = 2*n;
+      _premultiply_pair(&(in[v*in_dist]),
+                        ((v+1 < nvec) ? &(in[(v+1)*in_dist]) : NULL),
+                        &(work[n*length]));
+   }
+
+   _fft_plan->transform_rows(work, npairs, _fft_length,
+                             MRI_FFT_Plan::FORWARD);
+   for(n=0; n<npairs; n++){
+      _convolve(&(work[n*length]));
+   }
+   _fft_plan->transform_rows(work, npairs, _fft_length,
+                             MRI_FFT_Plan::INVERSE);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, 2*npairs);
+
+   for(n=0; n<npairs; n++){
+      v = 2*n;
+      _separate_pair(&(work[n*length]), &(out[2*v*out_dist]),
+                     ((v+1 < nvec) ? &(out[2*(v+1)*out_dist]) : NULL));
+   }
+
+}
+
+void Chirp_Algorithm::_apply_pair_block(unsigned int nvec,
+                                        const float in[], unsigned int in_dist,
+                                        float out[], unsigned int out_dist,
+                                        float work[]) const {
+
+   const unsigned int length = 2*_fft_length;
+   const unsigned int npairs = (nvec+1)/2;
+
+   unsigned int n, v;
+
+   for(n=0; n<npairs; n++){
+      v = 2*n;
+      _premultiply_pair(&(in[v*in_dist]),
+                        ((v+1 < nvec) ? &(in[(v+1)*in_dist]) : NULL),
+                        &(work[n*length]));
+   }
+
+   for(n=0; n<npairs; n++){
+      _fft_plan->forward(&(work[n*length]));
+      _convolve(&(work[n*length]));
+      _fft_plan->inverse(&(work[n*length]));
+   }
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, 2*npairs);
+
+   for(n=0; n<npairs; n++){
+      v = 2*n;
+      _separate_pair(&(work[n*length]), &(out[2*v*out_dist]),
+                     ((v+1 < nvec) ? &(out[2*(v+1)*out_dist]) : NULL));
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_premultiply_pair
+// Multiplies the complex vector a + j*b by the pre-filter and zero-pads
+// it to the FFT length.  b may be NULL for a zero imaginary part.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_premultiply_pair(const float a[], const float b[],
+                                        double tmp[]) const {
 
    int n, m;
    double tempr, tempi, filtr, filti;
 
-   // --- Premultiply by chirp filter --- //
+   for(n=0, m=0; n<2*_in_length; n+=2, m++){
+      tempr = a[m];
+      tempi = ((b != NULL) ? b[m] : 0.0);
+      filtr = _prefilter[n];
+      filti = _prefilter[n+1];
+
+      tmp[n]   = tempr * filtr - tempi * filti;
+      tmp[n+1] = tempr * filti + tempi * filtr;
+   }
+
+   for(n=2*_in_length; n<2*_fft_length; n++){
+      tmp[n] = 0.0;
+   }
+
+}
+
+void Chirp_Algorithm::_premultiply_pair(const float a[], const float b[],
+                                        float tmp[]) const {
+
+   int n, m;
+   float tempr, tempi, filtr, filti;
+
+   for(n=0, m=0; n<2*_in_length; n+=2, m++){
+      tempr = a[m];
+      tempi = ((b != NULL) ? b[m] : 0.0f);
+      filtr = _prefilter_f[n];
+      filti = _prefilter_f[n+1];
+
+      tmp[n]   = tempr * filtr - tempi * filti;
+      tmp[n+1] = tempr * filti + tempi * filtr;
+   }
+
+   for(n=2*_in_length; n<2*_fft_length; n++){
+      tmp[n] = 0.0f;
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_separate_pair
+// Splits the convolution of a pair of real vectors into their weighted
+// DFTs.  With Y[k] the DFT of a + j*b and Z[k] = conj(Y[_out_length-k]),
+// the DFTs are A[k] = (Y[k] + Z[k])/2 and B[k] = (Y[k] - Z[k])/(2j).
+// out_b may be NULL if there is no second vector.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_separate_pair(const double tmp[],
+                                     float out_a[], float out_b[]) const {
+
+   int n, m;
+   double yr, yi, zr, zi, ar, ai, br, bi, filtr, filti;
+
+   const double *tmp_no_alias = &(tmp[2*(_in_length-1)]);
+
+   for(n=0; n<2*_out_length; n+=2){
+      m = 2*_out_length-n;
+
+      yr = tmp_no_alias[n]   * _postchirp[n]   -
+           tmp_no_alias[n+1] * _postchirp[n+1];
+      yi = tmp_no_alias[n]   * _postchirp[n+1] +
+           tmp_no_alias[n+1] * _postchirp[n];
+      zr = tmp_no_alias[m]   * _postchirp[m]   -
+           tmp_no_alias[m+1] * _postchirp[m+1];
+      zi = tmp_no_alias[m]   * _postchirp[m+1] +
+           tmp_no_alias[m+1] * _postchirp[m];
+
+      filtr = _weight[n];
+      filti = _weight[n+1];
+
+      ar = 0.5*(yr + zr);
+      ai = 0.5*(yi - zi);
+      out_a[n]   = ar * filtr - ai * filti;
+      out_a[n+1] = ar * filti + ai * filtr;
+
+      if (out_b != NULL) {
+         br = 0.5*(yi + zi);
+         bi = 0.5*(zr - yr);
+         out_b[n]   = br * filtr - bi * filti;
+         out_b[n+1] = br * filti + bi * filtr;
+      }
+   }
+
+}
+
+void Chirp_Algorithm::_separate_pair(const float tmp[],
+                                     float out_a[], float out_b[]) const {
+
+   int n, m;
+   float yr, yi, zr, zi, ar, ai, br, bi, filtr, filti;
+
+   const float *tmp_no_alias = &(tmp[2*(_in_length-1)]);
+
+   for(n=0; n<2*_out_length; n+=2){
+      m = 2*_out_length-n;
+
+      yr = tmp_no_alias[n]   * _postchirp_f[n]   -
+           tmp_no_alias[n+1] * _postchirp_f[n+1];
+      yi = tmp_no_alias[n]   * _postchirp_f[n+1] +
+           tmp_no_alias[n+1] * _postchirp_f[n];
+      zr = tmp_no_alias[m]   * _postchirp_f[m]   -
+           tmp_no_alias[m+1] * _postchirp_f[m+1];
+      zi = tmp_no_alias[m]   * _postchirp_f[m+1] +
+           tmp_no_alias[m+1] * _postchirp_f[m];
+
+      filtr = _weight_f[n];
+      filti = _weight_f[n+1];
+
+      ar = 0.5f*(yr + zr);
+      ai = 0.5f*(yi - zi);
+      out_a[n]   = ar * filtr - ai * filti;
+      out_a[n+1] = ar * filti + ai * filtr;
+
+      if (out_b != NULL) {
+         br = 0.5f*(yi + zi);
+         bi = 0.5f*(zr - yr);
+         out_b[n]   = br * filtr - bi * filti;
+         out_b[n+1] = br * filti + bi * filtr;
+      }
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_premultiply
+// Multiplies the input vector by the pre-filter and zero-pads it to the
+// FFT length.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_premultiply(int complex_input,
+                                   const float in[], unsigned int in_stride,
+                                   double tmp[]) const {
+
+   int n, m;
+   double tempr, tempi, filtr, filti;
 
    if (complex_input) {
 
@@ -153,8 +789,46 @@ void Chirp_Algorithm::apply(int complex_input,
          filtr = _prefilter[n];
          filti = _prefilter[n+1];
  
-         _tmp[n]   = tempr * filtr - tempi * filti;
-         _tmp[n+1] = tempr * filti + tempi * filtr;
+         tmp[n]   = tempr * filtr - tempi * filti;
+         tmp[n+1] = tempr * filti + tempi * filtr;
+      }
+
+   } else {  // real input
+
+      for(n=0, m=0; n<2*_in_length; n+=2, m+=in_stride){
+         tempr = in[m];
+
+         tmp[n]   = _prefilter[n]   * tempr;
+         tmp[n+1] = _prefilter[n+1] * tempr;
+      }
+   
+   }
+
+   // --- Zero-pad the rest of the pre-filtered input vector --- //
+
+   for(n=2*_in_length; n<2*_fft_length; n++){
+      tmp[n] = 0.0;   
+   }
+
+}
+
+void Chirp_Algorithm::_premultiply(int complex_input,
+                                   const float in[], unsigned int in_stride,
+                                   float tmp[]) const {
+
+   int n, m;
+   float tempr, tempi, filtr, filti;
+
+   if (complex_input) {
+
+      for(n=0, m=0; n<2*_in_length; n+=2, m+=(2*in_stride)){
+         tempr = in[m]; 
+         tempi = in[m+1];
+         filtr = _prefilter_f[n];
+         filti = _prefilter_f[n+1];
+ 
+         tmp[n]   = tempr * filtr - tempi * filti;
+         tmp[n+1] = tempr * filti + tempi * filtr;
       }
 
    } else {  // real input
@@ -162,8 +836,8 @@ void Chirp_Algorithm::apply(int complex_input,
       for(n=0, m=0; n<2*_in_length; n+=2, m+=in_stride){
          tempr = in[m];
 
-         _tmp[n]   = _prefilter[n]   * tempr;
-         _tmp[n+1] = _prefilter[n+1] * tempr;
+         tmp[n]   = _prefilter_f[n]   * tempr;
+         tmp[n+1] = _prefilter_f[n+1] * tempr;
       }
    
    }
@@ -171,35 +845,93 @@ void Chirp_Algorithm::apply(int complex_input,
    // --- Zero-pad the rest of the pre-filtered input vector --- //
 
    for(n=2*_in_length; n<2*_fft_length; n++){
-      _tmp[n] = 0.0;   
+      tmp[n] = 0.0f;   
    }
 
-   // --- Use FFT for fast convolution --- //
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_convolve
+// Multiplies the transformed vector by the transform of the chirp filter.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_convolve(double tmp[]) const {
+
+   int n;
+   double tempr, tempi, filtr, filti;
 
-   four1(_tmp-1, _fft_length, -1);
    for(n=0; n<2*_fft_length; n+=2){
-      tempr = _tmp[n];  
-      tempi = _tmp[n+1];
+      tempr = tmp[n];  
+      tempi = tmp[n+1];
       filtr = _chirp_fft[n];
       filti = _chirp_fft[n+1];
 
-      _tmp[n]   = tempr * filtr - tempi * filti;
-      _tmp[n+1] = tempr * filti + tempi * filtr;
+      tmp[n]   = tempr * filtr - tempi * filti;
+      tmp[n+1] = tempr * filti + tempi * filtr;
+   }
+
+}
+
+void Chirp_Algorithm::_convolve(float tmp[]) const {
+
+   int n;
+   float tempr, tempi, filtr, filti;
+
+   for(n=0; n<2*_fft_length; n+=2){
+      tempr = tmp[n];  
+      tempi = tmp[n+1];
+      filtr = _chirp_fft_f[n];
+      filti = _chirp_fft_f[n+1];
+
+      tmp[n]   = tempr * filtr - tempi * filti;
+      tmp[n+1] = tempr * filti + tempi * filtr;
    }
-   four1(_tmp-1, _fft_length, 1);
 
-   // --- Postmultiply data --- //
-   // Note: postmultiplication is by 1./_chirp, which in
-   // the Fourier case simplifies to the complex conjugate.
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::_postmultiply
+// Multiplies the non-aliased part of the convolution by the post-filter.
+//---------------------------------------------------------------------------
+
+void Chirp_Algorithm::_postmultiply(const double tmp[],
+                                    float out[], unsigned int out_stride)
+                                    const {
+
+   int n, m;
+   double tempr, tempi, filtr, filti;
+
+   const double *tmp_no_alias = &(tmp[2*(_in_length-1)]);
+
+   for(n=0, m=0; n<2*_out_length; n+=2, m+=(2*out_stride)){
+      tempr = tmp_no_alias[n];
+      tempi = tmp_no_alias[n+1];
+      filtr = _postfilter[n];
+      filti = _postfilter[n+1];
+     
+      out[m]   = tempr * filtr - tempi * filti;
+      out[m+1] = tempr * filti + tempi * filtr;
+   }
+                             
+}
+
+void Chirp_Algorithm::_postmultiply(const float tmp[],
+                                    float out[], unsigned int out_stride)
+                                    const {
+
+   int n, m;
+   float tempr, tempi, filtr, filti;
+
+   const float *tmp_no_alias = &(tmp[2*(_in_length-1)]);
 
    for(n=0, m=0; n<2*_out_length; n+=2, m+=(2*out_stride)){
-      tempr = _tmp_no_alias[n];
-      tempi = _tmp_no_alias[n+1];
-      filtr = _chirp_delay_zero[n];
-      filti = _chirp_delay_zero[n+1];
+      tempr = tmp_no_alias[n];
+      tempi = tmp_no_alias[n+1];
+      filtr = _postfilter_f[n];
+      filti = _postfilter_f[n+1];
      
-      out[m]   = (tempr * filtr - tempi * filti) / _fft_length;
-      out[m+1] = (tempr * filti + tempi * filtr) / _fft_length;
+      out[m]   = tempr * filtr - tempi * filti;
+      out[m+1] = tempr * filti + tempi * filtr;
    }
                              
 }
@@ -23,7 +23,15 @@
  *
  *=========================================================================*/
 
+#include <stdio.h>
 #include "fourn.h"
+#include "mrifft.h"
+
+// Vectors transformed together by Chirp_Algorithm::apply_rows
+#define CHIRP_BLOCK 8
+
+// Largest vector length accepted by Chirp_Algorithm::read
+#define CHIRP_MAX_LENGTH 65536
 
 //---------------------------------------------------------------------------
 // Chirp_Algorithm
@@ -33,7 +41,8 @@
 class Chirp_Algorithm {
    public:
       Chirp_Algorithm(int in_length, int out_length,
-                      double w_initial, double w_step);
+                      double w_initial, double w_step,
+                      const double out_weight[] = NULL);
       virtual ~Chirp_Algorithm();
 
       // --- Access functions --- //
@@ -42,27 +51,126 @@ class Chirp_Algorithm {
       inline int get_output_length(void) const;
       inline double get_initial_freq(void) const;
       inline double get_step_freq(void) const;
+      inline int get_fft_length(void) const;
+      inline int get_workspace_length(void) const;
+      inline int get_batch_workspace_length(void) const;
+
+      // Estimated time per vector of apply_rows, in the units of
+      // MRI_FFT_Plan::get_cost
+      static double get_cost(int in_length, int out_length,
+                             double w_initial, double w_step,
+                             int complex_input);
 
       // --- Apply the chirp algorithm --- //
 
+      // The caller supplies work space of get_workspace_length()
+      // doubles, so several threads may share one Chirp_Algorithm.
       void apply(int complex_input,
                  const float in[],  unsigned int in_stride,
-                 float out[],       unsigned int out_stride);
+                 float out[],       unsigned int out_stride,
+                 double work[]) const;
+
+      // Applies the chirp to nvec vectors of contiguous elements, in_dist
+      // and out_dist elements apart, CHIRP_BLOCK vectors at a time.  Real
+      // vectors are packed in pairs when the output frequencies are
+      // symmetric about zero.  The work space must hold
+      // get_batch_workspace_length() doubles.  apply_rows and
+      // apply_columns compute in single precision when it is selected
+      // by MRI_FFT_Plan::set_precision.
+      void apply_rows(int complex_input, unsigned int nvec,
+                      const float in[],  unsigned int in_dist,
+                      float out[],       unsigned int out_dist,
+                      double work[]) const;
+
+      // Applies the chirp to the ncols complex columns of an in_length x
+      // ncols matrix, giving an out_length x ncols matrix.  CHIRP_BLOCK
+      // neighbouring columns are transformed together, so each row of
+      // the block is read from one cache line.  The work space must hold
+      // get_batch_workspace_length() doubles.
+      void apply_columns(unsigned int ncols,
+                         const float in[], float out[],
+                         double work[]) const;
+
+      // --- Saved filters --- //
+
+      int write(FILE *fp) const;
+      static Chirp_Algorithm *read(FILE *fp);
 
    private:
       int _in_length;                   // input vector length
       int _out_length;                  // output vector length
+      int _conv_length;                 // outputs of the convolution
+      int _chirp_length;                // length of the Chirp filter
       int _fft_length;                  // length for fast convolution
+      const MRI_FFT_Plan *_fft_plan;    // shared FFT plan of _fft_length
 
       double _w_initial;                // initial sample frequency
       double _w_step;                   // frequency step between samples
 
       double       *_chirp;             // the Chirp filter
       double       *_chirp_fft;         // FFT of the Chirp filter for conv.
-      double       *_tmp;               // work space
       double       *_prefilter;         // the Chirp data pre-filter
+      double       *_postfilter;        // 1/chirp * weight / _fft_length
+      double       *_postchirp;         // 1/chirp / _fft_length
+      double       *_weight;            // output weight
+      int          _real_pairs;         // TRUE if real pairs can be packed
       double       *_chirp_delay_zero;  // pointer to zero delay chirp filter
-      double       *_tmp_no_alias;      // pointer to no alias section of conv.
+
+      // Single precision copies for apply_rows and apply_columns
+      float        *_chirp_fft_f;
+      float        *_prefilter_f;
+      float        *_postfilter_f;
+      float        *_postchirp_f;
+      float        *_weight_f;
+
+      Chirp_Algorithm();
+      void _allocate(void);
+      void _single_precision_filters(void);
+      static int _has_real_pairs(int out_length,
+                                 double w_initial, double w_step);
+
+      void _premultiply(int complex_input,
+                        const float in[], unsigned int in_stride,
+                        double tmp[]) const;
+      void _premultiply(int complex_input,
+                        const float in[], unsigned int in_stride,
+                        float tmp[]) const;
+      void _convolve(double tmp[]) const;
+      void _convolve(float tmp[]) const;
+      void _apply_block(int complex_input, unsigned int nblock,
+                        const float in[], unsigned int in_dist,
+                        unsigned int in_stride,
+                        float out[], unsigned int out_dist,
+                        unsigned int out_stride, double work[]) const;
+      void _apply_block(int complex_input, unsigned int nblock,
+                        const float in[], unsigned int in_dist,
+                        unsigned int in_stride,
+                        float out[], unsigned int out_dist,
+                        unsigned int out_stride, float work[]) const;
+      void _apply_real_pairs(unsigned int nvec,
+                             const float in[], unsigned int in_dist,
+                             float out[], unsigned int out_dist,
+                             double work[]) const;
+      void _apply_pair_block(unsigned int nvec,
+                             const float in[], unsigned int in_dist,
+                             float out[], unsigned int out_dist,
+                             double work[]) const;
+      void _apply_pair_block(unsigned int nvec,
+                             const float in[], unsigned int in_dist,
+                             float out[], unsigned int out_dist,
+                             float work[]) const;
+      void _premultiply_pair(const float a[], const float b[],
+                             double tmp[]) const;
+      void _premultiply_pair(const float a[], const float b[],
+                             float tmp[]) const;
+      void _separate_pair(const double tmp[],
+                          float out_a[], float out_b[]) const;
+      void _separate_pair(const float tmp[],
+                          float out_a[], float out_b[]) const;
+      void _postmultiply(const double tmp[],
+                         float out[], unsigned int out_stride) const;
+      void _postmultiply(const float tmp[],
+                         float out[], unsigned int out_stride) const;
 
 };
 
@@ -110,4 +218,34 @@ double Chirp_Algorithm::get_step_freq(void) const {
    return _w_step;
 }
 
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::get_fft_length
+// Returns the length of the fast convolution transforms.
+//---------------------------------------------------------------------------
+
+inline
+int Chirp_Algorithm::get_fft_length(void) const {
+   return _fft_length;
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::get_workspace_length
+// Returns the number of doubles of work space needed by apply.
+//---------------------------------------------------------------------------
+
+inline
+int Chirp_Algorithm::get_workspace_length(void) const {
+   return 2*_fft_length;
+}
+
+//---------------------------------------------------------------------------
+// Chirp_Algorithm::get_batch_workspace_length
+// Returns the number of doubles of work space needed by apply_rows.
+//---------------------------------------------------------------------------
+
+inline
+int Chirp_Algorithm::get_batch_workspace_length(void) const {
+   return 2*_fft_length*CHIRP_BLOCK;
+}
+
 #endif
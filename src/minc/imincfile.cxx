@@ -36,6 +36,7 @@
 
 #include "imincfile.h"
 #include "mriimage.h"
+#include "mriprofile.h"
 
 //--------------------------------------------------------------------------
 // I_MINC_File constructors
@@ -111,6 +112,19 @@ int I_MINC_File::load_hyperslab(long start[], long count[], void *volume){
    assert(this->is_good());
    assert(volume != NULL);
 #endif
+
+   if (MRI_Profile::is_enabled()) {
+      long nelements = 1;
+      int  idim;
+      for (idim=0; idim<_volume_info.number_of_dimensions; idim++){
+         nelements *= count[idim];
+      }
+      MRI_Profile::count(MRI_Profile::MIICV_CALLS);
+      MRI_Profile::count(MRI_Profile::BYTES_READ, 
+                         nelements * nctypelen(_volume_info.datatype));
+   }
+
+   MRI_Lock lock(MINC_File::library_mutex);
    return miicv_get(_icvid, start, count, volume);
 
 }
@@ -167,6 +181,7 @@ int I_MINC_File::load_slice(int slice_num, MRI_Image& image){
    count[ndims-1] = _volume_info.length[ndims-1];
 
    // Read in the image maximum and minimum
+   MRI_Lock lock(MINC_File::library_mutex);
    if (mivarget1(_MINCid, ncvarid(_MINCid, MIimagemin), start, NC_DOUBLE, 
                  NULL, &min) == MI_ERROR){
       min = 0;
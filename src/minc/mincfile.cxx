@@ -37,6 +37,13 @@
 
 int MINC_File::_ncoldopts = ncopts;
 
+//--------------------------------------------------------------------------
+// MINC_File::library_mutex
+// Serializes calls into the MINC library from concurrent threads.
+//--------------------------------------------------------------------------
+
+MRI_Mutex MINC_File::library_mutex(TRUE);
+
 //--------------------------------------------------------------------------
 // MINC_File::type 
 // static look up table for data type names.
@@ -43,6 +43,7 @@ extern "C" {
 #include "mincicv.h"
 #include "mrimatrix.h"
 #include "mrivolume.h"
+#include "mrithread.h"
 
 //--------------------------------------------------------------------------
 // Volume dimensions
@@ -171,6 +172,13 @@ class MINC_File : public MINC_ICV {
       int create_std_variable(const char *varname, nc_type datatype,
                        int ndims, int dim[]);
 
+      // --- Thread safety --- //
+
+      // The MINC and NetCDF libraries are not reentrant.  Slice reads
+      // and writes hold this (recursive) mutex; callers that need a
+      // sequence of library calls to be atomic may hold it as well.
+      static MRI_Mutex library_mutex;
+
    protected:
 
       // --- Internal data structures --- //
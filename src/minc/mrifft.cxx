@@ -0,0 +1,1104 @@
+//===========================================================================
+// MRIFFT.CXX
+// Fast Fourier transforms with precomputed plans.
+//===========================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+#include "mrifft.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+// Static members
+//---------------------------------------------------------------------------
+
+MRI_FFT_Plan      *MRI_FFT_Plan::_plans = NULL;
+MRI_Mutex          MRI_FFT_Plan::_plans_mutex;
+MRI_FFT_Plan::Precision MRI_FFT_Plan::_precision =
+   MRI_FFT_Plan::DOUBLE_PRECISION;
+MRI_Real_FFT_Plan *MRI_Real_FFT_Plan::_plans = NULL;
+MRI_Mutex          MRI_Real_FFT_Plan::_plans_mutex;
+
+//---------------------------------------------------------------------------
+// Mixed radix stages
+// Each combines the f transforms of length m in every group of f*m
+// elements: output j + q*m of a group is the sum over r of W_f^(r*q)
+// times element j of transform r, twiddled by w[2*(f-1)*j + 2*(r-1)].
+// W_f = exp(-2*pi*i/f).  The float versions follow, step for step.
+//---------------------------------------------------------------------------
+
+#define TWIDDLE(xr, xi, p, w) { \
+   xr = (w)[0]*(p)[0] - (w)[1]*(p)[1]; \
+   xi = (w)[0]*(p)[1] + (w)[1]*(p)[0]; }
+
+static void radix2_stage(double x[], unsigned int n, unsigned int m,
+                         const double w[]) {
+   unsigned int g, j;
+   for(g=0; g<n; g+=2*m){
+      double *p0 = &(x[2*g]);
+      double *p1 = p0 + 2*m;
+      for(j=0; j<m; j++){
+         double br, bi;
+         TWIDDLE(br, bi, &(p1[2*j]), &(w[2*j]));
+         const double ar = p0[2*j], ai = p0[2*j+1];
+         p0[2*j]   = ar + br;
+         p0[2*j+1] = ai + bi;
+         p1[2*j]   = ar - br;
+         p1[2*j+1] = ai - bi;
+      }
+   }
+}
+
+static void radix3_stage(double x[], unsigned int n, unsigned int m,
+                         const double w[]) {
+   const double s3 = 0.86602540378443864676;        // sin(2*pi/3)
+   unsigned int g, j;
+   for(g=0; g<n; g+=3*m){
+      double *p0 = &(x[2*g]);
+      double *p1 = p0 + 2*m;
+      double *p2 = p1 + 2*m;
+      for(j=0; j<m; j++){
+         double b1r, b1i, b2r, b2i;
+         TWIDDLE(b1r, b1i, &(p1[2*j]), &(w[4*j]));
+         TWIDDLE(b2r, b2i, &(p2[2*j]), &(w[4*j+2]));
+         const double ar = p0[2*j], ai = p0[2*j+1];
+
+         const double sr = b1r + b2r, si = b1i + b2i;
+         const double dr = b1r - b2r, di = b1i - b2i;
+         const double tr = ar - 0.5*sr, ti = ai - 0.5*si;
+
+         p0[2*j]   = ar + sr;
+         p0[2*j+1] = ai + si;
+         p1[2*j]   = tr + s3*di;                     // t - i*s3*d
+         p1[2*j+1] = ti - s3*dr;
+         p2[2*j]   = tr - s3*di;
+         p2[2*j+1] = ti + s3*dr;
+      }
+   }
+}
+
+static void radix4_stage(double x[], unsigned int n, unsigned int m,
+                         const double w[]) {
+   unsigned int g, j;
+   for(g=0; g<n; g+=4*m){
+      double *p0 = &(x[2*g]);
+      double *p1 = p0 + 2*m;
+      double *p2 = p1 + 2*m;
+      double *p3 = p2 + 2*m;
+      for(j=0; j<m; j++){
+         double b1r, b1i, b2r, b2i, b3r, b3i;
+         TWIDDLE(b1r, b1i, &(p1[2*j]), &(w[6*j]));
+         TWIDDLE(b2r, b2i, &(p2[2*j]), &(w[6*j+2]));
+         TWIDDLE(b3r, b3i, &(p3[2*j]), &(w[6*j+4]));
+         const double ar = p0[2*j], ai = p0[2*j+1];
+
+         const double s0r = ar + b2r,  s0i = ai + b2i;
+         const double d0r = ar - b2r,  d0i = ai - b2i;
+         const double s1r = b1r + b3r, s1i = b1i + b3i;
+         const double d1r = b1r - b3r, d1i = b1i - b3i;
+
+         p0[2*j]   = s0r + s1r;
+         p0[2*j+1] = s0i + s1i;
+         p2[2*j]   = s0r - s1r;
+         p2[2*j+1] = s0i - s1i;
+         p1[2*j]   = d0r + d1i;                      // d0 - i*d1
+         p1[2*j+1] = d0i - d1r;
+         p3[2*j]   = d0r - d1i;                      // d0 + i*d1
+         p3[2*j+1] = d0i + d1r;
+      }
+   }
+}
+
+static void radix5_stage(double x[], unsigned int n, unsigned int m,
+                         const double w[]) {
+   const double c1 =  0.30901699437494742410;       // cos(2*pi/5)
+   const double c2 = -0.80901699437494742410;       // cos(4*pi/5)
+   const double s1 =  0.95105651629515357212;       // sin(2*pi/5)
+   const double s2 =  0.58778525229247312917;       // sin(4*pi/5)
+   unsigned int g, j;
+   for(g=0; g<n; g+=5*m){
+      double *p0 = &(x[2*g]);
+      double *p1 = p0 + 2*m;
+      double *p2 = p1 + 2*m;
+      double *p3 = p2 + 2*m;
+      double *p4 = p3 + 2*m;
+      for(j=0; j<m; j++){
+         double a1r, a1i, a2r, a2i, a3r, a3i, a4r, a4i;
+         TWIDDLE(a1r, a1i, &(p1[2*j]), &(w[8*j]));
+         TWIDDLE(a2r, a2i, &(p2[2*j]), &(w[8*j+2]));
+         TWIDDLE(a3r, a3i, &(p3[2*j]), &(w[8*j+4]));
+         TWIDDLE(a4r, a4i, &(p4[2*j]), &(w[8*j+6]));
+         const double ar = p0[2*j], ai = p0[2*j+1];
+
+         const double b1r = a1r + a4r, b1i = a1i + a4i;
+         const double b2r = a2r + a3r, b2i = a2i + a3i;
+         const double d1r = a1r - a4r, d1i = a1i - a4i;
+         const double d2r = a2r - a3r, d2i = a2i - a3i;
+
+         const double t1r = ar + c1*b1r + c2*b2r, t1i = ai + c1*b1i + c2*b2i;
+         const double t2r = ar + c2*b1r + c1*b2r, t2i = ai + c2*b1i + c1*b2i;
+         const double u1r = s1*d1r + s2*d2r, u1i = s1*d1i + s2*d2i;
+         const double u2r = s2*d1r - s1*d2r, u2i = s2*d1i - s1*d2i;
+
+         p0[2*j]   = ar + b1r + b2r;
+         p0[2*j+1] = ai + b1i + b2i;
+         p1[2*j]   = t1r + u1i;                      // t1 - i*u1
+         p1[2*j+1] = t1i - u1r;
+         p4[2*j]   = t1r - u1i;
+         p4[2*j+1] = t1i + u1r;
+         p2[2*j]   = t2r + u2i;                      // t2 - i*u2
+         p2[2*j+1] = t2i - u2r;
+         p3[2*j]   = t2r - u2i;
+         p3[2*j+1] = t2i + u2r;
+      }
+   }
+}
+
+static void radix2_stage(float x[], unsigned int n, unsigned int m,
+                         const float w[]) {
+   unsigned int g, j;
+   for(g=0; g<n; g+=2*m){
+      float *p0 = &(x[2*g]);
+      float *p1 = p0 + 2*m;
+      for(j=0; j<m; j++){
+         float br, bi;
+         TWIDDLE(br, bi, &(p1[2*j]), &(w[2*j]));
+         const float ar = p0[2*j], ai = p0[2*j+1];
+         p0[2*j]   = ar + br;
+         p0[2*j+1] = ai + bi;
+         p1[2*j]   = ar - br;
+         p1[2*j+1] = ai - bi;
+      }
+   }
+}
+
+static void radix3_stage(float x[], unsigned int n, unsigned int m,
+                         const float w[]) {
+   const float s3 = 0.86602540378443864676f;       // sin(2*pi/3)
+   unsigned int g, j;
+   for(g=0; g<n; g+=3*m){
+      float *p0 = &(x[2*g]);
+      float *p1 = p0 + 2*m;
+      float *p2 = p1 + 2*m;
+      for(j=0; j<m; j++){
+         float b1r, b1i, b2r, b2i;
+         TWIDDLE(b1r, b1i, &(p1[2*j]), &(w[4*j]));
+         TWIDDLE(b2r, b2i, &(p2[2*j]), &(w[4*j+2]));
+         const float ar = p0[2*j], ai = p0[2*j+1];
+
+         const float sr = b1r + b2r, si = b1i + b2i;
+         const float dr = b1r - b2r, di = b1i - b2i;
+         const float tr = ar - 0.5f*sr, ti = ai - 0.5f*si;
+
+         p0[2*j]   = ar + sr;
+         p0[2*j+1] = ai + si;
+         p1[2*j]   = tr + s3*di;                     // t - i*s3*d
+         p1[2*j+1] = ti - s3*dr;
+         p2[2*j]   = tr - s3*di;
+         p2[2*j+1] = ti + s3*dr;
+      }
+   }
+}
+
+static void radix4_stage(float x[], unsigned int n, unsigned int m,
+                         const float w[]) {
+   unsigned int g, j;
+   for(g=0; g<n; g+=4*m){
+      float *p0 = &(x[2*g]);
+      float *p1 = p0 + 2*m;
+      float *p2 = p1 + 2*m;
+      float *p3 = p2 + 2*m;
+      for(j=0; j<m; j++){
+         float b1r, b1i, b2r, b2i, b3r, b3i;
+         TWIDDLE(b1r, b1i, &(p1[2*j]), &(w[6*j]));
+         TWIDDLE(b2r, b2i, &(p2[2*j]), &(w[6*j+2]));
+         TWIDDLE(b3r, b3i, &(p3[2*j]), &(w[6*j+4]));
+         const float ar = p0[2*j], ai = p0[2*j+1];
+
+         const float s0r = ar + b2r,  s0i = ai + b2i;
+         const float d0r = ar - b2r,  d0i = ai - b2i;
+         const float s1r = b1r + b3r, s1i = b1i + b3i;
+         const float d1r = b1r - b3r, d1i = b1i - b3i;
+
+         p0[2*j]   = s0r + s1r;
+         p0[2*j+1] = s0i + s1i;
+         p2[2*j]   = s0r - s1r;
+         p2[2*j+1] = s0i - s1i;
+         p1[2*j]   = d0r + d1i;                      // d0 - i*d1
+         p1[2*j+1] = d0i - d1r;
+         p3[2*j]   = d0r - d1i;                      // d0 + i*d1
+         p3[2*j+1] = d0i + d1r;
+      }
+   }
+}
+
+static void radix5_stage(float x[], unsigned int n, unsigned int m,
+                         const float w[]) {
+   const float c1 =  0.30901699437494742410f;      // cos(2*pi/5)
+   const float c2 = -0.80901699437494742410f;      // cos(4*pi/5)
+   const float s1 =  0.95105651629515357212f;      // sin(2*pi/5)
+   const float s2 =  0.58778525229247312917f;      // sin(4*pi/5)
+   unsigned int g, j;
+   for(g=0; g<n; g+=5*m){
+      float *p0 = &(x[2*g]);
+      float *p1 = p0 + 2*m;
+      float *p2 = p1 + 2*m;
+      float *p3 = p2 + 2*m;
+      float *p4 = p3 + 2*m;
+      for(j=0; j<m; j++){
+         float a1r, a1i, a2r, a2i, a3r, a3i, a4r, a4i;
+         TWIDDLE(a1r, a1i, &(p1[2*j]), &(w[8*j]));
+         TWIDDLE(a2r, a2i, &(p2[2*j]), &(w[8*j+2]));
+         TWIDDLE(a3r, a3i, &(p3[2*j]), &(w[8*j+4]));
+         TWIDDLE(a4r, a4i, &(p4[2*j]), &(w[8*j+6]));
+         const float ar = p0[2*j], ai = p0[2*j+1];
+
+         const float b1r = a1r + a4r, b1i = a1i + a4i;
+         const float b2r = a2r + a3r, b2i = a2i + a3i;
+         const float d1r = a1r - a4r, d1i = a1i - a4i;
+         const float d2r = a2r - a3r, d2i = a2i - a3i;
+
+         const float t1r = ar + c1*b1r + c2*b2r, t1i = ai + c1*b1i + c2*b2i;
+         const float t2r = ar + c2*b1r + c1*b2r, t2i = ai + c2*b1i + c1*b2i;
+         const float u1r = s1*d1r + s2*d2r, u1i = s1*d1i + s2*d2i;
+         const float u2r = s2*d1r - s1*d2r, u2i = s2*d1i - s1*d2i;
+
+         p0[2*j]   = ar + b1r + b2r;
+         p0[2*j+1] = ai + b1i + b2i;
+         p1[2*j]   = t1r + u1i;                      // t1 - i*u1
+         p1[2*j+1] = t1i - u1r;
+         p4[2*j]   = t1r - u1i;
+         p4[2*j+1] = t1i + u1r;
+         p2[2*j]   = t2r + u2i;                      // t2 - i*u2
+         p2[2*j+1] = t2i - u2r;
+         p3[2*j]   = t2r - u2i;
+         p3[2*j+1] = t2i + u2r;
+      }
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan constructor
+// Power of two lengths use bit reversal and radix-4 stages.  Other
+// lengths of the form 2^a * 3^b * 5^c are factored into radix 4, 2, 3
+// and 5 stages, preceded by the matching digit reversal, which is stored
+// as a list of swaps that follow each cycle of the permutation.  The
+// twiddles are computed directly rather than by recurrence.
+//---------------------------------------------------------------------------
+
+MRI_FFT_Plan::MRI_FFT_Plan(unsigned int length) : _length(length) {
+
+   unsigned int log2n, i, j, k, m, bit;
+
+   if (!is_valid_length(length)) {
+      cerr << "MRI_FFT_Plan: length " << length
+           << " is not of the form 2^a * 3^b * 5^c." << endl;
+      exit(EXIT_FAILURE);
+   }
+
+   _nstages = 0;
+   _radix   = NULL;
+   _nswaps  = 0;
+   _swap    = new unsigned int[2*length];
+
+   for(log2n=0; (1U << log2n) < length; log2n++);
+   if ((1U << log2n) != length) {
+      _mixed_radix_tables();
+      _single_precision_tables();
+      _next = NULL;
+      return;
+   }
+
+   // --- Bit reversal pairs --- //
+
+   for(i=0; i<length; i++){
+      for(j=0, bit=0; bit<log2n; bit++){
+         j |= ((i >> bit) & 1U) << (log2n-1-bit);
+      }
+      if (i < j) {
+         _swap[2*_nswaps]   = i;
+         _swap[2*_nswaps+1] = j;
+         _nswaps++;
+      }
+   }
+
+   // --- Twiddles of the radix-4 stages --- //
+   // A stage combining four transforms of length m needs W^j, W^2j and
+   // W^3j, W = exp(-2*pi*i/4m), for j = 0, ..., m-1.
+
+   unsigned int ntwiddles = 0;
+   for(m=(log2n & 1) ? 2 : 1; 4*m<=length; m*=4){
+      ntwiddles += 6*m;
+   }
+   _twiddle = new double[ntwiddles > 0 ? ntwiddles : 1];
+
+   double *w = _twiddle;
+   for(m=(log2n & 1) ? 2 : 1; 4*m<=length; m*=4){
+      for(j=0; j<m; j++){
+         for(k=1; k<=3; k++){
+            const double angle = 2.0*M_PI*(double)(k*j)/(double)(4*m);
+            w[6*j+2*(k-1)]   =  cos(angle);
+            w[6*j+2*(k-1)+1] = -sin(angle);
+         }
+      }
+      w += 6*m;
+   }
+
+   _single_precision_tables();
+   _next = NULL;
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::_single_precision_tables
+// Rounds the twiddles to float for the single precision transforms.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::_single_precision_tables(void) {
+
+   unsigned int ntwiddles = 0, s, m;
+
+   if (_radix == NULL) {
+      for(s=0; (1U << s) < _length; s++);
+      for(m=(s & 1) ? 2 : 1; 4*m<=_length; m*=4) ntwiddles += 6*m;
+   } else {
+      for(s=0, m=1; s<_nstages; m*=_radix[s], s++){
+         ntwiddles += 2*(_radix[s]-1)*m;
+      }
+   }
+
+   _twiddle_f = new float[ntwiddles > 0 ? ntwiddles : 1];
+   for(m=0; m<ntwiddles; m++) _twiddle_f[m] = (float)_twiddle[m];
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::_mixed_radix_tables
+// Factors a length that is not a power of two into stages, and builds
+// the digit reversal swaps and the twiddles.  Stage s of radix f
+// combines f transforms of length m = f_0*...*f_(s-1) and needs W^(r*j),
+// W = exp(-2*pi*i/fm), for j = 0, ..., m-1 and r = 1, ..., f-1.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::_mixed_radix_tables(void) {
+
+   const unsigned int length = _length;
+   unsigned int i, j, k, m, p, r, s, rest;
+
+   // --- Factor into radix 4, 2, 3 and 5 stages --- //
+
+   _radix = new unsigned int[32];
+   for(rest=length; rest%4 == 0; rest/=4) _radix[_nstages++] = 4;
+   for(; rest%2 == 0; rest/=2) _radix[_nstages++] = 2;
+   for(; rest%3 == 0; rest/=3) _radix[_nstages++] = 3;
+   for(; rest%5 == 0; rest/=5) _radix[_nstages++] = 5;
+
+   // --- Digit reversal --- //
+   // Position p = d_0 + f_0*d_1 + f_0*f_1*d_2 + ... takes the sample
+   // d_0*(n/f_0) + d_1*(n/(f_0*f_1)) + ...  Each cycle of the permutation
+   // p -> source(p) is applied as a chain of swaps.
+
+   unsigned int *source = new unsigned int[length];
+   for(p=0; p<length; p++){
+      for(i=0, k=p, m=length, s=0; s<_nstages; s++){
+         m /= _radix[s];
+         i += (k % _radix[s]) * m;
+         k /= _radix[s];
+      }
+      source[p] = i;
+   }
+
+   char *done = new char[length];
+   for(p=0; p<length; p++) done[p] = 0;
+   for(p=0; p<length; p++){
+      if (done[p]) continue;
+      done[p] = 1;
+      for(i=p, j=source[p]; j!=p; i=j, j=source[j]){
+         _swap[2*_nswaps]   = i;
+         _swap[2*_nswaps+1] = j;
+         _nswaps++;
+         done[j] = 1;
+      }
+   }
+   delete[] done;
+   delete[] source;
+
+   // --- Twiddles --- //
+
+   unsigned int ntwiddles = 0;
+   for(s=0, m=1; s<_nstages; m*=_radix[s], s++){
+      ntwiddles += 2*(_radix[s]-1)*m;
+   }
+   _twiddle = new double[ntwiddles > 0 ? ntwiddles : 1];
+
+   double *w = _twiddle;
+   for(s=0, m=1; s<_nstages; m*=_radix[s], s++){
+      const unsigned int f = _radix[s];
+      for(j=0; j<m; j++){
+         for(r=1; r<f; r++){
+            const double angle = 2.0*M_PI*(double)(r*j)/(double)(f*m);
+            w[2*(f-1)*j+2*(r-1)]   =  cos(angle);
+            w[2*(f-1)*j+2*(r-1)+1] = -sin(angle);
+         }
+      }
+      w += 2*(f-1)*m;
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::is_valid_length
+// Returns TRUE if a plan can be made for the length: 2^a * 3^b * 5^c.
+//---------------------------------------------------------------------------
+
+int MRI_FFT_Plan::is_valid_length(unsigned int length) {
+
+   if (length == 0) return FALSE;
+   while (length%2 == 0) length /= 2;
+   while (length%3 == 0) length /= 3;
+   while (length%5 == 0) length /= 5;
+   return (length == 1);
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::get_cost
+// Estimated time of one transform, in arbitrary units: the work per
+// element of each stage times the length.  Radix-3 and radix-5 stages
+// do more arithmetic per element, and the digit reversal of mixed radix
+// lengths follows longer cycles than bit reversal.
+//---------------------------------------------------------------------------
+
+double MRI_FFT_Plan::get_cost(unsigned int length) {
+
+   double cost = 0.0;
+   unsigned int rest = length;
+   int power_of_two;
+
+   while (rest%4 == 0) { rest /= 4; cost += FFT_COST_RADIX4; }
+   while (rest%2 == 0) { rest /= 2; cost += FFT_COST_RADIX2; }
+   power_of_two = (rest == 1);
+   while (rest%3 == 0) { rest /= 3; cost += FFT_COST_RADIX3; }
+   while (rest%5 == 0) { rest /= 5; cost += FFT_COST_RADIX5; }
+
+   if (!power_of_two) cost += FFT_COST_MIXED;
+
+   return cost*(double)length;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::get_fast_length
+// Returns the valid length at least min_length with the lowest estimated
+// cost.  The next power of two is always a candidate, and is returned
+// when MRISIM_FFT=pow2, so timings can be compared with the power of two
+// lengths.
+//---------------------------------------------------------------------------
+
+unsigned int MRI_FFT_Plan::get_fast_length(unsigned int min_length) {
+
+   unsigned int length, best;
+
+   if (min_length < 1) min_length = 1;
+   for(best=1; best<min_length; best*=2);
+
+   const char *env = getenv("MRISIM_FFT");
+   if (env != NULL && strcmp(env, "pow2") == 0) {
+      return best;
+   }
+
+   double best_cost = get_cost(best);
+   for(length=min_length; length<best; length++){
+      if (is_valid_length(length) && get_cost(length) < best_cost) {
+         best      = length;
+         best_cost = get_cost(length);
+      }
+   }
+   return best;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan destructor
+//---------------------------------------------------------------------------
+
+MRI_FFT_Plan::~MRI_FFT_Plan() {
+   delete[] _swap;
+   delete[] _twiddle;
+   delete[] _twiddle_f;
+   if (_radix != NULL) delete[] _radix;
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::get
+// Returns the shared plan for a length, making it on first use.
+//---------------------------------------------------------------------------
+
+const MRI_FFT_Plan *MRI_FFT_Plan::get(unsigned int length) {
+
+   MRI_Lock lock(_plans_mutex);
+
+   MRI_FFT_Plan *plan;
+   for(plan=_plans; plan!=NULL; plan=plan->_next){
+      if (plan->_length == length) return plan;
+   }
+
+   plan = new MRI_FFT_Plan(length);
+   plan->_next = _plans;
+   _plans      = plan;
+   return plan;
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::set_precision
+// Sets the precision of the batch transforms of float data for the
+// whole process.  Not synchronized: call it before any thread starts.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::set_precision(Precision precision) {
+   _precision = precision;
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::_forward
+// Forward transform in place: bit reversal, an optional radix-2 stage,
+// then radix-4 stages.  Within each group of 4m elements the four
+// transforms of length m hold the samples 4k, 4k+2, 4k+1 and 4k+3, in
+// that order.  Mixed radix lengths go on to _mixed_radix_stages after
+// the digit reversal.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::_forward(double x[]) const {
+
+   const unsigned int n = _length;
+   unsigned int i, j, g, m;
+   double tr, ti;
+
+   // --- Bit reversal --- //
+
+   for(i=0; i<_nswaps; i++){
+      double *a = &(x[2*_swap[2*i]]);
+      double *b = &(x[2*_swap[2*i+1]]);
+      tr = a[0]; a[0] = b[0]; b[0] = tr;
+      ti = a[1]; a[1] = b[1]; b[1] = ti;
+   }
+
+   if (_radix != NULL) {
+      _mixed_radix_stages(x);
+      return;
+   }
+
+   // --- Radix-2 stage for odd powers of two --- //
+
+   m = 1;
+   for(i=0; (1U << i) < n; i++);
+   if (i & 1) {
+      for(g=0; g<2*n; g+=4){
+         tr = x[g+2];
+         ti = x[g+3];
+         x[g+2] = x[g]   - tr;
+         x[g+3] = x[g+1] - ti;
+         x[g]   += tr;
+         x[g+1] += ti;
+      }
+      m = 2;
+   }
+
+   // --- Radix-4 stages --- //
+
+   const double *w = _twiddle;
+   for(; 4*m<=n; m*=4){
+      for(g=0; g<n; g+=4*m){
+         double *p0 = &(x[2*g]);
+         double *p1 = p0 + 2*m;
+         double *p2 = p1 + 2*m;
+         double *p3 = p2 + 2*m;
+         for(j=0; j<m; j++){
+            const double *wj = &(w[6*j]);
+            const double ar = p0[2*j];
+            const double ai = p0[2*j+1];
+
+            // c1 = W^j * B1,  c2 = W^2j * B2,  c3 = W^3j * B3
+            const double br = p2[2*j], bi = p2[2*j+1];
+            const double c1r = wj[0]*br - wj[1]*bi;
+            const double c1i = wj[0]*bi + wj[1]*br;
+            const double er = p1[2*j], ei = p1[2*j+1];
+            const double c2r = wj[2]*er - wj[3]*ei;
+            const double c2i = wj[2]*ei + wj[3]*er;
+            const double fr = p3[2*j], fi = p3[2*j+1];
+            const double c3r = wj[4]*fr - wj[5]*fi;
+            const double c3i = wj[4]*fi + wj[5]*fr;
+
+            const double s0r = ar + c2r, s0i = ai + c2i;
+            const double d0r = ar - c2r, d0i = ai - c2i;
+            const double s1r = c1r + c3r, s1i = c1i + c3i;
+            const double d1r = c1r - c3r, d1i = c1i - c3i;
+
+            p0[2*j]   = s0r + s1r;
+            p0[2*j+1] = s0i + s1i;
+            p2[2*j]   = s0r - s1r;
+            p2[2*j+1] = s0i - s1i;
+            p1[2*j]   = d0r + d1i;      // d0 - i*d1
+            p1[2*j+1] = d0i - d1r;
+            p3[2*j]   = d0r - d1i;      // d0 + i*d1
+            p3[2*j+1] = d0i + d1r;
+         }
+      }
+      w += 6*m;
+   }
+}
+
+void MRI_FFT_Plan::_forward(float x[]) const {
+
+   const unsigned int n = _length;
+   unsigned int i, j, g, m;
+   float tr, ti;
+
+   // --- Bit reversal --- //
+
+   for(i=0; i<_nswaps; i++){
+      float *a = &(x[2*_swap[2*i]]);
+      float *b = &(x[2*_swap[2*i+1]]);
+      tr = a[0]; a[0] = b[0]; b[0] = tr;
+      ti = a[1]; a[1] = b[1]; b[1] = ti;
+   }
+
+   if (_radix != NULL) {
+      _mixed_radix_stages(x);
+      return;
+   }
+
+   // --- Radix-2 stage for odd powers of two --- //
+
+   m = 1;
+   for(i=0; (1U << i) < n; i++);
+   if (i & 1) {
+      for(g=0; g<2*n; g+=4){
+         tr = x[g+2];
+         ti = x[g+3];
+         x[g+2] = x[g]   - tr;
+         x[g+3] = x[g+1] - ti;
+         x[g]   += tr;
+         x[g+1] += ti;
+      }
+      m = 2;
+   }
+
+   // --- Radix-4 stages --- //
+
+   const float *w = _twiddle_f;
+   for(; 4*m<=n; m*=4){
+      for(g=0; g<n; g+=4*m){
+         float *p0 = &(x[2*g]);
+         float *p1 = p0 + 2*m;
+         float *p2 = p1 + 2*m;
+         float *p3 = p2 + 2*m;
+         for(j=0; j<m; j++){
+            const float *wj = &(w[6*j]);
+            const float ar = p0[2*j];
+            const float ai = p0[2*j+1];
+
+            // c1 = W^j * B1,  c2 = W^2j * B2,  c3 = W^3j * B3
+            const float br = p2[2*j], bi = p2[2*j+1];
+            const float c1r = wj[0]*br - wj[1]*bi;
+            const float c1i = wj[0]*bi + wj[1]*br;
+            const float er = p1[2*j], ei = p1[2*j+1];
+            const float c2r = wj[2]*er - wj[3]*ei;
+            const float c2i = wj[2]*ei + wj[3]*er;
+            const float fr = p3[2*j], fi = p3[2*j+1];
+            const float c3r = wj[4]*fr - wj[5]*fi;
+            const float c3i = wj[4]*fi + wj[5]*fr;
+
+            const float s0r = ar + c2r, s0i = ai + c2i;
+            const float d0r = ar - c2r, d0i = ai - c2i;
+            const float s1r = c1r + c3r, s1i = c1i + c3i;
+            const float d1r = c1r - c3r, d1i = c1i - c3i;
+
+            p0[2*j]   = s0r + s1r;
+            p0[2*j+1] = s0i + s1i;
+            p2[2*j]   = s0r - s1r;
+            p2[2*j+1] = s0i - s1i;
+            p1[2*j]   = d0r + d1i;      // d0 - i*d1
+            p1[2*j+1] = d0i - d1r;
+            p3[2*j]   = d0r - d1i;      // d0 + i*d1
+            p3[2*j+1] = d0i + d1r;
+         }
+      }
+      w += 6*m;
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::_mixed_radix_stages
+// Stages of a mixed radix transform, after the digit reversal.  Within
+// each group of f*m elements the f transforms of length m are in order.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::_mixed_radix_stages(double x[]) const {
+
+   const double *w = _twiddle;
+   unsigned int s, m;
+
+   for(s=0, m=1; s<_nstages; m*=_radix[s], s++){
+      switch (_radix[s]) {
+      case 2:  radix2_stage(x, _length, m, w); break;
+      case 3:  radix3_stage(x, _length, m, w); break;
+      case 4:  radix4_stage(x, _length, m, w); break;
+      default: radix5_stage(x, _length, m, w); break;
+      }
+      w += 2*(_radix[s]-1)*m;
+   }
+}
+
+void MRI_FFT_Plan::_mixed_radix_stages(float x[]) const {
+
+   const float *w = _twiddle_f;
+   unsigned int s, m;
+
+   for(s=0, m=1; s<_nstages; m*=_radix[s], s++){
+      switch (_radix[s]) {
+      case 2:  radix2_stage(x, _length, m, w); break;
+      case 3:  radix3_stage(x, _length, m, w); break;
+      case 4:  radix4_stage(x, _length, m, w); break;
+      default: radix5_stage(x, _length, m, w); break;
+      }
+      w += 2*(_radix[s]-1)*m;
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::forward
+// Forward transform of one vector in place.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::forward(double x[]) const {
+   _forward(x);
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::inverse
+// Unnormalized inverse transform of one vector in place, computed as
+// conj(forward(conj(x))).
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::inverse(double x[]) const {
+   unsigned int i;
+   for(i=1; i<2*_length; i+=2) x[i] = -x[i];
+   _forward(x);
+   for(i=1; i<2*_length; i+=2) x[i] = -x[i];
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::transform
+// Transform of one vector in place in the given direction.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::transform(double x[], Direction direction) const {
+   if (direction == FORWARD) {
+      forward(x);
+   } else {
+      inverse(x);
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::forward, inverse and transform of float data
+// The same transforms of one vector, computed in single precision.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::forward(float x[]) const {
+   _forward(x);
+}
+
+void MRI_FFT_Plan::inverse(float x[]) const {
+   unsigned int i;
+   for(i=1; i<2*_length; i+=2) x[i] = -x[i];
+   _forward(x);
+   for(i=1; i<2*_length; i+=2) x[i] = -x[i];
+}
+
+void MRI_FFT_Plan::transform(float x[], Direction direction) const {
+   if (direction == FORWARD) {
+      forward(x);
+   } else {
+      inverse(x);
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::transform_rows
+// Transforms nvec contiguous vectors, dist complex elements apart.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::transform_rows(double x[], unsigned int nvec,
+                                  unsigned int dist,
+                                  Direction direction) const {
+   unsigned int v;
+   for(v=0; v<nvec; v++){
+      transform(&(x[2*v*dist]), direction);
+   }
+}
+
+void MRI_FFT_Plan::transform_rows(float x[], unsigned int nvec,
+                                  unsigned int dist, Direction direction,
+                                  double work[]) const {
+   unsigned int v, i;
+
+   if (_precision == SINGLE_PRECISION) {
+      for(v=0; v<nvec; v++){
+         transform(&(x[2*v*dist]), direction);
+      }
+      return;
+   }
+
+   for(v=0; v<nvec; v++){
+      float *row = &(x[2*v*dist]);
+      for(i=0; i<2*_length; i++) work[i] = row[i];
+      transform(work, direction);
+      for(i=0; i<2*_length; i++) row[i] = (float)work[i];
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::transform_columns
+// Transforms nvec consecutive vectors whose elements are stride complex
+// elements apart, such as the columns of a matrix.  The columns are
+// gathered FFT_COLUMN_BLOCK at a time into contiguous rows of the work
+// space, so each pass over the matrix reads whole cache lines.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::transform_columns(double x[], unsigned int nvec,
+                                     unsigned int stride,
+                                     Direction direction,
+                                     double work[]) const {
+   unsigned int v0, nb, b, k;
+
+   for(v0=0; v0<nvec; v0+=FFT_COLUMN_BLOCK){
+      nb = (nvec-v0 < FFT_COLUMN_BLOCK) ? nvec-v0 : FFT_COLUMN_BLOCK;
+
+      for(k=0; k<_length; k++){
+         const double *src = &(x[2*(k*stride+v0)]);
+         for(b=0; b<nb; b++){
+            work[2*(b*_length+k)]   = src[2*b];
+            work[2*(b*_length+k)+1] = src[2*b+1];
+         }
+      }
+      for(b=0; b<nb; b++){
+         transform(&(work[2*b*_length]), direction);
+      }
+      for(k=0; k<_length; k++){
+         double *dst = &(x[2*(k*stride+v0)]);
+         for(b=0; b<nb; b++){
+            dst[2*b]   = work[2*(b*_length+k)];
+            dst[2*b+1] = work[2*(b*_length+k)+1];
+         }
+      }
+   }
+}
+
+void MRI_FFT_Plan::transform_columns(float x[], unsigned int nvec,
+                                     unsigned int stride,
+                                     Direction direction,
+                                     double work[]) const {
+   unsigned int v0, nb, b, k;
+
+   if (_precision == SINGLE_PRECISION) {
+      _transform_columns(x, nvec, stride, direction, (float *)work);
+      return;
+   }
+
+   for(v0=0; v0<nvec; v0+=FFT_COLUMN_BLOCK){
+      nb = (nvec-v0 < FFT_COLUMN_BLOCK) ? nvec-v0 : FFT_COLUMN_BLOCK;
+
+      for(k=0; k<_length; k++){
+         const float *src = &(x[2*(k*stride+v0)]);
+         for(b=0; b<nb; b++){
+            work[2*(b*_length+k)]   = src[2*b];
+            work[2*(b*_length+k)+1] = src[2*b+1];
+         }
+      }
+      for(b=0; b<nb; b++){
+         transform(&(work[2*b*_length]), direction);
+      }
+      for(k=0; k<_length; k++){
+         float *dst = &(x[2*(k*stride+v0)]);
+         for(b=0; b<nb; b++){
+            dst[2*b]   = (float)work[2*(b*_length+k)];
+            dst[2*b+1] = (float)work[2*(b*_length+k)+1];
+         }
+      }
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::_transform_columns
+// transform_columns in single precision, gathering the columns into a
+// float work space.
+//---------------------------------------------------------------------------
+
+void MRI_FFT_Plan::_transform_columns(float x[], unsigned int nvec,
+                                      unsigned int stride,
+                                      Direction direction,
+                                      float work[]) const {
+   unsigned int v0, nb, b, k;
+
+   for(v0=0; v0<nvec; v0+=FFT_COLUMN_BLOCK){
+      nb = (nvec-v0 < FFT_COLUMN_BLOCK) ? nvec-v0 : FFT_COLUMN_BLOCK;
+
+      for(k=0; k<_length; k++){
+         const float *src = &(x[2*(k*stride+v0)]);
+         for(b=0; b<nb; b++){
+            work[2*(b*_length+k)]   = src[2*b];
+            work[2*(b*_length+k)+1] = src[2*b+1];
+         }
+      }
+      for(b=0; b<nb; b++){
+         transform(&(work[2*b*_length]), direction);
+      }
+      for(k=0; k<_length; k++){
+         float *dst = &(x[2*(k*stride+v0)]);
+         for(b=0; b<nb; b++){
+            dst[2*b]   = work[2*(b*_length+k)];
+            dst[2*b+1] = work[2*(b*_length+k)+1];
+         }
+      }
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_Real_FFT_Plan constructor
+//---------------------------------------------------------------------------
+
+MRI_Real_FFT_Plan::MRI_Real_FFT_Plan(unsigned int length)
+   : _length(length) {
+
+   if (length < 2 || (length & 1)) {
+      cerr << "MRI_Real_FFT_Plan: length " << length
+           << " is not even." << endl;
+      exit(EXIT_FAILURE);
+   }
+
+   const unsigned int half = length/2;
+   _half    = MRI_FFT_Plan::get(half);
+   _twiddle = new double[2*half];
+
+   unsigned int k;
+   for(k=0; k<half; k++){
+      const double angle = 2.0*M_PI*(double)k/(double)length;
+      _twiddle[2*k]   =  cos(angle);
+      _twiddle[2*k+1] = -sin(angle);
+   }
+
+   _next = NULL;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Real_FFT_Plan destructor
+// The half length plan is shared and is not deleted.
+//---------------------------------------------------------------------------
+
+MRI_Real_FFT_Plan::~MRI_Real_FFT_Plan() {
+   delete[] _twiddle;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Real_FFT_Plan::get
+// Returns the shared plan for a length, making it on first use.
+//---------------------------------------------------------------------------
+
+const MRI_Real_FFT_Plan *MRI_Real_FFT_Plan::get(unsigned int length) {
+
+   MRI_Lock lock(_plans_mutex);
+
+   MRI_Real_FFT_Plan *plan;
+   for(plan=_plans; plan!=NULL; plan=plan->_next){
+      if (plan->_length == length) return plan;
+   }
+
+   plan = new MRI_Real_FFT_Plan(length);
+   plan->_next = _plans;
+   _plans      = plan;
+   return plan;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Real_FFT_Plan::forward
+// With z[j] = in[2j] + i*in[2j+1] and Z its transform of length h = n/2,
+// the even and odd sample transforms are E = (Z[k] + conj(Z[h-k]))/2 and
+// O = -i*(Z[k] - conj(Z[h-k]))/2, and X[k] = E + W^k*O.
+//---------------------------------------------------------------------------
+
+void MRI_Real_FFT_Plan::forward(const double in[], double out[]) const {
+
+   const unsigned int h = _length/2;
+   unsigned int i, k;
+
+   for(i=0; i<_length; i++) out[i] = in[i];
+   _half->forward(out);
+
+   // --- Zero and Nyquist frequencies --- //
+
+   const double z0r = out[0];
+   const double z0i = out[1];
+   out[0]     = z0r + z0i;
+   out[1]     = 0.0;
+   out[2*h]   = z0r - z0i;
+   out[2*h+1] = 0.0;
+
+   // --- Pairs k and h-k --- //
+
+   for(k=1; 2*k<=h; k++){
+      const unsigned int l = h-k;
+      const double ar = out[2*k], ai = out[2*k+1];
+      const double br = out[2*l], bi = out[2*l+1];
+
+      // X[k]
+      double er = 0.5*(ar + br),  ei = 0.5*(ai - bi);
+      double or_ = 0.5*(ai + bi), oi = -0.5*(ar - br);
+      const double *w = &(_twiddle[2*k]);
+      out[2*k]   = er + (w[0]*or_ - w[1]*oi);
+      out[2*k+1] = ei + (w[0]*oi  + w[1]*or_);
+
+      // X[h-k]
+      if (l != k) {
+         er  = 0.5*(br + ar);  ei = 0.5*(bi - ai);
+         or_ = 0.5*(bi + ai);  oi = -0.5*(br - ar);
+         w = &(_twiddle[2*l]);
+         out[2*l]   = er + (w[0]*or_ - w[1]*oi);
+         out[2*l+1] = ei + (w[0]*oi  + w[1]*or_);
+      }
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_Real_FFT_Plan::inverse
+// Rebuilds Z[k] = (X[k] + conj(X[h-k])) + i*W^-k*(X[k] - conj(X[h-k])),
+// twice the packed transform, so the inverse of length h gives n times
+// the real samples, as an unnormalized inverse of length n would.
+//---------------------------------------------------------------------------
+
+void MRI_Real_FFT_Plan::inverse(const double in[], double out[]) const {
+
+   const unsigned int h = _length/2;
+   unsigned int k;
+
+   for(k=0; k<h; k++){
+      const unsigned int l = h-k;
+      const double ar = in[2*k], ai = in[2*k+1];
+      const double br = in[2*l], bi = -in[2*l+1];
+
+      const double er = ar + br, ei = ai + bi;
+      const double dr = ar - br, di = ai - bi;
+
+      // W^-k * d
+      const double wr = _twiddle[2*k], wi = -_twiddle[2*k+1];
+      const double tr = wr*dr - wi*di;
+      const double ti = wr*di + wi*dr;
+
+      out[2*k]   = er - ti;     // e + i*t
+      out[2*k+1] = ei + tr;
+   }
+   _half->inverse(out);
+}
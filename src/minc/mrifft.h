@@ -0,0 +1,221 @@
+#ifndef __MRIFFT_H
+#define __MRIFFT_H
+
+//===========================================================================
+// MRIFFT.H
+// Fast Fourier transforms with precomputed plans.
+// Inherits from:
+// Base class to:
+//===========================================================================
+
+#include "mrithread.h"
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+// Columns gathered together by transform_columns
+#define FFT_COLUMN_BLOCK 8
+
+// Relative time per element of each kind of stage, and the extra time
+// per element of the digit reversal of mixed radix lengths, used to
+// choose transform lengths
+#define FFT_COST_RADIX2 1.0
+#define FFT_COST_RADIX4 2.1
+#define FFT_COST_RADIX3 2.1
+#define FFT_COST_RADIX5 2.5
+#define FFT_COST_MIXED  1.7
+
+// Relative time of a complex multiply of one element outside the FFT,
+// in the same units
+#define FFT_COST_POINTWISE 1.0
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan class
+// Complex FFT of one length of the form 2^a * 3^b * 5^c.  The input
+// permutation and the twiddle factors of every stage are computed once,
+// when the plan is made.  Powers of two use a radix-4 decimation in time
+// (with one radix-2 stage for odd powers of two); other lengths use
+// radix 4, 2, 3 and 5 stages.  Data are interleaved
+// {real0, imag0, real1, imag1, ...} arrays indexed from 0.
+//
+// The forward transform uses exp(-2*pi*i*j*k/n) and the inverse
+// exp(+2*pi*i*j*k/n), both unnormalized, matching four1 with isign -1
+// and +1.  A plan is never changed after it is made, so one plan may be
+// used by several threads at once, each with its own work space.
+//
+// Every plan also keeps its twiddles in single precision.  The float
+// transforms of float data compute in float; the batch transforms of
+// float data with a double work space compute in double unless the
+// process-wide precision has been set to SINGLE_PRECISION, which halves
+// the memory traffic and doubles the SIMD width at about 1e-7 relative
+// error.  The precision should be set once, before any thread starts.
+//---------------------------------------------------------------------------
+
+class MRI_FFT_Plan {
+   public:
+      enum Direction {FORWARD = -1, INVERSE = 1};
+      enum Precision {DOUBLE_PRECISION = 0, SINGLE_PRECISION = 1};
+
+      MRI_FFT_Plan(unsigned int length);
+      ~MRI_FFT_Plan();
+
+      // Shared plan for a length, made on first use.  Never deleted.
+      static const MRI_FFT_Plan *get(unsigned int length);
+
+      // Precision of the batch transforms of float data
+      static void set_precision(Precision precision);
+      static inline Precision get_precision(void);
+
+      // --- Transform lengths --- //
+      // get_fast_length: the valid length >= min_length with the lowest
+      // estimated cost, never above the next power of two (always the
+      // next power of two when MRISIM_FFT=pow2)
+      static int is_valid_length(unsigned int length);
+      static double get_cost(unsigned int length);
+      static unsigned int get_fast_length(unsigned int min_length);
+
+      inline unsigned int get_length(void) const;
+      inline unsigned int get_workspace_length(void) const;
+
+      // --- One vector, in place --- //
+      void forward(double x[]) const;
+      void inverse(double x[]) const;
+      void transform(double x[], Direction direction) const;
+      void forward(float x[]) const;
+      void inverse(float x[]) const;
+      void transform(float x[], Direction direction) const;
+
+      // --- Batches of vectors, in place --- //
+      // rows:    nvec vectors of contiguous elements, dist complex
+      //          elements apart
+      // columns: nvec consecutive vectors whose elements are stride
+      //          complex elements apart
+      // The float versions compute in the precision set by
+      // set_precision.  The work space must hold get_workspace_length()
+      // doubles.
+      void transform_rows(double x[], unsigned int nvec, unsigned int dist,
+                          Direction direction) const;
+      void transform_rows(float x[], unsigned int nvec, unsigned int dist,
+                          Direction direction, double work[]) const;
+      void transform_columns(double x[], unsigned int nvec,
+                             unsigned int stride, Direction direction,
+                             double work[]) const;
+      void transform_columns(float x[], unsigned int nvec,
+                             unsigned int stride, Direction direction,
+                             double work[]) const;
+
+   private:
+      unsigned int  _length;
+      unsigned int  _nswaps;          // input permutation swaps
+      unsigned int *_swap;            // {i0, j0, i1, j1, ...}, in order
+      double       *_twiddle;         // twiddles of each stage
+      float        *_twiddle_f;       // the same, in single precision
+      unsigned int  _nstages;         // mixed radix stages
+      unsigned int *_radix;           // radix of each, NULL for 2^a
+
+      MRI_FFT_Plan *_next;            // next shared plan
+
+      static MRI_FFT_Plan *_plans;    // shared plans
+      static MRI_Mutex     _plans_mutex;
+      static Precision     _precision;
+
+      void _single_precision_tables(void);
+      void _forward(double x[]) const;
+      void _forward(float x[]) const;
+      void _mixed_radix_tables(void);
+      void _mixed_radix_stages(double x[]) const;
+      void _mixed_radix_stages(float x[]) const;
+      void _transform_columns(float x[], unsigned int nvec,
+                              unsigned int stride, Direction direction,
+                              float work[]) const;
+
+      MRI_FFT_Plan(const MRI_FFT_Plan&);
+      MRI_FFT_Plan& operator=(const MRI_FFT_Plan&);
+};
+
+//---------------------------------------------------------------------------
+// MRI_Real_FFT_Plan class
+// FFT of real data of even length n, by a complex FFT of length n/2 of
+// the even and odd samples packed as real and imaginary parts.  The
+// forward transform gives the n/2+1 non-negative frequencies; the others
+// are their complex conjugates.  The inverse takes the n/2+1 frequencies
+// and gives n real samples, unnormalized.
+//---------------------------------------------------------------------------
+
+class MRI_Real_FFT_Plan {
+   public:
+      MRI_Real_FFT_Plan(unsigned int length);
+      ~MRI_Real_FFT_Plan();
+
+      static const MRI_Real_FFT_Plan *get(unsigned int length);
+
+      inline unsigned int get_length(void) const;
+
+      // forward: n reals in, 2*(n/2+1) doubles out
+      // inverse: 2*(n/2+1) doubles in, n reals out
+      // The input and output must not overlap.
+      void forward(const double in[], double out[]) const;
+      void inverse(const double in[], double out[]) const;
+
+   private:
+      unsigned int        _length;
+      const MRI_FFT_Plan *_half;      // complex plan of length n/2
+      double             *_twiddle;   // exp(-2*pi*i*k/n), k < n/2
+
+      MRI_Real_FFT_Plan *_next;
+
+      static MRI_Real_FFT_Plan *_plans;
+      static MRI_Mutex          _plans_mutex;
+
+      MRI_Real_FFT_Plan(const MRI_Real_FFT_Plan&);
+      MRI_Real_FFT_Plan& operator=(const MRI_Real_FFT_Plan&);
+};
+
+//---------------------------------------------------------------------------
+// Inline member functions
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::get_length
+// Returns the transform length.
+//---------------------------------------------------------------------------
+
+inline
+unsigned int MRI_FFT_Plan::get_length(void) const {
+   return _length;
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::get_precision
+// Returns the precision of the batch transforms of float data.
+//---------------------------------------------------------------------------
+
+inline
+MRI_FFT_Plan::Precision MRI_FFT_Plan::get_precision(void) {
+   return _precision;
+}
+
+//---------------------------------------------------------------------------
+// MRI_FFT_Plan::get_workspace_length
+// Returns the number of doubles of work space needed by the float and
+// column transforms.
+//---------------------------------------------------------------------------
+
+inline
+unsigned int MRI_FFT_Plan::get_workspace_length(void) const {
+   return 2*_length*FFT_COLUMN_BLOCK;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Real_FFT_Plan::get_length
+// Returns the number of real samples transformed.
+//---------------------------------------------------------------------------
+
+inline
+unsigned int MRI_Real_FFT_Plan::get_length(void) const {
+   return _length;
+}
+
+#endif
@@ -31,6 +31,58 @@
 //===========================================================================
 
 #include "mrimatrix.h"
+#include "mriprofile.h"
+#include "mrisimd.h"
+
+//===========================================================================
+// FFT helpers
+//===========================================================================
+
+//---------------------------------------------------------------------------
+// real_row_spectrum
+// Transforms the n real samples at the start of work with a real FFT
+// plan and writes the full spectrum of the row, filling the negative
+// frequencies by conjugate symmetry.  The spectrum is conjugated for an
+// inverse transform.  The work space holds 2n+2 doubles.
+//---------------------------------------------------------------------------
+
+static void real_row_spectrum(const MRI_Real_FFT_Plan *plan, double work[],
+                              MRI_FFT_Plan::Direction direction,
+                              float out[]) {
+   const unsigned int n    = plan->get_length();
+   const double       sign = (direction == MRI_FFT_Plan::FORWARD) ? 1.0 : -1.0;
+   const double      *spec = &(work[n]);
+   unsigned int k;
+
+   plan->forward(work, &(work[n]));
+   for(k=0; k<=n/2; k++){
+      out[2*k]   = spec[2*k];
+      out[2*k+1] = sign*spec[2*k+1];
+   }
+   for(k=n/2+1; k<n; k++){
+      out[2*k]   =  spec[2*(n-k)];
+      out[2*k+1] = -sign*spec[2*(n-k)+1];
+   }
+}
+
+static void real_row_spectrum(const MRI_Real_FFT_Plan *plan, double work[],
+                              MRI_FFT_Plan::Direction direction,
+                              double out[]) {
+   const unsigned int n    = plan->get_length();
+   const double       sign = (direction == MRI_FFT_Plan::FORWARD) ? 1.0 : -1.0;
+   const double      *spec = &(work[n]);
+   unsigned int k;
+
+   plan->forward(work, &(work[n]));
+   for(k=0; k<=n/2; k++){
+      out[2*k]   = spec[2*k];
+      out[2*k+1] = sign*spec[2*k+1];
+   }
+   for(k=n/2+1; k<n; k++){
+      out[2*k]   =  spec[2*(n-k)];
+      out[2*k+1] = -sign*spec[2*(n-k)+1];
+   }
+}
 
 //===========================================================================
 // MRI_Matrix
@@ -1150,12 +1202,7 @@ MRI_Float_Matrix& MRI_Float_Matrix::operator=(const MRI_Float_Matrix& mat){
 //---------------------------------------------------------------------------
 
 MRI_Float_Matrix& MRI_Float_Matrix::operator*=(double a){
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
-   for(n=0; n<len; n++){
-      _matrix[n] *= a;
-   }
+   MRI_SIMD::scale(_matrix, a, this->get_nelements());
    return *this;
 }
 
@@ -1164,17 +1211,12 @@ MRI_Float_Matrix& MRI_Float_Matrix::operator*=(double a){
 // Multiplies a matrix element-by-element by another matrix
 //---------------------------------------------------------------------------
 
-MRI_Float_Matrix& MRI_Float_Matrix::operator*=(const MRI_Float_Matrix& x) { 
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
+MRI_Float_Matrix& MRI_Float_Matrix::operator*=(const MRI_Float_Matrix& x) {
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
-  
-   for(n=0; n<len; n++){
-      _matrix[n] *= x._matrix[n];
-   } 
+
+   MRI_SIMD::mul(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -1184,16 +1226,11 @@ MRI_Float_Matrix& MRI_Float_Matrix::operator*=(const MRI_Float_Matrix& x) {
 //---------------------------------------------------------------------------
 
 MRI_Float_Matrix& MRI_Float_Matrix::operator/=(const MRI_Float_Matrix& x) {
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
 
-   for(n=0; n<len; n++){
-      _matrix[n] /= x._matrix[n];
-   }
+   MRI_SIMD::div(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -1203,16 +1240,11 @@ MRI_Float_Matrix& MRI_Float_Matrix::operator/=(const MRI_Float_Matrix& x) {
 //---------------------------------------------------------------------------
 
 MRI_Float_Matrix& MRI_Float_Matrix::operator+=(const MRI_Float_Matrix& x){
-   unsigned int n;
-   unsigned int len = this->get_nelements();
- 
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
- 
-   for(n=0; n<len; n++){
-      _matrix[n] += x._matrix[n];
-   } 
+
+   MRI_SIMD::add(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -1223,7 +1255,6 @@ MRI_Float_Matrix& MRI_Float_Matrix::operator+=(const MRI_Float_Matrix& x){
 
 MRI_Float_Matrix& MRI_Float_Matrix::saxpy(double a, const MRI_Float_Matrix& x,
                                       const MRI_Float_Matrix& y){
-   unsigned int n;
    unsigned int len = this->get_nelements();
 
 #ifdef DEBUG
@@ -1232,9 +1263,7 @@ MRI_Float_Matrix& MRI_Float_Matrix::saxpy(double a, const MRI_Float_Matrix& x,
    assert(len == y.get_nelements());
 #endif
 
-   for(n=0; n<len; n++){
-      _matrix[n] = a * x._matrix[n] + y._matrix[n];
-   }
+   MRI_SIMD::saxpy(_matrix, a, x._matrix, y._matrix, len);
    return *this;   
 }
 
@@ -1472,8 +1501,26 @@ double MRI_Float_Matrix::std(void) const{
 //---------------------------------------------------------------------------
 
 MRI_FComplex_Matrix MRI_Float_Matrix::FFT(void) const {
-   MRI_FComplex_Matrix mat(*this);
-   mat.FFT();
+
+   if (_ncols < 2) {
+      MRI_FComplex_Matrix mat(*this);
+      mat.FFT();
+      return mat;
+   }
+
+   // Real input: one real FFT of half the work per row
+   MRI_FComplex_Matrix mat(_nrows, _ncols);
+   const MRI_Real_FFT_Plan *plan = MRI_Real_FFT_Plan::get(_ncols);
+   double *work = new double[2*_ncols+2];
+   unsigned int irow, n;
+
+   for(irow=0; irow<_nrows; irow++){
+      const float *row = &(_matrix[irow*_ncols]);
+      for(n=0; n<_ncols; n++) work[n] = row[n];
+      real_row_spectrum(plan, work, MRI_FFT_Plan::FORWARD, mat.row_ptr(irow));
+   }
+   delete[] work;
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, _nrows);
    return mat;
 }
 
@@ -1483,8 +1530,27 @@ MRI_FComplex_Matrix MRI_Float_Matrix::FFT(void) const {
 //---------------------------------------------------------------------------
 
 MRI_FComplex_Matrix MRI_Float_Matrix::iFFT(void) const {
-   MRI_FComplex_Matrix mat(*this);
-   mat.iFFT();
+
+   if (_ncols < 2) {
+      MRI_FComplex_Matrix mat(*this);
+      mat.iFFT();
+      return mat;
+   }
+
+   // Real input: one real FFT of half the work per row
+   MRI_FComplex_Matrix mat(_nrows, _ncols);
+   const MRI_Real_FFT_Plan *plan = MRI_Real_FFT_Plan::get(_ncols);
+   double *work = new double[2*_ncols+2];
+   unsigned int irow, n;
+
+   for(irow=0; irow<_nrows; irow++){
+      const float *row = &(_matrix[irow*_ncols]);
+      for(n=0; n<_ncols; n++) work[n] = row[n];
+      real_row_spectrum(plan, work, MRI_FFT_Plan::INVERSE, mat.row_ptr(irow));
+   }
+   delete[] work;
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, _nrows);
+   mat *= (1.0/(float)_ncols);
    return mat;
 }
 
@@ -1696,12 +1762,7 @@ MRI_Double_Matrix& MRI_Double_Matrix::operator=(const MRI_Double_Matrix& mat){
 //---------------------------------------------------------------------------
 
 MRI_Double_Matrix& MRI_Double_Matrix::operator*=(double a){
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
-   for(n=0; n<len; n++){
-      _matrix[n] *= a;
-   }
+   MRI_SIMD::scale(_matrix, a, this->get_nelements());
    return *this;
 }
 
@@ -1710,17 +1771,12 @@ MRI_Double_Matrix& MRI_Double_Matrix::operator*=(double a){
 // Multiplies a matrix element-by-element by another matrix
 //---------------------------------------------------------------------------
 
-MRI_Double_Matrix& MRI_Double_Matrix::operator*=(const MRI_Double_Matrix& x) { 
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
+MRI_Double_Matrix& MRI_Double_Matrix::operator*=(const MRI_Double_Matrix& x) {
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
-  
-   for(n=0; n<len; n++){
-      _matrix[n] *= x._matrix[n];
-   } 
+
+   MRI_SIMD::mul(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -1730,16 +1786,11 @@ MRI_Double_Matrix& MRI_Double_Matrix::operator*=(const MRI_Double_Matrix& x) {
 //---------------------------------------------------------------------------
 
 MRI_Double_Matrix& MRI_Double_Matrix::operator/=(const MRI_Double_Matrix& x) {
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
- 
-   for(n=0; n<len; n++){
-      _matrix[n] /= x._matrix[n];
-   }
+
+   MRI_SIMD::div(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -1749,16 +1800,11 @@ MRI_Double_Matrix& MRI_Double_Matrix::operator/=(const MRI_Double_Matrix& x) {
 //---------------------------------------------------------------------------
 
 MRI_Double_Matrix& MRI_Double_Matrix::operator+=(const MRI_Double_Matrix& x){
-   unsigned int n;
-   unsigned int len = this->get_nelements();
- 
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
- 
-   for(n=0; n<len; n++){
-      _matrix[n] = _matrix[n] + x._matrix[n];
-   } 
+
+   MRI_SIMD::add(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -1769,7 +1815,6 @@ MRI_Double_Matrix& MRI_Double_Matrix::operator+=(const MRI_Double_Matrix& x){
 
 MRI_Double_Matrix& MRI_Double_Matrix::saxpy(double a, const MRI_Double_Matrix& x,
                                         const MRI_Double_Matrix& y){
-   unsigned int n;
    unsigned int len = this->get_nelements();
 
 #ifdef DEBUG
@@ -1778,9 +1823,7 @@ MRI_Double_Matrix& MRI_Double_Matrix::saxpy(double a, const MRI_Double_Matrix& x
    assert(len == y.get_nelements());
 #endif
 
-   for(n=0; n<len; n++){
-      _matrix[n] = a * x._matrix[n] + y._matrix[n];
-   }
+   MRI_SIMD::saxpy(_matrix, a, x._matrix, y._matrix, len);
    return *this;   
 }
 
@@ -2018,8 +2061,26 @@ double MRI_Double_Matrix::std(void) const{
 //---------------------------------------------------------------------------
 
 MRI_Complex_Matrix MRI_Double_Matrix::FFT(void) const {
-   MRI_Complex_Matrix mat(*this);
-   mat.FFT();
+
+   if (_ncols < 2) {
+      MRI_Complex_Matrix mat(*this);
+      mat.FFT();
+      return mat;
+   }
+
+   // Real input: one real FFT of half the work per row
+   MRI_Complex_Matrix mat(_nrows, _ncols);
+   const MRI_Real_FFT_Plan *plan = MRI_Real_FFT_Plan::get(_ncols);
+   double *work = new double[2*_ncols+2];
+   unsigned int irow, n;
+
+   for(irow=0; irow<_nrows; irow++){
+      const double *row = &(_matrix[irow*_ncols]);
+      for(n=0; n<_ncols; n++) work[n] = row[n];
+      real_row_spectrum(plan, work, MRI_FFT_Plan::FORWARD, mat.row_ptr(irow));
+   }
+   delete[] work;
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, _nrows);
    return mat;
 }
 
@@ -2029,8 +2090,27 @@ MRI_Complex_Matrix MRI_Double_Matrix::FFT(void) const {
 //---------------------------------------------------------------------------
 
 MRI_Complex_Matrix MRI_Double_Matrix::iFFT(void) const {
-   MRI_Complex_Matrix mat(*this);
-   mat.iFFT();
+
+   if (_ncols < 2) {
+      MRI_Complex_Matrix mat(*this);
+      mat.iFFT();
+      return mat;
+   }
+
+   // Real input: one real FFT of half the work per row
+   MRI_Complex_Matrix mat(_nrows, _ncols);
+   const MRI_Real_FFT_Plan *plan = MRI_Real_FFT_Plan::get(_ncols);
+   double *work = new double[2*_ncols+2];
+   unsigned int irow, n;
+
+   for(irow=0; irow<_nrows; irow++){
+      const double *row = &(_matrix[irow*_ncols]);
+      for(n=0; n<_ncols; n++) work[n] = row[n];
+      real_row_spectrum(plan, work, MRI_FFT_Plan::INVERSE, mat.row_ptr(irow));
+   }
+   delete[] work;
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, _nrows);
+   mat *= (1.0/(double)_ncols);
    return mat;
 }
 
@@ -2464,12 +2544,7 @@ MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator=(const MRI_FComplex_Matrix& m
 //---------------------------------------------------------------------------
 
 MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator*=(double a){
-   unsigned int n;
-   unsigned int len = 2*this->get_nelements();
-  
-   for(n=0; n<len; n++){
-      _matrix[n] *= a;
-   }
+   MRI_SIMD::scale(_matrix, a, 2*this->get_nelements());
    return *this;
 }
 
@@ -2478,36 +2553,21 @@ MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator*=(double a){
 // Multiplies a matrix element-by-element by another matrix
 //---------------------------------------------------------------------------
 
-MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator*=(const MRI_FComplex_Matrix& x) { 
-   unsigned int n;
-   unsigned int len = 2*this->get_nelements();
-   double   re, im;
-
+MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator*=(const MRI_FComplex_Matrix& x) {
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
-  
-   for(n=0; n<len; n+=2){
-      re = _matrix[n]*x._matrix[n]   - _matrix[n+1]*x._matrix[n+1];
-      im = _matrix[n]*x._matrix[n+1] + _matrix[n+1]*x._matrix[n];
-      _matrix[n]   = (float)re;
-      _matrix[n+1] = (float)im;
-   } 
+
+   MRI_SIMD::complex_mul(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
 MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator*=(const MRI_Float_Matrix& x) {
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
 
-   for(n=0; n<len; n++){
-      _matrix[2*n]   *= x._matrix[n];
-      _matrix[2*n+1] *= x._matrix[n];
-   }
+   MRI_SIMD::real_mul(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -2518,17 +2578,11 @@ MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator*=(const MRI_Float_Matrix& x)
 
 MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator/=(const MRI_Float_Matrix& x)
 {
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
 
-   for(n=0; n<len; n++){
-      _matrix[2*n]   /= x._matrix[n];
-      _matrix[2*n+1] /= x._matrix[n];
-   }
+   MRI_SIMD::real_div(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -2538,16 +2592,11 @@ MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator/=(const MRI_Float_Matrix& x)
 //---------------------------------------------------------------------------
 
 MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator+=(const MRI_FComplex_Matrix& x){
-   unsigned int n;
-   unsigned int len = 2*this->get_nelements();
- 
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
- 
-   for(n=0; n<len; n++){
-      _matrix[n] = _matrix[n] + x._matrix[n];
-   } 
+
+   MRI_SIMD::add(_matrix, x._matrix, 2*this->get_nelements());
    return *this;
 }
 
@@ -2559,22 +2608,13 @@ MRI_FComplex_Matrix& MRI_FComplex_Matrix::operator+=(const MRI_FComplex_Matrix&
 MRI_FComplex_Matrix& MRI_FComplex_Matrix::saxpy(double areal, double aimag, 
                                           const MRI_FComplex_Matrix& x,
                                           const MRI_FComplex_Matrix& y){
-   unsigned int n;
-   unsigned int len = 2*this->get_nelements();
-   double   re, im;
-
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
    assert(this->is_same_size_as(y));
 #endif
 
-   // Use temporary re, im in case x or y point to this.
-   for(n=0; n<len; n+=2){
-      re = areal*x._matrix[n]   - aimag*x._matrix[n+1] + y._matrix[n];
-      im = areal*x._matrix[n+1] + aimag*x._matrix[n]   + y._matrix[n+1];
-      _matrix[n] = (float)re;
-      _matrix[n] = (float)im;
-   }
+   MRI_SIMD::complex_saxpy(_matrix, areal, aimag, x._matrix, y._matrix,
+                           this->get_nelements());
    return *this;   
 }
 
@@ -2618,13 +2658,11 @@ void MRI_FComplex_Matrix::FFT(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned int  irow;
-   float        *row;
-
-   for(irow=0; irow<_nrows; irow++){
-      row = &(_matrix[irow*_ncols]);
-      four1f(row-1, _ncols, -1);
-   }
+   const MRI_FFT_Plan *plan = MRI_FFT_Plan::get(_ncols);
+   double *work = new double[plan->get_workspace_length()];
+   plan->transform_rows(_matrix, _nrows, _ncols, MRI_FFT_Plan::FORWARD, work);
+   delete[] work;
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, _nrows);
 }
 
 //---------------------------------------------------------------------------
@@ -2638,13 +2676,11 @@ void MRI_FComplex_Matrix::iFFT(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned int  irow;
-   float        *row;
-
-   for(irow=0; irow<_nrows; irow++){
-      row = &(_matrix[irow*_ncols]);
-      four1f(row-1, _ncols, 1);
-   }
+   const MRI_FFT_Plan *plan = MRI_FFT_Plan::get(_ncols);
+   double *work = new double[plan->get_workspace_length()];
+   plan->transform_rows(_matrix, _nrows, _ncols, MRI_FFT_Plan::INVERSE, work);
+   delete[] work;
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, _nrows);
    *this *= (1.0/(float)get_ncols());
 }
 
@@ -2659,10 +2695,8 @@ void MRI_FComplex_Matrix::FFT2(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned long sizes[2];
-   sizes[0] = _nrows;
-   sizes[1] = _ncols;
-   fournf(_matrix-1, sizes-1, 2, -1);
+   _transform2(MRI_FFT_Plan::FORWARD);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS);
 }
 
 //---------------------------------------------------------------------------
@@ -2676,13 +2710,30 @@ void MRI_FComplex_Matrix::iFFT2(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned long sizes[2];
-   sizes[0] = _nrows;
-   sizes[1] = _ncols;
-   fournf(_matrix-1, sizes-1, 2, 1);
+   _transform2(MRI_FFT_Plan::INVERSE);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS);
    *this *= (1.0/(float)get_nelements());
 }
 
+//---------------------------------------------------------------------------
+// MRI_FComplex_Matrix::_transform2
+// 2D-FFT in place: the rows, then the columns in cache-sized blocks.
+//---------------------------------------------------------------------------
+
+void MRI_FComplex_Matrix::_transform2(MRI_FFT_Plan::Direction direction){
+   const MRI_FFT_Plan *row_plan = MRI_FFT_Plan::get(_ncols);
+   const MRI_FFT_Plan *col_plan = MRI_FFT_Plan::get(_nrows);
+   double *work = new double[(row_plan->get_workspace_length() >
+                              col_plan->get_workspace_length()) ?
+                              row_plan->get_workspace_length() :
+                              col_plan->get_workspace_length()];
+
+   row_plan->transform_rows(_matrix, _nrows, _ncols, direction, work);
+   col_plan->transform_columns(_matrix, _ncols, _ncols, direction, work);
+
+   delete[] work;
+}
+
 //---------------------------------------------------------------------------
 // MRI_FComplex_Matrix::fftshift
 // Swaps first and fourth, second and third quadrants to move the
@@ -2693,6 +2744,44 @@ void MRI_FComplex_Matrix::fftshift(void){
    _fftshift((void *)_matrix, _nrows, _ncols, this->element_size_in_bytes());
 }
 
+//---------------------------------------------------------------------------
+// MRI_FComplex_Matrix::transpose
+// Stores the transpose of the matrix in mat, which must have _ncols rows
+// and _nrows columns.  The copy is done in TRANSPOSE_BLOCK square tiles
+// so that both the strided reads and the strided writes stay in cache.
+//---------------------------------------------------------------------------
+
+void MRI_FComplex_Matrix::transpose(MRI_FComplex_Matrix& mat) const {
+
+#ifdef DEBUG
+   assert(mat._nrows == _ncols);
+   assert(mat._ncols == _nrows);
+   assert(this != &mat);
+#endif
+
+   unsigned int row0, col0, row1, col1, row, col;
+   const float *source;
+   float *target;
+
+   for(row0=0; row0<_nrows; row0+=TRANSPOSE_BLOCK){
+      row1 = (row0+TRANSPOSE_BLOCK < _nrows) ? row0+TRANSPOSE_BLOCK : _nrows;
+      for(col0=0; col0<_ncols; col0+=TRANSPOSE_BLOCK){
+         col1 = (col0+TRANSPOSE_BLOCK < _ncols) ?
+                col0+TRANSPOSE_BLOCK : _ncols;
+         for(row=row0; row<row1; row++){
+            source = &(_matrix[2*(row*_ncols+col0)]);
+            target = &(mat._matrix[2*(col0*_nrows+row)]);
+            for(col=col0; col<col1; col++){
+               target[0] = source[0];
+               target[1] = source[1];
+               source += 2;
+               target += 2*_nrows;
+            }
+         }
+      }
+   }
+}
+
 //---------------------------------------------------------------------------
 // MRI_FComplex_Matrix::set_submatrix
 //---------------------------------------------------------------------------
@@ -3099,12 +3188,7 @@ MRI_Complex_Matrix& MRI_Complex_Matrix::operator=(const MRI_Complex_Matrix& mat)
 //---------------------------------------------------------------------------
 
 MRI_Complex_Matrix& MRI_Complex_Matrix::operator*=(double a){
-   unsigned int n;
-   unsigned int len = 2*this->get_nelements();
-  
-   for(n=0; n<len; n++){
-      _matrix[n] *= a;
-   }
+   MRI_SIMD::scale(_matrix, a, 2*this->get_nelements());
    return *this;
 }
 
@@ -3113,37 +3197,21 @@ MRI_Complex_Matrix& MRI_Complex_Matrix::operator*=(double a){
 // Multiplies a matrix element-by-element by another matrix
 //---------------------------------------------------------------------------
 
-MRI_Complex_Matrix& MRI_Complex_Matrix::operator*=(const MRI_Complex_Matrix& x) { 
-   unsigned int n;
-   unsigned int len = 2*this->get_nelements();
-   double   re, im;
-
+MRI_Complex_Matrix& MRI_Complex_Matrix::operator*=(const MRI_Complex_Matrix& x) {
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
-  
-   for(n=0; n<len; n+=2){
-      re = _matrix[n]*x._matrix[n]   - _matrix[n+1]*x._matrix[n+1];
-      im = _matrix[n]*x._matrix[n+1] + _matrix[n+1]*x._matrix[n];
-      _matrix[n]   = re;
-      _matrix[n+1] = im;
-   } 
+
+   MRI_SIMD::complex_mul(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
 MRI_Complex_Matrix& MRI_Complex_Matrix::operator*=(const MRI_Double_Matrix& x) {
-
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
 
-   for(n=0; n<len; n++){
-      _matrix[2*n]   *= x._matrix[n];
-      _matrix[2*n+1] *= x._matrix[n];
-   }
+   MRI_SIMD::real_mul(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -3153,17 +3221,11 @@ MRI_Complex_Matrix& MRI_Complex_Matrix::operator*=(const MRI_Double_Matrix& x) {
 //---------------------------------------------------------------------------
 
 MRI_Complex_Matrix& MRI_Complex_Matrix::operator/=(const MRI_Double_Matrix& x) {
-   unsigned int n;
-   unsigned int len = this->get_nelements();
-
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
 
-   for(n=0; n<len; n++){
-      _matrix[2*n]   /= x._matrix[n];
-      _matrix[2*n+1] /= x._matrix[n];
-   }
+   MRI_SIMD::real_div(_matrix, x._matrix, this->get_nelements());
    return *this;
 }
 
@@ -3173,16 +3235,11 @@ MRI_Complex_Matrix& MRI_Complex_Matrix::operator/=(const MRI_Double_Matrix& x) {
 //---------------------------------------------------------------------------
 
 MRI_Complex_Matrix& MRI_Complex_Matrix::operator+=(const MRI_Complex_Matrix& x){
-   unsigned int n;
-   unsigned int len = 2*this->get_nelements();
- 
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
 #endif
- 
-   for(n=0; n<len; n++){
-      _matrix[n] = _matrix[n] + x._matrix[n];
-   } 
+
+   MRI_SIMD::add(_matrix, x._matrix, 2*this->get_nelements());
    return *this;
 }
 
@@ -3195,22 +3252,13 @@ MRI_Complex_Matrix& MRI_Complex_Matrix::operator+=(const MRI_Complex_Matrix& x){
 MRI_Complex_Matrix& MRI_Complex_Matrix::saxpy(double areal, double aimag, 
                                           const MRI_Complex_Matrix& x,
                                           const MRI_Complex_Matrix& y){
-   unsigned int n;
-   unsigned int len = 2*this->get_nelements();
-   double   re, im;
-
 #ifdef DEBUG
    assert(this->is_same_size_as(x));
    assert(this->is_same_size_as(y));
 #endif
 
-   // Use temporary re, im in case x or y point to this.
-   for(n=0; n<len; n+=2){
-      re = areal*x._matrix[n]   - aimag*x._matrix[n+1] + y._matrix[n];
-      im = areal*x._matrix[n+1] + aimag*x._matrix[n]   + y._matrix[n+1];
-      _matrix[n] = re;
-      _matrix[n] = im;
-   }
+   MRI_SIMD::complex_saxpy(_matrix, areal, aimag, x._matrix, y._matrix,
+                           this->get_nelements());
    return *this;   
 }
 
@@ -3254,13 +3302,9 @@ void MRI_Complex_Matrix::FFT(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned int  irow;
-   double        *row;
-
-   for(irow=0; irow<_nrows; irow++){
-      row = &(_matrix[irow*_ncols]);
-      four1(row-1, _ncols, -1);
-   }
+   const MRI_FFT_Plan *plan = MRI_FFT_Plan::get(_ncols);
+   plan->transform_rows(_matrix, _nrows, _ncols, MRI_FFT_Plan::FORWARD);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, _nrows);
 }
 
 //---------------------------------------------------------------------------
@@ -3274,13 +3318,9 @@ void MRI_Complex_Matrix::iFFT(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned int  irow;
-   double        *row;
-
-   for(irow=0; irow<_nrows; irow++){
-      row = &(_matrix[irow*_ncols]);
-      four1(row-1, _ncols, 1);
-   }
+   const MRI_FFT_Plan *plan = MRI_FFT_Plan::get(_ncols);
+   plan->transform_rows(_matrix, _nrows, _ncols, MRI_FFT_Plan::INVERSE);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, _nrows);
    *this *= (1.0/(double)get_ncols());
 }
 
@@ -3295,10 +3335,8 @@ void MRI_Complex_Matrix::FFT2(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned long sizes[2];
-   sizes[0] = _nrows;
-   sizes[1] = _ncols;
-   fourn(_matrix-1, sizes-1, 2, -1);
+   _transform2(MRI_FFT_Plan::FORWARD);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS);
 }
 
 //---------------------------------------------------------------------------
@@ -3312,13 +3350,27 @@ void MRI_Complex_Matrix::iFFT2(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned long sizes[2];
-   sizes[0] = _nrows;
-   sizes[1] = _ncols;
-   fourn(_matrix-1, sizes-1, 2, 1);
+   _transform2(MRI_FFT_Plan::INVERSE);
+   MRI_Profile::count(MRI_Profile::FFT_CALLS);
    *this *= (1.0/(double)get_nelements());
 }
 
+//---------------------------------------------------------------------------
+// MRI_Complex_Matrix::_transform2
+// 2D-FFT in place: the rows, then the columns in cache-sized blocks.
+//---------------------------------------------------------------------------
+
+void MRI_Complex_Matrix::_transform2(MRI_FFT_Plan::Direction direction){
+   const MRI_FFT_Plan *row_plan = MRI_FFT_Plan::get(_ncols);
+   const MRI_FFT_Plan *col_plan = MRI_FFT_Plan::get(_nrows);
+   double *work = new double[col_plan->get_workspace_length()];
+
+   row_plan->transform_rows(_matrix, _nrows, _ncols, direction);
+   col_plan->transform_columns(_matrix, _ncols, _ncols, direction, work);
+
+   delete[] work;
+}
+
 //---------------------------------------------------------------------------
 // MRI_Complex_Matrix::fftshift
 // Swaps first and fourth, second and third quadrants to move the
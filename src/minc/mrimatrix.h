@@ -46,6 +46,7 @@
 #include <float.h>
 #include <string.h>
 #include "fourn.h"
+#include "mrifft.h"
 
 using namespace std;
 
@@ -63,6 +64,9 @@ using namespace std;
 #define FALSE 0
 #endif
 
+// Square tile edge used by cache-blocked transposes
+#define TRANSPOSE_BLOCK 32
+
 //===========================================================================
 // Base MRI_Matrix class
 // Abstract class which defines common interface to matrices.
@@ -683,6 +687,7 @@ class MRI_FComplex_Matrix : public MRI_Matrix {
       void FFT2(void);
       void iFFT2(void);
       void fftshift(void);
+      void transpose(MRI_FComplex_Matrix& mat) const;
 
       void set_submatrix(MRI_FComplex_Matrix& mat, 
                          unsigned int row, unsigned int col);
@@ -738,6 +743,8 @@ class MRI_FComplex_Matrix : public MRI_Matrix {
       const float *_matrix_endptr(void) const {
          return _matrix+2*get_nelements(); }
 
+      void _transform2(MRI_FFT_Plan::Direction direction);
+
       virtual void _allocate(unsigned int nelements) {
          _matrix = new float[2*nelements]; }
       virtual void _deallocate(void) {
@@ -859,6 +866,8 @@ class MRI_Complex_Matrix : public MRI_Matrix {
       const double *_matrix_endptr(void) const {
          return _matrix+2*get_nelements(); }
 
+      void _transform2(MRI_FFT_Plan::Direction direction);
+
       virtual void _allocate(unsigned int nelements) {
          _matrix = new double[2*nelements]; }
       virtual void _deallocate(void) {
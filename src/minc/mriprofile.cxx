@@ -0,0 +1,231 @@
+//===========================================================================
+// MRIPROFILE.CXX
+// Run-time profiling of the simulation stages.
+//===========================================================================
+
+#include <stdio.h>
+#include "mriprofile.h"
+
+//---------------------------------------------------------------------------
+// Static members
+//---------------------------------------------------------------------------
+
+int                  MRI_Profile::_enabled = 0;
+double               MRI_Profile::_start   = 0.0;
+MRI_Profile::Totals  MRI_Profile::_merged;
+MRI_Profile::Totals *MRI_Profile::_threads = NULL;
+pthread_key_t        MRI_Profile::_key;
+MRI_Mutex            MRI_Profile::_mutex;
+
+// Names used in the JSON output, in enum order.
+
+const char *MRI_Profile::_timer_name[MRI_Profile::NTIMERS] = {
+   "slice_select", "label_load", "chirp_rows", "chirp_cols",
+   "slab_encode", "noise", "fftshift_ifft2", "min_max", "quantize",
+   "write"
+};
+
+const char *MRI_Profile::_counter_name[MRI_Profile::NCOUNTERS] = {
+   "bytes_read", "bytes_written", "miicv_calls", "fft_calls"
+};
+
+//---------------------------------------------------------------------------
+// MRI_Profile::enable
+// Clears all timers and counters and turns profiling on.  Must be called
+// before any other threads are started.
+//---------------------------------------------------------------------------
+
+void MRI_Profile::enable(void) {
+
+   if (!_enabled) {
+      (void)pthread_key_create(&_key, _merge_totals);
+   }
+
+   Totals *totals;
+   _clear_totals(&_merged);
+   for (totals=_threads; totals!=NULL; totals=totals->next){
+      _clear_totals(totals);
+   }
+   _start   = now();
+   _enabled = 1;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::start
+// Starts a stage in this thread.  The time of the running stage, if any,
+// is added up to now and the stage is paused.  Returns the paused stage,
+// or NTIMERS.
+//---------------------------------------------------------------------------
+
+int MRI_Profile::start(Timer timer) {
+
+   Totals       *totals = _get_totals();
+   const double t       = now();
+   const int    resume  = totals->running;
+
+   if (resume < NTIMERS) {
+      totals->seconds[resume] += t - totals->mark;
+   }
+   totals->running = timer;
+   totals->mark    = t;
+   totals->calls[timer]++;
+
+   return resume;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::stop
+// Adds the time of the running stage up to now, and resumes the stage
+// it paused.
+//---------------------------------------------------------------------------
+
+void MRI_Profile::stop(int resume) {
+
+   Totals       *totals = _get_totals();
+   const double t       = now();
+
+   totals->seconds[totals->running] += t - totals->mark;
+   totals->running = resume;
+   totals->mark    = t;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::_add_count
+// Adds n to an event counter.
+//---------------------------------------------------------------------------
+
+void MRI_Profile::_add_count(Counter counter, long n) {
+
+   _get_totals()->counts[counter] += n;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::_get_totals
+// Returns the totals of this thread, made on the first event.  Only the
+// list of running threads is shared, so only making the totals locks.
+//---------------------------------------------------------------------------
+
+MRI_Profile::Totals *MRI_Profile::_get_totals(void) {
+
+   Totals *totals = (Totals *)pthread_getspecific(_key);
+
+   if (totals == NULL) {
+      totals = new Totals;
+      _clear_totals(totals);
+
+      MRI_Lock lock(_mutex);
+      totals->next = _threads;
+      _threads     = totals;
+      (void)pthread_setspecific(_key, totals);
+   }
+   return totals;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::_clear_totals
+// Zeroes the times and counts of a thread, with no stage running.
+//---------------------------------------------------------------------------
+
+void MRI_Profile::_clear_totals(Totals *totals) {
+
+   int n;
+   for (n=0; n<NTIMERS; n++){
+      totals->seconds[n] = 0.0;
+      totals->calls[n]   = 0;
+   }
+   for (n=0; n<NCOUNTERS; n++){
+      totals->counts[n] = 0;
+   }
+   totals->running = NTIMERS;
+   totals->mark    = 0.0;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::_merge_totals
+// Adds the totals of an exiting thread to those of the exited threads
+// and frees them.  Called by the thread's key destructor.
+//---------------------------------------------------------------------------
+
+void MRI_Profile::_merge_totals(void *ptr) {
+
+   Totals *totals = (Totals *)ptr;
+
+   MRI_Lock lock(_mutex);
+
+   int n;
+   for (n=0; n<NTIMERS; n++){
+      _merged.seconds[n] += totals->seconds[n];
+      _merged.calls[n]   += totals->calls[n];
+   }
+   for (n=0; n<NCOUNTERS; n++){
+      _merged.counts[n] += totals->counts[n];
+   }
+
+   Totals **link;
+   for (link=&_threads; *link!=NULL; link=&((*link)->next)){
+      if (*link == totals) {
+         *link = totals->next;
+         break;
+      }
+   }
+   delete totals;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::write_json
+// Writes the timers and counters to a file as a JSON object.  Returns
+// FALSE (0) if the file could not be written.
+//---------------------------------------------------------------------------
+
+int MRI_Profile::write_json(const char *path) {
+
+   FILE *fp;
+   if ((fp = fopen(path, "w")) == NULL) {
+      return 0;
+   }
+
+   MRI_Lock lock(_mutex);
+
+   // Stages still running in the threads are not included.
+   Totals sum = _merged;
+   Totals *totals;
+   int    n;
+   for (totals=_threads; totals!=NULL; totals=totals->next){
+      for (n=0; n<NTIMERS; n++){
+         sum.seconds[n] += totals->seconds[n];
+         sum.calls[n]   += totals->calls[n];
+      }
+      for (n=0; n<NCOUNTERS; n++){
+         sum.counts[n] += totals->counts[n];
+      }
+   }
+
+   fprintf(fp, "{\n");
+   fprintf(fp, "  \"wall_seconds\": %.6f,\n", now() - _start);
+
+   fprintf(fp, "  \"timers\": {\n");
+   for (n=0; n<NTIMERS; n++){
+      fprintf(fp, "    \"%s\": {\"seconds\": %.6f, \"calls\": %ld}%s\n",
+              _timer_name[n], sum.seconds[n], sum.calls[n],
+              (n < NTIMERS-1) ? "," : "");
+   }
+   fprintf(fp, "  },\n");
+
+   fprintf(fp, "  \"counters\": {\n");
+   for (n=0; n<NCOUNTERS; n++){
+      fprintf(fp, "    \"%s\": %ld%s\n", _counter_name[n], sum.counts[n],
+              (n < NCOUNTERS-1) ? "," : "");
+   }
+   fprintf(fp, "  }\n");
+   fprintf(fp, "}\n");
+
+   return (fclose(fp) == 0);
+
+}
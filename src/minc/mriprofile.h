@@ -0,0 +1,147 @@
+#ifndef __MRIPROFILE_H
+#define __MRIPROFILE_H
+
+//===========================================================================
+// MRIPROFILE.H
+// Run-time profiling of the simulation stages.
+// Inherits from:
+// Base class to:
+//===========================================================================
+
+#include <sys/time.h>
+#include "mrithread.h"
+
+//---------------------------------------------------------------------------
+// MRI_Profile class
+// Accumulates elapsed time and call counts for each simulation stage, and
+// event counters.  Profiling is off until enable() is called, and costs
+// a single test per event while off.
+//
+// Stage times are exclusive: a stage timed inside another (label_load
+// or chirp_rows inside slice_select, say) pauses the outer stage, so
+// the stages of one thread never count the same time twice.  Each thread
+// accumulates its own totals without locking; they are merged when the
+// thread exits, or by write_json.  Times of concurrent threads are
+// summed, so with several threads a stage may exceed the wall time.
+//---------------------------------------------------------------------------
+
+class MRI_Profile {
+   public:
+      enum Timer   {TIME_SLICE_SELECT, TIME_LABEL_LOAD, TIME_CHIRP_ROWS,
+                    TIME_CHIRP_COLS, TIME_SLAB_ENCODE, TIME_NOISE,
+                    TIME_RECON_FFT, TIME_MIN_MAX, TIME_QUANTIZE, TIME_WRITE,
+                    NTIMERS};
+      enum Counter {BYTES_READ, BYTES_WRITTEN, MIICV_CALLS, FFT_CALLS,
+                    NCOUNTERS};
+
+      static void enable(void);
+      static inline int is_enabled(void);
+
+      static inline double now(void);
+      static inline void count(Counter counter, long n = 1);
+
+      // Starts a stage in this thread, pausing the running one, which is
+      // returned (NTIMERS if none) to be resumed by stop.
+      static int  start(Timer timer);
+      static void stop(int resume);
+
+      // Call after the worker threads have finished.
+      static int write_json(const char *path);
+
+   private:
+      struct Totals {
+         double seconds[NTIMERS];
+         long   calls[NTIMERS];
+         long   counts[NCOUNTERS];
+         int    running;                    // stage being timed
+         double mark;                       // time the stage was resumed
+         Totals *next;
+      };
+
+      static void    _add_count(Counter counter, long n);
+      static Totals *_get_totals(void);
+      static void    _clear_totals(Totals *totals);
+      static void    _merge_totals(void *totals);
+
+      static int           _enabled;
+      static double        _start;          // time of enable()
+      static Totals        _merged;         // of threads that have exited
+      static Totals        *_threads;       // of running threads
+      static pthread_key_t _key;
+      static MRI_Mutex     _mutex;
+
+      static const char *_timer_name[NTIMERS];
+      static const char *_counter_name[NCOUNTERS];
+};
+
+//---------------------------------------------------------------------------
+// MRI_Profile_Timer class
+// Times a stage from its construction to its destruction.
+//---------------------------------------------------------------------------
+
+class MRI_Profile_Timer {
+   public:
+      inline MRI_Profile_Timer(MRI_Profile::Timer timer);
+      inline ~MRI_Profile_Timer();
+
+   private:
+      int _resume;                          // stage paused, or -1 if off
+};
+
+//---------------------------------------------------------------------------
+// Inline member functions
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// MRI_Profile::is_enabled
+// Returns TRUE if profiling is on.
+//---------------------------------------------------------------------------
+
+inline
+int MRI_Profile::is_enabled(void) {
+   return _enabled;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::now
+// Returns the current time in seconds.
+//---------------------------------------------------------------------------
+
+inline
+double MRI_Profile::now(void) {
+   struct timeval tv;
+   (void)gettimeofday(&tv, NULL);
+   return tv.tv_sec + 1.0e-6*tv.tv_usec;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile::count
+// Adds n to an event counter.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Profile::count(Counter counter, long n) {
+   if (_enabled) _add_count(counter, n);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile_Timer constructor
+// Starts timing a stage.
+//---------------------------------------------------------------------------
+
+inline
+MRI_Profile_Timer::MRI_Profile_Timer(MRI_Profile::Timer timer) {
+   _resume = MRI_Profile::is_enabled() ? MRI_Profile::start(timer) : -1;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Profile_Timer destructor
+// Adds the elapsed time to the stage and resumes the one it paused.
+//---------------------------------------------------------------------------
+
+inline
+MRI_Profile_Timer::~MRI_Profile_Timer() {
+   if (_resume >= 0) MRI_Profile::stop(_resume);
+}
+
+#endif
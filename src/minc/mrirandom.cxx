@@ -0,0 +1,798 @@
+//===========================================================================
+// MRIRANDOM.CXX
+// Counter-based random number generation.
+//
+// The batch kernels for each instruction set are compiled with the GCC
+// target attribute, as in mrisimd.cxx, and are chosen by the MRI_SIMD
+// level.  All of them give the same values, bit for bit, as the scalar
+// kernels.
+//===========================================================================
+
+#include <string.h>
+#include <math.h>
+#include "mrirandom.h"
+#include "mrisimd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MRI_RANDOM_X86
+#include <immintrin.h>
+#endif
+
+#ifdef __GNUC__
+#define EXACT_TARGET __attribute__((optimize("fp-contract=off")))
+#else
+#define EXACT_TARGET
+#endif
+
+// Counters generated together by gaussian_fill
+#define RANDOM_BLOCK 64
+
+//===========================================================================
+// Polynomial coefficients
+// log(m) = 2f + f^3 * (2/3 + 2/5 f^2 + ... + 2/23 f^20), f = (m-1)/(m+1),
+// accurate to an ulp or two for m in [sqrt(1/2), sqrt(2)].  sin and cos
+// are Taylor series through x^17 and x^16, accurate on [-pi/4, pi/4].
+//===========================================================================
+
+#define LOG_C1  (2.0/3.0)
+#define LOG_C2  (2.0/5.0)
+#define LOG_C3  (2.0/7.0)
+#define LOG_C4  (2.0/9.0)
+#define LOG_C5  (2.0/11.0)
+#define LOG_C6  (2.0/13.0)
+#define LOG_C7  (2.0/15.0)
+#define LOG_C8  (2.0/17.0)
+#define LOG_C9  (2.0/19.0)
+#define LOG_C10 (2.0/21.0)
+#define LOG_C11 (2.0/23.0)
+
+#define SIN_C1  (-1.0/6.0)
+#define SIN_C2  (1.0/120.0)
+#define SIN_C3  (-1.0/5040.0)
+#define SIN_C4  (1.0/362880.0)
+#define SIN_C5  (-1.0/39916800.0)
+#define SIN_C6  (1.0/6227020800.0)
+#define SIN_C7  (-1.0/1307674368000.0)
+#define SIN_C8  (1.0/355687428096000.0)
+
+#define COS_C2  (1.0/24.0)
+#define COS_C3  (-1.0/720.0)
+#define COS_C4  (1.0/40320.0)
+#define COS_C5  (-1.0/3628800.0)
+#define COS_C6  (1.0/479001600.0)
+#define COS_C7  (-1.0/87178291200.0)
+#define COS_C8  (1.0/20922789888000.0)
+
+//===========================================================================
+// Scalar kernels
+// Reference versions of each step, also used for the counters left over
+// by the vector kernels.
+//===========================================================================
+
+//---------------------------------------------------------------------------
+// philox_c
+// Applies the ten Philox rounds to n counters held as four word arrays.
+//---------------------------------------------------------------------------
+
+static void philox_c(unsigned int *c0, unsigned int *c1,
+                     unsigned int *c2, unsigned int *c3,
+                     const unsigned int key[2], unsigned int n) {
+   unsigned int k0 = key[0];
+   unsigned int k1 = key[1];
+   unsigned int i, round;
+
+   for(round=0; round<10; round++){
+      for(i=0; i<n; i++){
+         const unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0[i];
+         const unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2[i];
+         c0[i] = (unsigned int)(p1 >> 32) ^ c1[i] ^ k0;
+         c1[i] = (unsigned int)p1;
+         c2[i] = (unsigned int)(p0 >> 32) ^ c3[i] ^ k1;
+         c3[i] = (unsigned int)p0;
+      }
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+   }
+}
+
+//---------------------------------------------------------------------------
+// log_unit_c
+// Natural logarithm of u in (0,1), by splitting off the binary exponent.
+//---------------------------------------------------------------------------
+
+EXACT_TARGET
+static inline double log_unit_c(double u) {
+   unsigned long long bits;
+   double m, e, f, s, q;
+
+   memcpy(&bits, &u, sizeof(bits));
+   e    = (double)(bits >> 52) - 1023.0;
+   bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+   memcpy(&m, &bits, sizeof(m));
+   if (m > M_SQRT2) {
+      m = m*0.5;
+      e = e + 1.0;
+   }
+
+   f = (m - 1.0)/(m + 1.0);
+   s = f*f;
+   q = LOG_C11;
+   q = q*s + LOG_C10;
+   q = q*s + LOG_C9;
+   q = q*s + LOG_C8;
+   q = q*s + LOG_C7;
+   q = q*s + LOG_C6;
+   q = q*s + LOG_C5;
+   q = q*s + LOG_C4;
+   q = q*s + LOG_C3;
+   q = q*s + LOG_C2;
+   q = q*s + LOG_C1;
+   return e*M_LN2 + (f*2.0 + (f*s)*q);
+}
+
+//---------------------------------------------------------------------------
+// sincos_turn_c
+// Cosine and sine of 2*pi*v, for v in (0,1).  The angle is reduced to
+// [-pi/4, pi/4] about the nearest multiple of pi/2, which is exact in
+// turns, and the quadrant is applied by swapping and negating.
+//---------------------------------------------------------------------------
+
+EXACT_TARGET
+static inline void sincos_turn_c(double v, double& cos_v, double& sin_v) {
+   const double y = v*4.0;
+   const int    q = (int)(y + 0.5);
+   const double x = (y - (double)q)*M_PI_2;
+   const double z = x*x;
+   double sp, cp, sn, cn;
+
+   sp = SIN_C8;
+   sp = sp*z + SIN_C7;
+   sp = sp*z + SIN_C6;
+   sp = sp*z + SIN_C5;
+   sp = sp*z + SIN_C4;
+   sp = sp*z + SIN_C3;
+   sp = sp*z + SIN_C2;
+   sp = sp*z + SIN_C1;
+   sn = x + (x*z)*sp;
+
+   cp = COS_C8;
+   cp = cp*z + COS_C7;
+   cp = cp*z + COS_C6;
+   cp = cp*z + COS_C5;
+   cp = cp*z + COS_C4;
+   cp = cp*z + COS_C3;
+   cp = cp*z + COS_C2;
+   cn = (1.0 - z*0.5) + (z*z)*cp;
+
+   switch(q & 3){
+      case 0:  cos_v =  cn; sin_v =  sn; break;
+      case 1:  cos_v = -sn; sin_v =  cn; break;
+      case 2:  cos_v = -cn; sin_v = -sn; break;
+      default: cos_v =  sn; sin_v = -cn; break;
+   }
+}
+
+//---------------------------------------------------------------------------
+// box_muller_c
+// Turns n Philox outputs into n pairs of unit normals.
+//---------------------------------------------------------------------------
+
+EXACT_TARGET
+static void box_muller_c(const unsigned int *c0, const unsigned int *c1,
+                         const unsigned int *c2, const unsigned int *c3,
+                         double *n1, double *n2, unsigned int n) {
+   double r, cos_t, sin_t;
+   unsigned int i;
+
+   for(i=0; i<n; i++){
+      r = sqrt(-2.0*log_unit_c(MRI_Random::uniform(c0[i], c1[i])));
+      sincos_turn_c(MRI_Random::uniform(c2[i], c3[i]), cos_t, sin_t);
+      n1[i] = r*cos_t;
+      n2[i] = r*sin_t;
+   }
+}
+
+#ifdef MRI_RANDOM_X86
+
+//===========================================================================
+// SSE2 kernels
+// Four counters per integer register and two doubles per float register.
+// The 32 bit products are formed two at a time by _mm_mul_epu32, for the
+// even and odd words separately.
+//===========================================================================
+
+#define SSE2_TARGET \
+   __attribute__((target("sse2"), optimize("fp-contract=off")))
+
+SSE2_TARGET
+static inline void mulhilo_sse2(__m128i a, __m128i m,
+                                __m128i& hi, __m128i& lo) {
+   const __m128i lo_mask = _mm_set1_epi64x(0x00000000FFFFFFFFLL);
+   __m128i even = _mm_mul_epu32(a, m);
+   __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+   hi = _mm_or_si128(_mm_srli_epi64(even, 32),
+                     _mm_andnot_si128(lo_mask, odd));
+   lo = _mm_or_si128(_mm_and_si128(even, lo_mask),
+                     _mm_slli_epi64(odd, 32));
+}
+
+SSE2_TARGET
+static void philox_sse2(unsigned int *c0, unsigned int *c1,
+                        unsigned int *c2, unsigned int *c3,
+                        const unsigned int key[2], unsigned int n) {
+   const __m128i m0 = _mm_set1_epi32((int)PHILOX_M0);
+   const __m128i m1 = _mm_set1_epi32((int)PHILOX_M1);
+   unsigned int i, round;
+
+   for(i=0; i+4<=n; i+=4){
+      __m128i v0 = _mm_loadu_si128((const __m128i *)(c0+i));
+      __m128i v1 = _mm_loadu_si128((const __m128i *)(c1+i));
+      __m128i v2 = _mm_loadu_si128((const __m128i *)(c2+i));
+      __m128i v3 = _mm_loadu_si128((const __m128i *)(c3+i));
+      unsigned int k0 = key[0];
+      unsigned int k1 = key[1];
+      for(round=0; round<10; round++){
+         __m128i hi0, lo0, hi1, lo1;
+         mulhilo_sse2(v0, m0, hi0, lo0);
+         mulhilo_sse2(v2, m1, hi1, lo1);
+         v0 = _mm_xor_si128(_mm_xor_si128(hi1, v1), _mm_set1_epi32((int)k0));
+         v1 = lo1;
+         v2 = _mm_xor_si128(_mm_xor_si128(hi0, v3), _mm_set1_epi32((int)k1));
+         v3 = lo0;
+         k0 += PHILOX_W0;
+         k1 += PHILOX_W1;
+      }
+      _mm_storeu_si128((__m128i *)(c0+i), v0);
+      _mm_storeu_si128((__m128i *)(c1+i), v1);
+      _mm_storeu_si128((__m128i *)(c2+i), v2);
+      _mm_storeu_si128((__m128i *)(c3+i), v3);
+   }
+   philox_c(c0+i, c1+i, c2+i, c3+i, key, n-i);
+}
+
+// Converts 64 bit lanes holding integers below 2^52 to doubles.
+SSE2_TARGET
+static inline __m128d u64_to_pd_sse2(__m128i v) {
+   const __m128i magic = _mm_set1_epi64x(0x4330000000000000LL);
+   return _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(v, magic)),
+                     _mm_set1_pd(4503599627370496.0));
+}
+
+// Two uniforms from the next two entries of the hi and lo words.
+SSE2_TARGET
+static inline __m128d uniform_sse2(const unsigned int *hi,
+                                   const unsigned int *lo) {
+   const __m128i zero = _mm_setzero_si128();
+   __m128i h = _mm_srli_epi32(_mm_loadl_epi64((const __m128i *)hi), 5);
+   __m128i l = _mm_srli_epi32(_mm_loadl_epi64((const __m128i *)lo), 6);
+   __m128d bits = _mm_add_pd(
+                     _mm_mul_pd(u64_to_pd_sse2(_mm_unpacklo_epi32(h, zero)),
+                                _mm_set1_pd(67108864.0)),
+                     u64_to_pd_sse2(_mm_unpacklo_epi32(l, zero)));
+   return _mm_mul_pd(_mm_add_pd(bits, _mm_set1_pd(0.5)),
+                     _mm_set1_pd(1.0 / 9007199254740992.0));
+}
+
+SSE2_TARGET
+static inline __m128d log_unit_sse2(__m128d u) {
+   __m128i bits = _mm_castpd_si128(u);
+   __m128d e    = _mm_sub_pd(u64_to_pd_sse2(_mm_srli_epi64(bits, 52)),
+                             _mm_set1_pd(1023.0));
+   __m128d m    = _mm_castsi128_pd(_mm_or_si128(
+                     _mm_and_si128(bits,
+                                   _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                     _mm_set1_epi64x(0x3FF0000000000000LL)));
+   __m128d big  = _mm_cmpgt_pd(m, _mm_set1_pd(M_SQRT2));
+   m = _mm_or_pd(_mm_andnot_pd(big, m),
+                 _mm_and_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5))));
+   e = _mm_add_pd(e, _mm_and_pd(big, _mm_set1_pd(1.0)));
+
+   __m128d f = _mm_div_pd(_mm_sub_pd(m, _mm_set1_pd(1.0)),
+                          _mm_add_pd(m, _mm_set1_pd(1.0)));
+   __m128d s = _mm_mul_pd(f, f);
+   __m128d q = _mm_set1_pd(LOG_C11);
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C10));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C9));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C8));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C7));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C6));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C5));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C4));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C3));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C2));
+   q = _mm_add_pd(_mm_mul_pd(q, s), _mm_set1_pd(LOG_C1));
+   return _mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(M_LN2)),
+                     _mm_add_pd(_mm_mul_pd(f, _mm_set1_pd(2.0)),
+                                _mm_mul_pd(_mm_mul_pd(f, s), q)));
+}
+
+SSE2_TARGET
+static inline void sincos_turn_sse2(__m128d v, __m128d& cos_v,
+                                    __m128d& sin_v) {
+   const __m128i one  = _mm_set1_epi32(1);
+   const __m128i two  = _mm_set1_epi32(2);
+   const __m128d sign = _mm_set1_pd(-0.0);
+   __m128d y  = _mm_mul_pd(v, _mm_set1_pd(4.0));
+   __m128i q  = _mm_cvttpd_epi32(_mm_add_pd(y, _mm_set1_pd(0.5)));
+   __m128d x  = _mm_mul_pd(_mm_sub_pd(y, _mm_cvtepi32_pd(q)),
+                           _mm_set1_pd(M_PI_2));
+   __m128d z  = _mm_mul_pd(x, x);
+
+   __m128d sp = _mm_set1_pd(SIN_C8);
+   sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C7));
+   sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C6));
+   sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C5));
+   sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C4));
+   sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C3));
+   sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C2));
+   sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C1));
+   __m128d sn = _mm_add_pd(x, _mm_mul_pd(_mm_mul_pd(x, z), sp));
+
+   __m128d cp = _mm_set1_pd(COS_C8);
+   cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C7));
+   cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C6));
+   cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C5));
+   cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C4));
+   cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C3));
+   cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C2));
+   __m128d cn = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0),
+                                      _mm_mul_pd(z, _mm_set1_pd(0.5))),
+                           _mm_mul_pd(_mm_mul_pd(z, z), cp));
+
+   // Quadrant in both halves of each 64 bit lane
+   __m128i qq    = _mm_shuffle_epi32(q, _MM_SHUFFLE(1, 1, 0, 0));
+   __m128d swap  = _mm_castsi128_pd(
+                      _mm_cmpeq_epi32(_mm_and_si128(qq, one), one));
+   __m128d csign = _mm_and_pd(sign, _mm_castsi128_pd(_mm_slli_epi32(
+                      _mm_and_si128(_mm_add_epi32(qq, one), two), 30)));
+   __m128d ssign = _mm_and_pd(sign, _mm_castsi128_pd(_mm_slli_epi32(
+                      _mm_and_si128(qq, two), 30)));
+   cos_v = _mm_xor_pd(_mm_or_pd(_mm_and_pd(swap, sn),
+                                _mm_andnot_pd(swap, cn)), csign);
+   sin_v = _mm_xor_pd(_mm_or_pd(_mm_and_pd(swap, cn),
+                                _mm_andnot_pd(swap, sn)), ssign);
+}
+
+SSE2_TARGET
+static void box_muller_sse2(const unsigned int *c0, const unsigned int *c1,
+                            const unsigned int *c2, const unsigned int *c3,
+                            double *n1, double *n2, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      __m128d r = _mm_sqrt_pd(_mm_mul_pd(_mm_set1_pd(-2.0),
+                              log_unit_sse2(uniform_sse2(c0+i, c1+i))));
+      __m128d cos_t, sin_t;
+      sincos_turn_sse2(uniform_sse2(c2+i, c3+i), cos_t, sin_t);
+      _mm_storeu_pd(n1+i, _mm_mul_pd(r, cos_t));
+      _mm_storeu_pd(n2+i, _mm_mul_pd(r, sin_t));
+   }
+   box_muller_c(c0+i, c1+i, c2+i, c3+i, n1+i, n2+i, n-i);
+}
+
+//===========================================================================
+// AVX2 kernels
+// Eight counters per integer register and four doubles per float
+// register.
+//===========================================================================
+
+#define AVX2_TARGET \
+   __attribute__((target("avx2"), optimize("fp-contract=off")))
+
+AVX2_TARGET
+static inline void mulhilo_avx2(__m256i a, __m256i m,
+                                __m256i& hi, __m256i& lo) {
+   const __m256i lo_mask = _mm256_set1_epi64x(0x00000000FFFFFFFFLL);
+   __m256i even = _mm256_mul_epu32(a, m);
+   __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+   hi = _mm256_or_si256(_mm256_srli_epi64(even, 32),
+                        _mm256_andnot_si256(lo_mask, odd));
+   lo = _mm256_or_si256(_mm256_and_si256(even, lo_mask),
+                        _mm256_slli_epi64(odd, 32));
+}
+
+AVX2_TARGET
+static void philox_avx2(unsigned int *c0, unsigned int *c1,
+                        unsigned int *c2, unsigned int *c3,
+                        const unsigned int key[2], unsigned int n) {
+   const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+   const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+   unsigned int i, round;
+
+   for(i=0; i+8<=n; i+=8){
+      __m256i v0 = _mm256_loadu_si256((const __m256i *)(c0+i));
+      __m256i v1 = _mm256_loadu_si256((const __m256i *)(c1+i));
+      __m256i v2 = _mm256_loadu_si256((const __m256i *)(c2+i));
+      __m256i v3 = _mm256_loadu_si256((const __m256i *)(c3+i));
+      unsigned int k0 = key[0];
+      unsigned int k1 = key[1];
+      for(round=0; round<10; round++){
+         __m256i hi0, lo0, hi1, lo1;
+         mulhilo_avx2(v0, m0, hi0, lo0);
+         mulhilo_avx2(v2, m1, hi1, lo1);
+         v0 = _mm256_xor_si256(_mm256_xor_si256(hi1, v1),
+                               _mm256_set1_epi32((int)k0));
+         v1 = lo1;
+         v2 = _mm256_xor_si256(_mm256_xor_si256(hi0, v3),
+                               _mm256_set1_epi32((int)k1));
+         v3 = lo0;
+         k0 += PHILOX_W0;
+         k1 += PHILOX_W1;
+      }
+      _mm256_storeu_si256((__m256i *)(c0+i), v0);
+      _mm256_storeu_si256((__m256i *)(c1+i), v1);
+      _mm256_storeu_si256((__m256i *)(c2+i), v2);
+      _mm256_storeu_si256((__m256i *)(c3+i), v3);
+   }
+   philox_c(c0+i, c1+i, c2+i, c3+i, key, n-i);
+}
+
+AVX2_TARGET
+static inline __m256d u64_to_pd_avx2(__m256i v) {
+   const __m256i magic = _mm256_set1_epi64x(0x4330000000000000LL);
+   return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(v, magic)),
+                        _mm256_set1_pd(4503599627370496.0));
+}
+
+AVX2_TARGET
+static inline __m256d uniform_avx2(const unsigned int *hi,
+                                   const unsigned int *lo) {
+   __m128i h = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)hi), 5);
+   __m128i l = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)lo), 6);
+   __m256d bits = _mm256_add_pd(
+                     _mm256_mul_pd(u64_to_pd_avx2(_mm256_cvtepu32_epi64(h)),
+                                   _mm256_set1_pd(67108864.0)),
+                     u64_to_pd_avx2(_mm256_cvtepu32_epi64(l)));
+   return _mm256_mul_pd(_mm256_add_pd(bits, _mm256_set1_pd(0.5)),
+                        _mm256_set1_pd(1.0 / 9007199254740992.0));
+}
+
+AVX2_TARGET
+static inline __m256d log_unit_avx2(__m256d u) {
+   __m256i bits = _mm256_castpd_si256(u);
+   __m256d e    = _mm256_sub_pd(u64_to_pd_avx2(_mm256_srli_epi64(bits, 52)),
+                                _mm256_set1_pd(1023.0));
+   __m256d m    = _mm256_castsi256_pd(_mm256_or_si256(
+                     _mm256_and_si256(bits,
+                                      _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                     _mm256_set1_epi64x(0x3FF0000000000000LL)));
+   __m256d big  = _mm256_cmp_pd(m, _mm256_set1_pd(M_SQRT2), _CMP_GT_OQ);
+   m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+   e = _mm256_add_pd(e, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
+
+   __m256d f = _mm256_div_pd(_mm256_sub_pd(m, _mm256_set1_pd(1.0)),
+                             _mm256_add_pd(m, _mm256_set1_pd(1.0)));
+   __m256d s = _mm256_mul_pd(f, f);
+   __m256d q = _mm256_set1_pd(LOG_C11);
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C10));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C9));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C8));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C7));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C6));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C5));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C4));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C3));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C2));
+   q = _mm256_add_pd(_mm256_mul_pd(q, s), _mm256_set1_pd(LOG_C1));
+   return _mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(M_LN2)),
+                        _mm256_add_pd(_mm256_mul_pd(f, _mm256_set1_pd(2.0)),
+                                      _mm256_mul_pd(_mm256_mul_pd(f, s), q)));
+}
+
+AVX2_TARGET
+static inline void sincos_turn_avx2(__m256d v, __m256d& cos_v,
+                                    __m256d& sin_v) {
+   const __m256i one  = _mm256_set1_epi64x(1);
+   const __m256i two  = _mm256_set1_epi64x(2);
+   __m256d y  = _mm256_mul_pd(v, _mm256_set1_pd(4.0));
+   __m128i q  = _mm256_cvttpd_epi32(_mm256_add_pd(y, _mm256_set1_pd(0.5)));
+   __m256d x  = _mm256_mul_pd(_mm256_sub_pd(y, _mm256_cvtepi32_pd(q)),
+                              _mm256_set1_pd(M_PI_2));
+   __m256d z  = _mm256_mul_pd(x, x);
+
+   __m256d sp = _mm256_set1_pd(SIN_C8);
+   sp = _mm256_add_pd(_mm256_mul_pd(sp, z), _mm256_set1_pd(SIN_C7));
+   sp = _mm256_add_pd(_mm256_mul_pd(sp, z), _mm256_set1_pd(SIN_C6));
+   sp = _mm256_add_pd(_mm256_mul_pd(sp, z), _mm256_set1_pd(SIN_C5));
+   sp = _mm256_add_pd(_mm256_mul_pd(sp, z), _mm256_set1_pd(SIN_C4));
+   sp = _mm256_add_pd(_mm256_mul_pd(sp, z), _mm256_set1_pd(SIN_C3));
+   sp = _mm256_add_pd(_mm256_mul_pd(sp, z), _mm256_set1_pd(SIN_C2));
+   sp = _mm256_add_pd(_mm256_mul_pd(sp, z), _mm256_set1_pd(SIN_C1));
+   __m256d sn = _mm256_add_pd(x, _mm256_mul_pd(_mm256_mul_pd(x, z), sp));
+
+   __m256d cp = _mm256_set1_pd(COS_C8);
+   cp = _mm256_add_pd(_mm256_mul_pd(cp, z), _mm256_set1_pd(COS_C7));
+   cp = _mm256_add_pd(_mm256_mul_pd(cp, z), _mm256_set1_pd(COS_C6));
+   cp = _mm256_add_pd(_mm256_mul_pd(cp, z), _mm256_set1_pd(COS_C5));
+   cp = _mm256_add_pd(_mm256_mul_pd(cp, z), _mm256_set1_pd(COS_C4));
+   cp = _mm256_add_pd(_mm256_mul_pd(cp, z), _mm256_set1_pd(COS_C3));
+   cp = _mm256_add_pd(_mm256_mul_pd(cp, z), _mm256_set1_pd(COS_C2));
+   __m256d cn = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0),
+                                            _mm256_mul_pd(z,
+                                               _mm256_set1_pd(0.5))),
+                              _mm256_mul_pd(_mm256_mul_pd(z, z), cp));
+
+   __m256i q64   = _mm256_cvtepi32_epi64(q);
+   __m256d swap  = _mm256_castsi256_pd(
+                      _mm256_cmpeq_epi64(_mm256_and_si256(q64, one), one));
+   __m256d csign = _mm256_castsi256_pd(_mm256_slli_epi64(
+                      _mm256_and_si256(_mm256_add_epi64(q64, one), two), 62));
+   __m256d ssign = _mm256_castsi256_pd(_mm256_slli_epi64(
+                      _mm256_and_si256(q64, two), 62));
+   cos_v = _mm256_xor_pd(_mm256_blendv_pd(cn, sn, swap), csign);
+   sin_v = _mm256_xor_pd(_mm256_blendv_pd(sn, cn, swap), ssign);
+}
+
+AVX2_TARGET
+static void box_muller_avx2(const unsigned int *c0, const unsigned int *c1,
+                            const unsigned int *c2, const unsigned int *c3,
+                            double *n1, double *n2, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m256d r = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_set1_pd(-2.0),
+                                 log_unit_avx2(uniform_avx2(c0+i, c1+i))));
+      __m256d cos_t, sin_t;
+      sincos_turn_avx2(uniform_avx2(c2+i, c3+i), cos_t, sin_t);
+      _mm256_storeu_pd(n1+i, _mm256_mul_pd(r, cos_t));
+      _mm256_storeu_pd(n2+i, _mm256_mul_pd(r, sin_t));
+   }
+   box_muller_c(c0+i, c1+i, c2+i, c3+i, n1+i, n2+i, n-i);
+}
+
+//===========================================================================
+// AVX-512 kernels
+// Sixteen counters per integer register and eight doubles per float
+// register.
+//===========================================================================
+
+#define AVX512_TARGET \
+   __attribute__((target("avx512f"), optimize("fp-contract=off")))
+
+// As in mrisimd.cxx, the zero-masked forms of the intrinsics are used with
+// every lane selected, so that GCC does not warn of their undefined
+// pass-through operands.
+
+#define AVX512_ALL8 ((__mmask8)0xFF)
+
+AVX512_TARGET
+static inline void mulhilo_avx512(__m512i a, __m512i m,
+                                  __m512i& hi, __m512i& lo) {
+   const __m512i lo_mask = _mm512_set1_epi64(0x00000000FFFFFFFFLL);
+   __m512i even = _mm512_maskz_mul_epu32(AVX512_ALL8, a, m);
+   __m512i odd  = _mm512_maskz_mul_epu32(AVX512_ALL8,
+                     _mm512_maskz_srli_epi64(AVX512_ALL8, a, 32), m);
+   hi = _mm512_or_si512(_mm512_maskz_srli_epi64(AVX512_ALL8, even, 32),
+                        _mm512_maskz_andnot_epi64(AVX512_ALL8, lo_mask, odd));
+   lo = _mm512_or_si512(_mm512_and_si512(even, lo_mask),
+                        _mm512_maskz_slli_epi64(AVX512_ALL8, odd, 32));
+}
+
+AVX512_TARGET
+static void philox_avx512(unsigned int *c0, unsigned int *c1,
+                          unsigned int *c2, unsigned int *c3,
+                          const unsigned int key[2], unsigned int n) {
+   const __m512i m0 = _mm512_set1_epi32((int)PHILOX_M0);
+   const __m512i m1 = _mm512_set1_epi32((int)PHILOX_M1);
+   unsigned int i, round;
+
+   for(i=0; i+16<=n; i+=16){
+      __m512i v0 = _mm512_loadu_si512(c0+i);
+      __m512i v1 = _mm512_loadu_si512(c1+i);
+      __m512i v2 = _mm512_loadu_si512(c2+i);
+      __m512i v3 = _mm512_loadu_si512(c3+i);
+      unsigned int k0 = key[0];
+      unsigned int k1 = key[1];
+      for(round=0; round<10; round++){
+         __m512i hi0, lo0, hi1, lo1;
+         mulhilo_avx512(v0, m0, hi0, lo0);
+         mulhilo_avx512(v2, m1, hi1, lo1);
+         v0 = _mm512_xor_si512(_mm512_xor_si512(hi1, v1),
+                               _mm512_set1_epi32((int)k0));
+         v1 = lo1;
+         v2 = _mm512_xor_si512(_mm512_xor_si512(hi0, v3),
+                               _mm512_set1_epi32((int)k1));
+         v3 = lo0;
+         k0 += PHILOX_W0;
+         k1 += PHILOX_W1;
+      }
+      _mm512_storeu_si512(c0+i, v0);
+      _mm512_storeu_si512(c1+i, v1);
+      _mm512_storeu_si512(c2+i, v2);
+      _mm512_storeu_si512(c3+i, v3);
+   }
+   philox_c(c0+i, c1+i, c2+i, c3+i, key, n-i);
+}
+
+AVX512_TARGET
+static inline __m512d u64_to_pd_avx512(__m512i v) {
+   const __m512i magic = _mm512_set1_epi64(0x4330000000000000LL);
+   return _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(v, magic)),
+                        _mm512_set1_pd(4503599627370496.0));
+}
+
+AVX512_TARGET
+static inline __m512d uniform_avx512(const unsigned int *hi,
+                                     const unsigned int *lo) {
+   __m512i h = _mm512_maskz_cvtepu32_epi64(AVX512_ALL8,
+                  _mm256_loadu_si256((const __m256i *)hi));
+   __m512i l = _mm512_maskz_cvtepu32_epi64(AVX512_ALL8,
+                  _mm256_loadu_si256((const __m256i *)lo));
+   h = _mm512_maskz_srli_epi64(AVX512_ALL8, h, 5);
+   l = _mm512_maskz_srli_epi64(AVX512_ALL8, l, 6);
+   __m512d bits = _mm512_add_pd(_mm512_mul_pd(u64_to_pd_avx512(h),
+                                              _mm512_set1_pd(67108864.0)),
+                                u64_to_pd_avx512(l));
+   return _mm512_mul_pd(_mm512_add_pd(bits, _mm512_set1_pd(0.5)),
+                        _mm512_set1_pd(1.0 / 9007199254740992.0));
+}
+
+AVX512_TARGET
+static inline __m512d log_unit_avx512(__m512d u) {
+   __m512i bits = _mm512_castpd_si512(u);
+   __m512d e    = _mm512_sub_pd(u64_to_pd_avx512(
+                     _mm512_maskz_srli_epi64(AVX512_ALL8, bits, 52)),
+                                _mm512_set1_pd(1023.0));
+   __m512d m    = _mm512_castsi512_pd(_mm512_or_si512(
+                     _mm512_and_si512(bits,
+                                      _mm512_set1_epi64(0x000FFFFFFFFFFFFFLL)),
+                     _mm512_set1_epi64(0x3FF0000000000000LL)));
+   __mmask8 big = _mm512_cmp_pd_mask(m, _mm512_set1_pd(M_SQRT2), _CMP_GT_OQ);
+   m = _mm512_mask_mul_pd(m, big, m, _mm512_set1_pd(0.5));
+   e = _mm512_mask_add_pd(e, big, e, _mm512_set1_pd(1.0));
+
+   __m512d f = _mm512_div_pd(_mm512_sub_pd(m, _mm512_set1_pd(1.0)),
+                             _mm512_add_pd(m, _mm512_set1_pd(1.0)));
+   __m512d s = _mm512_mul_pd(f, f);
+   __m512d q = _mm512_set1_pd(LOG_C11);
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C10));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C9));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C8));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C7));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C6));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C5));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C4));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C3));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C2));
+   q = _mm512_add_pd(_mm512_mul_pd(q, s), _mm512_set1_pd(LOG_C1));
+   return _mm512_add_pd(_mm512_mul_pd(e, _mm512_set1_pd(M_LN2)),
+                        _mm512_add_pd(_mm512_mul_pd(f, _mm512_set1_pd(2.0)),
+                                      _mm512_mul_pd(_mm512_mul_pd(f, s), q)));
+}
+
+AVX512_TARGET
+static inline void sincos_turn_avx512(__m512d v, __m512d& cos_v,
+                                      __m512d& sin_v) {
+   const __m512i one  = _mm512_set1_epi64(1);
+   const __m512i two  = _mm512_set1_epi64(2);
+   __m512d y  = _mm512_mul_pd(v, _mm512_set1_pd(4.0));
+   __m256i q  = _mm512_maskz_cvttpd_epi32(AVX512_ALL8,
+                   _mm512_add_pd(y, _mm512_set1_pd(0.5)));
+   __m512d x  = _mm512_mul_pd(_mm512_sub_pd(y,
+                   _mm512_maskz_cvtepi32_pd(AVX512_ALL8, q)),
+                              _mm512_set1_pd(M_PI_2));
+   __m512d z  = _mm512_mul_pd(x, x);
+
+   __m512d sp = _mm512_set1_pd(SIN_C8);
+   sp = _mm512_add_pd(_mm512_mul_pd(sp, z), _mm512_set1_pd(SIN_C7));
+   sp = _mm512_add_pd(_mm512_mul_pd(sp, z), _mm512_set1_pd(SIN_C6));
+   sp = _mm512_add_pd(_mm512_mul_pd(sp, z), _mm512_set1_pd(SIN_C5));
+   sp = _mm512_add_pd(_mm512_mul_pd(sp, z), _mm512_set1_pd(SIN_C4));
+   sp = _mm512_add_pd(_mm512_mul_pd(sp, z), _mm512_set1_pd(SIN_C3));
+   sp = _mm512_add_pd(_mm512_mul_pd(sp, z), _mm512_set1_pd(SIN_C2));
+   sp = _mm512_add_pd(_mm512_mul_pd(sp, z), _mm512_set1_pd(SIN_C1));
+   __m512d sn = _mm512_add_pd(x, _mm512_mul_pd(_mm512_mul_pd(x, z), sp));
+
+   __m512d cp = _mm512_set1_pd(COS_C8);
+   cp = _mm512_add_pd(_mm512_mul_pd(cp, z), _mm512_set1_pd(COS_C7));
+   cp = _mm512_add_pd(_mm512_mul_pd(cp, z), _mm512_set1_pd(COS_C6));
+   cp = _mm512_add_pd(_mm512_mul_pd(cp, z), _mm512_set1_pd(COS_C5));
+   cp = _mm512_add_pd(_mm512_mul_pd(cp, z), _mm512_set1_pd(COS_C4));
+   cp = _mm512_add_pd(_mm512_mul_pd(cp, z), _mm512_set1_pd(COS_C3));
+   cp = _mm512_add_pd(_mm512_mul_pd(cp, z), _mm512_set1_pd(COS_C2));
+   __m512d cn = _mm512_add_pd(_mm512_sub_pd(_mm512_set1_pd(1.0),
+                                            _mm512_mul_pd(z,
+                                               _mm512_set1_pd(0.5))),
+                              _mm512_mul_pd(_mm512_mul_pd(z, z), cp));
+
+   __m512i  q64   = _mm512_maskz_cvtepi32_epi64(AVX512_ALL8, q);
+   __mmask8 swap  = _mm512_test_epi64_mask(q64, one);
+   __m512i  csign = _mm512_maskz_slli_epi64(AVX512_ALL8,
+                       _mm512_and_si512(_mm512_add_epi64(q64, one), two), 62);
+   __m512i  ssign = _mm512_maskz_slli_epi64(AVX512_ALL8,
+                       _mm512_and_si512(q64, two), 62);
+   cos_v = _mm512_castsi512_pd(_mm512_xor_si512(
+              _mm512_castpd_si512(_mm512_mask_blend_pd(swap, cn, sn)), csign));
+   sin_v = _mm512_castsi512_pd(_mm512_xor_si512(
+              _mm512_castpd_si512(_mm512_mask_blend_pd(swap, sn, cn)), ssign));
+}
+
+AVX512_TARGET
+static void box_muller_avx512(const unsigned int *c0, const unsigned int *c1,
+                              const unsigned int *c2, const unsigned int *c3,
+                              double *n1, double *n2, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      __m512d r = _mm512_maskz_sqrt_pd(AVX512_ALL8,
+                     _mm512_mul_pd(_mm512_set1_pd(-2.0),
+                                   log_unit_avx512(uniform_avx512(c0+i,
+                                                                  c1+i))));
+      __m512d cos_t, sin_t;
+      sincos_turn_avx512(uniform_avx512(c2+i, c3+i), cos_t, sin_t);
+      _mm512_storeu_pd(n1+i, _mm512_mul_pd(r, cos_t));
+      _mm512_storeu_pd(n2+i, _mm512_mul_pd(r, sin_t));
+   }
+   box_muller_c(c0+i, c1+i, c2+i, c3+i, n1+i, n2+i, n-i);
+}
+
+#endif // MRI_RANDOM_X86
+
+//---------------------------------------------------------------------------
+// MRI_Random constructor
+//---------------------------------------------------------------------------
+
+MRI_Random::MRI_Random(unsigned long long key) {
+   set_key(key);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Random::gaussian_fill
+// Fills out with the normal pairs of n consecutive counters, a block of
+// counters at a time: the Philox rounds are applied to the whole block,
+// then the Box-Muller transform, both with the widest kernels the
+// processor supports.  The logarithm, sine and cosine are evaluated by
+// polynomials rather than the C library, so that every instruction set
+// gives the same values.
+//---------------------------------------------------------------------------
+
+void MRI_Random::gaussian_fill(const unsigned int counter[4], unsigned int n,
+                               double out[]) const {
+   unsigned int c0[RANDOM_BLOCK], c1[RANDOM_BLOCK];
+   unsigned int c2[RANDOM_BLOCK], c3[RANDOM_BLOCK];
+   double n1[RANDOM_BLOCK], n2[RANDOM_BLOCK];
+   unsigned int start, count, i;
+
+   void (*philox)(unsigned int *, unsigned int *, unsigned int *,
+                  unsigned int *, const unsigned int *, unsigned int);
+   void (*box_muller)(const unsigned int *, const unsigned int *,
+                      const unsigned int *, const unsigned int *,
+                      double *, double *, unsigned int);
+
+   philox     = philox_c;
+   box_muller = box_muller_c;
+#ifdef MRI_RANDOM_X86
+   switch(MRI_SIMD::get_level()){
+      case MRI_SIMD::AVX512:
+         philox     = philox_avx512;
+         box_muller = box_muller_avx512;
+         break;
+      case MRI_SIMD::AVX2:
+         philox     = philox_avx2;
+         box_muller = box_muller_avx2;
+         break;
+      case MRI_SIMD::SSE2:
+         philox     = philox_sse2;
+         box_muller = box_muller_sse2;
+         break;
+      default:
+         break;
+   }
+#endif
+
+   for(start=0; start<n; start+=RANDOM_BLOCK){
+      count = (n-start < RANDOM_BLOCK) ? n-start : RANDOM_BLOCK;
+
+      for(i=0; i<count; i++){
+         c0[i] = counter[0] + start + i;
+         c1[i] = counter[1];
+         c2[i] = counter[2];
+         c3[i] = counter[3];
+      }
+
+      philox(c0, c1, c2, c3, _key, count);
+      box_muller(c0, c1, c2, c3, n1, n2, count);
+
+      for(i=0; i<count; i++){
+         out[2*(start+i)]   = n1[i];
+         out[2*(start+i)+1] = n2[i];
+      }
+   }
+}
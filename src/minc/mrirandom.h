@@ -0,0 +1,139 @@
+#ifndef __MRIRANDOM_H
+#define __MRIRANDOM_H
+
+//===========================================================================
+// MRIRANDOM.H
+// Counter-based random number generation.
+// Inherits from:
+// Base class to:
+//===========================================================================
+
+// Philox4x32 round multipliers and key increments
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+//---------------------------------------------------------------------------
+// MRI_Random class
+// Philox4x32-10 counter-based random number generator (Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3", SC11).  Each 128-bit
+// counter is mapped to four independent random words by a keyed
+// bijection, so there is no generator state: any number in the sequence
+// can be computed directly, in any order and from any thread, and always
+// gives the same value for the same key and counter.
+//---------------------------------------------------------------------------
+
+class MRI_Random {
+   public:
+      MRI_Random(unsigned long long key = 0);
+
+      inline void set_key(unsigned long long key);
+
+      // --- Random words for one counter --- //
+      inline void block(const unsigned int counter[4],
+                        unsigned int out[4]) const;
+
+      // --- Distributions --- //
+      // uniform: (0,1) from two words with 53 bit resolution
+      // gaussian_pair: two independent zero mean, unit variance normals
+      static inline double uniform(unsigned int hi, unsigned int lo);
+      inline void gaussian_pair(const unsigned int counter[4],
+                                double& n1, double& n2) const;
+
+      // --- Batches --- //
+      // gaussian_fill: the normal pairs of n consecutive counters,
+      // starting at counter and stepping counter[0], interleaved in out[2n]
+      void gaussian_fill(const unsigned int counter[4], unsigned int n,
+                         double out[]) const;
+
+   private:
+      unsigned int _key[2];
+
+      static inline void _round(unsigned int ctr[4],
+                                const unsigned int key[2]);
+};
+
+//---------------------------------------------------------------------------
+// Inline member functions
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// MRI_Random::set_key
+// Sets the 64-bit key, normally derived from the random seed.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Random::set_key(unsigned long long key) {
+   _key[0] = (unsigned int)(key & 0xFFFFFFFFULL);
+   _key[1] = (unsigned int)(key >> 32);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Random::_round
+// One Philox4x32 round.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Random::_round(unsigned int ctr[4], const unsigned int key[2]) {
+   const unsigned long long p0 = (unsigned long long)PHILOX_M0 * ctr[0];
+   const unsigned long long p1 = (unsigned long long)PHILOX_M1 * ctr[2];
+
+   const unsigned int hi0 = (unsigned int)(p0 >> 32);
+   const unsigned int lo0 = (unsigned int)p0;
+   const unsigned int hi1 = (unsigned int)(p1 >> 32);
+   const unsigned int lo1 = (unsigned int)p1;
+
+   ctr[0] = hi1 ^ ctr[1] ^ key[0];
+   ctr[1] = lo1;
+   ctr[2] = hi0 ^ ctr[3] ^ key[1];
+   ctr[3] = lo0;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Random::block
+// Returns the four random words for a counter value.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Random::block(const unsigned int counter[4],
+                       unsigned int out[4]) const {
+   unsigned int key[2] = {_key[0], _key[1]};
+   int i;
+
+   for (i=0; i<4; i++) out[i] = counter[i];
+   for (i=0; i<10; i++){
+      _round(out, key);
+      key[0] += PHILOX_W0;
+      key[1] += PHILOX_W1;
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_Random::uniform
+// Converts two random words to a double uniform on (0,1).
+//---------------------------------------------------------------------------
+
+inline
+double MRI_Random::uniform(unsigned int hi, unsigned int lo) {
+   const double bits = (double)(hi >> 5) * 67108864.0 + (double)(lo >> 6);
+   return (bits + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Random::gaussian_pair
+// Returns two independent unit normals for a counter value, by the
+// Box-Muller transform of the counter's two uniforms.  Unlike the polar
+// method, each counter gives exactly one pair.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Random::gaussian_pair(const unsigned int counter[4],
+                               double& n1, double& n2) const {
+   double pair[2];
+   gaussian_fill(counter, 1, pair);
+   n1 = pair[0];
+   n2 = pair[1];
+}
+
+#endif
@@ -0,0 +1,1115 @@
+//===========================================================================
+// MRISIMD.CXX
+// Vectorized element-wise kernels for the MRI matrix classes.
+//
+// Kernels for each instruction set are compiled with the GCC target
+// attribute, so the whole file is built for the baseline processor and
+// the faster kernels are only called where they are supported.
+//===========================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "mrisimd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MRI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+//---------------------------------------------------------------------------
+// Static members
+//---------------------------------------------------------------------------
+
+const MRI_SIMD::Kernels *MRI_SIMD::_kernels = 0;
+MRI_SIMD::Level          MRI_SIMD::_level   = MRI_SIMD::NONE;
+
+//===========================================================================
+// Scalar kernels
+// These are the loops formerly in mrimatrix.cxx, and also finish the
+// elements left over by the vector kernels.
+//===========================================================================
+
+static void scale_f_c(float *x, double a, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] *= a;
+}
+
+static void mul_f_c(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] *= y[i];
+}
+
+static void div_f_c(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] /= y[i];
+}
+
+static void add_f_c(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] += y[i];
+}
+
+static void saxpy_f_c(float *z, double a, const float *x, const float *y,
+                      unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) z[i] = a * x[i] + y[i];
+}
+
+static void scale_d_c(double *x, double a, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] *= a;
+}
+
+static void mul_d_c(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] *= y[i];
+}
+
+static void div_d_c(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] /= y[i];
+}
+
+static void add_d_c(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] += y[i];
+}
+
+static void saxpy_d_c(double *z, double a, const double *x, const double *y,
+                      unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) z[i] = a * x[i] + y[i];
+}
+
+static void real_mul_cf_c(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++){
+      x[2*i]   *= y[i];
+      x[2*i+1] *= y[i];
+   }
+}
+
+static void real_div_cf_c(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++){
+      x[2*i]   /= y[i];
+      x[2*i+1] /= y[i];
+   }
+}
+
+static void complex_mul_cf_c(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   float re, im;
+   for(i=0; i<2*n; i+=2){
+      re = x[i]*y[i]   - x[i+1]*y[i+1];
+      im = x[i]*y[i+1] + x[i+1]*y[i];
+      x[i]   = re;
+      x[i+1] = im;
+   }
+}
+
+static void complex_saxpy_cf_c(float *z, double ar, double ai,
+                               const float *x, const float *y,
+                               unsigned int n) {
+   unsigned int i;
+   double re, im;
+   for(i=0; i<2*n; i+=2){
+      re = ar*x[i]   - ai*x[i+1] + y[i];
+      im = ar*x[i+1] + ai*x[i]   + y[i+1];
+      z[i]   = (float)re;
+      z[i+1] = (float)im;
+   }
+}
+
+static void real_mul_cd_c(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++){
+      x[2*i]   *= y[i];
+      x[2*i+1] *= y[i];
+   }
+}
+
+static void real_div_cd_c(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++){
+      x[2*i]   /= y[i];
+      x[2*i+1] /= y[i];
+   }
+}
+
+static void complex_mul_cd_c(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   double re, im;
+   for(i=0; i<2*n; i+=2){
+      re = x[i]*y[i]   - x[i+1]*y[i+1];
+      im = x[i]*y[i+1] + x[i+1]*y[i];
+      x[i]   = re;
+      x[i+1] = im;
+   }
+}
+
+static void complex_saxpy_cd_c(double *z, double ar, double ai,
+                               const double *x, const double *y,
+                               unsigned int n) {
+   unsigned int i;
+   double re, im;
+   for(i=0; i<2*n; i+=2){
+      re = ar*x[i]   - ai*x[i+1] + y[i];
+      im = ar*x[i+1] + ai*x[i]   + y[i+1];
+      z[i]   = re;
+      z[i+1] = im;
+   }
+}
+
+static void lerp_d_c(double *out, const double *t, const unsigned int *k,
+                     const double *w, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) out[i] = t[k[i]] + (t[k[i]+1] - t[k[i]])*w[i];
+}
+
+static void add_scaled_fd_c(float *x, double a, const double *y,
+                            unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++) x[i] += a*y[i];
+}
+
+static const MRI_SIMD::Kernels scalar_kernels = {
+   "none",
+   scale_f_c, mul_f_c, div_f_c, add_f_c, saxpy_f_c,
+   scale_d_c, mul_d_c, div_d_c, add_d_c, saxpy_d_c,
+   real_mul_cf_c, real_div_cf_c, complex_mul_cf_c, complex_saxpy_cf_c,
+   real_mul_cd_c, real_div_cd_c, complex_mul_cd_c, complex_saxpy_cd_c,
+   lerp_d_c, add_scaled_fd_c
+};
+
+#ifdef MRI_SIMD_X86
+
+//===========================================================================
+// SSE2 kernels
+// Two doubles or four floats per register.  Complex products are formed
+// as x*re(y) + swap(x)*im(y) with the sign of the real part's second
+// term flipped, which rounds exactly as the scalar a*c - b*d.
+//===========================================================================
+
+#define SSE2_TARGET \
+   __attribute__((target("sse2"), optimize("fp-contract=off")))
+
+SSE2_TARGET
+static void scale_f_sse2(float *x, double a, unsigned int n) {
+   __m128d va = _mm_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m128  v  = _mm_loadu_ps(x+i);
+      __m128d lo = _mm_mul_pd(_mm_cvtps_pd(v), va);
+      __m128d hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), va);
+      _mm_storeu_ps(x+i, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+   }
+   scale_f_c(x+i, a, n-i);
+}
+
+SSE2_TARGET
+static void mul_f_sse2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm_storeu_ps(x+i, _mm_mul_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i)));
+   }
+   mul_f_c(x+i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void div_f_sse2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm_storeu_ps(x+i, _mm_div_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i)));
+   }
+   div_f_c(x+i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void add_f_sse2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm_storeu_ps(x+i, _mm_add_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i)));
+   }
+   add_f_c(x+i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void saxpy_f_sse2(float *z, double a, const float *x, const float *y,
+                         unsigned int n) {
+   __m128d va = _mm_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m128  vx = _mm_loadu_ps(x+i);
+      __m128  vy = _mm_loadu_ps(y+i);
+      __m128d lo = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(vx), va),
+                              _mm_cvtps_pd(vy));
+      __m128d hi = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(vx,vx)),
+                                         va),
+                              _mm_cvtps_pd(_mm_movehl_ps(vy,vy)));
+      _mm_storeu_ps(z+i, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+   }
+   saxpy_f_c(z+i, a, x+i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void scale_d_sse2(double *x, double a, unsigned int n) {
+   __m128d va = _mm_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      _mm_storeu_pd(x+i, _mm_mul_pd(_mm_loadu_pd(x+i), va));
+   }
+   scale_d_c(x+i, a, n-i);
+}
+
+SSE2_TARGET
+static void mul_d_sse2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      _mm_storeu_pd(x+i, _mm_mul_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+   }
+   mul_d_c(x+i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void div_d_sse2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      _mm_storeu_pd(x+i, _mm_div_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+   }
+   div_d_c(x+i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void add_d_sse2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      _mm_storeu_pd(x+i, _mm_add_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+   }
+   add_d_c(x+i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void saxpy_d_sse2(double *z, double a, const double *x,
+                         const double *y, unsigned int n) {
+   __m128d va = _mm_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      _mm_storeu_pd(z+i, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(x+i), va),
+                                    _mm_loadu_pd(y+i)));
+   }
+   saxpy_d_c(z+i, a, x+i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void real_mul_cf_sse2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m128 vy = _mm_loadu_ps(y+i);
+      _mm_storeu_ps(x+2*i,   _mm_mul_ps(_mm_loadu_ps(x+2*i),
+                                        _mm_unpacklo_ps(vy, vy)));
+      _mm_storeu_ps(x+2*i+4, _mm_mul_ps(_mm_loadu_ps(x+2*i+4),
+                                        _mm_unpackhi_ps(vy, vy)));
+   }
+   real_mul_cf_c(x+2*i, y+i, n-i);
+}
+
+SSE2_TARGET
+static void real_div_cf_sse2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m128 vy = _mm_loadu_ps(y+i);
+      _mm_storeu_ps(x+2*i,   _mm_div_ps(_mm_loadu_ps(x+2*i),
+                                        _mm_unpacklo_ps(vy, vy)));
+      _mm_storeu_ps(x+2*i+4, _mm_div_ps(_mm_loadu_ps(x+2*i+4),
+                                        _mm_unpackhi_ps(vy, vy)));
+   }
+   real_div_cf_c(x+2*i, y+i, n-i);
+}
+
+// One complex double: x*y with the real part negated in the second term.
+SSE2_TARGET
+static inline __m128d cmul_sse2(__m128d vx, __m128d vy, __m128d sign) {
+   __m128d p = _mm_mul_pd(vx, _mm_unpacklo_pd(vy, vy));
+   __m128d q = _mm_mul_pd(_mm_shuffle_pd(vx, vx, 1),
+                          _mm_unpackhi_pd(vy, vy));
+   return _mm_add_pd(p, _mm_xor_pd(q, sign));
+}
+
+SSE2_TARGET
+static inline __m128d load_cf_sse2(const float *x) {
+   return _mm_cvtps_pd(_mm_castsi128_ps(
+                          _mm_loadl_epi64((const __m128i *)x)));
+}
+
+SSE2_TARGET
+static inline void store_cf_sse2(float *x, __m128d v) {
+   _mm_storel_epi64((__m128i *)x, _mm_castps_si128(_mm_cvtpd_ps(v)));
+}
+
+SSE2_TARGET
+static void complex_mul_cf_sse2(float *x, const float *y, unsigned int n) {
+   __m128 sign = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      __m128 vx = _mm_loadu_ps(x+2*i);
+      __m128 vy = _mm_loadu_ps(y+2*i);
+      __m128 p  = _mm_mul_ps(vx, _mm_shuffle_ps(vy, vy, 0xA0));
+      __m128 q  = _mm_mul_ps(_mm_shuffle_ps(vx, vx, 0xB1),
+                             _mm_shuffle_ps(vy, vy, 0xF5));
+      _mm_storeu_ps(x+2*i, _mm_add_ps(p, _mm_xor_ps(q, sign)));
+   }
+   complex_mul_cf_c(x+2*i, y+2*i, n-i);
+}
+
+SSE2_TARGET
+static void complex_saxpy_cf_sse2(float *z, double ar, double ai,
+                                  const float *x, const float *y,
+                                  unsigned int n) {
+   __m128d va   = _mm_set_pd(ai, ar);
+   __m128d sign = _mm_set_pd(0.0, -0.0);
+   unsigned int i;
+   for(i=0; i<n; i++){
+      __m128d v = cmul_sse2(load_cf_sse2(x+2*i), va, sign);
+      store_cf_sse2(z+2*i, _mm_add_pd(v, load_cf_sse2(y+2*i)));
+   }
+}
+
+SSE2_TARGET
+static void real_mul_cd_sse2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++){
+      _mm_storeu_pd(x+2*i, _mm_mul_pd(_mm_loadu_pd(x+2*i),
+                                      _mm_set1_pd(y[i])));
+   }
+}
+
+SSE2_TARGET
+static void real_div_cd_sse2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i<n; i++){
+      _mm_storeu_pd(x+2*i, _mm_div_pd(_mm_loadu_pd(x+2*i),
+                                      _mm_set1_pd(y[i])));
+   }
+}
+
+SSE2_TARGET
+static void complex_mul_cd_sse2(double *x, const double *y, unsigned int n) {
+   __m128d sign = _mm_set_pd(0.0, -0.0);
+   unsigned int i;
+   for(i=0; i<n; i++){
+      _mm_storeu_pd(x+2*i, cmul_sse2(_mm_loadu_pd(x+2*i),
+                                     _mm_loadu_pd(y+2*i), sign));
+   }
+}
+
+SSE2_TARGET
+static void complex_saxpy_cd_sse2(double *z, double ar, double ai,
+                                  const double *x, const double *y,
+                                  unsigned int n) {
+   __m128d va   = _mm_set_pd(ai, ar);
+   __m128d sign = _mm_set_pd(0.0, -0.0);
+   unsigned int i;
+   for(i=0; i<n; i++){
+      __m128d v = cmul_sse2(_mm_loadu_pd(x+2*i), va, sign);
+      _mm_storeu_pd(z+2*i, _mm_add_pd(v, _mm_loadu_pd(y+2*i)));
+   }
+}
+
+// SSE2 has no gather; pairs of table entries are loaded separately.
+SSE2_TARGET
+static void lerp_d_sse2(double *out, const double *t, const unsigned int *k,
+                        const double *w, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      __m128d t0 = _mm_loadh_pd(_mm_load_sd(t+k[i]),   t+k[i+1]);
+      __m128d t1 = _mm_loadh_pd(_mm_load_sd(t+k[i]+1), t+k[i+1]+1);
+      __m128d v  = _mm_add_pd(t0, _mm_mul_pd(_mm_sub_pd(t1, t0),
+                                             _mm_loadu_pd(w+i)));
+      _mm_storeu_pd(out+i, v);
+   }
+   lerp_d_c(out+i, t, k+i, w+i, n-i);
+}
+
+SSE2_TARGET
+static void add_scaled_fd_sse2(float *x, double a, const double *y,
+                               unsigned int n) {
+   __m128d va = _mm_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m128  v  = _mm_loadu_ps(x+i);
+      __m128d lo = _mm_add_pd(_mm_cvtps_pd(v),
+                              _mm_mul_pd(_mm_loadu_pd(y+i), va));
+      __m128d hi = _mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)),
+                              _mm_mul_pd(_mm_loadu_pd(y+i+2), va));
+      _mm_storeu_ps(x+i, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+   }
+   add_scaled_fd_c(x+i, a, y+i, n-i);
+}
+
+static const MRI_SIMD::Kernels sse2_kernels = {
+   "sse2",
+   scale_f_sse2, mul_f_sse2, div_f_sse2, add_f_sse2, saxpy_f_sse2,
+   scale_d_sse2, mul_d_sse2, div_d_sse2, add_d_sse2, saxpy_d_sse2,
+   real_mul_cf_sse2, real_div_cf_sse2, complex_mul_cf_sse2,
+   complex_saxpy_cf_sse2,
+   real_mul_cd_sse2, real_div_cd_sse2, complex_mul_cd_sse2,
+   complex_saxpy_cd_sse2,
+   lerp_d_sse2, add_scaled_fd_sse2
+};
+
+//===========================================================================
+// AVX2 kernels
+// Four doubles or eight floats per register.  The compiler must not fuse
+// multiplies and adds, which would round differently from the scalar code.
+//===========================================================================
+
+#define AVX2_TARGET \
+   __attribute__((target("avx2"), optimize("fp-contract=off")))
+
+AVX2_TARGET
+static void scale_f_avx2(float *x, double a, unsigned int n) {
+   __m256d va = _mm256_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m256d v = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i)), va);
+      _mm_storeu_ps(x+i, _mm256_cvtpd_ps(v));
+   }
+   scale_f_c(x+i, a, n-i);
+}
+
+AVX2_TARGET
+static void mul_f_avx2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm256_storeu_ps(x+i, _mm256_mul_ps(_mm256_loadu_ps(x+i),
+                                          _mm256_loadu_ps(y+i)));
+   }
+   mul_f_c(x+i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void div_f_avx2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm256_storeu_ps(x+i, _mm256_div_ps(_mm256_loadu_ps(x+i),
+                                          _mm256_loadu_ps(y+i)));
+   }
+   div_f_c(x+i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void add_f_avx2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm256_storeu_ps(x+i, _mm256_add_ps(_mm256_loadu_ps(x+i),
+                                          _mm256_loadu_ps(y+i)));
+   }
+   add_f_c(x+i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void saxpy_f_avx2(float *z, double a, const float *x, const float *y,
+                         unsigned int n) {
+   __m256d va = _mm256_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m256d v = _mm256_add_pd(
+                     _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i)), va),
+                     _mm256_cvtps_pd(_mm_loadu_ps(y+i)));
+      _mm_storeu_ps(z+i, _mm256_cvtpd_ps(v));
+   }
+   saxpy_f_c(z+i, a, x+i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void scale_d_avx2(double *x, double a, unsigned int n) {
+   __m256d va = _mm256_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm256_storeu_pd(x+i, _mm256_mul_pd(_mm256_loadu_pd(x+i), va));
+   }
+   scale_d_c(x+i, a, n-i);
+}
+
+AVX2_TARGET
+static void mul_d_avx2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm256_storeu_pd(x+i, _mm256_mul_pd(_mm256_loadu_pd(x+i),
+                                          _mm256_loadu_pd(y+i)));
+   }
+   mul_d_c(x+i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void div_d_avx2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm256_storeu_pd(x+i, _mm256_div_pd(_mm256_loadu_pd(x+i),
+                                          _mm256_loadu_pd(y+i)));
+   }
+   div_d_c(x+i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void add_d_avx2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm256_storeu_pd(x+i, _mm256_add_pd(_mm256_loadu_pd(x+i),
+                                          _mm256_loadu_pd(y+i)));
+   }
+   add_d_c(x+i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void saxpy_d_avx2(double *z, double a, const double *x,
+                         const double *y, unsigned int n) {
+   __m256d va = _mm256_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm256_storeu_pd(z+i, _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(x+i),
+                                                        va),
+                                          _mm256_loadu_pd(y+i)));
+   }
+   saxpy_d_c(z+i, a, x+i, y+i, n-i);
+}
+
+// Four real floats, each repeated for the real and imaginary parts.
+AVX2_TARGET
+static inline __m256 dup_f_avx2(const float *y) {
+   __m128 vy = _mm_loadu_ps(y);
+   return _mm256_insertf128_ps(
+             _mm256_castps128_ps256(_mm_unpacklo_ps(vy, vy)),
+             _mm_unpackhi_ps(vy, vy), 1);
+}
+
+AVX2_TARGET
+static void real_mul_cf_avx2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm256_storeu_ps(x+2*i, _mm256_mul_ps(_mm256_loadu_ps(x+2*i),
+                                            dup_f_avx2(y+i)));
+   }
+   real_mul_cf_c(x+2*i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void real_div_cf_avx2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm256_storeu_ps(x+2*i, _mm256_div_ps(_mm256_loadu_ps(x+2*i),
+                                            dup_f_avx2(y+i)));
+   }
+   real_div_cf_c(x+2*i, y+i, n-i);
+}
+
+// Two complex doubles.
+AVX2_TARGET
+static inline __m256d cmul_avx2(__m256d vx, __m256d vy) {
+   __m256d p = _mm256_mul_pd(vx, _mm256_movedup_pd(vy));
+   __m256d q = _mm256_mul_pd(_mm256_permute_pd(vx, 0x5),
+                             _mm256_permute_pd(vy, 0xF));
+   return _mm256_addsub_pd(p, q);
+}
+
+AVX2_TARGET
+static void complex_mul_cf_avx2(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m256 vx = _mm256_loadu_ps(x+2*i);
+      __m256 vy = _mm256_loadu_ps(y+2*i);
+      __m256 p  = _mm256_mul_ps(vx, _mm256_moveldup_ps(vy));
+      __m256 q  = _mm256_mul_ps(_mm256_permute_ps(vx, 0xB1),
+                                _mm256_movehdup_ps(vy));
+      _mm256_storeu_ps(x+2*i, _mm256_addsub_ps(p, q));
+   }
+   complex_mul_cf_c(x+2*i, y+2*i, n-i);
+}
+
+AVX2_TARGET
+static void complex_saxpy_cf_avx2(float *z, double ar, double ai,
+                                  const float *x, const float *y,
+                                  unsigned int n) {
+   __m256d va = _mm256_set_pd(ai, ar, ai, ar);
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      __m256d v = cmul_avx2(_mm256_cvtps_pd(_mm_loadu_ps(x+2*i)), va);
+      v = _mm256_add_pd(v, _mm256_cvtps_pd(_mm_loadu_ps(y+2*i)));
+      _mm_storeu_ps(z+2*i, _mm256_cvtpd_ps(v));
+   }
+   complex_saxpy_cf_c(z+2*i, ar, ai, x+2*i, y+2*i, n-i);
+}
+
+AVX2_TARGET
+static void real_mul_cd_avx2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      __m256d vy = _mm256_permute4x64_pd(
+                      _mm256_castpd128_pd256(_mm_loadu_pd(y+i)), 0x50);
+      _mm256_storeu_pd(x+2*i, _mm256_mul_pd(_mm256_loadu_pd(x+2*i), vy));
+   }
+   real_mul_cd_c(x+2*i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void real_div_cd_avx2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      __m256d vy = _mm256_permute4x64_pd(
+                      _mm256_castpd128_pd256(_mm_loadu_pd(y+i)), 0x50);
+      _mm256_storeu_pd(x+2*i, _mm256_div_pd(_mm256_loadu_pd(x+2*i), vy));
+   }
+   real_div_cd_c(x+2*i, y+i, n-i);
+}
+
+AVX2_TARGET
+static void complex_mul_cd_avx2(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      _mm256_storeu_pd(x+2*i, cmul_avx2(_mm256_loadu_pd(x+2*i),
+                                        _mm256_loadu_pd(y+2*i)));
+   }
+   complex_mul_cd_c(x+2*i, y+2*i, n-i);
+}
+
+AVX2_TARGET
+static void complex_saxpy_cd_avx2(double *z, double ar, double ai,
+                                  const double *x, const double *y,
+                                  unsigned int n) {
+   __m256d va = _mm256_set_pd(ai, ar, ai, ar);
+   unsigned int i;
+   for(i=0; i+2<=n; i+=2){
+      __m256d v = cmul_avx2(_mm256_loadu_pd(x+2*i), va);
+      _mm256_storeu_pd(z+2*i, _mm256_add_pd(v, _mm256_loadu_pd(y+2*i)));
+   }
+   complex_saxpy_cd_c(z+2*i, ar, ai, x+2*i, y+2*i, n-i);
+}
+
+AVX2_TARGET
+static void lerp_d_avx2(double *out, const double *t, const unsigned int *k,
+                        const double *w, unsigned int n) {
+   // Masked gathers of every lane from a zero source: GCC 12 warns that
+   // the undefined source of the unmasked form may be used uninitialized.
+   const __m256d all  = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+   const __m256d zero = _mm256_setzero_pd();
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m128i vk = _mm_loadu_si128((const __m128i *)(k+i));
+      __m256d t0 = _mm256_mask_i32gather_pd(zero, t,   vk, all, 8);
+      __m256d t1 = _mm256_mask_i32gather_pd(zero, t+1, vk, all, 8);
+      __m256d v  = _mm256_add_pd(t0, _mm256_mul_pd(_mm256_sub_pd(t1, t0),
+                                                   _mm256_loadu_pd(w+i)));
+      _mm256_storeu_pd(out+i, v);
+   }
+   lerp_d_c(out+i, t, k+i, w+i, n-i);
+}
+
+AVX2_TARGET
+static void add_scaled_fd_avx2(float *x, double a, const double *y,
+                               unsigned int n) {
+   __m256d va = _mm256_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m256d v = _mm256_add_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i)),
+                                _mm256_mul_pd(_mm256_loadu_pd(y+i), va));
+      _mm_storeu_ps(x+i, _mm256_cvtpd_ps(v));
+   }
+   add_scaled_fd_c(x+i, a, y+i, n-i);
+}
+
+static const MRI_SIMD::Kernels avx2_kernels = {
+   "avx2",
+   scale_f_avx2, mul_f_avx2, div_f_avx2, add_f_avx2, saxpy_f_avx2,
+   scale_d_avx2, mul_d_avx2, div_d_avx2, add_d_avx2, saxpy_d_avx2,
+   real_mul_cf_avx2, real_div_cf_avx2, complex_mul_cf_avx2,
+   complex_saxpy_cf_avx2,
+   real_mul_cd_avx2, real_div_cd_avx2, complex_mul_cd_avx2,
+   complex_saxpy_cd_avx2,
+   lerp_d_avx2, add_scaled_fd_avx2
+};
+
+//===========================================================================
+// AVX-512 kernels
+// Eight doubles or sixteen floats per register.  AVX-512F has no addsub,
+// so complex products subtract in the real lanes with a mask.
+//===========================================================================
+
+#define AVX512_TARGET \
+   __attribute__((target("avx512f"), optimize("fp-contract=off")))
+
+// GCC 12 leaves the pass-through operand of many unmasked AVX-512F
+// intrinsics undefined, and warns that it may be used uninitialized once
+// they are inlined into a kernel.  The kernels use the zero-masked forms
+// with every lane selected, which compute the same values and define
+// every operand.
+
+#define AVX512_ALL8  ((__mmask8)0xFF)
+#define AVX512_ALL16 ((__mmask16)0xFFFF)
+
+AVX512_TARGET
+static inline __m512d load_f_avx512(const float *x) {
+   return _mm512_maskz_cvtps_pd(AVX512_ALL8, _mm256_loadu_ps(x));
+}
+
+AVX512_TARGET
+static inline void store_f_avx512(float *x, __m512d v) {
+   _mm256_storeu_ps(x, _mm512_maskz_cvtpd_ps(AVX512_ALL8, v));
+}
+
+AVX512_TARGET
+static void scale_f_avx512(float *x, double a, unsigned int n) {
+   __m512d va = _mm512_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      store_f_avx512(x+i, _mm512_mul_pd(load_f_avx512(x+i), va));
+   }
+   scale_f_c(x+i, a, n-i);
+}
+
+AVX512_TARGET
+static void mul_f_avx512(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+16<=n; i+=16){
+      _mm512_storeu_ps(x+i, _mm512_mul_ps(_mm512_loadu_ps(x+i),
+                                          _mm512_loadu_ps(y+i)));
+   }
+   mul_f_c(x+i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void div_f_avx512(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+16<=n; i+=16){
+      _mm512_storeu_ps(x+i, _mm512_div_ps(_mm512_loadu_ps(x+i),
+                                          _mm512_loadu_ps(y+i)));
+   }
+   div_f_c(x+i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void add_f_avx512(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+16<=n; i+=16){
+      _mm512_storeu_ps(x+i, _mm512_add_ps(_mm512_loadu_ps(x+i),
+                                          _mm512_loadu_ps(y+i)));
+   }
+   add_f_c(x+i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void saxpy_f_avx512(float *z, double a, const float *x,
+                           const float *y, unsigned int n) {
+   __m512d va = _mm512_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      __m512d v = _mm512_add_pd(
+                     _mm512_mul_pd(load_f_avx512(x+i), va),
+                     load_f_avx512(y+i));
+      store_f_avx512(z+i, v);
+   }
+   saxpy_f_c(z+i, a, x+i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void scale_d_avx512(double *x, double a, unsigned int n) {
+   __m512d va = _mm512_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm512_storeu_pd(x+i, _mm512_mul_pd(_mm512_loadu_pd(x+i), va));
+   }
+   scale_d_c(x+i, a, n-i);
+}
+
+AVX512_TARGET
+static void mul_d_avx512(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm512_storeu_pd(x+i, _mm512_mul_pd(_mm512_loadu_pd(x+i),
+                                          _mm512_loadu_pd(y+i)));
+   }
+   mul_d_c(x+i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void div_d_avx512(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm512_storeu_pd(x+i, _mm512_div_pd(_mm512_loadu_pd(x+i),
+                                          _mm512_loadu_pd(y+i)));
+   }
+   div_d_c(x+i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void add_d_avx512(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm512_storeu_pd(x+i, _mm512_add_pd(_mm512_loadu_pd(x+i),
+                                          _mm512_loadu_pd(y+i)));
+   }
+   add_d_c(x+i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void saxpy_d_avx512(double *z, double a, const double *x,
+                           const double *y, unsigned int n) {
+   __m512d va = _mm512_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm512_storeu_pd(z+i, _mm512_add_pd(_mm512_mul_pd(_mm512_loadu_pd(x+i),
+                                                        va),
+                                          _mm512_loadu_pd(y+i)));
+   }
+   saxpy_d_c(z+i, a, x+i, y+i, n-i);
+}
+
+// Eight real floats, each repeated for the real and imaginary parts.
+AVX512_TARGET
+static inline __m512 dup_f_avx512(const float *y) {
+   const __m512i idx = _mm512_set_epi32(7,7,6,6,5,5,4,4,3,3,2,2,1,1,0,0);
+   return _mm512_maskz_permutexvar_ps(AVX512_ALL16, idx,
+                               _mm512_castps256_ps512(_mm256_loadu_ps(y)));
+}
+
+// Four real doubles, each repeated for the real and imaginary parts.
+AVX512_TARGET
+static inline __m512d dup_d_avx512(const double *y) {
+   const __m512i idx = _mm512_set_epi64(3,3,2,2,1,1,0,0);
+   return _mm512_maskz_permutexvar_pd(AVX512_ALL8, idx,
+                               _mm512_castpd256_pd512(_mm256_loadu_pd(y)));
+}
+
+AVX512_TARGET
+static void real_mul_cf_avx512(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm512_storeu_ps(x+2*i, _mm512_mul_ps(_mm512_loadu_ps(x+2*i),
+                                            dup_f_avx512(y+i)));
+   }
+   real_mul_cf_c(x+2*i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void real_div_cf_avx512(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      _mm512_storeu_ps(x+2*i, _mm512_div_ps(_mm512_loadu_ps(x+2*i),
+                                            dup_f_avx512(y+i)));
+   }
+   real_div_cf_c(x+2*i, y+i, n-i);
+}
+
+// Four complex doubles.
+AVX512_TARGET
+static inline __m512d cmul_avx512(__m512d vx, __m512d vy) {
+   __m512d p = _mm512_mul_pd(vx, _mm512_maskz_movedup_pd(AVX512_ALL8, vy));
+   __m512d q = _mm512_mul_pd(_mm512_maskz_permute_pd(AVX512_ALL8, vx, 0x55),
+                             _mm512_maskz_permute_pd(AVX512_ALL8, vy, 0xFF));
+   return _mm512_mask_sub_pd(_mm512_add_pd(p, q), 0x55, p, q);
+}
+
+AVX512_TARGET
+static void complex_mul_cf_avx512(float *x, const float *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      __m512 vx = _mm512_loadu_ps(x+2*i);
+      __m512 vy = _mm512_loadu_ps(y+2*i);
+      __m512 p  = _mm512_mul_ps(vx, _mm512_maskz_moveldup_ps(AVX512_ALL16,
+                                                             vy));
+      __m512 q  = _mm512_mul_ps(
+                     _mm512_maskz_permute_ps(AVX512_ALL16, vx, 0xB1),
+                     _mm512_maskz_movehdup_ps(AVX512_ALL16, vy));
+      _mm512_storeu_ps(x+2*i, _mm512_mask_sub_ps(_mm512_add_ps(p, q),
+                                                 0x5555, p, q));
+   }
+   complex_mul_cf_c(x+2*i, y+2*i, n-i);
+}
+
+AVX512_TARGET
+static void complex_saxpy_cf_avx512(float *z, double ar, double ai,
+                                    const float *x, const float *y,
+                                    unsigned int n) {
+   __m512d va = _mm512_set_pd(ai, ar, ai, ar, ai, ar, ai, ar);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m512d v = cmul_avx512(load_f_avx512(x+2*i), va);
+      v = _mm512_add_pd(v, load_f_avx512(y+2*i));
+      store_f_avx512(z+2*i, v);
+   }
+   complex_saxpy_cf_c(z+2*i, ar, ai, x+2*i, y+2*i, n-i);
+}
+
+AVX512_TARGET
+static void real_mul_cd_avx512(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm512_storeu_pd(x+2*i, _mm512_mul_pd(_mm512_loadu_pd(x+2*i),
+                                            dup_d_avx512(y+i)));
+   }
+   real_mul_cd_c(x+2*i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void real_div_cd_avx512(double *x, const double *y, unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm512_storeu_pd(x+2*i, _mm512_div_pd(_mm512_loadu_pd(x+2*i),
+                                            dup_d_avx512(y+i)));
+   }
+   real_div_cd_c(x+2*i, y+i, n-i);
+}
+
+AVX512_TARGET
+static void complex_mul_cd_avx512(double *x, const double *y,
+                                  unsigned int n) {
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      _mm512_storeu_pd(x+2*i, cmul_avx512(_mm512_loadu_pd(x+2*i),
+                                          _mm512_loadu_pd(y+2*i)));
+   }
+   complex_mul_cd_c(x+2*i, y+2*i, n-i);
+}
+
+AVX512_TARGET
+static void complex_saxpy_cd_avx512(double *z, double ar, double ai,
+                                    const double *x, const double *y,
+                                    unsigned int n) {
+   __m512d va = _mm512_set_pd(ai, ar, ai, ar, ai, ar, ai, ar);
+   unsigned int i;
+   for(i=0; i+4<=n; i+=4){
+      __m512d v = cmul_avx512(_mm512_loadu_pd(x+2*i), va);
+      _mm512_storeu_pd(z+2*i, _mm512_add_pd(v, _mm512_loadu_pd(y+2*i)));
+   }
+   complex_saxpy_cd_c(z+2*i, ar, ai, x+2*i, y+2*i, n-i);
+}
+
+AVX512_TARGET
+static void lerp_d_avx512(double *out, const double *t, const unsigned int *k,
+                          const double *w, unsigned int n) {
+   const __m512d zero = _mm512_setzero_pd();
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      __m256i vk = _mm256_loadu_si256((const __m256i *)(k+i));
+      __m512d t0 = _mm512_mask_i32gather_pd(zero, AVX512_ALL8, vk, t,   8);
+      __m512d t1 = _mm512_mask_i32gather_pd(zero, AVX512_ALL8, vk, t+1, 8);
+      __m512d v  = _mm512_add_pd(t0, _mm512_mul_pd(_mm512_sub_pd(t1, t0),
+                                                   _mm512_loadu_pd(w+i)));
+      _mm512_storeu_pd(out+i, v);
+   }
+   lerp_d_c(out+i, t, k+i, w+i, n-i);
+}
+
+AVX512_TARGET
+static void add_scaled_fd_avx512(float *x, double a, const double *y,
+                                 unsigned int n) {
+   __m512d va = _mm512_set1_pd(a);
+   unsigned int i;
+   for(i=0; i+8<=n; i+=8){
+      store_f_avx512(x+i, _mm512_add_pd(load_f_avx512(x+i),
+                                        _mm512_mul_pd(_mm512_loadu_pd(y+i),
+                                                      va)));
+   }
+   add_scaled_fd_c(x+i, a, y+i, n-i);
+}
+
+static const MRI_SIMD::Kernels avx512_kernels = {
+   "avx512",
+   scale_f_avx512, mul_f_avx512, div_f_avx512, add_f_avx512,
+   saxpy_f_avx512,
+   scale_d_avx512, mul_d_avx512, div_d_avx512, add_d_avx512,
+   saxpy_d_avx512,
+   real_mul_cf_avx512, real_div_cf_avx512, complex_mul_cf_avx512,
+   complex_saxpy_cf_avx512,
+   real_mul_cd_avx512, real_div_cd_avx512, complex_mul_cd_avx512,
+   complex_saxpy_cd_avx512,
+   lerp_d_avx512, add_scaled_fd_avx512
+};
+
+#endif // MRI_SIMD_X86
+
+//===========================================================================
+// Kernel selection
+//===========================================================================
+
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+//---------------------------------------------------------------------------
+// choose_kernels
+// Picks the best kernels for this processor, limited by MRISIM_SIMD.
+//---------------------------------------------------------------------------
+
+static void choose_kernels(const MRI_SIMD::Kernels **kernels,
+                           MRI_SIMD::Level *level) {
+
+   MRI_SIMD::Level limit = MRI_SIMD::AVX512;
+   const char *env = getenv("MRISIM_SIMD");
+   if (env != NULL) {
+      if (strcmp(env, "none") == 0)        limit = MRI_SIMD::NONE;
+      else if (strcmp(env, "sse2") == 0)   limit = MRI_SIMD::SSE2;
+      else if (strcmp(env, "avx2") == 0)   limit = MRI_SIMD::AVX2;
+   }
+
+   *kernels = &scalar_kernels;
+   *level   = MRI_SIMD::NONE;
+
+#ifdef MRI_SIMD_X86
+   __builtin_cpu_init();
+   if (limit >= MRI_SIMD::AVX512 && __builtin_cpu_supports("avx512f")) {
+      *kernels = &avx512_kernels;
+      *level   = MRI_SIMD::AVX512;
+   } else if (limit >= MRI_SIMD::AVX2 && __builtin_cpu_supports("avx2")) {
+      *kernels = &avx2_kernels;
+      *level   = MRI_SIMD::AVX2;
+   } else if (limit >= MRI_SIMD::SSE2 && __builtin_cpu_supports("sse2")) {
+      *kernels = &sse2_kernels;
+      *level   = MRI_SIMD::SSE2;
+   }
+#endif
+
+}
+
+//---------------------------------------------------------------------------
+// select_kernels
+// pthread_once callback for MRI_SIMD::_select.
+//---------------------------------------------------------------------------
+
+static const MRI_SIMD::Kernels *selected_kernels = &scalar_kernels;
+static MRI_SIMD::Level          selected_level   = MRI_SIMD::NONE;
+
+extern "C" {
+static void select_kernels(void) {
+   choose_kernels(&selected_kernels, &selected_level);
+}
+}
+
+//---------------------------------------------------------------------------
+// MRI_SIMD::_select
+// Chooses the kernels on first use.  Safe to call from several threads.
+//---------------------------------------------------------------------------
+
+void MRI_SIMD::_select(void) {
+   (void)pthread_once(&select_once, select_kernels);
+   _level   = selected_level;
+   _kernels = selected_kernels;
+}
+
+//---------------------------------------------------------------------------
+// MRI_SIMD::get_level
+// Returns the instruction set used by the kernels.
+//---------------------------------------------------------------------------
+
+MRI_SIMD::Level MRI_SIMD::get_level(void) {
+   (void)_get();
+   return _level;
+}
+
+//---------------------------------------------------------------------------
+// MRI_SIMD::get_level_name
+// Returns the name of the instruction set used by the kernels.
+//---------------------------------------------------------------------------
+
+const char *MRI_SIMD::get_level_name(void) {
+   return _get().name;
+}
@@ -0,0 +1,256 @@
+#ifndef __MRISIMD_H
+#define __MRISIMD_H
+
+//===========================================================================
+// MRISIMD.H
+// Vectorized element-wise kernels for the MRI matrix classes.
+// Inherits from:
+// Base class to:
+//===========================================================================
+
+//---------------------------------------------------------------------------
+// MRI_SIMD class
+// Element-wise arithmetic on float and double arrays, and on interleaved
+// (real, imaginary) complex arrays.  The instruction set is chosen when
+// the first kernel is called, from the best supported by the processor
+// (AVX-512, AVX2, SSE2 or plain C++).  Setting the environment variable
+// MRISIM_SIMD to "avx512", "avx2", "sse2" or "none" limits the choice.
+//
+// Each kernel gives the same result, bit for bit, as the scalar loops in
+// mrimatrix.cxx, evaluating each expression in the same precision (float
+// times float in float, anything with a double scalar in double).  The
+// output array may be the same as any input array.
+//---------------------------------------------------------------------------
+
+class MRI_SIMD {
+   public:
+      enum Level {NONE, SSE2, AVX2, AVX512};
+
+      static Level       get_level(void);
+      static const char *get_level_name(void);
+
+      // --- Real arrays of length n --- //
+      // x *= a, x *= y, x /= y, x += y, z = a*x + y
+      static inline void scale(float x[], double a, unsigned int n);
+      static inline void mul(float x[], const float y[], unsigned int n);
+      static inline void div(float x[], const float y[], unsigned int n);
+      static inline void add(float x[], const float y[], unsigned int n);
+      static inline void saxpy(float z[], double a, const float x[],
+                               const float y[], unsigned int n);
+
+      // x += a*y for float x and double y, rounding once to float
+      static inline void add_scaled(float x[], double a, const double y[],
+                                    unsigned int n);
+
+      static inline void scale(double x[], double a, unsigned int n);
+      static inline void mul(double x[], const double y[], unsigned int n);
+      static inline void div(double x[], const double y[], unsigned int n);
+      static inline void add(double x[], const double y[], unsigned int n);
+      static inline void saxpy(double z[], double a, const double x[],
+                               const double y[], unsigned int n);
+
+      // --- Complex arrays of n elements (2n values) --- //
+      // x *= y and x /= y for real y, x *= y for complex y,
+      // z = (ar + i ai)*x + y
+      static inline void real_mul(float x[], const float y[],
+                                  unsigned int n);
+      static inline void real_div(float x[], const float y[],
+                                  unsigned int n);
+      static inline void complex_mul(float x[], const float y[],
+                                     unsigned int n);
+      static inline void complex_saxpy(float z[], double ar, double ai,
+                                       const float x[], const float y[],
+                                       unsigned int n);
+
+      static inline void real_mul(double x[], const double y[],
+                                  unsigned int n);
+      static inline void real_div(double x[], const double y[],
+                                  unsigned int n);
+      static inline void complex_mul(double x[], const double y[],
+                                     unsigned int n);
+      static inline void complex_saxpy(double z[], double ar, double ai,
+                                       const double x[], const double y[],
+                                       unsigned int n);
+
+      // --- Table interpolation of n values --- //
+      // out[i] = t[k] + (t[k+1] - t[k])*weight[i], where k = index[i]
+      static inline void lerp(double out[], const double table[],
+                              const unsigned int index[],
+                              const double weight[], unsigned int n);
+
+      // Kernel table for one instruction set.
+      struct Kernels {
+         const char *name;
+         void (*scale_f)(float *, double, unsigned int);
+         void (*mul_f)(float *, const float *, unsigned int);
+         void (*div_f)(float *, const float *, unsigned int);
+         void (*add_f)(float *, const float *, unsigned int);
+         void (*saxpy_f)(float *, double, const float *, const float *,
+                         unsigned int);
+         void (*scale_d)(double *, double, unsigned int);
+         void (*mul_d)(double *, const double *, unsigned int);
+         void (*div_d)(double *, const double *, unsigned int);
+         void (*add_d)(double *, const double *, unsigned int);
+         void (*saxpy_d)(double *, double, const double *, const double *,
+                         unsigned int);
+         void (*real_mul_cf)(float *, const float *, unsigned int);
+         void (*real_div_cf)(float *, const float *, unsigned int);
+         void (*complex_mul_cf)(float *, const float *, unsigned int);
+         void (*complex_saxpy_cf)(float *, double, double, const float *,
+                                  const float *, unsigned int);
+         void (*real_mul_cd)(double *, const double *, unsigned int);
+         void (*real_div_cd)(double *, const double *, unsigned int);
+         void (*complex_mul_cd)(double *, const double *, unsigned int);
+         void (*complex_saxpy_cd)(double *, double, double, const double *,
+                                  const double *, unsigned int);
+         void (*lerp_d)(double *, const double *, const unsigned int *,
+                        const double *, unsigned int);
+         void (*add_scaled_fd)(float *, double, const double *,
+                               unsigned int);
+      };
+
+   private:
+      static const Kernels *_kernels;
+      static Level         _level;
+
+      static void _select(void);
+      static inline const Kernels& _get(void);
+};
+
+//---------------------------------------------------------------------------
+// Inline member functions
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// MRI_SIMD::_get
+// Returns the kernel table, choosing it on first use.
+//---------------------------------------------------------------------------
+
+inline
+const MRI_SIMD::Kernels& MRI_SIMD::_get(void) {
+   if (_kernels == 0) _select();
+   return *_kernels;
+}
+
+//---------------------------------------------------------------------------
+// MRI_SIMD real array kernels
+//---------------------------------------------------------------------------
+
+inline
+void MRI_SIMD::scale(float x[], double a, unsigned int n) {
+   _get().scale_f(x, a, n);
+}
+
+inline
+void MRI_SIMD::mul(float x[], const float y[], unsigned int n) {
+   _get().mul_f(x, y, n);
+}
+
+inline
+void MRI_SIMD::div(float x[], const float y[], unsigned int n) {
+   _get().div_f(x, y, n);
+}
+
+inline
+void MRI_SIMD::add(float x[], const float y[], unsigned int n) {
+   _get().add_f(x, y, n);
+}
+
+inline
+void MRI_SIMD::saxpy(float z[], double a, const float x[],
+                     const float y[], unsigned int n) {
+   _get().saxpy_f(z, a, x, y, n);
+}
+
+inline
+void MRI_SIMD::add_scaled(float x[], double a, const double y[],
+                          unsigned int n) {
+   _get().add_scaled_fd(x, a, y, n);
+}
+
+inline
+void MRI_SIMD::scale(double x[], double a, unsigned int n) {
+   _get().scale_d(x, a, n);
+}
+
+inline
+void MRI_SIMD::mul(double x[], const double y[], unsigned int n) {
+   _get().mul_d(x, y, n);
+}
+
+inline
+void MRI_SIMD::div(double x[], const double y[], unsigned int n) {
+   _get().div_d(x, y, n);
+}
+
+inline
+void MRI_SIMD::add(double x[], const double y[], unsigned int n) {
+   _get().add_d(x, y, n);
+}
+
+inline
+void MRI_SIMD::saxpy(double z[], double a, const double x[],
+                     const double y[], unsigned int n) {
+   _get().saxpy_d(z, a, x, y, n);
+}
+
+//---------------------------------------------------------------------------
+// MRI_SIMD complex array kernels
+//---------------------------------------------------------------------------
+
+inline
+void MRI_SIMD::real_mul(float x[], const float y[], unsigned int n) {
+   _get().real_mul_cf(x, y, n);
+}
+
+inline
+void MRI_SIMD::real_div(float x[], const float y[], unsigned int n) {
+   _get().real_div_cf(x, y, n);
+}
+
+inline
+void MRI_SIMD::complex_mul(float x[], const float y[], unsigned int n) {
+   _get().complex_mul_cf(x, y, n);
+}
+
+inline
+void MRI_SIMD::complex_saxpy(float z[], double ar, double ai,
+                             const float x[], const float y[],
+                             unsigned int n) {
+   _get().complex_saxpy_cf(z, ar, ai, x, y, n);
+}
+
+inline
+void MRI_SIMD::real_mul(double x[], const double y[], unsigned int n) {
+   _get().real_mul_cd(x, y, n);
+}
+
+inline
+void MRI_SIMD::real_div(double x[], const double y[], unsigned int n) {
+   _get().real_div_cd(x, y, n);
+}
+
+inline
+void MRI_SIMD::complex_mul(double x[], const double y[], unsigned int n) {
+   _get().complex_mul_cd(x, y, n);
+}
+
+inline
+void MRI_SIMD::complex_saxpy(double z[], double ar, double ai,
+                             const double x[], const double y[],
+                             unsigned int n) {
+   _get().complex_saxpy_cd(z, ar, ai, x, y, n);
+}
+
+//---------------------------------------------------------------------------
+// MRI_SIMD table interpolation kernel
+//---------------------------------------------------------------------------
+
+inline
+void MRI_SIMD::lerp(double out[], const double table[],
+                    const unsigned int index[], const double weight[],
+                    unsigned int n) {
+   _get().lerp_d(out, table, index, weight, n);
+}
+
+#endif
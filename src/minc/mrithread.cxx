@@ -0,0 +1,124 @@
+//===========================================================================
+// MRITHREAD.CXX
+// Thin wrappers around POSIX thread mutexes and condition variables,
+// and a bounded queue for passing work between threads.
+//===========================================================================
+
+#include <stdlib.h>
+#include <iostream>
+#include "mrithread.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+// MRI_Mutex constructor
+//---------------------------------------------------------------------------
+
+MRI_Mutex::MRI_Mutex(int recursive) {
+
+   pthread_mutexattr_t attr;
+
+   (void)pthread_mutexattr_init(&attr);
+   if (recursive) {
+      (void)pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+   }
+   if (pthread_mutex_init(&_mutex, &attr) != 0) {
+      cerr << "MRI_Mutex: could not initialize mutex." << endl;
+      exit(EXIT_FAILURE);
+   }
+   (void)pthread_mutexattr_destroy(&attr);
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Mutex destructor
+//---------------------------------------------------------------------------
+
+MRI_Mutex::~MRI_Mutex() {
+   (void)pthread_mutex_destroy(&_mutex);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Condition constructor
+//---------------------------------------------------------------------------
+
+MRI_Condition::MRI_Condition() {
+   if (pthread_cond_init(&_cond, NULL) != 0) {
+      cerr << "MRI_Condition: could not initialize condition variable."
+           << endl;
+      exit(EXIT_FAILURE);
+   }
+}
+
+//---------------------------------------------------------------------------
+// MRI_Condition destructor
+//---------------------------------------------------------------------------
+
+MRI_Condition::~MRI_Condition() {
+   (void)pthread_cond_destroy(&_cond);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Queue constructor
+//---------------------------------------------------------------------------
+
+MRI_Queue::MRI_Queue(unsigned int capacity) {
+
+#ifdef DEBUG
+   assert(capacity > 0);
+#endif
+
+   _items    = new void *[capacity];
+   _capacity = capacity;
+   _head     = 0;
+   _count    = 0;
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Queue destructor
+//---------------------------------------------------------------------------
+
+MRI_Queue::~MRI_Queue() {
+   delete[] _items;
+}
+
+//---------------------------------------------------------------------------
+// MRI_Queue::put
+// Adds an item to the back of the queue, waiting for space if needed.
+//---------------------------------------------------------------------------
+
+void MRI_Queue::put(void *item) {
+
+   MRI_Lock lock(_mutex);
+
+   while (_count == _capacity)
+      _not_full.wait(_mutex);
+
+   _items[(_head + _count) % _capacity] = item;
+   _count++;
+   _not_empty.signal();
+
+}
+
+//---------------------------------------------------------------------------
+// MRI_Queue::get
+// Removes and returns the item at the front of the queue, waiting for 
+// one to arrive if needed.
+//---------------------------------------------------------------------------
+
+void *MRI_Queue::get(void) {
+
+   MRI_Lock lock(_mutex);
+
+   while (_count == 0)
+      _not_empty.wait(_mutex);
+
+   void *item = _items[_head];
+   _head = (_head + 1) % _capacity;
+   _count--;
+   _not_full.signal();
+
+   return item;
+
+}
@@ -0,0 +1,183 @@
+#ifndef __MRITHREAD_H
+#define __MRITHREAD_H
+
+//===========================================================================
+// MRITHREAD.H
+// Thin wrappers around POSIX thread mutexes and condition variables,
+// and a bounded queue for passing work between threads.
+// Inherits from:
+// Base class to:
+//===========================================================================
+
+#include <pthread.h>
+
+#ifdef DEBUG
+#include <assert.h>
+#endif
+
+//---------------------------------------------------------------------------
+// MRI_Mutex class
+// A POSIX mutex.  A recursive mutex may be locked more than once by the
+// thread that holds it, and must be unlocked as many times.
+//---------------------------------------------------------------------------
+
+class MRI_Mutex {
+   public:
+      MRI_Mutex(int recursive = 0);
+      virtual ~MRI_Mutex();
+
+      inline void lock(void);
+      inline void unlock(void);
+
+   private:
+      pthread_mutex_t _mutex;
+
+      // Mutexes cannot be copied.
+      MRI_Mutex(const MRI_Mutex&);
+      MRI_Mutex& operator=(const MRI_Mutex&);
+
+      friend class MRI_Condition;
+};
+
+//---------------------------------------------------------------------------
+// MRI_Lock class
+// Holds a mutex for the lifetime of the MRI_Lock object.
+//---------------------------------------------------------------------------
+
+class MRI_Lock {
+   public:
+      inline MRI_Lock(MRI_Mutex& mutex);
+      inline ~MRI_Lock();
+
+   private:
+      MRI_Mutex& _mutex;
+
+      MRI_Lock(const MRI_Lock&);
+      MRI_Lock& operator=(const MRI_Lock&);
+};
+
+//---------------------------------------------------------------------------
+// MRI_Condition class
+// A POSIX condition variable.
+//---------------------------------------------------------------------------
+
+class MRI_Condition {
+   public:
+      MRI_Condition();
+      virtual ~MRI_Condition();
+
+      inline void wait(MRI_Mutex& mutex);
+      inline void signal(void);
+      inline void broadcast(void);
+
+   private:
+      pthread_cond_t _cond;
+
+      MRI_Condition(const MRI_Condition&);
+      MRI_Condition& operator=(const MRI_Condition&);
+};
+
+//---------------------------------------------------------------------------
+// MRI_Queue class
+// A bounded first-in first-out queue of pointers shared between threads.
+// put blocks while the queue is full and get blocks while it is empty.
+//---------------------------------------------------------------------------
+
+class MRI_Queue {
+   public:
+      MRI_Queue(unsigned int capacity);
+      virtual ~MRI_Queue();
+
+      void put(void *item);
+      void *get(void);
+
+   private:
+      void          **_items;
+      unsigned int  _capacity;
+      unsigned int  _head;          // index of the oldest item
+      unsigned int  _count;         // number of items in the queue
+
+      MRI_Mutex     _mutex;
+      MRI_Condition _not_empty;
+      MRI_Condition _not_full;
+
+      MRI_Queue(const MRI_Queue&);
+      MRI_Queue& operator=(const MRI_Queue&);
+};
+
+//---------------------------------------------------------------------------
+// Inline member functions
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// MRI_Mutex::lock
+// Blocks until the mutex is acquired.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Mutex::lock(void) {
+   (void)pthread_mutex_lock(&_mutex);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Mutex::unlock
+// Releases the mutex.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Mutex::unlock(void) {
+   (void)pthread_mutex_unlock(&_mutex);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Lock constructor
+// Acquires the mutex.
+//---------------------------------------------------------------------------
+
+inline
+MRI_Lock::MRI_Lock(MRI_Mutex& mutex) : _mutex(mutex) {
+   _mutex.lock();
+}
+
+//---------------------------------------------------------------------------
+// MRI_Lock destructor
+// Releases the mutex.
+//---------------------------------------------------------------------------
+
+inline
+MRI_Lock::~MRI_Lock() {
+   _mutex.unlock();
+}
+
+//---------------------------------------------------------------------------
+// MRI_Condition::wait
+// Atomically releases the (locked) mutex and waits for the condition
+// to be signalled.  The mutex is held again on return.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Condition::wait(MRI_Mutex& mutex) {
+   (void)pthread_cond_wait(&_cond, &mutex._mutex);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Condition::signal
+// Wakes one waiting thread.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Condition::signal(void) {
+   (void)pthread_cond_signal(&_cond);
+}
+
+//---------------------------------------------------------------------------
+// MRI_Condition::broadcast
+// Wakes all waiting threads.
+//---------------------------------------------------------------------------
+
+inline
+void MRI_Condition::broadcast(void) {
+   (void)pthread_cond_broadcast(&_cond);
+}
+
+#endif
@@ -1511,16 +1511,7 @@ void MRI_Complex_Volume::FFT2(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned long sizes[2];
-   unsigned int islice;
-   double *slice;
-
-   sizes[0] = _nrows;
-   sizes[1] = _ncols;
-   for(islice=0; islice<_nslices; islice++){
-      slice = &(_volume[islice*_nrows*_ncols]);
-      fourn(slice-1, sizes-1, 2, -1);
-   }
+   _transform2(MRI_FFT_Plan::FORWARD);
 }
 
 //---------------------------------------------------------------------------
@@ -1534,17 +1525,30 @@ void MRI_Complex_Volume::iFFT2(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned long sizes[2];
+   _transform2(MRI_FFT_Plan::INVERSE);
+   *this *= (1.0/(double)get_slicesize());
+}
+
+//---------------------------------------------------------------------------
+// MRI_Complex_Volume::_transform2
+// 2D-FFT in place of each slice: the rows, then the columns in
+// cache-sized blocks.
+//---------------------------------------------------------------------------
+
+void MRI_Complex_Volume::_transform2(MRI_FFT_Plan::Direction direction){
+   const MRI_FFT_Plan *row_plan = MRI_FFT_Plan::get(_ncols);
+   const MRI_FFT_Plan *col_plan = MRI_FFT_Plan::get(_nrows);
+   double *work = new double[col_plan->get_workspace_length()];
    unsigned int islice;
    double *slice;
 
-   sizes[0] = _nrows;
-   sizes[1] = _ncols;
    for(islice=0; islice<_nslices; islice++){
-      slice = &(_volume[islice*_nrows*_ncols]);
-      fourn(slice-1, sizes-1, 2, 1);
+      slice = &(_volume[2*islice*_nrows*_ncols]);
+      row_plan->transform_rows(slice, _nrows, _ncols, direction);
+      col_plan->transform_columns(slice, _ncols, _ncols, direction, work);
    }
-   *this *= (1.0/(double)get_slicesize());
+
+   delete[] work;
 }
 
 //---------------------------------------------------------------------------
@@ -1558,11 +1562,13 @@ void MRI_Complex_Volume::FFT3(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned long sizes[3];
-   sizes[0] = _nrows;
-   sizes[1] = _ncols;
-   sizes[2] = _nslices;
-   fourn(_volume-1, sizes-1, 3, -1);
+   const MRI_FFT_Plan *slice_plan = MRI_FFT_Plan::get(_nslices);
+   double *work = new double[slice_plan->get_workspace_length()];
+
+   _transform2(MRI_FFT_Plan::FORWARD);
+   slice_plan->transform_columns(_volume, get_slicesize(), get_slicesize(),
+                                 MRI_FFT_Plan::FORWARD, work);
+   delete[] work;
 }
 
 //---------------------------------------------------------------------------
@@ -1576,11 +1582,13 @@ void MRI_Complex_Volume::iFFT3(void){
    assert(this->is_power_of_two());
 #endif
 
-   unsigned long sizes[3];
-   sizes[0] = _nrows;
-   sizes[1] = _ncols;
-   sizes[2] = _nslices;
-   fourn(_volume-1, sizes-1, 3, 1);
+   const MRI_FFT_Plan *slice_plan = MRI_FFT_Plan::get(_nslices);
+   double *work = new double[slice_plan->get_workspace_length()];
+
+   _transform2(MRI_FFT_Plan::INVERSE);
+   slice_plan->transform_columns(_volume, get_slicesize(), get_slicesize(),
+                                 MRI_FFT_Plan::INVERSE, work);
+   delete[] work;
    *this *= (1.0/(double)get_nelements());
 }
 
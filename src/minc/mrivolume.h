@@ -461,6 +461,8 @@ class MRI_Complex_Volume : public MRI_Volume {
       
       double *_volume;
 
+      void _transform2(MRI_FFT_Plan::Direction direction);
+
       virtual void _allocate(unsigned int nelements) {
          _volume = new double[2*nelements]; }
       virtual void _deallocate(void) {
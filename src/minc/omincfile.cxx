@@ -30,6 +30,7 @@
 
 #include "imincfile.h"
 #include "omincfile.h"
+#include "mriprofile.h"
 #include <string.h>
 
 //--------------------------------------------------------------------------
@@ -111,6 +112,18 @@ int O_MINC_File::save_hyperslab(long start[], long count[], void *volume){
    assert(volume != NULL);
 #endif
 
+   if (MRI_Profile::is_enabled()) {
+      long nelements = 1;
+      int  idim;
+      for (idim=0; idim<_volume_info.number_of_dimensions; idim++){
+         nelements *= count[idim];
+      }
+      MRI_Profile::count(MRI_Profile::MIICV_CALLS);
+      MRI_Profile::count(MRI_Profile::BYTES_WRITTEN, 
+                         nelements * nctypelen(_volume_info.datatype));
+   }
+
+   MRI_Lock lock(MINC_File::library_mutex);
    return miicv_put(_icvid, start, count, volume);
 
 }
@@ -122,6 +135,8 @@ int O_MINC_File::save_hyperslab(long start[], long count[], void *volume){
 
 int O_MINC_File::save_slice(int slice_num, void *slice){
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_WRITE);
+
    long start[MAX_VAR_DIMS], count[MAX_VAR_DIMS];
    int  ndims = _volume_info.number_of_dimensions;
 
@@ -141,6 +156,7 @@ int O_MINC_File::save_slice(int slice_num, void *slice){
    count[ndims-1] = _volume_info.length[ndims-1];
    
    // Write out slice min and max
+   MRI_Lock lock(MINC_File::library_mutex);
    (void) mivarput1(_MINCid, ncvarid(_MINCid, MIimagemin), start,
                     NC_DOUBLE, NULL, &_volume_info.valid_range[0]);
    (void) mivarput1(_MINCid, ncvarid(_MINCid, MIimagemax), start,
@@ -153,6 +169,8 @@ int O_MINC_File::save_slice(int slice_num, void *slice){
 
 int O_MINC_File::save_slice(int slice_num, MRI_Image& image){
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_WRITE);
+
    long start[MAX_VAR_DIMS], count[MAX_VAR_DIMS];
    int  ndims = _volume_info.number_of_dimensions;
    double slice_min, slice_max;
@@ -174,6 +192,7 @@ int O_MINC_File::save_slice(int slice_num, MRI_Image& image){
    slice_min = image.get_real_minimum();
    slice_max = image.get_real_maximum();
 
+   MRI_Lock lock(MINC_File::library_mutex);
    (void) mivarput1(_MINCid, ncvarid(_MINCid, MIimagemin), start,
                     NC_DOUBLE, NULL, &slice_min);
    (void) mivarput1(_MINCid, ncvarid(_MINCid, MIimagemax), start,
@@ -0,0 +1,470 @@
+//==========================================================================
+// CHIRP_PLAN.CXX
+// Chirp_Plan class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include "chirp_plan.h"
+
+// First bytes of a wisdom file, followed by a byte order check word
+static const char         WISDOM_MAGIC[] = "MRISIM CHIRP WISDOM 4\n";
+static const unsigned int WISDOM_ORDER   = 0x01020304U;
+
+// Length of the processor names kept with tuned methods, and the most
+// tuned methods read from one file
+#define WISDOM_CPU_LENGTH  64
+#define WISDOM_MAX_METHODS 65536
+
+//--------------------------------------------------------------------------
+// Tuned_Method
+// A resampling method chosen by timing, for one geometry and processor.
+//--------------------------------------------------------------------------
+
+struct Tuned_Method {
+   unsigned int  lengths[4];
+   double        fovs[4];
+   int           method;
+   char          cpu[WISDOM_CPU_LENGTH];
+   Tuned_Method *next;
+};
+
+Chirp_Plan *Chirp_Plan::_plans   = NULL;
+int         Chirp_Plan::_changed = FALSE;
+MRI_Mutex   Chirp_Plan::_plans_mutex;
+
+// Tuned methods and the name of this processor, under _plans_mutex
+static Tuned_Method *tuned_methods = NULL;
+static char          cpu_name[WISDOM_CPU_LENGTH] = "";
+
+//--------------------------------------------------------------------------
+// find_tuned_method
+// Returns the tuned method for a geometry and processor, or NULL.
+// The caller must hold Chirp_Plan::_plans_mutex.
+//--------------------------------------------------------------------------
+
+static Tuned_Method *find_tuned_method(const unsigned int lengths[4],
+                                       const double fovs[4],
+                                       const char *cpu) {
+
+   Tuned_Method *tuned;
+   for (tuned=tuned_methods; tuned!=NULL; tuned=tuned->next){
+      if (memcmp(tuned->lengths, lengths, sizeof(tuned->lengths)) == 0 &&
+          tuned->fovs[0] == fovs[0] && tuned->fovs[1] == fovs[1] &&
+          tuned->fovs[2] == fovs[2] && tuned->fovs[3] == fovs[3] &&
+          strcmp(tuned->cpu, cpu) == 0) {
+         return tuned;
+      }
+   }
+   return NULL;
+
+}
+
+//--------------------------------------------------------------------------
+// set_cpu_name
+// Finds the name of this processor: the model name given by the Linux
+// kernel, or else the machine type.  The caller must hold
+// Chirp_Plan::_plans_mutex.
+//--------------------------------------------------------------------------
+
+static void set_cpu_name(void) {
+
+   if (cpu_name[0] != '\0') return;
+
+   char  line[256];
+   char *name;
+   FILE *fp;
+
+   if ((fp = fopen("/proc/cpuinfo", "r")) != NULL) {
+      while (fgets(line, sizeof(line), fp) != NULL) {
+         if (strncmp(line, "model name", 10) == 0 &&
+             (name = strchr(line, ':')) != NULL) {
+            name += strspn(name, ": \t");
+            name[strcspn(name, "\n")] = '\0';
+            snprintf(cpu_name, WISDOM_CPU_LENGTH, "%s", name);
+            break;
+         }
+      }
+      fclose(fp);
+   }
+
+   struct utsname host;
+   if (cpu_name[0] == '\0') {
+      snprintf(cpu_name, WISDOM_CPU_LENGTH, "%.*s", WISDOM_CPU_LENGTH-1,
+               ((uname(&host) == 0) ? host.machine : "unknown"));
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan constructor
+// The plan becomes the owner of the Chirp_Algorithm.
+//--------------------------------------------------------------------------
+
+Chirp_Plan::Chirp_Plan(unsigned int in_length, unsigned int out_length,
+                       double in_fov, double out_fov,
+                       double w_initial, double w_step,
+                       Chirp_Algorithm *chirp)
+   : _in_length(in_length), _out_length(out_length),
+     _in_fov(in_fov), _out_fov(out_fov),
+     _w_initial(w_initial), _w_step(w_step), _chirp(chirp) {
+
+   _next = NULL;
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan destructor
+//--------------------------------------------------------------------------
+
+Chirp_Plan::~Chirp_Plan() {
+   delete _chirp;
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::_matches
+// Returns TRUE if the plan was made for the given geometry.
+//--------------------------------------------------------------------------
+
+int Chirp_Plan::_matches(unsigned int in_length, unsigned int out_length,
+                         double in_fov, double out_fov,
+                         double w_initial, double w_step) const {
+
+   return (_in_length == in_length && _out_length == out_length &&
+           _in_fov    == in_fov    && _out_fov    == out_fov &&
+           _w_initial == w_initial && _w_step     == w_step);
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::_find
+// Returns the registered plan for a geometry, or NULL.  The caller must
+// hold _plans_mutex.
+//--------------------------------------------------------------------------
+
+Chirp_Plan *Chirp_Plan::_find(unsigned int in_length,
+                              unsigned int out_length,
+                              double in_fov, double out_fov,
+                              double w_initial, double w_step) {
+
+   Chirp_Plan *plan;
+   for (plan=_plans; plan!=NULL; plan=plan->_next){
+      if (plan->_matches(in_length, out_length, in_fov, out_fov,
+                         w_initial, w_step)) {
+         return plan;
+      }
+   }
+   return NULL;
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::get
+// Returns the shared plan for a geometry, building the weights and the
+// Chirp filters the first time the geometry is used.
+//--------------------------------------------------------------------------
+
+const Chirp_Plan *Chirp_Plan::get(unsigned int in_length,
+                                  unsigned int out_length,
+                                  double in_fov, double out_fov,
+                                  double w_initial, double w_step) {
+
+   MRI_Lock lock(_plans_mutex);
+
+   Chirp_Plan *plan = _find(in_length, out_length, in_fov, out_fov,
+                            w_initial, w_step);
+   if (plan != NULL) {
+      return plan;
+   }
+
+   // The resampling weight depends only on the output sample, so it is
+   // folded into the post-filter of the Chirp DFT.
+
+   double *weight = new double[2*out_length];
+   compute_weight(weight, in_length, out_length, in_fov, out_fov);
+
+   Chirp_Algorithm *chirp = new Chirp_Algorithm(in_length, out_length,
+                                                w_initial, w_step, weight);
+   delete[] weight;
+
+   plan = new Chirp_Plan(in_length, out_length, in_fov, out_fov,
+                         w_initial, w_step, chirp);
+   plan->_next = _plans;
+   _plans      = plan;
+   _changed    = TRUE;
+
+   return plan;
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::compute_weight
+// Computes the Fourier resampling weights: the transform of the linear
+// interpolation kernel and a linear phase shift.
+//--------------------------------------------------------------------------
+
+void Chirp_Plan::compute_weight(double weight[],
+                                unsigned int in_length,
+                                unsigned int out_length,
+                                double in_fov, double out_fov) {
+
+   const double shift      = M_PI_2*(1.0 - (in_fov/out_fov));
+   const double voxel_size = in_fov/(double)in_length;
+   const double factor     = 0.5*voxel_size/out_fov;
+
+   double angle, linear_comp;
+
+   unsigned int n;
+   for (n=0; n<2*out_length; n+=2){
+      angle = shift*n;
+      linear_comp =  voxel_size *
+                     _sinc(factor*(n-(double)out_length)) *
+                     _sinc(factor*(n-(double)out_length));
+      weight[n]   =  linear_comp*cos(angle);
+      weight[n+1] = -linear_comp*sin(angle);
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::find_method
+// Looks up the resampling method tuned for a geometry on this processor.
+//--------------------------------------------------------------------------
+
+int Chirp_Plan::find_method(const unsigned int lengths[4],
+                            const double fovs[4],
+                            Resample_Method& method) {
+
+   MRI_Lock lock(_plans_mutex);
+
+   set_cpu_name();
+   Tuned_Method *tuned = find_tuned_method(lengths, fovs, cpu_name);
+   if (tuned == NULL) {
+      return FALSE;
+   }
+   method = (Resample_Method)tuned->method;
+   return TRUE;
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::add_method
+// Records the resampling method tuned for a geometry on this processor.
+//--------------------------------------------------------------------------
+
+void Chirp_Plan::add_method(const unsigned int lengths[4],
+                            const double fovs[4],
+                            Resample_Method method) {
+
+   MRI_Lock lock(_plans_mutex);
+
+   set_cpu_name();
+   Tuned_Method *tuned = find_tuned_method(lengths, fovs, cpu_name);
+   if (tuned == NULL) {
+      tuned = new Tuned_Method;
+      memcpy(tuned->lengths, lengths, sizeof(tuned->lengths));
+      memcpy(tuned->fovs, fovs, sizeof(tuned->fovs));
+      memset(tuned->cpu, 0, sizeof(tuned->cpu));
+      strcpy(tuned->cpu, cpu_name);
+      tuned->next   = tuned_methods;
+      tuned_methods = tuned;
+   }
+   tuned->method = method;
+   _changed      = TRUE;
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::get_cpu_name
+// Returns the processor name under which tuned methods are kept.
+//--------------------------------------------------------------------------
+
+const char *Chirp_Plan::get_cpu_name(void) {
+
+   MRI_Lock lock(_plans_mutex);
+   set_cpu_name();
+   return cpu_name;
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::wisdom_changed
+// Returns TRUE if plans or tuned methods have been made since the wisdom
+// file was loaded.
+//--------------------------------------------------------------------------
+
+int Chirp_Plan::wisdom_changed(void) {
+
+   MRI_Lock lock(_plans_mutex);
+   return _changed;
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::load_wisdom
+// Adds the tuned methods and plans saved in a wisdom file to the
+// registry.  Entries already in the registry are kept.  A file written
+// on a machine with another byte order or word size is ignored; a
+// truncated file gives the entries before the damaged record.  Tuned
+// methods of every processor are kept, so that they are saved again,
+// but only the Chirp plans are counted.
+//--------------------------------------------------------------------------
+
+int Chirp_Plan::load_wisdom(const char *path) {
+
+   FILE *fp;
+   if ((fp = fopen(path, "rb")) == NULL) {
+      return -1;
+   }
+
+   char         magic[sizeof(WISDOM_MAGIC)];
+   unsigned int order;
+   unsigned int sizes[2];
+
+   if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+       memcmp(magic, WISDOM_MAGIC, sizeof(magic)) != 0 ||
+       fread(&order, sizeof(order), 1, fp) != 1 ||
+       fread(sizes, sizeof(unsigned int), 2, fp) != 2 ||
+       order != WISDOM_ORDER ||
+       sizes[0] != sizeof(int) || sizes[1] != sizeof(double)) {
+      fclose(fp);
+      return -1;
+   }
+
+   MRI_Lock lock(_plans_mutex);
+
+   int nplans = 0;
+   unsigned int lengths[2];
+   double       params[4];
+   Chirp_Algorithm *chirp;
+
+   // --- Tuned methods --- //
+
+   unsigned int nmethods, n;
+   Tuned_Method record;
+
+   if (fread(&nmethods, sizeof(nmethods), 1, fp) != 1 ||
+       nmethods > WISDOM_MAX_METHODS) {
+      fclose(fp);
+      return -1;
+   }
+   for (n=0; n<nmethods; n++){
+      if (fread(record.lengths, sizeof(unsigned int), 4, fp) != 4 ||
+          fread(record.fovs, sizeof(double), 4, fp) != 4 ||
+          fread(&record.method, sizeof(int), 1, fp) != 1 ||
+          fread(record.cpu, 1, WISDOM_CPU_LENGTH, fp) != WISDOM_CPU_LENGTH) {
+         fclose(fp);
+         return nplans;
+      }
+      record.cpu[WISDOM_CPU_LENGTH-1] = '\0';
+      if ((record.method != RESAMPLE_CHIRP &&
+           record.method != RESAMPLE_FFT &&
+           record.method != RESAMPLE_DIRECT) ||
+          find_tuned_method(record.lengths, record.fovs,
+                            record.cpu) != NULL) {
+         continue;
+      }
+      Tuned_Method *tuned = new Tuned_Method(record);
+      tuned->next   = tuned_methods;
+      tuned_methods = tuned;
+   }
+
+   // --- Chirp plans --- //
+
+   while (fread(lengths, sizeof(unsigned int), 2, fp) == 2 &&
+          fread(params, sizeof(double), 4, fp) == 4 &&
+          (chirp = Chirp_Algorithm::read(fp)) != NULL) {
+
+      if (chirp->get_input_length()  != (int)lengths[0] ||
+          chirp->get_output_length() != (int)lengths[1] ||
+          _find(lengths[0], lengths[1], params[0], params[1],
+                params[2], params[3]) != NULL) {
+         delete chirp;
+         continue;
+      }
+
+      Chirp_Plan *plan = new Chirp_Plan(lengths[0], lengths[1],
+                                        params[0], params[1],
+                                        params[2], params[3], chirp);
+      plan->_next = _plans;
+      _plans      = plan;
+      nplans++;
+   }
+
+   fclose(fp);
+   _changed = FALSE;
+
+   return nplans;
+
+}
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::save_wisdom
+// Writes every tuned method and plan in the registry to a wisdom file.
+// The file is written under a temporary name and renamed, so that
+// concurrent jobs sharing one wisdom file never read a partly written
+// file.
+//--------------------------------------------------------------------------
+
+int Chirp_Plan::save_wisdom(const char *path) {
+
+   char *tmp_path = new char[strlen(path) + 32];
+   sprintf(tmp_path, "%s.%ld", path, (long)getpid());
+
+   FILE *fp;
+   if ((fp = fopen(tmp_path, "wb")) == NULL) {
+      delete[] tmp_path;
+      return FALSE;
+   }
+
+   MRI_Lock lock(_plans_mutex);
+
+   const unsigned int order    = WISDOM_ORDER;
+   const unsigned int sizes[2] = {sizeof(int), sizeof(double)};
+
+   int ok = (fwrite(WISDOM_MAGIC, 1, sizeof(WISDOM_MAGIC), fp) ==
+                sizeof(WISDOM_MAGIC) &&
+             fwrite(&order, sizeof(order), 1, fp) == 1 &&
+             fwrite(sizes, sizeof(unsigned int), 2, fp) == 2);
+
+   unsigned int  nmethods = 0;
+   Tuned_Method *tuned;
+   for (tuned=tuned_methods; tuned!=NULL; tuned=tuned->next){
+      nmethods++;
+   }
+   ok = ok && (fwrite(&nmethods, sizeof(nmethods), 1, fp) == 1);
+   for (tuned=tuned_methods; ok && tuned!=NULL; tuned=tuned->next){
+      ok = (fwrite(tuned->lengths, sizeof(unsigned int), 4, fp) == 4 &&
+            fwrite(tuned->fovs, sizeof(double), 4, fp) == 4 &&
+            fwrite(&tuned->method, sizeof(int), 1, fp) == 1 &&
+            fwrite(tuned->cpu, 1, WISDOM_CPU_LENGTH, fp) ==
+               WISDOM_CPU_LENGTH);
+   }
+
+   Chirp_Plan *plan;
+   for (plan=_plans; ok && plan!=NULL; plan=plan->_next){
+      const unsigned int lengths[2] = {plan->_in_length, plan->_out_length};
+      const double       params[4]  = {plan->_in_fov, plan->_out_fov,
+                                       plan->_w_initial, plan->_w_step};
+
+      ok = (fwrite(lengths, sizeof(unsigned int), 2, fp) == 2 &&
+            fwrite(params, sizeof(double), 4, fp) == 4 &&
+            plan->_chirp->write(fp));
+   }
+
+   ok = (fclose(fp) == 0) && ok;
+   ok = ok && (rename(tmp_path, path) == 0);
+   if (!ok) {
+      remove(tmp_path);
+   } else {
+      _changed = FALSE;
+   }
+   delete[] tmp_path;
+
+   return ok;
+
+}
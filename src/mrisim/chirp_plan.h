@@ -0,0 +1,133 @@
+#ifndef __CHIRP_PLAN_H
+#define __CHIRP_PLAN_H
+
+//==========================================================================
+// CHIRP_PLAN.H
+// Chirp_Plan class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <math.h>
+#include <minc/chirp.h>
+#include <minc/mrithread.h>
+#include "resample_dft.h"
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+//--------------------------------------------------------------------------
+// Chirp_Plan class
+// A weighted 1-D Chirp DFT for Fourier resampling along one direction,
+// shared through a registry keyed by the input and output lengths and
+// fields of view and the DFT frequencies.  Plans are made on first use
+// and kept until the program exits, so every phantom and every pulse
+// sequence with the same geometry uses one set of filters.
+//
+// The registry can be saved to and loaded from a wisdom file, so that
+// repeated runs with the same geometry skip building the filters.  The
+// file holds raw doubles in the native byte order and is only read on
+// a machine of the same kind.
+//
+// The wisdom file also keeps the resampling methods chosen by timing
+// (see Phantom::use_autotune), keyed by the 2-D geometry and by the
+// processor, so one file may be shared by different machines.
+//--------------------------------------------------------------------------
+
+class Chirp_Plan {
+   public:
+      static const Chirp_Plan *get(unsigned int in_length,
+                                   unsigned int out_length,
+                                   double in_fov, double out_fov,
+                                   double w_initial, double w_step);
+
+      inline const Chirp_Algorithm *get_chirp(void) const;
+
+      // --- Wisdom files --- //
+      // load_wisdom returns the number of Chirp plans read (tuned
+      // methods are not counted), or -1 if the file could not be read.
+      // save_wisdom returns FALSE (0) on failure.
+      static int load_wisdom(const char *path);
+      static int save_wisdom(const char *path);
+      static int wisdom_changed(void);
+
+      // --- Tuned resampling methods --- //
+      // lengths: input row and column lengths, output row and column
+      // lengths; fovs: the matching fields of view.  find_method returns
+      // FALSE if no method was tuned for the geometry on this processor.
+      static int  find_method(const unsigned int lengths[4],
+                              const double fovs[4],
+                              Resample_Method& method);
+      static void add_method(const unsigned int lengths[4],
+                             const double fovs[4],
+                             Resample_Method method);
+      static const char *get_cpu_name(void);
+
+      // The Fourier resampling weights of a geometry, as used by the
+      // plans, for the other ways of computing the resampling
+      static void compute_weight(double weight[],
+                                 unsigned int in_length,
+                                 unsigned int out_length,
+                                 double in_fov, double out_fov);
+
+   private:
+      Chirp_Plan(unsigned int in_length, unsigned int out_length,
+                 double in_fov, double out_fov,
+                 double w_initial, double w_step,
+                 Chirp_Algorithm *chirp);
+      ~Chirp_Plan();
+
+      unsigned int    _in_length;
+      unsigned int    _out_length;
+      double          _in_fov;
+      double          _out_fov;
+      double          _w_initial;
+      double          _w_step;
+      Chirp_Algorithm *_chirp;
+
+      Chirp_Plan      *_next;
+
+      static Chirp_Plan *_plans;
+      static int        _changed;      // plans made since the last load
+      static MRI_Mutex  _plans_mutex;
+
+      int _matches(unsigned int in_length, unsigned int out_length,
+                   double in_fov, double out_fov,
+                   double w_initial, double w_step) const;
+      static Chirp_Plan *_find(unsigned int in_length,
+                               unsigned int out_length,
+                               double in_fov, double out_fov,
+                               double w_initial, double w_step);
+
+      Chirp_Plan(const Chirp_Plan&);
+      Chirp_Plan& operator=(const Chirp_Plan&);
+};
+
+//--------------------------------------------------------------------------
+// _sinc
+// Computes the sinc function sin(PI x) / (PI x) handling the singularity at
+// (x == 0.0) correctly.
+//--------------------------------------------------------------------------
+
+inline
+double _sinc(double x) {
+   return ((x!=0.0) ? sin(M_PI*x)/(M_PI*x) : 1.0);
+}
+
+//--------------------------------------------------------------------------
+// Inline member functions
+//--------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------
+// Chirp_Plan::get_chirp
+// Returns the weighted Chirp DFT of the plan.
+//--------------------------------------------------------------------------
+
+inline
+const Chirp_Algorithm *Chirp_Plan::get_chirp(void) const {
+   return _chirp;
+}
+
+#endif
@@ -22,6 +22,7 @@
 //===========================================================================
 
 #include "discrete_label_phantom.h"
+#include <minc/mriprofile.h>
 
 //---------------------------------------------------------------------------
 // Discrete_Label_Phantom constructor
@@ -96,6 +97,12 @@ void Discrete_Label_Phantom::_load_label_slice(int slice_num,
    assert(this->is_same_slice_size_as(label_slice));
 #endif
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_LABEL_LOAD);
+
+   // The ICV is updated for each slice, so the whole read must be
+   // atomic with respect to other threads using the MINC library.
+   MRI_Lock lock(MINC_File::library_mutex);
+
    // Read in the real image-min and image-max for the slice
    long start[3] = {0, 0, 0};
    start[SLICE]  = slice_num;
@@ -111,19 +111,24 @@ void Discrete_RF_Phantom::get_simulated_phantom_slice(int slice_num,
 
    if (uses_tx_map()) {
 
-      // Load RF coil transmit map
+      // Load RF coil transmit map and find each voxel's position in
+      // the flip angle error tables
       load_tx_map_slice(slice_num, rf_map);
-   
+      Flip_Error_Map flip_map(rf_map.get_nelements());
+      _get_flip_error_map(rf_map, flip_map);
+
       // Generate simulated slice with transmit inhomogeneity
-      for (m=0; m<sim_slice.get_nrows(); m++){
-         for (n=0; n<sim_slice.get_ncols(); n++){
-   
-            sim_slice.real(m,n) = RF_Tissue_Phantom::get_real_intensity(
-                                    discrete_label(m,n), (double)rf_map(m,n) ); 
-            sim_slice.imag(m,n) = RF_Tissue_Phantom::get_imag_intensity(
-                                    discrete_label(m,n), (double)rf_map(m,n) );
-         }
+      unsigned int len  = sim_slice.get_nelements();
+      double       *real = new double[len];
+      double       *imag = new double[len];
+      float        *out  = sim_slice.row_ptr(0);
+      _interp_intensities(discrete_label, flip_map, real, imag);
+      for (n=0; n<len; n++){
+         out[2*n]   = real[n];
+         out[2*n+1] = imag[n];
       }
+      delete[] real;
+      delete[] imag;
 
    } else {
   
@@ -186,17 +191,23 @@ void Discrete_RF_Phantom::get_simulated_mag_phantom_slice(int slice_num,
 
    if (uses_tx_map()) {
 
-      // Load RF coil transmit map
+      // Load RF coil transmit map and find each voxel's position in
+      // the flip angle error tables
       load_tx_map_slice(slice_num, rf_map);
-   
+      Flip_Error_Map flip_map(rf_map.get_nelements());
+      _get_flip_error_map(rf_map, flip_map);
+
       // Generate simulated slice with transmit inhomogeneity
-      for (m=0; m<sim_slice.get_nrows(); m++){
-         for (n=0; n<sim_slice.get_ncols(); n++){
-         
-            sim_slice(m,n) = RF_Tissue_Phantom::get_mag_intensity(
-                                   discrete_label(m,n), rf_map(m,n) );
-         }
+      unsigned int len  = sim_slice.get_nelements();
+      double       *real = new double[len];
+      double       *imag = new double[len];
+      float        *out  = sim_slice.row_ptr(0);
+      _interp_intensities(discrete_label, flip_map, real, imag);
+      for (n=0; n<len; n++){
+         out[n] = hypot(real[n], imag[n]);
       }
+      delete[] real;
+      delete[] imag;
 
    } else {
   
@@ -255,17 +266,21 @@ void Discrete_RF_Phantom::get_simulated_real_phantom_slice(int slice_num,
 
    if (uses_tx_map()) {
 
-      // Load RF coil transmit map
+      // Load RF coil transmit map and find each voxel's position in
+      // the flip angle error tables
       load_tx_map_slice(slice_num, rf_map);
-   
+      Flip_Error_Map flip_map(rf_map.get_nelements());
+      _get_flip_error_map(rf_map, flip_map);
+
       // Generate simulated slice with transmit inhomogeneity
-      for (m=0; m<get_nrows(); m++){
-         for (n=0; n<get_ncols(); n++){
-   
-            sim_slice(m,n) = RF_Tissue_Phantom::get_real_intensity(
-                                   discrete_label(m,n), (double)rf_map(m,n) );
-         }
+      unsigned int len  = sim_slice.get_nelements();
+      double       *real = new double[len];
+      float        *out  = sim_slice.row_ptr(0);
+      _interp_intensities(discrete_label, flip_map, real, NULL);
+      for (n=0; n<len; n++){
+         out[n] = real[n];
       }
+      delete[] real;
 
    } else {
   
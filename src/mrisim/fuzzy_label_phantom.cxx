@@ -22,6 +22,7 @@
 //===========================================================================
 
 #include "fuzzy_label_phantom.h"
+#include <minc/mriprofile.h>
 
 //---------------------------------------------------------------------------
 // Fuzzy_Label_Phantom constructor
@@ -31,6 +32,15 @@ Fuzzy_Label_Phantom::Fuzzy_Label_Phantom(unsigned int n_tissue_classes) :
    Phantom(n_tissue_classes) {
 
    _tissue_label_file = new I_MINC_File[n_tissue_classes];
+   _preload_flag      = FALSE;
+   _label_volume      = new MRI_Float_Volume *[n_tissue_classes];
+   _volume_slice      = new Fuzzy_Label_Slice *[n_tissue_classes];
+
+   unsigned int itissue;
+   for (itissue=0; itissue<n_tissue_classes; itissue++){
+      _label_volume[itissue] = NULL;
+      _volume_slice[itissue] = NULL;
+   }
 
 }
 
@@ -40,6 +50,20 @@ Fuzzy_Label_Phantom::Fuzzy_Label_Phantom(unsigned int n_tissue_classes) :
 
 Fuzzy_Label_Phantom::~Fuzzy_Label_Phantom() {
 
+   unsigned int itissue;
+   int          slice_num;
+   for (itissue=0; itissue<get_num_tissues(); itissue++){
+      if (_volume_slice[itissue] != NULL) {
+         for (slice_num=0; slice_num<get_nslices(); slice_num++){
+            delete[] _volume_slice[itissue][slice_num].span;
+         }
+         delete[] _volume_slice[itissue];
+      }
+      if (_label_volume[itissue] != NULL) delete _label_volume[itissue];
+   }
+   delete[] _volume_slice;
+   delete[] _label_volume;
+
    this->close_label_files();
    delete[] _tissue_label_file;
 
@@ -83,6 +107,11 @@ int Fuzzy_Label_Phantom::open_fuzzy_label_file(Tissue_Label tissue_label,
            << _tissue_label_file[0].get_filename() << "."
            << endl; 
    }
+
+   // Read the whole volume now if it is to be held in memory
+   if (_preload_flag && label_file.is_good() && consistent) {
+      _preload_label_volume(tissue_index);
+   }
       
    return (label_file.is_good() && consistent);
 
@@ -107,20 +136,346 @@ void Fuzzy_Label_Phantom::close_label_files(void){
 
 }
 
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::use_label_preload
+// Selects whether the label volumes opened from now on are read whole
+// into memory.
+//---------------------------------------------------------------------------
+
+void Fuzzy_Label_Phantom::use_label_preload(int flag) {
+   _preload_flag = flag;
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::get_label_volume_bytes
+// Returns the memory, in bytes, taken by the label volumes of the open
+// label files as preloaded floats, whether or not they are preloaded.
+//---------------------------------------------------------------------------
+
+double Fuzzy_Label_Phantom::get_label_volume_bytes(void) const {
+
+   unsigned int itissue, nopen = 0;
+
+   for (itissue=0; itissue<get_num_tissues(); itissue++){
+      if (_tissue_label_file[itissue].is_open()) nopen++;
+   }
+   if (nopen == 0) return 0.0;
+
+   return (double)nopen * (double)get_nslices() *
+          (double)get_nrows() * (double)get_ncols() * sizeof(float);
+
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::write_packed_label_file
+// Converts the fuzzy volumes to a packed phantom file, a slice at a
+// time.  Returns FALSE, and removes the file, if it cannot be written.
+//---------------------------------------------------------------------------
+
+int Fuzzy_Label_Phantom::write_packed_label_file(const char *path,
+                                                 unsigned int ntop) {
+
+   unsigned int ntissues  = get_num_tissues();
+   unsigned int nelements = get_nrows()*get_ncols();
+   unsigned int itissue;
+   int          slice_num;
+
+   Volume_Info volume_info;
+   get_volume_info(volume_info);
+
+   Label *label = new Label[ntissues];
+   for (itissue=0; itissue<ntissues; itissue++){
+      label[itissue] = get_tissue_label(itissue);
+   }
+
+   Packed_Label_File packed_file;
+   int ok = packed_file.create(path, ntop, ntissues, label, volume_info);
+
+   Packed_Label *packed_slice = new Packed_Label[nelements*ntop];
+   const float **fraction     = new const float *[ntissues];
+
+   for (slice_num=0; ok && slice_num<get_nslices(); slice_num++){
+      Fuzzy_Label_Slice *label_slice = _load_label_slices(slice_num);
+      for (itissue=0; itissue<ntissues; itissue++){
+         fraction[itissue] = label_slice[itissue].label;
+      }
+      Packed_Label_File::pack_slice(ntop, ntissues, label, fraction,
+                                    nelements, packed_slice);
+      _free_label_slices(label_slice);
+
+      ok = packed_file.write_slice(packed_slice);
+   }
+
+   ok = packed_file.finish() && ok;
+   if (!ok) {
+      remove(path);
+   }
+
+   delete[] fraction;
+   delete[] packed_slice;
+   delete[] label;
+
+   return ok;
+
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::_preload_label_volume
+// Reads every slice of a tissue's fuzzy volume into memory, through the
+// same ICV as the slices read on demand, and finds the runs of nonzero
+// fractions of each slice.
+//---------------------------------------------------------------------------
+
+void Fuzzy_Label_Phantom::_preload_label_volume(unsigned int tissue_index) {
+
+   MRI_Profile_Timer timer(MRI_Profile::TIME_LABEL_LOAD);
+
+   I_MINC_File &label_file = _tissue_label_file[tissue_index];
+   int          nslices    = label_file.get_nslices();
+   unsigned int nelements  = label_file.get_nrows()*label_file.get_ncols();
+   int          slice_num;
+
+   if (_label_volume[tissue_index] == NULL) {
+      _label_volume[tissue_index] = new MRI_Float_Volume(
+         label_file.get_nrows(), label_file.get_ncols(), nslices);
+      _volume_slice[tissue_index] = new Fuzzy_Label_Slice[nslices];
+   } else {
+      for (slice_num=0; slice_num<nslices; slice_num++){
+         delete[] _volume_slice[tissue_index][slice_num].span;
+      }
+   }
+
+   MRI_Float_Volume  &volume = *(_label_volume[tissue_index]);
+   Fuzzy_Label_Slice *slice  = _volume_slice[tissue_index];
+
+   for (slice_num=0; slice_num<nslices; slice_num++){
+      label_file.load_slice(slice_num, (void *)volume[slice_num]);
+      slice[slice_num].label = volume[slice_num];
+      _find_spans(slice[slice_num], nelements);
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::_find_spans
+// Finds the runs of a label slice that hold its nonzero fractions.
+// Runs closer than LABEL_SPAN_GAP are joined.
+//---------------------------------------------------------------------------
+
+void Fuzzy_Label_Phantom::_find_spans(Fuzzy_Label_Slice& label_slice,
+                                      unsigned int nelements) {
+
+   const float *label = label_slice.label;
+   unsigned int n, end, pass, nspans = 0;
+
+   // Count the runs on the first pass and store them on the second
+
+   label_slice.span = NULL;
+   for (pass=0; pass<2; pass++){
+      nspans = 0;
+      end    = 0;
+      for (n=0; n<nelements; n++){
+         if (label[n] == 0.0) continue;
+         if (nspans > 0 && n < end + LABEL_SPAN_GAP) {
+            end = n+1;
+            if (pass == 1) label_slice.span[2*nspans-1] = end;
+         } else {
+            end = n+1;
+            if (pass == 1) {
+               label_slice.span[2*nspans]   = n;
+               label_slice.span[2*nspans+1] = end;
+            }
+            nspans++;
+         }
+      }
+      if (pass == 0) label_slice.span = new unsigned int[2*nspans+1];
+   }
+   label_slice.nspans = nspans;
+
+}
+
 //---------------------------------------------------------------------------
 // Fuzzy_Label_Phantom::_load_label_slice
 // Load a slice of the labelled volume into memory from a MINC file.
 //---------------------------------------------------------------------------
 
 void Fuzzy_Label_Phantom::_load_label_slice(int slice_num,
-                                      Tissue_Label tissue_label,
-                                      Real_Slice& label_slice) {
+                                            unsigned int tissue_index,
+                                            float label_slice[]) {
+
+   MRI_Profile_Timer timer(MRI_Profile::TIME_LABEL_LOAD);
+
+   _tissue_label_file[tissue_index].load_slice(slice_num,
+                                               (void *)label_slice);
+
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::_load_label_slices
+// Returns a slice of every tissue's fuzzy volume, indexed by tissue
+// index.  Preloaded tissues share their slices and runs; the others are
+// read from their files and their runs found.  Free the returned slices
+// with _free_label_slices.
+//---------------------------------------------------------------------------
+
+Fuzzy_Label_Slice *Fuzzy_Label_Phantom::_load_label_slices(int slice_num) {
+
+   unsigned int itissue;
+   unsigned int nelements = get_nrows()*get_ncols();
+   Fuzzy_Label_Slice *label_slice = new Fuzzy_Label_Slice[get_num_tissues()];
+
+   for (itissue=0; itissue<get_num_tissues(); itissue++){
+      if (_volume_slice[itissue] != NULL) {
+         label_slice[itissue] = _volume_slice[itissue][slice_num];
+      } else {
+         float *slice = new float[nelements];
+         _load_label_slice(slice_num, itissue, slice);
+         label_slice[itissue].label = slice;
+         _find_spans(label_slice[itissue], nelements);
+      }
+   }
+
+   return label_slice;
+
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::_free_label_slices
+// Deletes slices loaded by _load_label_slices.
+//---------------------------------------------------------------------------
+
+void Fuzzy_Label_Phantom::_free_label_slices(Fuzzy_Label_Slice *label_slice)
+   const {
+
+   unsigned int itissue;
+   for (itissue=0; itissue<get_num_tissues(); itissue++){
+      if (_volume_slice[itissue] == NULL) {
+         delete[] label_slice[itissue].label;
+         delete[] label_slice[itissue].span;
+      }
+   }
+   delete[] label_slice;
+
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::_mix_tissues
+// Computes the fuzzy weighted average of the tissue intensities,
+//
+//    sim_slice = sum(label_slice[i] * intensity[i]) / sum(label_slice[i])
+//
+// in a single pass over the slice.  Voxels are processed a tile at a
+// time, accumulating every tissue into small buffers that stay in cache
+// before normalizing and storing the tile.  Tissues are added in index
+// order with the same rounding as the former tissue-by-tissue loops.
+// Each tissue is added over its runs of nonzero fractions only, which
+// leaves the sums unchanged, and a tissue with no run in the tile is
+// skipped.
+//---------------------------------------------------------------------------
+
+#define MIX_TILE 256
+
+void Fuzzy_Label_Phantom::_mix_tissues(const Fuzzy_Label_Slice label_slice[],
+                                       const double intensity[],
+                                       Real_Slice& sim_slice) const {
+
+#ifdef DEBUG
+   assert(this->is_same_slice_size_as(sim_slice));
+#endif
+
+   unsigned int ntissues = get_num_tissues();
+   unsigned int len      = sim_slice.get_nelements();
+   float        *out     = sim_slice.row_ptr(0);
+
+   float        acc[MIX_TILE], sum[MIX_TILE];
+   unsigned int start, count, itissue, n, k, first, last;
+   unsigned int *cursor  = new unsigned int[ntissues];
+
+   for (itissue=0; itissue<ntissues; itissue++){
+      cursor[itissue] = 0;
+   }
+
+   for (start=0; start<len; start+=MIX_TILE){
+      count = (len-start < MIX_TILE) ? len-start : MIX_TILE;
+
+      for (n=0; n<count; n++){
+         acc[n] = 0.0;
+         sum[n] = 0.0;
+      }
+
+      for (itissue=0; itissue<ntissues; itissue++){
+         const Fuzzy_Label_Slice &slice = label_slice[itissue];
+         const float *label = slice.label + start;
+         double      a      = intensity[itissue];
+         for (k=_skip_spans(slice, start, cursor[itissue]);
+              _tile_span(slice, k, start, count, first, last); k++){
+            for (n=first; n<last; n++){
+               acc[n] += label[n] * a;
+               sum[n] += label[n];
+            }
+         }
+      }
+
+      for (n=0; n<count; n++){
+         out[start+n] = acc[n] / sum[n];
+      }
+   }
+
+   delete[] cursor;
+
+}
+
+void Fuzzy_Label_Phantom::_mix_tissues(const Fuzzy_Label_Slice label_slice[],
+                                       const double real_intensity[],
+                                       const double imag_intensity[],
+                                       Complex_Slice& sim_slice) const {
 
 #ifdef DEBUG
-   assert(this->is_same_slice_size_as(label_slice));
+   assert(this->is_same_slice_size_as(sim_slice));
 #endif
 
-   unsigned int tissue_index = Phantom::get_tissue_index(tissue_label); 
-   _tissue_label_file[tissue_index].load_slice(slice_num, (void *)label_slice);
+   unsigned int ntissues = get_num_tissues();
+   unsigned int len      = sim_slice.get_nelements();
+   float        *out     = sim_slice.row_ptr(0);
+
+   float        re[MIX_TILE], im[MIX_TILE], sum[MIX_TILE];
+   unsigned int start, count, itissue, n, k, first, last;
+   unsigned int *cursor  = new unsigned int[ntissues];
+
+   for (itissue=0; itissue<ntissues; itissue++){
+      cursor[itissue] = 0;
+   }
+
+   for (start=0; start<len; start+=MIX_TILE){
+      count = (len-start < MIX_TILE) ? len-start : MIX_TILE;
+
+      for (n=0; n<count; n++){
+         re[n]  = 0.0;
+         im[n]  = 0.0;
+         sum[n] = 0.0;
+      }
+
+      for (itissue=0; itissue<ntissues; itissue++){
+         const Fuzzy_Label_Slice &slice = label_slice[itissue];
+         const float *label = slice.label + start;
+         double      a      = real_intensity[itissue];
+         double      b      = imag_intensity[itissue];
+         for (k=_skip_spans(slice, start, cursor[itissue]);
+              _tile_span(slice, k, start, count, first, last); k++){
+            for (n=first; n<last; n++){
+               re[n]  += label[n] * a;
+               im[n]  += label[n] * b;
+               sum[n] += label[n];
+            }
+         }
+      }
+
+      for (n=0; n<count; n++){
+         out[2*(start+n)]   = re[n] / sum[n];
+         out[2*(start+n)+1] = im[n] / sum[n];
+      }
+   }
+
+   delete[] cursor;
 
 }
@@ -28,10 +28,37 @@
 #include "phantom.h"
 #include <minc/imincfile.h>
 #include <minc/mrimatrix.h>
+#include <minc/mrivolume.h>
+#include "packed_label_file.h"
+
+// Zero fractions between two runs of a Fuzzy_Label_Slice that are
+// kept inside one run rather than splitting it
+#define LABEL_SPAN_GAP 16
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Slice
+// One slice of a tissue's fuzzy volume and the runs of elements that
+// hold all of its nonzero fractions, in raster order.  The extent of
+// the runs bounds the tissue in the slice; a tissue absent from the
+// slice has no runs.  Gaps of fewer than LABEL_SPAN_GAP zeros are kept
+// inside a run so that the runs stay long enough to vectorize.
+//---------------------------------------------------------------------------
+
+struct Fuzzy_Label_Slice {
+   const float  *label;          // fractions of the whole slice
+   unsigned int  nspans;
+   unsigned int *span;           // {begin0, end0, begin1, end1, ...}
+};
 
 //---------------------------------------------------------------------------
 // Fuzzy_Label_Phantom class
-// Describes a fuzzy labelled MRI phantom.
+// Describes a fuzzy labelled MRI phantom.  The fuzzy volume of each
+// tissue is either read slice by slice from its MINC file when a slice
+// is synthesized, or, with use_label_preload, read whole into memory
+// when the file is opened so that synthesis indexes memory directly.
+// Either way each label slice comes with its runs of nonzero fractions,
+// found once per preloaded volume, and the tissues are mixed over their
+// runs only.
 //---------------------------------------------------------------------------
 
 class Fuzzy_Label_Phantom : virtual public Phantom {
@@ -45,6 +72,19 @@ class Fuzzy_Label_Phantom : virtual public Phantom {
                                  const char *path);
       void close_label_files(void);
 
+      // --- Label volumes in memory --- //
+      // use_label_preload must be called before the label files are
+      // opened.  get_label_volume_bytes is the memory taken by the
+      // label volumes of the files opened so far when they are preloaded.
+      void   use_label_preload(int flag);
+      inline int has_preloaded_labels(void) const;
+      double get_label_volume_bytes(void) const;
+
+      // --- Packed phantom conversion --- //
+      // Writes the fuzzy volumes of the installed tissues to a single
+      // Packed_Label_File keeping ntop tissues for each voxel.
+      int write_packed_label_file(const char *path, unsigned int ntop);
+
       // --- Volume convenience functions --- //
       inline int    is_same_slice_size_as(const MRI_Matrix& mat) const;
       inline int    get_nrows(void) const;
@@ -62,12 +102,43 @@ class Fuzzy_Label_Phantom : virtual public Phantom {
    protected:
 
       // --- Internal member functions --- //
-      void _load_label_slice(int slice_num, 
-                             Tissue_Label tissue_label,
-                             Real_Slice& label_slice);
+      void _load_label_slice(int slice_num, unsigned int tissue_index,
+                             float label_slice[]);
+      void _preload_label_volume(unsigned int tissue_index);
+
+      static void _find_spans(Fuzzy_Label_Slice& label_slice,
+                              unsigned int nelements);
+
+      // Runs of a label slice that overlap a tile of count elements from
+      // start: _skip_spans moves the cursor past the runs that end before
+      // the tile and returns it; _tile_span gives the part of run k in
+      // the tile, relative to start, or returns FALSE past the tile.
+      static inline unsigned int _skip_spans(const Fuzzy_Label_Slice& slice,
+                                             unsigned int start,
+                                             unsigned int& cursor);
+      static inline int _tile_span(const Fuzzy_Label_Slice& slice,
+                                   unsigned int k, unsigned int start,
+                                   unsigned int count, unsigned int& first,
+                                   unsigned int& last);
+
+      // The label slice of each tissue, indexed by tissue index.  Points
+      // into the preloaded volumes where there are any.
+      Fuzzy_Label_Slice *_load_label_slices(int slice_num);
+      void _free_label_slices(Fuzzy_Label_Slice *label_slice) const;
+
+      void _mix_tissues(const Fuzzy_Label_Slice label_slice[],
+                        const double intensity[],
+                        Real_Slice& sim_slice) const;
+      void _mix_tissues(const Fuzzy_Label_Slice label_slice[],
+                        const double real_intensity[],
+                        const double imag_intensity[],
+                        Complex_Slice& sim_slice) const;
 
       // --- Internal data structures --- //
       I_MINC_File *_tissue_label_file;
+      int                 _preload_flag;
+      MRI_Float_Volume  **_label_volume;  // preloaded, or NULL
+      Fuzzy_Label_Slice **_volume_slice;  // slices of each, or NULL
 
 };
 
@@ -75,6 +146,49 @@ class Fuzzy_Label_Phantom : virtual public Phantom {
 // Inline member functions
 //---------------------------------------------------------------------------
 
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::has_preloaded_labels
+// Returns TRUE if the label volumes are read into memory when opened.
+//---------------------------------------------------------------------------
+
+inline
+int Fuzzy_Label_Phantom::has_preloaded_labels(void) const {
+   return _preload_flag;
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::_skip_spans
+// Steps the cursor past the runs that end at or before start.
+//---------------------------------------------------------------------------
+
+inline
+unsigned int Fuzzy_Label_Phantom::_skip_spans(const Fuzzy_Label_Slice& slice,
+                                              unsigned int start,
+                                              unsigned int& cursor) {
+   while (cursor < slice.nspans && slice.span[2*cursor+1] <= start) {
+      cursor++;
+   }
+   return cursor;
+}
+
+//---------------------------------------------------------------------------
+// Fuzzy_Label_Phantom::_tile_span
+// Clips run k to the tile.  Returns FALSE if run k starts past the tile
+// or there is no run k.
+//---------------------------------------------------------------------------
+
+inline
+int Fuzzy_Label_Phantom::_tile_span(const Fuzzy_Label_Slice& slice,
+                                    unsigned int k, unsigned int start,
+                                    unsigned int count, unsigned int& first,
+                                    unsigned int& last) {
+   if (k >= slice.nspans || slice.span[2*k] >= start+count) return FALSE;
+   first = ((slice.span[2*k] > start) ? slice.span[2*k]-start : 0);
+   last  = ((slice.span[2*k+1] < start+count) ?
+            slice.span[2*k+1]-start : count);
+   return TRUE;
+}
+
 //---------------------------------------------------------------------------
 // Fuzzy_Label_Phantom::is_same_slice_size_as
 // Returns TRUE if the matrix has the same row and column dimensions as
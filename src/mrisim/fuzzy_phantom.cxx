@@ -57,46 +57,25 @@ void Fuzzy_Phantom::get_simulated_phantom_slice(int slice_num,
    assert(slice_num < get_nslices());
 #endif
 
-   // Create a fuzzy label slice of the same size
-   Real_Slice fuzzy_label(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice sum(sim_slice.get_nrows(), sim_slice.get_ncols());
-
-   // Clear the slice
-   sim_slice.zeros();
-   sum.zeros();
- 
-   // Loop over each tissue type computing the weighting
-   unsigned int itissue, m, n;
-   Tissue_Label tissue_label;
-
-   for (itissue=0; itissue<get_num_tissues(); itissue++){
-
-      tissue_label = get_tissue_label(itissue);
-      _load_label_slice(slice_num, tissue_label, fuzzy_label);
-
-      //sim_slice.saxpy(get_real_intensity(tissue_label),
-      //                get_imag_intensity(tissue_label), 
-      //                fuzzy_label, sim_slice);
-
-      for (m=0; m<sim_slice.get_nrows(); m++){
-         for (n=0; n<sim_slice.get_ncols(); n++){
-            sim_slice.real(m,n) += fuzzy_label(m,n) *
+   // Look up the intensity of each tissue once for the slice
+   unsigned int itissue, ntissues = get_num_tissues();
+   double *real_intensity = new double[ntissues];
+   double *imag_intensity = new double[ntissues];
+   for (itissue=0; itissue<ntissues; itissue++){
+      Tissue_Label tissue_label = get_tissue_label(itissue);
+      real_intensity[itissue] = 
                      Tissue_Phantom::get_real_intensity(tissue_label);
-            sim_slice.imag(m,n) += fuzzy_label(m,n) *
+      imag_intensity[itissue] = 
                      Tissue_Phantom::get_imag_intensity(tissue_label);
-            sum(m,n) += fuzzy_label(m,n);
-         }
-      }
-                                  
    }
 
-   // --- Fuzzy volume normalization --- //
-   for (m=0; m<sim_slice.get_nrows(); m++){
-      for (n=0; n<sim_slice.get_ncols(); n++){
-         sim_slice.real(m,n) /= sum(m,n);
-         sim_slice.imag(m,n) /= sum(m,n);
-      }
-   }
+   // Weight each tissue by its fuzzy label and normalize
+   Fuzzy_Label_Slice *fuzzy_label = _load_label_slices(slice_num);
+   _mix_tissues(fuzzy_label, real_intensity, imag_intensity, sim_slice);
+   _free_label_slices(fuzzy_label);
+
+   delete[] real_intensity;
+   delete[] imag_intensity;
 
 }
 
@@ -115,35 +94,20 @@ void Fuzzy_Phantom::get_simulated_mag_phantom_slice(int slice_num,
    assert(slice_num < get_nslices());
 #endif
 
-   // Create a fuzzy label slice of the same size
-   Real_Slice fuzzy_label(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice sum(sim_slice.get_nrows(), sim_slice.get_ncols());
-
-   // Clear the slice
-   sim_slice.zeros();
-   sum.zeros();
- 
-   // Loop over each tissue type computing the weighting
-   unsigned int itissue, m, n;
-   Tissue_Label tissue_label;
-
-   for (itissue=0; itissue<get_num_tissues(); itissue++){
-
-      tissue_label = get_tissue_label(itissue);
-      _load_label_slice(slice_num, tissue_label, fuzzy_label);
+   // Look up the intensity of each tissue once for the slice
+   unsigned int itissue, ntissues = get_num_tissues();
+   double *intensity = new double[ntissues];
+   for (itissue=0; itissue<ntissues; itissue++){
+      intensity[itissue] = 
+             Tissue_Phantom::get_mag_intensity(get_tissue_label(itissue));
+   }
 
-      for (m=0; m<sim_slice.get_nrows(); m++){
-         for (n=0; n<sim_slice.get_ncols(); n++){
-            sim_slice(m,n) += fuzzy_label(m,n) *
-                              Tissue_Phantom::get_mag_intensity(tissue_label);
-            sum(m,n) += fuzzy_label(m,n);
-         }
-      }
+   // Weight each tissue by its fuzzy label and normalize
+   Fuzzy_Label_Slice *fuzzy_label = _load_label_slices(slice_num);
+   _mix_tissues(fuzzy_label, intensity, sim_slice);
+   _free_label_slices(fuzzy_label);
 
-   }
- 
-   // --- Fuzzy volume normalization --- //
-   sim_slice /= sum;
+   delete[] intensity;
 
 }
 
@@ -162,37 +126,19 @@ void Fuzzy_Phantom::get_simulated_real_phantom_slice(int slice_num,
    assert(slice_num < get_nslices());
 #endif
 
-   // Create a fuzzy label slice of the same size
-   Real_Slice fuzzy_label(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice sum(sim_slice.get_nrows(), sim_slice.get_ncols());
-
-   // Clear the slice
-   sim_slice.zeros();
-   sum.zeros();
-
-   // Loop over each tissue type computing the weighting
-   unsigned int itissue, m, n;
-   Tissue_Label tissue_label;
-
-   for (itissue=0; itissue<get_num_tissues(); itissue++){
-
-      tissue_label = get_tissue_label(itissue);
-      _load_label_slice(slice_num, tissue_label, fuzzy_label);
-
-      //sim_slice.saxpy(get_real_intensity(tissue_label),
-      //                fuzzy_label, sim_slice);
-
-      for (m=0; m<sim_slice.get_nrows(); m++){
-         for (n=0; n<sim_slice.get_ncols(); n++){
-            sim_slice(m,n) += fuzzy_label(m,n) *
-                              Tissue_Phantom::get_real_intensity(tissue_label);
-            sum(m,n) += fuzzy_label(m,n);
-         }
-      }
-
+   // Look up the intensity of each tissue once for the slice
+   unsigned int itissue, ntissues = get_num_tissues();
+   double *intensity = new double[ntissues];
+   for (itissue=0; itissue<ntissues; itissue++){
+      intensity[itissue] = 
+             Tissue_Phantom::get_real_intensity(get_tissue_label(itissue));
    }
 
-   // --- Fuzzy volume normalization --- //
-   sim_slice /= sum;
+   // Weight each tissue by its fuzzy label and normalize
+   Fuzzy_Label_Slice *fuzzy_label = _load_label_slices(slice_num);
+   _mix_tissues(fuzzy_label, intensity, sim_slice);
+   _free_label_slices(fuzzy_label);
+
+   delete[] intensity;
 
 }
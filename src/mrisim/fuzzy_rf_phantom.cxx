@@ -100,77 +100,47 @@ void Fuzzy_RF_Phantom::get_simulated_phantom_slice(int slice_num,
 #endif
 
    Real_Slice rf_map(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice fuzzy_label(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice sum(sim_slice.get_nrows(), sim_slice.get_ncols());
-
-   // Clear slice
-   sim_slice.zeros();
-   sum.zeros();
 
    // --- Apply RF transmit inhomogeneity --- //
 
-   unsigned int itissue, m, n;
+   unsigned int itissue;
    Tissue_Label tissue_label;
 
    if (uses_tx_map()) {
 
-      // Load RF coil transmit map
+      // Load RF coil transmit map and find each voxel's position in
+      // the flip angle error tables, shared by all tissues
       load_tx_map_slice(slice_num, rf_map);
- 
-      // Generate simulated slice with transmit inhomogeneity 
-      // Loop over each tissue type computing signal contribution
-      for (itissue=0; itissue<get_num_tissues(); itissue++){
+      Flip_Error_Map flip_map(rf_map.get_nelements());
+      _get_flip_error_map(rf_map, flip_map);
 
-         tissue_label = get_tissue_label(itissue);
-         _load_label_slice(slice_num, tissue_label, fuzzy_label);
-
-         for (m=0; m<sim_slice.get_nrows(); m++){
-            for (n=0; n<sim_slice.get_ncols(); n++){
-
-               sim_slice.real(m,n) += fuzzy_label(m,n) *
-                        RF_Tissue_Phantom::get_real_intensity(tissue_label,
-                                                         (double)rf_map(m,n));
-               sim_slice.imag(m,n) += fuzzy_label(m,n) *
-                        RF_Tissue_Phantom::get_imag_intensity(tissue_label,
-                                                         (double)rf_map(m,n));
-               sum(m,n) += fuzzy_label(m,n);
-            }
-         }
+      // Generate simulated slice with transmit inhomogeneity
+      Fuzzy_Label_Slice *fuzzy_labels = _load_label_slices(slice_num);
+      _mix_tx_tissues(fuzzy_labels, flip_map, sim_slice);
+      _free_label_slices(fuzzy_labels);
 
-      }
-   
    } else {
 
       // Generate simulated slice without transmit inhomogeneity
-      // Loop over each tissue type computing signal contribution
+      // Tissue intensities are constant over the slice, so all tissues
+      // are weighted and normalized in a single pass
+      double *real_intensity = new double[get_num_tissues()];
+      double *imag_intensity = new double[get_num_tissues()];
       for (itissue=0; itissue<get_num_tissues(); itissue++){
- 
          tissue_label = get_tissue_label(itissue);
-         _load_label_slice(slice_num, tissue_label, fuzzy_label);
-
-         for (m=0; m<sim_slice.get_nrows(); m++){
-            for (n=0; n<sim_slice.get_ncols(); n++){
-   
-               sim_slice.real(m,n) += fuzzy_label(m,n) *
-                        RF_Tissue_Phantom::get_real_intensity(tissue_label);
-               sim_slice.imag(m,n) += fuzzy_label(m,n) *
-                        RF_Tissue_Phantom::get_imag_intensity(tissue_label);
-               sum(m,n) += fuzzy_label(m,n);
-
-            }
-         }
-
+         real_intensity[itissue] = 
+                  RF_Tissue_Phantom::get_real_intensity(tissue_label);
+         imag_intensity[itissue] = 
+                  RF_Tissue_Phantom::get_imag_intensity(tissue_label);
       }
 
-   }
+      Fuzzy_Label_Slice *fuzzy_labels = _load_label_slices(slice_num);
+      _mix_tissues(fuzzy_labels, real_intensity, imag_intensity, sim_slice);
+      _free_label_slices(fuzzy_labels);
 
-   // --- Fuzzy volume normalization --- //
+      delete[] real_intensity;
+      delete[] imag_intensity;
 
-   for (m=0; m<sim_slice.get_nrows(); m++){
-      for (n=0; n<sim_slice.get_ncols(); n++){
-         sim_slice.real(m,n) /= sum(m,n);
-         sim_slice.imag(m,n) /= sum(m,n);
-      }
    }
 
    // --- Apply RF receive inhomogeneity --- //
@@ -204,67 +174,44 @@ void Fuzzy_RF_Phantom::get_simulated_mag_phantom_slice(int slice_num,
 #endif
 
    Real_Slice rf_map(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice fuzzy_label(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice sum(sim_slice.get_nrows(), sim_slice.get_ncols());
-
-   // Clear the slice
-   sim_slice.zeros();
-   sum.zeros();
 
    // --- Apply RF transmit inhomogeneity --- //
 
-   unsigned int itissue, m, n;
+   unsigned int itissue;
    Tissue_Label tissue_label;
 
    if (uses_tx_map()) {
 
-      // Load RF coil transmit map
+      // Load RF coil transmit map and find each voxel's position in
+      // the flip angle error tables, shared by all tissues
       load_tx_map_slice(slice_num, rf_map);
+      Flip_Error_Map flip_map(rf_map.get_nelements());
+      _get_flip_error_map(rf_map, flip_map);
 
       // Generate simulated slice with transmit inhomogeneity
-      // Loop over each tissue type computing signal contribution
-      for (itissue=0; itissue<get_num_tissues(); itissue++){
-
-         tissue_label = get_tissue_label(itissue);
-         _load_label_slice(slice_num, tissue_label, fuzzy_label);
-
-         for (m=0; m<sim_slice.get_nrows(); m++){
-            for (n=0; n<sim_slice.get_ncols(); n++){
-
-               sim_slice(m,n) += fuzzy_label(m,n) *
-                        RF_Tissue_Phantom::get_mag_intensity(tissue_label,
-                                                         (double)rf_map(m,n));
-               sum(m,n) += fuzzy_label(m,n);
-            }
-         }
-
-      }
+      Fuzzy_Label_Slice *fuzzy_labels = _load_label_slices(slice_num);
+      _mix_tx_tissues(fuzzy_labels, flip_map, TRUE, sim_slice);
+      _free_label_slices(fuzzy_labels);
 
    } else {
 
       // Generate simulated slice without transmit inhomogeneity
-      // Loop over each tissue type computing signal contribution
+      // Tissue intensities are constant over the slice, so all tissues
+      // are weighted and normalized in a single pass
+      double *intensity = new double[get_num_tissues()];
       for (itissue=0; itissue<get_num_tissues(); itissue++){
-
          tissue_label = get_tissue_label(itissue);
-         _load_label_slice(slice_num, tissue_label, fuzzy_label);
-
-         for (m=0; m<sim_slice.get_nrows(); m++){
-            for (n=0; n<sim_slice.get_ncols(); n++){
+         intensity[itissue] = RF_Tissue_Phantom::get_mag_intensity(tissue_label);
+      }
 
-               sim_slice(m,n) += fuzzy_label(m,n) *
-                        RF_Tissue_Phantom::get_mag_intensity(tissue_label);
-               sum(m,n) += fuzzy_label(m,n);
-            }
-         }
+      Fuzzy_Label_Slice *fuzzy_labels = _load_label_slices(slice_num);
+      _mix_tissues(fuzzy_labels, intensity, sim_slice);
+      _free_label_slices(fuzzy_labels);
 
-      }
+      delete[] intensity;
 
    }
 
-   // --- Fuzzy volume normalization --- // 
-   sim_slice /= sum;
-
    // --- Apply RF receive inhomogeneity --- //
 
    // If a receive map has been specified, multiply the simulated slice
@@ -295,67 +242,44 @@ void Fuzzy_RF_Phantom::get_simulated_real_phantom_slice(int slice_num,
 #endif
 
    Real_Slice rf_map(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice fuzzy_label(sim_slice.get_nrows(), sim_slice.get_ncols());
-   Real_Slice sum(sim_slice.get_nrows(), sim_slice.get_ncols());
-
-   // Clear the slice
-   sim_slice.zeros();
-   sum.zeros();
 
    // --- Apply RF transmit inhomogeneity --- //
 
-   unsigned int itissue, m, n;
+   unsigned int itissue;
    Tissue_Label tissue_label;
 
    if (uses_tx_map()) {
 
-      // Load RF coil transmit map
+      // Load RF coil transmit map and find each voxel's position in
+      // the flip angle error tables, shared by all tissues
       load_tx_map_slice(slice_num, rf_map);
+      Flip_Error_Map flip_map(rf_map.get_nelements());
+      _get_flip_error_map(rf_map, flip_map);
 
       // Generate simulated slice with transmit inhomogeneity
-      // Loop over each tissue type computing signal contribution
-      for (itissue=0; itissue<get_num_tissues(); itissue++){
-
-         tissue_label = get_tissue_label(itissue);
-         _load_label_slice(slice_num, tissue_label, fuzzy_label);
-
-         for (m=0; m<sim_slice.get_nrows(); m++){
-            for (n=0; n<sim_slice.get_ncols(); n++){
-
-               sim_slice(m,n) += fuzzy_label(m,n) *
-                        RF_Tissue_Phantom::get_real_intensity(tissue_label,
-                                                         (double)rf_map(m,n));
-               sum(m,n) += fuzzy_label(m,n);
-            }
-         }
-
-      }
+      Fuzzy_Label_Slice *fuzzy_labels = _load_label_slices(slice_num);
+      _mix_tx_tissues(fuzzy_labels, flip_map, FALSE, sim_slice);
+      _free_label_slices(fuzzy_labels);
 
    } else {
 
       // Generate simulated slice without transmit inhomogeneity
-      // Loop over each tissue type computing signal contribution
+      // Tissue intensities are constant over the slice, so all tissues
+      // are weighted and normalized in a single pass
+      double *intensity = new double[get_num_tissues()];
       for (itissue=0; itissue<get_num_tissues(); itissue++){
-
          tissue_label = get_tissue_label(itissue);
-         _load_label_slice(slice_num, tissue_label, fuzzy_label);
-
-         for (m=0; m<sim_slice.get_nrows(); m++){
-            for (n=0; n<sim_slice.get_ncols(); n++){
+         intensity[itissue] = RF_Tissue_Phantom::get_real_intensity(tissue_label);
+      }
 
-               sim_slice(m,n) += fuzzy_label(m,n) *
-                        RF_Tissue_Phantom::get_real_intensity(tissue_label);
-               sum(m,n) += fuzzy_label(m,n);
-            }
-         }
+      Fuzzy_Label_Slice *fuzzy_labels = _load_label_slices(slice_num);
+      _mix_tissues(fuzzy_labels, intensity, sim_slice);
+      _free_label_slices(fuzzy_labels);
 
-      }
+      delete[] intensity;
 
    }
 
-   // --- Fuzzy volume normalization --- // 
-   sim_slice /= sum;
-
    // --- Apply RF receive inhomogeneity --- //
 
    // If a receive map has been specified, multiply the simulated slice
@@ -369,3 +293,133 @@ void Fuzzy_RF_Phantom::get_simulated_real_phantom_slice(int slice_num,
    }
 
 }
+
+//---------------------------------------------------------------------------
+// Fuzzy_RF_Phantom::_mix_tx_tissues
+// Computes the fuzzy weighted average of the tissue intensities under a
+// transmit map, in a single pass over the slice.  For each tile of
+// voxels, the intensities of every tissue are interpolated from the
+// flip error map and accumulated, then the tile is normalized.  Only
+// the runs of nonzero fractions of each tissue are interpolated and
+// accumulated.  If magnitude is TRUE the magnitude image is formed,
+// otherwise the real part.
+//---------------------------------------------------------------------------
+
+#define MIX_TILE 256
+
+void Fuzzy_RF_Phantom::_mix_tx_tissues(const Fuzzy_Label_Slice label_slice[],
+                                       const Flip_Error_Map& flip_map,
+                                       Complex_Slice& sim_slice) const {
+
+#ifdef DEBUG
+   assert(flip_map.nelements == sim_slice.get_nelements());
+#endif
+
+   unsigned int ntissues = get_num_tissues();
+   unsigned int len      = sim_slice.get_nelements();
+   float        *out     = sim_slice.row_ptr(0);
+
+   double       real[MIX_TILE], imag[MIX_TILE];
+   float        re[MIX_TILE], im[MIX_TILE], sum[MIX_TILE];
+   unsigned int start, count, itissue, n, k, first, last;
+   unsigned int *cursor  = new unsigned int[ntissues];
+
+   for (itissue=0; itissue<ntissues; itissue++){
+      cursor[itissue] = 0;
+   }
+
+   for (start=0; start<len; start+=MIX_TILE){
+      count = (len-start < MIX_TILE) ? len-start : MIX_TILE;
+
+      for (n=0; n<count; n++){
+         re[n]  = 0.0;
+         im[n]  = 0.0;
+         sum[n] = 0.0;
+      }
+
+      for (itissue=0; itissue<ntissues; itissue++){
+         const Fuzzy_Label_Slice &slice = label_slice[itissue];
+         const float *label = slice.label + start;
+         for (k=_skip_spans(slice, start, cursor[itissue]);
+              _tile_span(slice, k, start, count, first, last); k++){
+            _interp_intensities(itissue, flip_map, start+first, last-first,
+                                &(real[first]), &(imag[first]));
+            for (n=first; n<last; n++){
+               re[n]  += label[n] * real[n];
+               im[n]  += label[n] * imag[n];
+               sum[n] += label[n];
+            }
+         }
+      }
+
+      for (n=0; n<count; n++){
+         out[2*(start+n)]   = re[n] / sum[n];
+         out[2*(start+n)+1] = im[n] / sum[n];
+      }
+   }
+
+   delete[] cursor;
+
+}
+
+void Fuzzy_RF_Phantom::_mix_tx_tissues(const Fuzzy_Label_Slice label_slice[],
+                                       const Flip_Error_Map& flip_map,
+                                       int magnitude,
+                                       Real_Slice& sim_slice) const {
+
+#ifdef DEBUG
+   assert(flip_map.nelements == sim_slice.get_nelements());
+#endif
+
+   unsigned int ntissues = get_num_tissues();
+   unsigned int len      = sim_slice.get_nelements();
+   float        *out     = sim_slice.row_ptr(0);
+
+   double       real[MIX_TILE], imag[MIX_TILE];
+   float        acc[MIX_TILE], sum[MIX_TILE];
+   unsigned int start, count, itissue, n, k, first, last;
+   unsigned int *cursor  = new unsigned int[ntissues];
+
+   for (itissue=0; itissue<ntissues; itissue++){
+      cursor[itissue] = 0;
+   }
+
+   for (start=0; start<len; start+=MIX_TILE){
+      count = (len-start < MIX_TILE) ? len-start : MIX_TILE;
+
+      for (n=0; n<count; n++){
+         acc[n] = 0.0;
+         sum[n] = 0.0;
+      }
+
+      for (itissue=0; itissue<ntissues; itissue++){
+         const Fuzzy_Label_Slice &slice = label_slice[itissue];
+         const float *label = slice.label + start;
+         for (k=_skip_spans(slice, start, cursor[itissue]);
+              _tile_span(slice, k, start, count, first, last); k++){
+            if (magnitude) {
+               _interp_intensities(itissue, flip_map, start+first,
+                                   last-first, &(real[first]),
+                                   &(imag[first]));
+               for (n=first; n<last; n++){
+                  real[n] = hypot(real[n], imag[n]);
+               }
+            } else {
+               _interp_intensities(itissue, flip_map, start+first,
+                                   last-first, &(real[first]), NULL);
+            }
+            for (n=first; n<last; n++){
+               acc[n] += label[n] * real[n];
+               sum[n] += label[n];
+            }
+         }
+      }
+
+      for (n=0; n<count; n++){
+         out[start+n] = acc[n] / sum[n];
+      }
+   }
+
+   delete[] cursor;
+
+}
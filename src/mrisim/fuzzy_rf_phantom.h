@@ -56,6 +56,14 @@ class Fuzzy_RF_Phantom : public Fuzzy_Label_Phantom,
       void get_simulated_real_phantom_slice(int slice_num,
                                        Real_Slice& sim_slice);
 
+   private:
+      void _mix_tx_tissues(const Fuzzy_Label_Slice label_slice[],
+                           const Flip_Error_Map& flip_map,
+                           Complex_Slice& sim_slice) const;
+      void _mix_tx_tissues(const Fuzzy_Label_Slice label_slice[],
+                           const Flip_Error_Map& flip_map, int magnitude,
+                           Real_Slice& sim_slice) const;
+
 };
 
 //---------------------------------------------------------------------------
@@ -42,10 +42,12 @@
 //==========================================================================
 
 #include <iostream>
+#include <string.h>
 #include <mrisim/mrisim.h>
 #include "phantom.h"
 #include "../minc/mriimage.h"
 #include "../signal/pulseseq.h"
+#include "../minc/mriprofile.h"
 
 #include "mriscanner.h"
 
@@ -59,6 +61,9 @@ MRI_Scanner::MRI_Scanner() {
    _rf_coil      = (RF_Coil *)NULL;
 
    _signal_gain  = 1.0;
+
+   _slab_encoder = (Slab_Encoder *)NULL;
+   _slab         = (Complex_Slice *)NULL;
 }
 
 //--------------------------------------------------------------------------
@@ -66,6 +71,8 @@ MRI_Scanner::MRI_Scanner() {
 //--------------------------------------------------------------------------
 
 MRI_Scanner::~MRI_Scanner() {
+   _free_slab();
+   if (_current_pseq != NULL) delete _current_pseq;
    if (_phantom != NULL) delete _phantom;
    if (_rf_coil != NULL) delete _rf_coil;
 }
@@ -111,7 +118,9 @@ int MRI_Scanner::attach(RF_Coil *rf_coil) {
 
 //--------------------------------------------------------------------------
 // MRI_Scanner::apply
-// Applies the current pulse sequence to the phantom model.
+// Applies the current pulse sequence to the phantom model.  The scanner
+// takes ownership of the pulse sequence, which is deleted when the next
+// one is applied or the scanner is destroyed.
 //--------------------------------------------------------------------------
 
 int MRI_Scanner::apply(Quick_Sequence *pseq) {
@@ -120,7 +129,11 @@ int MRI_Scanner::apply(Quick_Sequence *pseq) {
    assert(pseq != NULL);
 #endif
    
+   if (_current_pseq != NULL && _current_pseq != pseq) {
+      delete _current_pseq;
+   }
    _current_pseq = (Pulse_Sequence *)pseq;
+   _free_slab();
 
    if (!has_attached_phantom()) {
       cerr << "MRI_Scanner:  No attached phantom." << endl;
@@ -141,7 +154,11 @@ int MRI_Scanner::apply(Custom_Sequence *pseq) {
    assert(pseq != NULL);
 #endif
 
+   if (_current_pseq != NULL && _current_pseq != pseq) {
+      delete _current_pseq;
+   }
    _current_pseq = (Pulse_Sequence *)pseq;
+   _free_slab();
 
    if (!has_attached_phantom()) {
       cerr << "MRI_Scanner:  No attached phantom." << endl;
@@ -271,13 +288,16 @@ void MRI_Scanner::get_simulated_image_slice(int slice, MRI_Image& image_slice) {
 
    // Add noise and scale the image
 
+   Noise_Stream stream;
+   _rf_coil->init_noise_stream(slice, stream);
+
    switch(get_image_type()){
       case REAL_IMAGE:
       case IMAG_IMAGE:
-         _rf_coil->add_noise_to_real_image(noisy_slice);
+         _rf_coil->add_noise_to_real_image(noisy_slice, stream);
          break;
       case MOD_IMAGE:
-         _rf_coil->add_noise_to_modulus_image(noisy_slice);
+         _rf_coil->add_noise_to_modulus_image(noisy_slice, stream);
       default:
          break;
    }
@@ -297,24 +317,95 @@ void MRI_Scanner::get_simulated_image_slice(int slice, MRI_Image& image_slice) {
 }
 
 //--------------------------------------------------------------------------
-// MRI_Scanner::get_raw_slice
+// MRI_Scanner::get_raw_data_slice
 // Computes raw fourier data according to the scanner models.
 //--------------------------------------------------------------------------
 
 void MRI_Scanner::get_raw_data_slice(int slice, Complex_Slice& raw_slice) {
 
+   get_raw_data_slice(slice, raw_slice, _phantom->get_resample_workspace());
+
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::get_raw_data_slice
+// As above, but may be called for several slices concurrently.  Each
+// caller supplies its own resampling workspace.
+//--------------------------------------------------------------------------
+
+void MRI_Scanner::get_raw_data_slice(int slice, Complex_Slice& raw_slice,
+                                     Resample_Workspace& workspace) {
+
+   get_noiseless_raw_data_slice(slice, raw_slice, workspace);
+   add_noise_to_raw_data_slice(slice, raw_slice);
+
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::get_noiseless_raw_data_slice
+// As above, but without noise, so that several noise realizations can 
+// be added to one resampled slice.
+//--------------------------------------------------------------------------
+
+void MRI_Scanner::get_noiseless_raw_data_slice(int slice, 
+                                               Complex_Slice& raw_slice,
+                                               Resample_Workspace& workspace) {
+
+   if (has_encoded_slab()) {
+      _get_partition(slice, raw_slice);
+   } else {
+      Real_Slice phantom_slice(_phantom->get_nrows(), _phantom->get_ncols());
+
+      select_phantom_slice(slice, phantom_slice);
+      generate_raw_data_slice(phantom_slice, raw_slice, workspace);
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::select_phantom_slice
+// Computes the slice selected phantom slice for an output slice.  This
+// is where phantom data is read from disk.
+//--------------------------------------------------------------------------
+
+void MRI_Scanner::select_phantom_slice(int slice, Real_Slice& phantom_slice) {
+
+   MRI_Profile_Timer timer(MRI_Profile::TIME_SLICE_SELECT);
+
    const double slice_thickness  = _current_pseq->get_slice_thickness();
    const double slice_separation = _current_pseq->get_voxel_step(SLICE);
    const double z_centre         = slice * slice_separation + 
                                    get_voxel_offset(SLICE);
 
-   Real_Slice   phantom_slice(_phantom->get_nrows(), _phantom->get_ncols());
-
    _phantom->ideal_lin_slice_select(z_centre, slice_thickness, phantom_slice);
-   _phantom->generate_raw_data_slice(phantom_slice, raw_slice);
 
-   _rf_coil->add_noise_to_raw_slice(raw_slice);
+}
 
+//--------------------------------------------------------------------------
+// MRI_Scanner::generate_raw_data_slice
+// Resamples a slice selected phantom slice to noiseless raw data.
+//--------------------------------------------------------------------------
+
+void MRI_Scanner::generate_raw_data_slice(const Real_Slice& phantom_slice,
+                                          Complex_Slice& raw_slice,
+                                          Resample_Workspace& workspace) const {
+   _phantom->generate_raw_data_slice(phantom_slice, raw_slice, workspace);
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::add_noise_to_raw_data_slice
+// Adds coil noise to a raw data slice.  The noise depends only on the 
+// random seed, the slice number and the noise realization, so slices may
+// be generated concurrently and in any order.
+//--------------------------------------------------------------------------
+
+void MRI_Scanner::add_noise_to_raw_data_slice(int slice, 
+                                              Complex_Slice& raw_slice,
+                                              int realization) const {
+   MRI_Profile_Timer timer(MRI_Profile::TIME_NOISE);
+   Noise_Stream stream;
+   _rf_coil->init_noise_stream(slice, stream, realization);
+   _rf_coil->add_noise_to_raw_slice(raw_slice, stream);
 }
 
 //--------------------------------------------------------------------------
@@ -345,6 +436,133 @@ void MRI_Scanner::initialize_chirp_resample(void) {
 
 }
 
+//--------------------------------------------------------------------------
+// MRI_Scanner::new_resample_workspace
+// Returns a new workspace for get_raw_data_slice, once the Chirp 
+// resampling has been initialized.  The caller must delete it.
+//--------------------------------------------------------------------------
+
+Resample_Workspace *MRI_Scanner::new_resample_workspace(void) const {
+   return _phantom->new_resample_workspace();
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::get_resample_method_name
+// Returns the name of the Fourier resampling method chosen by
+// initialize_chirp_resample.
+//--------------------------------------------------------------------------
+
+const char *MRI_Scanner::get_resample_method_name(void) const {
+   return Phantom::get_resample_method_name(
+                      _phantom->get_resample_method());
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::encode_slab
+// Computes the raw data of every partition of a 3-D scan.  Rather than
+// selecting each partition from the phantom in the image domain, each
+// phantom slice in the slab is resampled in-plane once, and the slab is
+// then phase encoded along z and decoded to partitions by a pair of 1-D
+// DFTs over every in-plane k-space sample.  The slab spans the
+// partitions, and holds the phantom slices whose centres fall inside
+// it.  Needs initialize_chirp_resample first.
+//--------------------------------------------------------------------------
+
+void MRI_Scanner::encode_slab(void) {
+
+   _free_slab();
+
+   const unsigned int nrows       = get_matrix_size(ROW);
+   const unsigned int ncols       = get_matrix_size(COLUMN);
+   const unsigned int npartitions = get_nslices();
+   const double       step        = _current_pseq->get_voxel_step(SLICE);
+   const double       start       = get_voxel_offset(SLICE);
+   const double       phantom_step = _phantom->get_voxel_step(SLICE);
+
+   // Phantom z-coordinate starts at 0, as for slice selection
+   int first = (int)ceil((start - 0.5*step)/phantom_step);
+   int last  = (int)ceil((start + (npartitions-0.5)*step)/phantom_step) - 1;
+   if (first < 0) first = 0;
+   if (last >= _phantom->get_nslices()) last = _phantom->get_nslices()-1;
+
+   const unsigned int nin = ((last >= first) ? last-first+1 : 0);
+
+   _slab = new Complex_Slice((nin > npartitions) ? nin : npartitions,
+                             nrows*ncols);
+   if (nin == 0) {
+      return;
+   }
+
+   _slab_encoder = new Slab_Encoder(nin, first*phantom_step, phantom_step,
+                                    npartitions, start, step);
+
+   // --- Resample each phantom slice in-plane --- //
+
+   Resample_Workspace *workspace = new_resample_workspace();
+   Real_Slice    phantom_slice(_phantom->get_nrows(), _phantom->get_ncols());
+   Complex_Slice raw_slice(nrows, ncols);
+
+   unsigned int n;
+   for(n=0; n<nin; n++){
+      {
+         MRI_Profile_Timer timer(MRI_Profile::TIME_SLICE_SELECT);
+         _phantom->get_simulated_mag_phantom_slice(first+n, phantom_slice);
+      }
+      generate_raw_data_slice(phantom_slice, raw_slice, *workspace);
+      memcpy(_slab->row_ptr(n), raw_slice.row_ptr(0),
+             raw_slice.size_in_bytes());
+   }
+   delete workspace;
+
+   // --- Encode and decode along z --- //
+
+   MRI_Profile_Timer timer(MRI_Profile::TIME_SLAB_ENCODE);
+
+   float  *kz   = new float[2*npartitions*nrows*ncols];
+   double *work = new double[_slab_encoder->get_workspace_length(
+                                nrows*ncols)];
+
+   _slab_encoder->encode(nrows*ncols, _slab->row_ptr(0), kz, work);
+
+   delete[] kz;
+   delete[] work;
+
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::_get_partition
+// Copies the noiseless raw data of one partition of an encoded slab.
+//--------------------------------------------------------------------------
+
+void MRI_Scanner::_get_partition(int slice, Complex_Slice& raw_slice) const {
+
+#ifdef DEBUG
+   assert(_slab != NULL);
+   assert(raw_slice.get_nelements() == _slab->get_ncols());
+#endif
+
+   const unsigned int row = ((_slab_encoder != NULL) ?
+                             _slab_encoder->get_partition_row(slice) :
+                             (unsigned int)slice);
+
+   memcpy(raw_slice.row_ptr(0), _slab->row_ptr(row),
+          raw_slice.size_in_bytes());
+
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::_free_slab
+// Frees the partitions of an encoded slab, which belong to one pulse
+// sequence.
+//--------------------------------------------------------------------------
+
+void MRI_Scanner::_free_slab(void) {
+   if (_slab_encoder != NULL) delete _slab_encoder;
+   if (_slab != NULL) delete _slab;
+   _slab_encoder = (Slab_Encoder *)NULL;
+   _slab         = (Complex_Slice *)NULL;
+}
+
 //--------------------------------------------------------------------------
 // MRI_Scanner::reconstruct_raw_data_slice
 // Reconstructs an MR image from the complex raw data slice.
@@ -353,6 +571,8 @@ void MRI_Scanner::initialize_chirp_resample(void) {
 void MRI_Scanner::reconstruct_raw_data_slice(const Complex_Slice& raw_slice,
                                              Complex_Slice& output_slice) {
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_RECON_FFT);
+
    int m, n;
    for (m=0; m<output_slice.get_nrows(); m++){
       for (n=0; n<output_slice.get_ncols(); n++){
@@ -367,6 +587,8 @@ void MRI_Scanner::reconstruct_raw_data_slice(const Complex_Slice& raw_slice,
 
 void MRI_Scanner::reconstruct_raw_data_slice(Complex_Slice &raw_slice) {
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_RECON_FFT);
+
    raw_slice.fftshift();
    raw_slice.iFFT2();
 
@@ -381,10 +603,15 @@ void MRI_Scanner::get_real_image(const Complex_Slice& complex_slice,
                                  MRI_Image& image_slice) {
 
    double min, max;
-   complex_slice.get_real_min_max(min, max);
+   {
+      MRI_Profile_Timer timer(MRI_Profile::TIME_MIN_MAX);
+      complex_slice.get_real_min_max(min, max);
+   }
    image_slice.set_real_minimum(min);
    image_slice.set_real_maximum(max);
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_QUANTIZE);
+
    unsigned int m,n;
    for (m=0; m<image_slice.get_nrows(); m++){
       for (n=0; n<image_slice.get_ncols(); n++){
@@ -403,10 +630,15 @@ void MRI_Scanner::get_imag_image(const Complex_Slice& complex_slice,
                                  MRI_Image& image_slice) {
 
    double min, max;
-   complex_slice.get_imag_min_max(min, max);
+   {
+      MRI_Profile_Timer timer(MRI_Profile::TIME_MIN_MAX);
+      complex_slice.get_imag_min_max(min, max);
+   }
    image_slice.set_real_minimum(min);
    image_slice.set_real_maximum(max);
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_QUANTIZE);
+
    unsigned int m,n;
    for (m=0; m<image_slice.get_nrows(); m++){
       for (n=0; n<image_slice.get_ncols(); n++){
@@ -424,10 +656,15 @@ void MRI_Scanner::get_abs_image(const Complex_Slice& complex_slice,
                                 MRI_Image& image_slice) {
 
    double min, max;
-   complex_slice.get_abs_min_max(min, max);
+   {
+      MRI_Profile_Timer timer(MRI_Profile::TIME_MIN_MAX);
+      complex_slice.get_abs_min_max(min, max);
+   }
    image_slice.set_real_minimum(min);
    image_slice.set_real_maximum(max);
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_QUANTIZE);
+
    double value;
    unsigned int m,n;
    for (m=0; m<image_slice.get_nrows(); m++){
@@ -448,10 +685,15 @@ void MRI_Scanner::get_angle_image(const Complex_Slice& complex_slice,
                                   MRI_Image& image_slice) {
 
    double min, max;
-   complex_slice.get_angle_min_max(min, max);
+   {
+      MRI_Profile_Timer timer(MRI_Profile::TIME_MIN_MAX);
+      complex_slice.get_angle_min_max(min, max);
+   }
    image_slice.set_real_minimum(min);
    image_slice.set_real_maximum(max);
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_QUANTIZE);
+
    double value;
    unsigned int m,n;
    for (m=0; m<image_slice.get_nrows(); m++){
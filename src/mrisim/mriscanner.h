@@ -41,6 +41,7 @@
 #include <iostream>
 #include "phantom.h"
 #include "rf_coil.h"
+#include "slab_encoder.h"
 
 using namespace std;
 
@@ -72,6 +73,7 @@ class MRI_Scanner {
 
       inline Phantom *get_attached_phantom(void) const;
       inline Image_Type get_image_type(void) const;
+      inline Scan_Mode get_scan_mode(void) const;
 
       inline int save_raw_data(void) const;
       inline void save_raw_data(int on);
@@ -102,8 +104,30 @@ class MRI_Scanner {
 
       void get_simulated_image_slice(int slice, MRI_Image& image);
       void get_raw_data_slice(int slice, Complex_Slice& raw_slice);
+      void get_raw_data_slice(int slice, Complex_Slice& raw_slice,
+                              Resample_Workspace& workspace);
+      void get_noiseless_raw_data_slice(int slice, Complex_Slice& raw_slice,
+                                        Resample_Workspace& workspace);
+
+      // The stages of get_raw_data_slice, for use in a pipeline
+      void select_phantom_slice(int slice, Real_Slice& phantom_slice);
+      void generate_raw_data_slice(const Real_Slice& phantom_slice,
+                                   Complex_Slice& raw_slice,
+                                   Resample_Workspace& workspace) const;
+      void add_noise_to_raw_data_slice(int slice, Complex_Slice& raw_slice,
+                                       int realization = 0) const;
 
       void initialize_chirp_resample(void);
+      Resample_Workspace *new_resample_workspace(void) const;
+      const char *get_resample_method_name(void) const;
+
+      // --- 3-D acquisitions --- //
+      // encode_slab computes the raw data of every partition of a 3-D
+      // scan at once, by phase encoding along z; get_raw_data_slice and
+      // get_noiseless_raw_data_slice then return the partitions.
+      void encode_slab(void);
+      inline int has_encoded_slab(void) const;
+      inline const Slab_Encoder *get_slab_encoder(void) const;
       void reconstruct_raw_data_slice(const Complex_Slice& raw_slice, 
                                       Complex_Slice& output_slice);
       void reconstruct_raw_data_slice(Complex_Slice& raw_slice);
@@ -130,10 +154,16 @@ class MRI_Scanner {
       double         _voxel_offset[3];
     
       int            _save_raw_data;
+
+      Slab_Encoder   *_slab_encoder;  // z encoding of a 3-D scan
+      Complex_Slice  *_slab;          // raw data of its partitions, one
+                                      // row each
  
       // --- Internal member functions --- // 
 
       void _update_volume_info(Phantom *phantom, Pulse_Sequence *pseq);
+      void _free_slab(void);
+      void _get_partition(int slice, Complex_Slice& raw_slice) const;
 
 };
 
@@ -191,6 +221,38 @@ Image_Type MRI_Scanner::get_image_type(void) const {
    return _current_pseq->get_image_type();
 }
 
+//--------------------------------------------------------------------------
+// MRI_Scanner::get_scan_mode
+// Returns the scan mode (2D, MS or 3D) of the current pulse sequence.
+//--------------------------------------------------------------------------
+
+inline
+Scan_Mode MRI_Scanner::get_scan_mode(void) const {
+   return _current_pseq->get_scan_mode();
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::has_encoded_slab
+// Returns TRUE if the partitions of a 3-D scan have been computed by
+// encode_slab.
+//--------------------------------------------------------------------------
+
+inline
+int MRI_Scanner::has_encoded_slab(void) const {
+   return (_slab != NULL);
+}
+
+//--------------------------------------------------------------------------
+// MRI_Scanner::get_slab_encoder
+// Returns the z encoding used by encode_slab, or NULL if no phantom
+// slices fell within the slab.
+//--------------------------------------------------------------------------
+
+inline
+const Slab_Encoder *MRI_Scanner::get_slab_encoder(void) const {
+   return _slab_encoder;
+}
+
 //--------------------------------------------------------------------------
 // MRI_Scanner::save_raw_data
 // Returns TRUE if the save raw data option is turned on.
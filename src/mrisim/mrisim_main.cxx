@@ -49,6 +49,9 @@
 
 #include "mrisim_main.h"
 #include "scanner_output.h"
+#include "chirp_plan.h"
+#include "signal_cache.h"
+#include <minc/mriprofile.h>
 
 //--------------------------------------------------------------------------
 // main
@@ -64,37 +67,105 @@ int main(int argc, char *argv[]){
    // Check command line arguments
    mrisimArgs args(argc, argv);
 
+   // Start profiling if requested
+   if (args.profileFile != NULL) {
+      MRI_Profile::enable();
+   }
+
+   // Convert a fuzzy phantom to a packed phantom file and stop
+   if (args.packFile != NULL) {
+      exit(pack_phantom(args) ? 0 : EXIT_FAILURE);
+   }
+
+   // Select the precision of the Fourier transforms before any plan is
+   // used by a worker thread
+   if (args.singlePrecisionFlag) {
+      MRI_FFT_Plan::set_precision(MRI_FFT_Plan::SINGLE_PRECISION);
+   }
+
+   // Load saved Chirp filters and tuned resampling methods if requested.
+   // A missing wisdom file is not an error; it is written when the run
+   // finishes.
+   if (args.wisdomFile != NULL) {
+      int nplans = Chirp_Plan::load_wisdom(args.wisdomFile);
+      if (args.verboseFlag && nplans > 0) {
+         cout << "Loaded " << nplans << " resampling plans from "
+              << args.wisdomFile << "." << endl;
+      }
+   }
+
+   // Load saved tissue signals likewise
+   if (args.signalCacheFile != NULL) {
+      int nsignals = Tissue_Signal_Cache::load(args.signalCacheFile);
+      if (args.verboseFlag && nsignals > 0) {
+         cout << "Loaded " << nsignals << " tissue signals from "
+              << args.signalCacheFile << "." << endl;
+      }
+   }
+
    // --- CREATE SIMULATOR MODELS --- //
 
    MRI_Scanner  scanner;
    create_models(args, scanner);
    //args.delete_fuzzy_list();
 
-   // --- APPLY PULSE SEQUENCE --- //
-   // Create a Pulse_Sequence from the parameter file and apply
-   // it to the MRI_Scanner model.
+   // Each pulse sequence in a batch is applied to the same phantom
+   // and coil, so labels, maps and Chirp filters are loaded once.
+   // A failed sequence ends the batch, but the wisdom and tissue
+   // signals computed for the sequences before it are still saved.
 
-   if (!apply_pulse_sequence(args, scanner)){
-       cerr << endl << "FATAL ERROR: Could not create Pulse Sequence."
-            << flush << endl;
-       exit(EXIT_FAILURE);
-   }
+   int status = TRUE;
+   int isequence;
+   for (isequence=0; isequence<args.nsequences; isequence++){
 
-   // --- OUTPUT IMAGES --- //
+      args.select_sequence(isequence);
 
-   Scanner_Output output(args, stamp, scanner);
+      // --- APPLY PULSE SEQUENCE --- //
+      // Create a Pulse_Sequence from the parameter file and apply
+      // it to the MRI_Scanner model.
 
-   if (!output.is_good()) {
-      exit(EXIT_FAILURE);
+      if (!apply_pulse_sequence(args, scanner)){
+          cerr << endl << "FATAL ERROR: Could not create Pulse Sequence "
+               << args.sequenceFile << "." << flush << endl;
+          status = FALSE;
+          break;
+      }
+
+      // --- OUTPUT IMAGES --- //
+
+      Scanner_Output output(args, stamp, scanner);
+
+      if (!output.is_good()) {
+         status = FALSE;
+         break;
+      }
+
+      output.display_info(args, stamp, scanner);
+      output.save_images(args, scanner);
+
+   }
+
+   if (args.profileFile != NULL && !MRI_Profile::write_json(args.profileFile)){
+      cerr << endl << "WARNING: Could not write profile file " 
+           << args.profileFile << flush << endl;
    }
 
-   output.display_info(args, stamp, scanner);
-   output.save_images(args, scanner);
+   if (args.wisdomFile != NULL && Chirp_Plan::wisdom_changed() &&
+       !Chirp_Plan::save_wisdom(args.wisdomFile)){
+      cerr << endl << "WARNING: Could not write wisdom file "
+           << args.wisdomFile << flush << endl;
+   }
+
+   if (args.signalCacheFile != NULL && Tissue_Signal_Cache::changed() &&
+       !Tissue_Signal_Cache::save(args.signalCacheFile)){
+      cerr << endl << "WARNING: Could not write signal cache file "
+           << args.signalCacheFile << flush << endl;
+   }
 
    // --- CLEAN UP --- //
    free(stamp);
 
-   return 0;
+   return (status ? 0 : EXIT_FAILURE);
 
 }
 
@@ -149,16 +220,31 @@ void create_models(const mrisimArgs &args, MRI_Scanner &scanner) {
       exit(EXIT_FAILURE);
    }
 
+   // Cache synthesized phantom slices shared by neighbouring output slices
+   phantom->set_slice_cache_size((unsigned long)args.slice_cache_mb << 20);
+
+   // Select thick slices from an integral of the phantom along z
+   if (args.zintegralFlag) {
+      phantom->use_z_integral(TRUE);
+   }
+
+   // Choose the resampling method by timing rather than by estimate
+   if (args.autotuneFlag) {
+      phantom->use_autotune(TRUE);
+   }
+
 }
 
 //--------------------------------------------------------------------------
 // open_phantom
 // Parses the mrisim phantom and tissue parameter files and creates a new
 // Phantom model.
-// Returns FALSE if phantom creation has failed.
+// Returns FALSE if phantom creation has failed.  If fuzzy_labels is
+// given it is set to the fuzzy label volumes of a fuzzy phantom, or NULL.
 //--------------------------------------------------------------------------
 
-Phantom *open_phantom(const mrisimArgs& args, const RF_Coil *rf_coil) {
+Phantom *open_phantom(const mrisimArgs& args, const RF_Coil *rf_coil,
+                      Fuzzy_Label_Phantom **fuzzy_labels) {
 
    int       status = TRUE;
 
@@ -168,8 +254,11 @@ Phantom *open_phantom(const mrisimArgs& args, const RF_Coil *rf_coil) {
    Discrete_RF_Phantom *drfphantom = NULL;
    Fuzzy_Phantom       *fphantom   = NULL;
    Fuzzy_RF_Phantom    *frfphantom = NULL;
+   Packed_Phantom      *pphantom   = NULL;
    Phantom             *phantom    = NULL;
 
+   if (fuzzy_labels != NULL) *fuzzy_labels = NULL;
+
    ParamFile paramfile(args.tissueFile);
 
    // --- Input Parameters --- //
@@ -203,7 +292,8 @@ Phantom *open_phantom(const mrisimArgs& args, const RF_Coil *rf_coil) {
    // use values from the parameter file.
 
    paramfile.getfield(255, phantom_type_specifier);
-   if (!(args.uses_fuzzy_phantom() || args.uses_discrete_phantom())) {
+   if (!(args.uses_fuzzy_phantom() || args.uses_discrete_phantom() ||
+         args.uses_packed_phantom())) {
       if (strcmp(phantom_type_specifier, "discrete")==0) {
          args.phantomFile = new char;
          args.phantomFile[0] = '\0';
@@ -267,14 +357,22 @@ Phantom *open_phantom(const mrisimArgs& args, const RF_Coil *rf_coil) {
       case FUZZY:       // --- Fuzzy Phantom --- //
 
          fphantom   = new Fuzzy_Phantom(n_tissue_classes); 
+         fphantom->use_label_preload(args.preloadFlag);
          phantom    = (Phantom *)fphantom;
          break;
 
       case FUZZY_RF:    // --- Fuzzy RF Phantom --- //
    
          frfphantom = new Fuzzy_RF_Phantom(n_tissue_classes, n_flip_angles);
+         frfphantom->use_label_preload(args.preloadFlag);
          phantom    = (Phantom *)frfphantom;
          break;
+
+      case PACKED:      // --- Packed Phantom --- //
+
+         pphantom   = new Packed_Phantom(n_tissue_classes);
+         phantom    = (Phantom *)pphantom;
+         break;
    }
 
    // --- Read tissue parameters and install tissues in the phantom --- //
@@ -416,6 +514,36 @@ Phantom *open_phantom(const mrisimArgs& args, const RF_Coil *rf_coil) {
       }
    }
 
+   // --- Packed Phantom File --- //
+   // Opened once the tissues are installed, so that its tissue labels
+   // can be checked.
+
+   if (phantom_type == PACKED &&
+       !pphantom->open_packed_label_file(args.packedFile)) {
+      delete phantom;
+      return NULL;
+   }
+
+   // --- Fuzzy Label Memory --- //
+   // Report the memory the label volumes take with -preload, so that
+   // preloading can be chosen over reading slices on demand.
+
+   Fuzzy_Label_Phantom *flphantom = NULL;
+   if (fphantom != NULL)   flphantom = fphantom;
+   if (frfphantom != NULL) flphantom = frfphantom;
+   if (fuzzy_labels != NULL) *fuzzy_labels = flphantom;
+   if (flphantom != NULL && args.verboseFlag) {
+      long megabytes =
+         (long)(flphantom->get_label_volume_bytes()/1048576.0 + 0.5);
+      if (flphantom->has_preloaded_labels()) {
+         cout << "Preloaded fuzzy label volumes: " << megabytes
+              << " MB." << endl;
+      } else {
+         cout << "Fuzzy label volumes are read by slice; -preload would use "
+              << megabytes << " MB." << endl;
+      }
+   }
+
    // --- RF Map Consistency Checks --- //
 
    switch (phantom_type) {
@@ -471,6 +599,11 @@ Phantom *open_phantom(const mrisimArgs& args, const RF_Coil *rf_coil) {
                  << "same as Phantom." << flush << endl;
          }
          break;
+      case DISCRETE:
+      case FUZZY:
+      case PACKED:
+         // No RF maps to check
+         break;
    }
 
    paramfile.close();
@@ -479,6 +612,46 @@ Phantom *open_phantom(const mrisimArgs& args, const RF_Coil *rf_coil) {
 
 }
 
+//--------------------------------------------------------------------------
+// pack_phantom
+// Opens the fuzzy phantom described by the tissue parameter file and
+// the -fuzzy option, and writes it to the -pack file.
+// Returns FALSE if the phantom is not fuzzy or cannot be written.
+//--------------------------------------------------------------------------
+
+int pack_phantom(const mrisimArgs& args) {
+
+   Fuzzy_Label_Phantom *fuzzy_labels;
+   Phantom             *phantom;
+
+   if ((phantom = open_phantom(args, NULL, &fuzzy_labels)) == NULL) {
+      cerr << endl << "FATAL ERROR: Could not create phantom."
+           << flush << endl;
+      return FALSE;
+   }
+   if (fuzzy_labels == NULL) {
+      cerr << endl << "FATAL ERROR: Only a fuzzy phantom can be packed."
+           << flush << endl;
+      delete phantom;
+      return FALSE;
+   }
+
+   int status = fuzzy_labels->write_packed_label_file(args.packFile,
+                                                      args.pack_top);
+   if (!status) {
+      cerr << endl << "FATAL ERROR: Could not write packed phantom file "
+           << args.packFile << "." << flush << endl;
+   } else if (args.verboseFlag) {
+      cout << "Packed " << fuzzy_labels->get_num_tissues()
+           << " fuzzy label volumes into " << args.packFile << ", keeping "
+           << args.pack_top << " tissues for each voxel." << endl;
+   }
+
+   delete phantom;
+   return status;
+
+}
+
 //--------------------------------------------------------------------------
 // make_coil
 // Parses the mrisim rf_coil parameter file and creates a new coil
@@ -579,6 +752,16 @@ RF_Coil *make_coil(const mrisimArgs& args) {
       args.txmapFile = strdup(txmap);
    }
 
+   // The -rxmap and -txmap switches are rejected with -packed when the
+   // arguments are parsed, but maps named by the coil file only get
+   // here.  A packed phantom has no RF inhomogeneity.
+
+   if (args.uses_packed_phantom() && args.uses_rf_phantom()) {
+      cerr << "-pack and -packed cannot be used with -rxmap or -txmap."
+           << endl;
+      status = FALSE;
+   }
+
    paramfile.getfield(random_seed);
 
    // -- Check for file parsing errors --- //
@@ -1132,6 +1315,14 @@ int apply_pulse_sequence(const mrisimArgs &args, MRI_Scanner &scanner) {
    pseq->set_scan_mode(scan_mode);
    pseq->set_water_fat_shift(water_fat_shift);
 
+   // The tissue signals depend only on the technique and timing, which
+   // are written in full so that the signal cache keys are exact
+   if (args.signalCacheFile != NULL) {
+      sprintf(buffer, "%d %.17g %.17g %.17g %.17g %.17g", (int)scan_technique,
+              TR, TI, TE1, TE2, flip_angle);
+      phantom->set_sequence_key(buffer);
+   }
+
    switch(scan_technique) {
       case SCAN_TYPE_SE:
       case SCAN_TYPE_IR:
@@ -49,6 +49,7 @@
 #include "discrete_rf_phantom.h"
 #include "fuzzy_phantom.h"
 #include "fuzzy_rf_phantom.h"
+#include "packed_phantom.h"
 
 #include "rf_coil.h"
 #include "intrinsic_coil.h"
@@ -62,7 +63,10 @@ void create_models(const mrisimArgs &args, MRI_Scanner &scanner);
 
 void output_images(const mrisimArgs &args, char *stamp, MRI_Scanner &scanner);
 
-Phantom *open_phantom(const mrisimArgs &args, const RF_Coil *rf_coil);
+Phantom *open_phantom(const mrisimArgs &args, const RF_Coil *rf_coil,
+                      Fuzzy_Label_Phantom **fuzzy_labels = NULL);
+
+int pack_phantom(const mrisimArgs &args);
 
 RF_Coil *make_coil(const mrisimArgs &args);
 
@@ -44,6 +44,7 @@
 #include <ctype.h>
 
 #include "mrisimargs.h"
+#include "packed_label_file.h"
 
 //------------------------------------------------------------------------- 
 // Static command line argument flags
@@ -63,6 +64,10 @@ char *mrisimArgs::outputFile   = NULL;
 char            *mrisimArgs::fuzzy_specifier_string = NULL;
 Fuzzy_Specifier *mrisimArgs::fuzzy_list             = NULL;
 
+int  mrisimArgs::nsequences      = 0;
+char **mrisimArgs::sequenceFiles = NULL;
+char **mrisimArgs::outputFiles   = NULL;
+
 // --- Option flags --- //
 
 int mrisimArgs::logFlag        = FALSE;
@@ -82,6 +87,28 @@ int    mrisimArgs::matrix_size     = 0;
 int    mrisimArgs::nslices         = 0;
 double mrisimArgs::slice_thickness = 0;
 
+// --- Performance options --- //
+
+int    mrisimArgs::nthreads        = 1;
+int    mrisimArgs::pipelineFlag    = FALSE;
+char  *mrisimArgs::profileFile     = NULL;
+int    mrisimArgs::slice_cache_mb  = 64;
+int    mrisimArgs::zintegralFlag   = FALSE;
+int    mrisimArgs::nrealizations   = 1;
+char  *mrisimArgs::wisdomFile      = NULL;
+int    mrisimArgs::autotuneFlag    = FALSE;
+int    mrisimArgs::kspace3dFlag    = FALSE;
+char  *mrisimArgs::precisionString = (char *)"double";
+int    mrisimArgs::singlePrecisionFlag = FALSE;
+int    mrisimArgs::preloadFlag     = FALSE;
+char  *mrisimArgs::signalCacheFile = NULL;
+
+// --- Packed phantoms --- //
+
+char  *mrisimArgs::packFile        = NULL;
+int    mrisimArgs::pack_top        = PACKED_LABEL_TOP;
+char  *mrisimArgs::packedFile      = NULL;
+
 //------------------------------------------------------------------------- 
 // Command line argument descriptor table
 //------------------------------------------------------------------------- 
@@ -112,7 +139,7 @@ ArgvInfo mrisimArgs::argTable[] = {
             "RF Coil parameter file."},
    {"-sequence", ARGV_STRING, (char *)1, 
             (char *)&mrisimArgs::sequenceFile,
-            "Pulse sequence parameter file."},
+            "Pulse sequence parameter file(s), comma separated."},
    {"-discrete", ARGV_FUNC, 
             (char *)parse_optional_string_argument, 
             (char *)&mrisimArgs::phantomFile,
@@ -160,6 +187,51 @@ ArgvInfo mrisimArgs::argTable[] = {
    {"-nslices", ARGV_INT, (char *) 1,
              (char *)&mrisimArgs::nslices,
              "Specify the acquisition slice thickness (mm)."},
+   {"-threads", ARGV_INT, (char *) 1,
+             (char *)&mrisimArgs::nthreads,
+             "Number of worker threads used to generate output slices."},
+   {"-pipeline", ARGV_CONSTANT, (char *)TRUE,
+             (char *)&mrisimArgs::pipelineFlag,
+             "Overlap phantom reads, resampling and output in a pipeline."},
+   {"-profile", ARGV_STRING, (char *) 1,
+             (char *)&mrisimArgs::profileFile,
+             "Write stage timings and counters to a JSON file."},
+   {"-slice_cache", ARGV_INT, (char *) 1,
+             (char *)&mrisimArgs::slice_cache_mb,
+             "Memory (MB) for caching synthesized phantom slices (0 = off)."},
+   {"-zintegral", ARGV_CONSTANT, (char *)TRUE,
+             (char *)&mrisimArgs::zintegralFlag,
+             "Select slices from a z integral of the phantom."},
+   {"-realizations", ARGV_INT, (char *) 1,
+             (char *)&mrisimArgs::nrealizations,
+             "Number of noise realizations to write for each output."},
+   {"-wisdom", ARGV_STRING, (char *) 1,
+             (char *)&mrisimArgs::wisdomFile,
+             "Read and update Chirp resampling filters saved in a file."},
+   {"-autotune", ARGV_CONSTANT, (char *)TRUE,
+             (char *)&mrisimArgs::autotuneFlag,
+             "Choose the Fourier resampling method by timing each one."},
+   {"-kspace3d", ARGV_CONSTANT, (char *)TRUE,
+             (char *)&mrisimArgs::kspace3dFlag,
+             "Encode 3D scans along z in k-space rather than by slice."},
+   {"-precision", ARGV_STRING, (char *) 1,
+             (char *)&mrisimArgs::precisionString,
+             "Precision of the Fourier transforms: single or double."},
+   {"-preload", ARGV_CONSTANT, (char *)TRUE,
+             (char *)&mrisimArgs::preloadFlag,
+             "Read the fuzzy label volumes into memory when opened."},
+   {"-signal_cache", ARGV_STRING, (char *) 1,
+             (char *)&mrisimArgs::signalCacheFile,
+             "Read and update tissue signals saved in a file."},
+   {"-pack", ARGV_STRING, (char *) 1,
+             (char *)&mrisimArgs::packFile,
+             "Write the fuzzy phantom to a packed phantom file and exit."},
+   {"-pack_top", ARGV_INT, (char *) 1,
+             (char *)&mrisimArgs::pack_top,
+             "Number of tissues kept for each voxel by -pack."},
+   {"-packed", ARGV_STRING, (char *) 1,
+             (char *)&mrisimArgs::packedFile,
+             "Use a packed phantom file written by -pack."},
    {(char *)NULL, ARGV_END, (char *)NULL, (char *)NULL,
             (char *)NULL}
 };
@@ -172,7 +244,8 @@ mrisimArgs::mrisimArgs(int argc, char *argv[]){
 
    // Parse and check command line arguments
 
-   if (ParseArgv(&argc, argv, argTable, 0) || (argc != 2) ||
+   if (ParseArgv(&argc, argv, argTable, 0) ||
+       ((argc < 2) && (mrisimArgs::packFile == NULL)) ||
        mrisimArgs::versionFlag){
 
       if (mrisimArgs::versionFlag){
@@ -183,16 +256,32 @@ mrisimArgs::mrisimArgs(int argc, char *argv[]){
       } else {
          cerr << endl << "Usage: " << argv[0] << " [<options>] <output.mnc>" 
               << endl;
+         cerr <<         "       " << argv[0] 
+              << " [<options>] -sequence <seq1>,<seq2>,... <output1.mnc>"
+              << " <output2.mnc> ..." << endl;
          cerr <<         "       " << argv[0] << " [-help]" << endl << endl;
          exit(EXIT_FAILURE);
       }
 
    }
    
-   // Check output file
-   mrisimArgs::outputFile = argv[1];
-   if (strcmp(&mrisimArgs::outputFile[strlen(argv[1])-4],".mnc") != 0){
-      cerr << "Output file name must end in extension .mnc" << endl;
+   // Check output files
+   int i;
+   mrisimArgs::nsequences  = argc-1;
+   mrisimArgs::outputFiles = new char *[mrisimArgs::nsequences];
+   for(i=0; i<mrisimArgs::nsequences; i++){
+      mrisimArgs::outputFiles[i] = argv[i+1];
+      if (strlen(argv[i+1]) < 4 ||
+          strcmp(&argv[i+1][strlen(argv[i+1])-4],".mnc") != 0){
+         cerr << "Output file name must end in extension .mnc" << endl;
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   // A phantom conversion needs only the tissue file and the phantom
+
+   if ((mrisimArgs::packFile != NULL) && (mrisimArgs::nsequences > 0)){
+      cerr << "-pack writes no output files." << endl;
       exit(EXIT_FAILURE);
    }
 
@@ -207,15 +296,86 @@ mrisimArgs::mrisimArgs(int argc, char *argv[]){
       cerr << "No tissue parameter file specified." << endl;
       exit(EXIT_FAILURE);
    }
-   if (mrisimArgs::coilFile == NULL){
+   if ((mrisimArgs::coilFile == NULL) && (mrisimArgs::packFile == NULL)){
       cerr << "No coil parameter file specified." << endl;
       exit(EXIT_FAILURE);
    }
-   if (mrisimArgs::sequenceFile == NULL){
+   if ((mrisimArgs::sequenceFile == NULL) && (mrisimArgs::packFile == NULL)){
       cerr << "No pulse sequence parameter file specified." << endl;
       exit(EXIT_FAILURE);
    }
 
+   // Split the sequence list, one sequence for each output file
+   char *head = mrisimArgs::sequenceFile;
+   char *tail;
+   int  more_members = FALSE;
+   mrisimArgs::sequenceFiles = new char *[mrisimArgs::nsequences];
+   for(i=0; i<mrisimArgs::nsequences; i++){
+      more_members = split_string(head, ',', &tail);
+      if (*head == '\0') {
+         cerr << "Empty pulse sequence file name not allowed." << endl;
+         exit(EXIT_FAILURE);
+      }
+      mrisimArgs::sequenceFiles[i] = head;
+      if (!more_members && i+1 < mrisimArgs::nsequences) {
+         cerr << "Fewer pulse sequence files than output files." << endl;
+         exit(EXIT_FAILURE);
+      }
+      head = tail;
+   }
+   if (more_members) {
+      cerr << "More pulse sequence files than output files." << endl;
+      exit(EXIT_FAILURE);
+   }
+   if (mrisimArgs::nsequences > 0) {
+      select_sequence(0);
+   }
+
+   if (mrisimArgs::nthreads < 1){
+      cerr << "Number of threads must be at least 1." << endl;
+      exit(EXIT_FAILURE);
+   }
+   if (mrisimArgs::slice_cache_mb < 0){
+      cerr << "Slice cache size must not be negative." << endl;
+      exit(EXIT_FAILURE);
+   }
+   if (mrisimArgs::nrealizations < 1){
+      cerr << "Number of noise realizations must be at least 1." << endl;
+      exit(EXIT_FAILURE);
+   }
+   if (mrisimArgs::nrealizations > 1 && mrisimArgs::oldpvFlag){
+      cerr << "-realizations cannot be used with -nnpv." << endl;
+      exit(EXIT_FAILURE);
+   }
+   if (strcmp(mrisimArgs::precisionString, "single") == 0){
+      mrisimArgs::singlePrecisionFlag = TRUE;
+   } else if (strcmp(mrisimArgs::precisionString, "double") != 0){
+      cerr << "Precision must be single or double." << endl;
+      exit(EXIT_FAILURE);
+   }
+   if (mrisimArgs::pack_top < 1 || mrisimArgs::pack_top > MAX_LABEL){
+      cerr << "Number of tissues kept for each voxel must be 1 - "
+           << MAX_LABEL << "." << endl;
+      exit(EXIT_FAILURE);
+   }
+   if (mrisimArgs::packFile != NULL && mrisimArgs::packedFile != NULL){
+      cerr << "Only one of -pack or -packed can be specified at a time."
+           << endl;
+      exit(EXIT_FAILURE);
+   }
+   if (mrisimArgs::packedFile != NULL &&
+       (mrisimArgs::phantomFile != NULL ||
+        mrisimArgs::fuzzy_specifier_string != NULL)){
+      cerr << "-packed cannot be used with -discrete or -fuzzy." << endl;
+      exit(EXIT_FAILURE);
+   }
+   if ((mrisimArgs::packFile != NULL || mrisimArgs::packedFile != NULL) &&
+       uses_rf_phantom()){
+      cerr << "-pack and -packed cannot be used with -rxmap or -txmap."
+           << endl;
+      exit(EXIT_FAILURE);
+   }
+
    if (mrisimArgs::logFile != NULL){
       mrisimArgs::logFlag = TRUE;
    } else {
@@ -244,6 +404,22 @@ mrisimArgs::mrisimArgs(int argc, char *argv[]){
 
 mrisimArgs::~mrisimArgs() {
    delete_fuzzy_list();
+   delete[] mrisimArgs::sequenceFiles;
+   delete[] mrisimArgs::outputFiles;
+}
+
+//------------------------------------------------------------------------- 
+// mrisimArgs::select_sequence
+// Makes the index'th pulse sequence file and output file of a batch the
+// current sequenceFile and outputFile.
+//------------------------------------------------------------------------- 
+
+void mrisimArgs::select_sequence(int index) {
+#ifdef DEBUG
+   assert(index >= 0 && index < mrisimArgs::nsequences);
+#endif
+   mrisimArgs::sequenceFile = mrisimArgs::sequenceFiles[index];
+   mrisimArgs::outputFile   = mrisimArgs::outputFiles[index];
 }
 
 //------------------------------------------------------------------------- 
@@ -254,7 +430,9 @@ mrisimArgs::~mrisimArgs() {
 Phantom_Type mrisimArgs::get_phantom_type(void) const {
    Phantom_Type phantom_type;
 
-   if (uses_discrete_phantom()) {
+   if (uses_packed_phantom()) {
+      phantom_type = PACKED;
+   } else if (uses_discrete_phantom()) {
       if (uses_rf_phantom()) {
          phantom_type = DISCRETE_RF;
       } else {
@@ -67,7 +67,7 @@ struct Fuzzy_Specifier {
 // Phantom selection type
 //--------------------------------------------------------------------------
 
-enum Phantom_Type {DISCRETE, DISCRETE_RF, FUZZY, FUZZY_RF};
+enum Phantom_Type {DISCRETE, DISCRETE_RF, FUZZY, FUZZY_RF, PACKED};
 
 //--------------------------------------------------------------------------
 // mrisimArgs class
@@ -97,6 +97,12 @@ class mrisimArgs {
       static char *fuzzy_specifier_string;
       static Fuzzy_Specifier *fuzzy_list;  
 
+      // --- Batch of sequences sharing one phantom --- //
+
+      static int  nsequences;
+      static char **sequenceFiles;     // -sequence list, one per output
+      static char **outputFiles;
+
       // --- Option flags --- //
 
       static int  logFlag;
@@ -116,12 +122,35 @@ class mrisimArgs {
       static int    nslices;
       static double slice_thickness;
 
+      // --- Performance options --- //
+
+      static int    nthreads;
+      static int    pipelineFlag;
+      static char   *profileFile;
+      static int    slice_cache_mb;
+      static int    zintegralFlag;
+      static int    nrealizations;
+      static char   *wisdomFile;
+      static int    autotuneFlag;
+      static int    kspace3dFlag;
+      static char   *precisionString;
+      static int    singlePrecisionFlag;
+      static int    preloadFlag;
+      static char   *signalCacheFile;
+
+      // --- Packed phantoms --- //
+
+      static char   *packFile;          // written by -pack
+      static int    pack_top;           // tissues kept for each voxel
+      static char   *packedFile;        // read by -packed
+
       // --- Access functions --- //
 
       inline int uses_fuzzy_phantom(void) const;
       inline int uses_discrete_phantom(void) const;
       inline int uses_default_fuzzy_phantom(void) const;
       inline int uses_default_discrete_phantom(void) const;
+      inline int uses_packed_phantom(void) const;
       inline int fuzzy_labels_specified(void) const;
 
       inline int uses_rx_map(void) const;
@@ -134,6 +163,7 @@ class mrisimArgs {
 
       Phantom_Type get_phantom_type(void) const;
       inline void delete_fuzzy_list(void);
+      void select_sequence(int index);
 
    private:
 
@@ -198,6 +228,16 @@ int mrisimArgs::uses_default_discrete_phantom(void) const {
            (mrisimArgs::phantomFile[0]=='\0'));
 }
 
+//--------------------------------------------------------------------------
+// mrisimArgs::uses_packed_phantom
+// Returns TRUE if -packed was used.
+//--------------------------------------------------------------------------
+
+inline
+int mrisimArgs::uses_packed_phantom(void) const {
+   return (mrisimArgs::packedFile != NULL);
+}
+
 //--------------------------------------------------------------------------
 // mrisimArgs::fuzzy_labels_specified
 // Returns TRUE if -fuzzy was used with labels specified in the phantom
@@ -0,0 +1,382 @@
+//==========================================================================
+// PACKED_LABEL_FILE.CXX
+// Packed_Label_File class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <math.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "packed_label_file.h"
+
+// First bytes of a packed phantom file, followed by a byte order check
+// word, the sizes of the stored structures, the entries per voxel and
+// the number of tissues, the tissue labels and the volume information
+static const char         PACKED_MAGIC[] = "MRISIM PACKED LABELS 1\n";
+static const unsigned int PACKED_ORDER   = 0x01020304U;
+
+static const unsigned char packed_padding[PACKED_LABEL_ALIGN] = {0};
+
+//--------------------------------------------------------------------------
+// Packed_Label_File constructor
+//--------------------------------------------------------------------------
+
+Packed_Label_File::Packed_Label_File() {
+
+   _filename    = NULL;
+   _ntop        = 0;
+   _ntissues    = 0;
+   _label       = NULL;
+   _slice_bytes = 0;
+   _chunk_bytes = 0;
+   _map         = NULL;
+   _map_bytes   = 0;
+   _data_offset = 0;
+   _fp          = NULL;
+   _write_ok    = FALSE;
+
+   memset(&_volume_info, 0, sizeof(Volume_Info));
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File destructor
+//--------------------------------------------------------------------------
+
+Packed_Label_File::~Packed_Label_File() {
+
+   if (_fp != NULL) finish();
+   close();
+   delete[] _filename;
+   delete[] _label;
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::open
+// Maps a packed phantom file for reading and checks its header.
+// Returns FALSE if the file cannot be mapped, was written on another
+// kind of machine, or is shorter than its header says.
+//--------------------------------------------------------------------------
+
+int Packed_Label_File::open(const char *path) {
+
+   close();
+
+   delete[] _filename;
+   _filename = new char[strlen(path)+1];
+   strcpy(_filename, path);
+
+   int fd;
+   struct stat st;
+   if ((fd = ::open(path, O_RDONLY)) < 0) {
+      return FALSE;
+   }
+   if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      ::close(fd);
+      return FALSE;
+   }
+
+   void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (map == MAP_FAILED) {
+      return FALSE;
+   }
+   _map       = (unsigned char *)map;
+   _map_bytes = (unsigned long)st.st_size;
+
+   // --- Header --- //
+
+   unsigned int  order, sizes[2], counts[2];
+   unsigned long offset = sizeof(PACKED_MAGIC);
+   unsigned long fixed  = offset + sizeof(order) + sizeof(sizes) +
+                          sizeof(counts);
+
+   int ok = (_map_bytes >= fixed &&
+             memcmp(_map, PACKED_MAGIC, sizeof(PACKED_MAGIC)) == 0);
+   if (ok) {
+      memcpy(&order, _map + offset, sizeof(order));
+      offset += sizeof(order);
+      memcpy(sizes, _map + offset, sizeof(sizes));
+      offset += sizeof(sizes);
+      memcpy(counts, _map + offset, sizeof(counts));
+      offset += sizeof(counts);
+
+      ok = (order == PACKED_ORDER &&
+            sizes[0] == sizeof(Volume_Info) &&
+            sizes[1] == sizeof(Packed_Label) &&
+            counts[0] >= 1 && counts[0] <= MAX_LABEL+1 &&
+            counts[1] >= 1 && counts[1] <= MAX_LABEL+1 &&
+            _map_bytes >= offset + counts[1] + sizeof(Volume_Info));
+   }
+   if (ok) {
+      _ntop     = counts[0];
+      _ntissues = counts[1];
+      delete[] _label;
+      _label    = new Label[_ntissues];
+      memcpy(_label, _map + offset, _ntissues);
+      offset += _ntissues;
+      memcpy(&_volume_info, _map + offset, sizeof(Volume_Info));
+
+      ok = (_volume_info.number_of_dimensions == 3 &&
+            _volume_info.length[SLICE]  > 0 &&
+            _volume_info.length[ROW]    > 0 &&
+            _volume_info.length[COLUMN] > 0);
+   }
+   if (ok) {
+      _set_layout();
+      ok = (_map_bytes >= _data_offset +
+            (unsigned long)_volume_info.length[SLICE]*_chunk_bytes);
+   }
+
+   if (!ok) {
+      close();
+   }
+
+   return ok;
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::close
+// Unmaps the file opened for reading.
+//--------------------------------------------------------------------------
+
+void Packed_Label_File::close(void) {
+
+   if (_map != NULL) {
+      munmap((void *)_map, (size_t)_map_bytes);
+      _map       = NULL;
+      _map_bytes = 0;
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::display_volume_info
+// Writes formatted information about the packed phantom to an output
+// stream, in the form used for MINC volumes.
+//--------------------------------------------------------------------------
+
+void Packed_Label_File::display_volume_info(ostream& stream) const {
+
+#ifdef DEBUG
+   assert(is_open());
+#endif
+
+   stream << "file: " << _filename << endl;
+   stream << "packed labels: " << _ntissues << " tissues, "
+          << _ntop << " per voxel" << endl;
+
+   stream << "image dimensions: ";
+   int i;
+   for(i=0; i< _volume_info.number_of_dimensions; i++){
+      stream << _volume_info.dimension_names[i] << " ";
+   }
+   stream << endl;
+
+   stream << setw(20) << "dimension name" << setw(8) << "length"
+          << setw(12) << "step" << setw(12) << "start" << endl;
+   stream << setw(20) << "--------------" << setw(8) << "------"
+          << setw(12) << "----" << setw(12) << "-----" << endl;
+
+   for(i=0; i< _volume_info.number_of_dimensions; i++){
+      stream << setw(20) << _volume_info.dimension_names[i]
+             << setw(8)  << _volume_info.length[i];
+
+      if (_volume_info.step[i] == HUGE_VAL)
+         stream << setw(12) << "unknown";
+      else
+         stream << setw(12) << _volume_info.step[i];
+
+      if (_volume_info.start[i] == HUGE_VAL)
+         stream << setw(12) << "unknown" << endl;
+      else
+         stream << setw(12) << _volume_info.start[i] << endl;
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::create
+// Starts writing a packed phantom file of ntop entries per voxel for the
+// given tissue labels and volume.  Returns FALSE if the file cannot be
+// created.
+//--------------------------------------------------------------------------
+
+int Packed_Label_File::create(const char *path, unsigned int ntop,
+                              unsigned int ntissues, const Label label[],
+                              const Volume_Info &volume_info) {
+
+#ifdef DEBUG
+   assert(ntop >= 1 && ntop <= MAX_LABEL+1);
+   assert(ntissues >= 1 && ntissues <= MAX_LABEL+1);
+   assert(volume_info.number_of_dimensions == 3);
+#endif
+
+   close();
+
+   delete[] _filename;
+   _filename = new char[strlen(path)+1];
+   strcpy(_filename, path);
+
+   if ((_fp = fopen(path, "wb")) == NULL) {
+      return FALSE;
+   }
+
+   _ntop     = ntop;
+   _ntissues = ntissues;
+   delete[] _label;
+   _label    = new Label[ntissues];
+   memcpy(_label, label, ntissues);
+   memcpy(&_volume_info, &volume_info, sizeof(Volume_Info));
+   _set_layout();
+
+   const unsigned int order     = PACKED_ORDER;
+   const unsigned int sizes[2]  = {sizeof(Volume_Info), sizeof(Packed_Label)};
+   const unsigned int counts[2] = {ntop, ntissues};
+   unsigned long      header    = sizeof(PACKED_MAGIC) + sizeof(order) +
+                                  sizeof(sizes) + sizeof(counts) +
+                                  ntissues + sizeof(Volume_Info);
+
+   _write_ok = (fwrite(PACKED_MAGIC, 1, sizeof(PACKED_MAGIC), _fp) ==
+                   sizeof(PACKED_MAGIC) &&
+                fwrite(&order, sizeof(order), 1, _fp) == 1 &&
+                fwrite(sizes, sizeof(unsigned int), 2, _fp) == 2 &&
+                fwrite(counts, sizeof(unsigned int), 2, _fp) == 2 &&
+                fwrite(_label, 1, ntissues, _fp) == ntissues &&
+                fwrite(&_volume_info, sizeof(Volume_Info), 1, _fp) == 1 &&
+                fwrite(packed_padding, 1, _data_offset - header, _fp) ==
+                   _data_offset - header);
+
+   return _write_ok;
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::write_slice
+// Appends the entries of the next slice, padded to the slice alignment.
+//--------------------------------------------------------------------------
+
+int Packed_Label_File::write_slice(const Packed_Label slice[]) {
+
+#ifdef DEBUG
+   assert(_fp != NULL);
+#endif
+
+   unsigned long padding = _chunk_bytes - _slice_bytes;
+
+   _write_ok = (_write_ok &&
+                fwrite(slice, 1, _slice_bytes, _fp) == _slice_bytes &&
+                fwrite(packed_padding, 1, padding, _fp) == padding);
+
+   return _write_ok;
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::finish
+// Closes the file being written.  Returns FALSE if any part of it could
+// not be written.
+//--------------------------------------------------------------------------
+
+int Packed_Label_File::finish(void) {
+
+   if (_fp == NULL) return FALSE;
+
+   int ok = (fclose(_fp) == 0) && _write_ok;
+   _fp       = NULL;
+   _write_ok = FALSE;
+
+   return ok;
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::pack_slice
+// Packs a slice of ntissues fuzzy volumes into ntop entries per voxel.
+// The largest fractions of each voxel are kept, largest first, with the
+// lower tissue index first among equal fractions, and quantized relative
+// to the largest.  Zero and negative fractions, and fractions that
+// quantize to zero, are dropped and their entries left unused.
+//--------------------------------------------------------------------------
+
+void Packed_Label_File::pack_slice(unsigned int ntop, unsigned int ntissues,
+                                   const Label label[],
+                                   const float *const fraction[],
+                                   unsigned int nelements,
+                                   Packed_Label slice[]) {
+
+#ifdef DEBUG
+   assert(ntop >= 1 && ntop <= MAX_LABEL+1);
+#endif
+
+   float        top[MAX_LABEL+1];
+   unsigned int index[MAX_LABEL+1];
+   unsigned int n, itissue, j, count, quantized;
+   float        f;
+
+   for (n=0; n<nelements; n++){
+
+      // Insert each tissue into the sorted list of the largest fractions
+      count = 0;
+      for (itissue=0; itissue<ntissues; itissue++){
+         f = fraction[itissue][n];
+         if (!(f > 0.0)) continue;
+         if (count < ntop) {
+            j = count++;
+         } else if (f > top[ntop-1]) {
+            j = ntop-1;
+         } else {
+            continue;
+         }
+         while (j > 0 && top[j-1] < f) {
+            top[j]   = top[j-1];
+            index[j] = index[j-1];
+            j--;
+         }
+         top[j]   = f;
+         index[j] = itissue;
+      }
+
+      Packed_Label *voxel = &slice[n*ntop];
+      for (j=0; j<ntop; j++){
+         quantized = ((j < count) ?
+                      (unsigned int)(255.0*top[j]/top[0] + 0.5) : 0);
+         if (quantized > 0) {
+            voxel[j].label    = label[index[j]];
+            voxel[j].fraction = (unsigned char)quantized;
+         } else {
+            voxel[j].label    = 0;
+            voxel[j].fraction = 0;
+         }
+      }
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::_set_layout
+// Finds the slice sizes and the offset of the first slice from the
+// header fields.
+//--------------------------------------------------------------------------
+
+void Packed_Label_File::_set_layout(void) {
+
+   unsigned long header = sizeof(PACKED_MAGIC) + sizeof(unsigned int) +
+                          4*sizeof(unsigned int) + _ntissues +
+                          sizeof(Volume_Info);
+
+   _slice_bytes = (unsigned long)_volume_info.length[ROW] *
+                  (unsigned long)_volume_info.length[COLUMN] *
+                  _ntop * sizeof(Packed_Label);
+   _chunk_bytes = (_slice_bytes + PACKED_LABEL_ALIGN-1) /
+                  PACKED_LABEL_ALIGN * PACKED_LABEL_ALIGN;
+   _data_offset = (header + PACKED_LABEL_ALIGN-1) /
+                  PACKED_LABEL_ALIGN * PACKED_LABEL_ALIGN;
+
+}
@@ -0,0 +1,198 @@
+#ifndef __PACKED_LABEL_FILE_H
+#define __PACKED_LABEL_FILE_H
+
+//==========================================================================
+// PACKED_LABEL_FILE.H
+// Packed_Label_File class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <stdio.h>
+#include <minc/mincfile.h>
+#include <minc/mrilabel.h>
+// Tissues kept for each voxel unless another number is asked for
+#define PACKED_LABEL_TOP 4
+
+// Alignment, in bytes, of the first slice and of the slice chunks, so
+// that each slice starts on a page of the mapped file
+#define PACKED_LABEL_ALIGN 4096
+
+//--------------------------------------------------------------------------
+// Packed_Label
+// One tissue of a voxel of a packed phantom.  The fraction is quantized
+// so that the largest fraction of the voxel is 255; a fraction of 0
+// marks an unused entry.
+//--------------------------------------------------------------------------
+
+struct Packed_Label {
+   unsigned char label;          // tissue label
+   unsigned char fraction;       // quantized tissue fraction
+};
+
+//--------------------------------------------------------------------------
+// Packed_Label_File class
+// A fuzzy phantom in a single file.  Each voxel keeps the ntop tissues
+// with the largest fractions as Packed_Label entries, largest first, and
+// the voxels of a slice are stored together in one chunk.  The header
+// holds the tissue labels used and the volume information of the MINC
+// phantom.  A file is read by mapping it into memory, so opening it and
+// reading a slice cost the same whatever the number of tissues.  As
+// with saved Chirp filters, the file is only read on a machine with the
+// byte order and structure sizes of the one that wrote it.
+//--------------------------------------------------------------------------
+
+class Packed_Label_File {
+   public:
+      Packed_Label_File();
+      virtual ~Packed_Label_File();
+
+      // --- Reading --- //
+
+      int  open(const char *path);
+      void close(void);
+
+      inline int is_open(void) const;
+      inline const char *get_filename(void) const;
+      inline unsigned int get_ntop(void) const;
+      inline unsigned int get_ntissues(void) const;
+      inline Label get_tissue_label(unsigned int n) const;
+      inline const Volume_Info &get_volume_info(void) const;
+      inline unsigned long get_slice_bytes(void) const;
+
+      // The ntop entries of each voxel of a slice, in raster order
+      inline const Packed_Label *get_slice(int slice_num) const;
+
+      void display_volume_info(ostream& stream) const;
+
+      // --- Writing --- //
+      // Slices are written in order after create; finish returns FALSE
+      // if any of them could not be written.
+
+      int  create(const char *path, unsigned int ntop,
+                  unsigned int ntissues, const Label label[],
+                  const Volume_Info &volume_info);
+      int  write_slice(const Packed_Label slice[]);
+      int  finish(void);
+
+      // Keeps the ntop largest of the ntissues fractions of each voxel
+      static void pack_slice(unsigned int ntop, unsigned int ntissues,
+                             const Label label[],
+                             const float *const fraction[],
+                             unsigned int nelements, Packed_Label slice[]);
+
+   private:
+      char          *_filename;
+      unsigned int  _ntop;             // entries per voxel
+      unsigned int  _ntissues;
+      Label         *_label;           // tissue labels in the file
+      Volume_Info   _volume_info;
+      unsigned long _slice_bytes;      // bytes of entries in a slice
+      unsigned long _chunk_bytes;      // slice bytes with alignment
+
+      unsigned char *_map;             // mapped file, or NULL
+      unsigned long _map_bytes;
+      unsigned long _data_offset;      // offset of the first slice
+
+      FILE          *_fp;              // file being written, or NULL
+      int           _write_ok;
+
+      void _set_layout(void);
+
+      Packed_Label_File(const Packed_Label_File&);
+      Packed_Label_File& operator=(const Packed_Label_File&);
+};
+
+//--------------------------------------------------------------------------
+// Inline member functions
+//--------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::is_open
+// Returns TRUE if a packed phantom is mapped for reading.
+//--------------------------------------------------------------------------
+
+inline
+int Packed_Label_File::is_open(void) const {
+   return (_map != NULL);
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::get_filename
+// Returns the path of the file last opened or created.
+//--------------------------------------------------------------------------
+
+inline
+const char *Packed_Label_File::get_filename(void) const {
+   return _filename;
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::get_ntop
+// Returns the number of tissue entries kept for each voxel.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Packed_Label_File::get_ntop(void) const {
+   return _ntop;
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::get_ntissues
+// Returns the number of tissue labels listed in the header.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Packed_Label_File::get_ntissues(void) const {
+   return _ntissues;
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::get_tissue_label
+// Returns the n'th tissue label listed in the header.
+//--------------------------------------------------------------------------
+
+inline
+Label Packed_Label_File::get_tissue_label(unsigned int n) const {
+#ifdef DEBUG
+   assert(n < _ntissues);
+#endif
+   return _label[n];
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::get_volume_info
+// Returns the volume information of the phantom.
+//--------------------------------------------------------------------------
+
+inline
+const Volume_Info &Packed_Label_File::get_volume_info(void) const {
+   return _volume_info;
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::get_slice_bytes
+// Returns the number of bytes of entries in a slice.
+//--------------------------------------------------------------------------
+
+inline
+unsigned long Packed_Label_File::get_slice_bytes(void) const {
+   return _slice_bytes;
+}
+
+//--------------------------------------------------------------------------
+// Packed_Label_File::get_slice
+// Returns the entries of a slice in the mapped file.
+//--------------------------------------------------------------------------
+
+inline
+const Packed_Label *Packed_Label_File::get_slice(int slice_num) const {
+#ifdef DEBUG
+   assert(is_open());
+   assert(slice_num >= 0 && slice_num < _volume_info.length[SLICE]);
+#endif
+   return (const Packed_Label *)(_map + _data_offset +
+                                 (unsigned long)slice_num*_chunk_bytes);
+}
+
+#endif
@@ -0,0 +1,259 @@
+//==========================================================================
+// PACKED_PHANTOM.CXX
+// Packed_Phantom class.
+// Inherits from:  Tissue_Phantom
+// Base class to:
+//==========================================================================
+
+#include "packed_phantom.h"
+#include <minc/mriprofile.h>
+
+//---------------------------------------------------------------------------
+// Packed_Phantom constructor
+//---------------------------------------------------------------------------
+
+Packed_Phantom::Packed_Phantom(unsigned int n_tissue_classes) :
+   Phantom(n_tissue_classes),
+   Tissue_Phantom(n_tissue_classes) {
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom destructor
+//---------------------------------------------------------------------------
+
+Packed_Phantom::~Packed_Phantom() {
+
+   this->close_packed_label_file();
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::open_packed_label_file
+// Opens a packed phantom file.  Returns FALSE if it cannot be read or
+// holds a tissue label not installed in the phantom.
+//---------------------------------------------------------------------------
+
+int Packed_Phantom::open_packed_label_file(const char *path) {
+
+   if (!_label_file.open(path)) {
+      cerr << endl << "Cannot read packed phantom file: " << path << "."
+           << endl;
+      return FALSE;
+   }
+
+   unsigned int n;
+   int          status = TRUE;
+   for (n=0; n<_label_file.get_ntissues(); n++){
+      if (!tissue_label_is_valid(_label_file.get_tissue_label(n))) {
+         cerr << "Packed phantom tissue label "
+              << (int)_label_file.get_tissue_label(n)
+              << " is not in the tissue parameter file." << endl;
+         status = FALSE;
+      }
+   }
+
+   if (!status) {
+      _label_file.close();
+   }
+
+   return status;
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::close_packed_label_file
+//---------------------------------------------------------------------------
+
+void Packed_Phantom::close_packed_label_file(void) {
+
+   _label_file.close();
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_simulated_phantom_slice
+// Generate a coloured phantom slice from labelled phantom data.
+//---------------------------------------------------------------------------
+
+void Packed_Phantom::get_simulated_phantom_slice(int slice_num,
+                                                 Complex_Slice& sim_slice) {
+
+#ifdef DEBUG
+   // Check that the slice is the right size
+   assert(this->is_same_slice_size_as(sim_slice));
+   assert(slice_num >= 0);
+   assert(slice_num < get_nslices());
+#endif
+
+   // Look up the intensity of each tissue once for the slice, by label
+   double       real_intensity[MAX_TISSUE_LABEL+1];
+   double       imag_intensity[MAX_TISSUE_LABEL+1];
+   unsigned int itissue, n;
+   for (n=0; n<=MAX_TISSUE_LABEL; n++){
+      real_intensity[n] = 0.0;
+      imag_intensity[n] = 0.0;
+   }
+   for (itissue=0; itissue<get_num_tissues(); itissue++){
+      Tissue_Label tissue_label = get_tissue_label(itissue);
+      real_intensity[tissue_label] =
+                     Tissue_Phantom::get_real_intensity(tissue_label);
+      imag_intensity[tissue_label] =
+                     Tissue_Phantom::get_imag_intensity(tissue_label);
+   }
+
+   // Weight the tissues kept for each voxel and normalize
+   _mix_tissues(_load_packed_slice(slice_num),
+                real_intensity, imag_intensity, sim_slice);
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_simulated_mag_phantom_slice
+// Generate a coloured phantom slice from labelled phantom data.
+//---------------------------------------------------------------------------
+
+void Packed_Phantom::get_simulated_mag_phantom_slice(int slice_num,
+                                                     Real_Slice& sim_slice) {
+
+#ifdef DEBUG
+   // Check that the slice is the right size
+   assert(this->is_same_slice_size_as(sim_slice));
+   assert(slice_num >= 0);
+   assert(slice_num < get_nslices());
+#endif
+
+   // Look up the intensity of each tissue once for the slice, by label
+   double       intensity[MAX_TISSUE_LABEL+1];
+   unsigned int itissue, n;
+   for (n=0; n<=MAX_TISSUE_LABEL; n++){
+      intensity[n] = 0.0;
+   }
+   for (itissue=0; itissue<get_num_tissues(); itissue++){
+      Tissue_Label tissue_label = get_tissue_label(itissue);
+      intensity[tissue_label] =
+                     Tissue_Phantom::get_mag_intensity(tissue_label);
+   }
+
+   // Weight the tissues kept for each voxel and normalize
+   _mix_tissues(_load_packed_slice(slice_num), intensity, sim_slice);
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_simulated_real_phantom_slice
+// Generate a coloured phantom slice from labelled phantom data.
+//---------------------------------------------------------------------------
+
+void Packed_Phantom::get_simulated_real_phantom_slice(int slice_num,
+                                                      Real_Slice& sim_slice) {
+
+#ifdef DEBUG
+   // Check that the slice is the right size
+   assert(this->is_same_slice_size_as(sim_slice));
+   assert(slice_num >= 0);
+   assert(slice_num < get_nslices());
+#endif
+
+   // Look up the intensity of each tissue once for the slice, by label
+   double       intensity[MAX_TISSUE_LABEL+1];
+   unsigned int itissue, n;
+   for (n=0; n<=MAX_TISSUE_LABEL; n++){
+      intensity[n] = 0.0;
+   }
+   for (itissue=0; itissue<get_num_tissues(); itissue++){
+      Tissue_Label tissue_label = get_tissue_label(itissue);
+      intensity[tissue_label] =
+                     Tissue_Phantom::get_real_intensity(tissue_label);
+   }
+
+   // Weight the tissues kept for each voxel and normalize
+   _mix_tissues(_load_packed_slice(slice_num), intensity, sim_slice);
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::_load_packed_slice
+// Returns the entries of a slice in the mapped file.  The pages of the
+// slice are read from the file as they are first touched.
+//---------------------------------------------------------------------------
+
+const Packed_Label *Packed_Phantom::_load_packed_slice(int slice_num) const {
+
+   MRI_Profile_Timer timer(MRI_Profile::TIME_LABEL_LOAD);
+   MRI_Profile::count(MRI_Profile::BYTES_READ, _label_file.get_slice_bytes());
+
+   return _label_file.get_slice(slice_num);
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::_mix_tissues
+// Computes the fuzzy weighted average of the intensities of the tissues
+// kept for each voxel,
+//
+//    sim_slice = sum(fraction[j] * intensity[label[j]]) / sum(fraction[j])
+//
+// with the intensities indexed by tissue label.  Unused entries have a
+// zero fraction and add nothing.
+//---------------------------------------------------------------------------
+
+void Packed_Phantom::_mix_tissues(const Packed_Label packed_slice[],
+                                  const double intensity[],
+                                  Real_Slice& sim_slice) const {
+
+#ifdef DEBUG
+   assert(this->is_same_slice_size_as(sim_slice));
+#endif
+
+   unsigned int ntop = _label_file.get_ntop();
+   unsigned int len  = sim_slice.get_nelements();
+   float        *out = sim_slice.row_ptr(0);
+
+   unsigned int n, j;
+   double       acc, sum;
+
+   for (n=0; n<len; n++){
+      const Packed_Label *voxel = &packed_slice[n*ntop];
+      acc = 0.0;
+      sum = 0.0;
+      for (j=0; j<ntop; j++){
+         acc += voxel[j].fraction * intensity[voxel[j].label];
+         sum += voxel[j].fraction;
+      }
+      out[n] = acc / sum;
+   }
+
+}
+
+void Packed_Phantom::_mix_tissues(const Packed_Label packed_slice[],
+                                  const double real_intensity[],
+                                  const double imag_intensity[],
+                                  Complex_Slice& sim_slice) const {
+
+#ifdef DEBUG
+   assert(this->is_same_slice_size_as(sim_slice));
+#endif
+
+   unsigned int ntop = _label_file.get_ntop();
+   unsigned int len  = sim_slice.get_nelements();
+   float        *out = sim_slice.row_ptr(0);
+
+   unsigned int n, j;
+   double       re, im, sum;
+
+   for (n=0; n<len; n++){
+      const Packed_Label *voxel = &packed_slice[n*ntop];
+      re  = 0.0;
+      im  = 0.0;
+      sum = 0.0;
+      for (j=0; j<ntop; j++){
+         re  += voxel[j].fraction * real_intensity[voxel[j].label];
+         im  += voxel[j].fraction * imag_intensity[voxel[j].label];
+         sum += voxel[j].fraction;
+      }
+      out[2*n]   = re / sum;
+      out[2*n+1] = im / sum;
+   }
+
+}
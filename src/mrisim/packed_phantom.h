@@ -0,0 +1,192 @@
+#ifndef __PACKED_PHANTOM_H
+#define __PACKED_PHANTOM_H
+
+//==========================================================================
+// PACKED_PHANTOM.H
+// Packed_Phantom class.
+// Inherits from:  Tissue_Phantom
+// Base class to:
+//==========================================================================
+
+#include "tissue_phantom.h"
+#include "packed_label_file.h"
+
+//---------------------------------------------------------------------------
+// Packed_Phantom class
+// Describes a fuzzy MRI phantom read from a single Packed_Label_File
+// rather than from one MINC file per tissue.  Each voxel mixes the few
+// tissues kept for it in the file, so a slice is read and mixed at the
+// same cost whatever the number of tissues.  The output volume takes the
+// dimensions of the packed phantom, without the rest of its original
+// MINC header.
+//---------------------------------------------------------------------------
+
+class Packed_Phantom : public Tissue_Phantom {
+   public:
+      Packed_Phantom(unsigned int n_tissue_classes);
+
+      virtual ~Packed_Phantom();
+
+      // --- Tissue Information --- //
+      // The tissues must be installed before the file is opened.
+      int  open_packed_label_file(const char *path);
+      void close_packed_label_file(void);
+
+      // --- Image Formation --- //
+      void get_simulated_phantom_slice(int slice_num,
+                                       Complex_Slice& sim_slice);
+      void get_simulated_mag_phantom_slice(int slice_num,
+                                       Real_Slice& sim_slice);
+      void get_simulated_real_phantom_slice(int slice_num,
+                                       Real_Slice& sim_slice);
+
+      // --- Volume convenience functions --- //
+      inline int    is_same_slice_size_as(const MRI_Matrix& mat) const;
+      inline int    get_nrows(void) const;
+      inline int    get_ncols(void) const;
+      inline int    get_nslices(void) const;
+      inline void   get_volume_dimensions(int length[]) const;
+      inline void   get_volume_info(Volume_Info &volume_info) const;
+      inline double get_voxel_step(int n) const;
+      inline double get_voxel_start(int n) const;
+      inline void   display_volume_info(ostream& stream) const;
+      inline void   set_output_volume_info(O_MINC_File& output,
+                                        const Volume_Info& vol_info,
+                                        const char *argstring = NULL) const;
+
+   protected:
+
+      // --- Internal member functions --- //
+      const Packed_Label *_load_packed_slice(int slice_num) const;
+
+      void _mix_tissues(const Packed_Label packed_slice[],
+                        const double intensity[],
+                        Real_Slice& sim_slice) const;
+      void _mix_tissues(const Packed_Label packed_slice[],
+                        const double real_intensity[],
+                        const double imag_intensity[],
+                        Complex_Slice& sim_slice) const;
+
+      // --- Internal data structures --- //
+      Packed_Label_File _label_file;
+
+};
+
+//---------------------------------------------------------------------------
+// Inline member functions
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::is_same_slice_size_as
+// Returns TRUE if the matrix has the same row and column dimensions as
+// the phantom.
+//---------------------------------------------------------------------------
+
+inline
+int Packed_Phantom::is_same_slice_size_as(const MRI_Matrix& mat) const {
+   return ((mat.get_nrows() == (unsigned int)get_nrows()) &&
+           (mat.get_ncols() == (unsigned int)get_ncols()));
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_nrows
+// Return the length of the ROW dimension of the phantom.
+//---------------------------------------------------------------------------
+
+inline
+int Packed_Phantom::get_nrows(void) const {
+   return (int)_label_file.get_volume_info().length[ROW];
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_ncols
+// Return the length of the COLUMN dimension of the phantom.
+//---------------------------------------------------------------------------
+
+inline
+int Packed_Phantom::get_ncols(void) const {
+   return (int)_label_file.get_volume_info().length[COLUMN];
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_nslices
+// Return the length of the SLICE dimension of the phantom.
+//---------------------------------------------------------------------------
+
+inline
+int Packed_Phantom::get_nslices(void) const {
+   return (int)_label_file.get_volume_info().length[SLICE];
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_volume_dimensions
+// Returns the dimension lengths of the phantom.
+//---------------------------------------------------------------------------
+
+inline
+void Packed_Phantom::get_volume_dimensions(int length[]) const {
+
+   length[SLICE]  = get_nslices();
+   length[ROW]    = get_nrows();
+   length[COLUMN] = get_ncols();
+
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_volume_info
+// Gets information about the packed phantom volume.
+//---------------------------------------------------------------------------
+
+inline
+void Packed_Phantom::get_volume_info(Volume_Info &volume_info) const {
+   volume_info = _label_file.get_volume_info();
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_voxel_step
+// Returns the step size of the phantom dimension n.
+//---------------------------------------------------------------------------
+
+inline
+double Packed_Phantom::get_voxel_step(int n) const {
+   return _label_file.get_volume_info().step[n];
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::get_voxel_start
+// Returns the start value of the phantom dimension n.
+//---------------------------------------------------------------------------
+
+inline
+double Packed_Phantom::get_voxel_start(int n) const {
+   return _label_file.get_volume_info().start[n];
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::display_volume_info
+// Displays information about the packed phantom volume.
+//---------------------------------------------------------------------------
+
+inline
+void Packed_Phantom::display_volume_info(ostream& stream) const {
+   stream << "Phantom Labelled Volume Information:" << endl;
+   stream << "------------------------------------" << endl << endl;
+   _label_file.display_volume_info(stream);
+}
+
+//---------------------------------------------------------------------------
+// Packed_Phantom::set_output_volume_info
+// Sets the volume information of an output file.  There is no MINC
+// header to copy from.
+//---------------------------------------------------------------------------
+
+inline
+void Packed_Phantom::set_output_volume_info(O_MINC_File& output,
+                                           const Volume_Info& vol_info,
+                                           const char *argstring) const {
+
+   output.set_volume_info(MI_ERROR, vol_info, argstring);
+
+}
+
+#endif
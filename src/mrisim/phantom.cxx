@@ -37,7 +37,9 @@
 //===========================================================================
 
 #include "phantom.h"
+#include <minc/mriprofile.h>
 #include <assert.h>
+#include <string.h>
 #include <float.h>
 
 #include <signal/quick_model.h>
@@ -50,6 +52,11 @@
 #define COLUMN 2
 #endif
 
+// Timed runs of each resampling method when tuning, and the most a
+// method may be estimated to cost, relative to the cheapest, to be tried
+#define AUTOTUNE_TRIALS     5
+#define AUTOTUNE_COST_LIMIT 4.0
+
 //---------------------------------------------------------------------------
 // Static data members
 //---------------------------------------------------------------------------
@@ -57,6 +64,32 @@
 double Phantom::_I_sample;
 double Phantom::_Q_sample;
 
+//---------------------------------------------------------------------------
+// Resample_Workspace constructor
+//---------------------------------------------------------------------------
+
+Resample_Workspace::Resample_Workspace(unsigned int in_nrows,
+                                       unsigned int out_nrows,
+                                       unsigned int out_ncols,
+                                       unsigned int row_work_length,
+                                       unsigned int col_work_length)
+   : tmp_slice(in_nrows, out_ncols), tmp_trans(out_ncols, in_nrows),
+     raw_trans(out_ncols, out_nrows) {
+
+   row_work = new double[row_work_length];
+   col_work = new double[col_work_length];
+
+}
+
+//---------------------------------------------------------------------------
+// Resample_Workspace destructor
+//---------------------------------------------------------------------------
+
+Resample_Workspace::~Resample_Workspace() {
+   delete[] row_work;
+   delete[] col_work;
+}
+
 //---------------------------------------------------------------------------
 // Phantom constructor
 //---------------------------------------------------------------------------
@@ -112,11 +145,35 @@ Phantom::Phantom(unsigned int n_tissue_classes) {
    _min_mag  = DBL_MAX;
 
    // Fourier resampling
+   _resample_method = RESAMPLE_CHIRP;
    row_chirp  = NULL;
    col_chirp  = NULL;
-   row_weight = NULL;
-   col_weight = NULL;
-   tmp_slice  = NULL;
+   row_dft    = NULL;
+   col_dft    = NULL;
+   workspace  = NULL;
+
+   _chirp_row_length = 0;
+   _chirp_col_length = 0;
+   _chirp_row_fov    = 0.0;
+   _chirp_col_fov    = 0.0;
+   _row_w_initial    = 0.0;
+   _row_w_step       = 0.0;
+   _col_w_initial    = 0.0;
+   _col_w_step       = 0.0;
+   _autotune_flag    = FALSE;
+
+   // Synthesized slices are not cached until set_slice_cache_size
+   _pseq         = NULL;
+   _pseq_serial  = 0;
+   _slice_cache  = NULL;
+
+   // Tissue signals are not cached until set_sequence_key
+   _sequence_key = NULL;
+
+   // Slices are selected by summing phantom slices until use_z_integral
+   _z_integral_flag   = FALSE;
+   _z_integral        = NULL;
+   _z_integral_serial = 0;
 }
 
 //---------------------------------------------------------------------------
@@ -138,11 +195,14 @@ Phantom::~Phantom(){
 
    // Clean up Fourier resampling temporaries
 
-   if (row_chirp != NULL) delete row_chirp;
-   if (col_chirp != NULL) delete col_chirp;
-   if (row_weight != NULL) delete row_weight;
-   if (col_weight != NULL) delete col_weight;
-   if (tmp_slice != NULL) delete tmp_slice;
+   // The Chirp filters belong to the shared Chirp_Plan registry
+
+   if (row_dft != NULL) delete row_dft;
+   if (col_dft != NULL) delete col_dft;
+   if (workspace != NULL) delete workspace;
+   if (_slice_cache != NULL) delete _slice_cache;
+   if (_sequence_key != NULL) delete[] _sequence_key;
+   _free_z_integral();
 
 }
 
@@ -238,6 +298,11 @@ void Phantom::ideal_lin_slice_select(double z_centre,
    cout << "z_start: " << z_start << " z_stop: " << z_stop << endl;
 #endif
 
+   if (_z_integral_flag) {
+      _integral_lin_slice_select(z_min, z_max, output_slice);
+      return;
+   }
+
    // Buffer two phantom slices at a time to compute a single output slice.  
    // Clear the output slice and create two buffer slices of the same size.
    // Set up a buffer of pointers to the slices and a temporary pointer
@@ -269,12 +334,12 @@ void Phantom::ideal_lin_slice_select(double z_centre,
      
       // If slices do not exist in the phantom assume they are zero.
       if (z_start >= 0 && z_start < get_nslices()) {
-         get_simulated_mag_phantom_slice(z_start, *(buffer[0]));
+         _get_cached_mag_phantom_slice(z_start, *(buffer[0]));
          output_slice.saxpy(w0, *(buffer[0]), output_slice); 
          total_w += w0;
       }
       if (z_start+1 >= 0 && z_start+1 < get_nslices()) { 
-         get_simulated_mag_phantom_slice(z_start+1, *(buffer[1]));
+         _get_cached_mag_phantom_slice(z_start+1, *(buffer[1]));
          output_slice.saxpy(w1, *(buffer[1]), output_slice);
          total_w += w1;
       }
@@ -303,7 +368,7 @@ void Phantom::ideal_lin_slice_select(double z_centre,
       w1 = u - w0;
    
       if (z_start >= 0 && z_start < get_nslices()) {
-         get_simulated_mag_phantom_slice(z_start, *(buffer[0]));
+         _get_cached_mag_phantom_slice(z_start, *(buffer[0]));
          output_slice.saxpy(w0, *(buffer[0]), output_slice); 
          total_w += w0;
 #ifdef TRACE
@@ -311,7 +376,7 @@ void Phantom::ideal_lin_slice_select(double z_centre,
 #endif
       }
       if (z_start+1 >= 0 && z_start+1 < get_nslices()) { 
-         get_simulated_mag_phantom_slice(z_start+1, *(buffer[1]));
+         _get_cached_mag_phantom_slice(z_start+1, *(buffer[1]));
          output_slice.saxpy(w1, *(buffer[1]), output_slice);
          total_w += w1;
 #ifdef TRACE
@@ -345,7 +410,7 @@ void Phantom::ideal_lin_slice_select(double z_centre,
 #endif
          }
          if (z_n+1 >= 0 && z_n+1 < get_nslices()) {
-            get_simulated_mag_phantom_slice(z_n+1, *(buffer[1]));
+            _get_cached_mag_phantom_slice(z_n+1, *(buffer[1]));
             output_slice.saxpy(w0, *(buffer[1]), output_slice);
             total_w += w0;
 #ifdef TRACE
@@ -376,7 +441,7 @@ void Phantom::ideal_lin_slice_select(double z_centre,
 #endif
       }
       if (z_stop+1 >= 0 && z_stop+1 < get_nslices()) {
-         get_simulated_mag_phantom_slice(z_stop+1, *(buffer[1]));
+         _get_cached_mag_phantom_slice(z_stop+1, *(buffer[1]));
          output_slice.saxpy(w1, *(buffer[1]), output_slice); 
          total_w += w1;
 #ifdef TRACE
@@ -398,6 +463,114 @@ void Phantom::ideal_lin_slice_select(double z_centre,
    delete buffer[1];
 }
 
+//---------------------------------------------------------------------------
+// Phantom::set_slice_cache_size
+// Sets the memory used to cache synthesized phantom slices, which are
+// otherwise resynthesized for every output slice they contribute to.
+// A size of 0 turns the cache off.  Must be called after the phantom
+// volume has been opened, and before slices are generated.
+//---------------------------------------------------------------------------
+
+void Phantom::set_slice_cache_size(unsigned long max_bytes) {
+
+   if (_slice_cache != NULL) {
+      delete _slice_cache;
+      _slice_cache = NULL;
+   }
+   if (max_bytes > 0) {
+      _slice_cache = new Phantom_Slice_Cache(get_nrows(), get_ncols(),
+                                             max_bytes);
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::set_sequence_key
+// Sets a string holding every parameter of the pulse sequence next
+// applied to the phantom, so that the signals of its tissues are kept
+// in the Tissue_Signal_Cache and taken from it rather than simulated
+// again.  A NULL key turns the signal cache off.
+//---------------------------------------------------------------------------
+
+void Phantom::set_sequence_key(const char *sequence_key) {
+
+   if (_sequence_key != NULL) {
+      delete[] _sequence_key;
+      _sequence_key = NULL;
+   }
+   if (sequence_key != NULL) {
+      _sequence_key = new char[strlen(sequence_key) + 1];
+      strcpy(_sequence_key, sequence_key);
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_find_tissue_signal
+// Gets the signals of tissue itissue from the signal cache: the signal
+// without flip angle error, followed by one for each of the nflip flip
+// angle errors.  Returns FALSE if the signals must be simulated.
+//---------------------------------------------------------------------------
+
+int Phantom::_find_tissue_signal(Signal_Model model, unsigned int itissue,
+                                 unsigned int nflip,
+                                 const double flip_error[],
+                                 double real[], double imag[]) const {
+
+   if (_sequence_key == NULL) {
+      return FALSE;
+   }
+
+   return Tissue_Signal_Cache::find(
+             Tissue_Signal_Cache::make_key(_sequence_key, model,
+                                           *_tissue[itissue],
+                                           nflip, flip_error),
+             nflip+1, real, imag);
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_save_tissue_signal
+// Keeps the simulated signals of tissue itissue in the signal cache.
+//---------------------------------------------------------------------------
+
+void Phantom::_save_tissue_signal(Signal_Model model, unsigned int itissue,
+                                  unsigned int nflip,
+                                  const double flip_error[],
+                                  const double real[],
+                                  const double imag[]) const {
+
+   if (_sequence_key == NULL) {
+      return;
+   }
+
+   Tissue_Signal_Cache::add(
+             Tissue_Signal_Cache::make_key(_sequence_key, model,
+                                           *_tissue[itissue],
+                                           nflip, flip_error),
+             nflip+1, real, imag);
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_get_cached_mag_phantom_slice
+// As get_simulated_mag_phantom_slice, but returns the slice from the 
+// cache if it has already been synthesized for the current pulse 
+// sequence.
+//---------------------------------------------------------------------------
+
+void Phantom::_get_cached_mag_phantom_slice(int slice_num, 
+                                            Real_Slice& sim_slice) {
+
+   if (_slice_cache == NULL) {
+      get_simulated_mag_phantom_slice(slice_num, sim_slice);
+   } else if (!_slice_cache->get(slice_num, _pseq_serial, sim_slice)) {
+      get_simulated_mag_phantom_slice(slice_num, sim_slice);
+      _slice_cache->put(slice_num, _pseq_serial, sim_slice);
+   }
+
+}
+
 //---------------------------------------------------------------------------
 // Phantom::ideal_nn_slice_select
 //
@@ -433,6 +606,11 @@ void Phantom::ideal_nn_slice_select(double z_centre,
    double z_min = (z_centre - 0.5*slice_thickness)/phantom_thickness;
    double z_max = (z_centre + 0.5*slice_thickness)/phantom_thickness;
 
+   if (_z_integral_flag) {
+      _integral_nn_slice_select(z_min, z_max, output_slice);
+      return;
+   }
+
    int z_start = (int)floor(z_min);
    int z_stop  = (int)floor(z_max);
 
@@ -462,7 +640,7 @@ void Phantom::ideal_nn_slice_select(double z_centre,
 
       if (z_start >= 0 && z_start < get_nslices()) {
 
-         get_simulated_mag_phantom_slice(z_start, buffer);
+         _get_cached_mag_phantom_slice(z_start, buffer);
 
          // Compute special case slice selection weighting
          w = (z_max - z_min);
@@ -487,7 +665,7 @@ void Phantom::ideal_nn_slice_select(double z_centre,
       // If slices do not exist in the phantom assume they are zero.
       if (z_start >= 0 && z_start < get_nslices()) {
 
-         get_simulated_mag_phantom_slice(z_start, buffer);
+         _get_cached_mag_phantom_slice(z_start, buffer);
 
          // Compute partial slice weight, and weight the slice.
          w = (z_start + 0.5 - z_min);
@@ -504,7 +682,7 @@ void Phantom::ideal_nn_slice_select(double z_centre,
          // Load simulated phantom slice into the buffer. 
          if (z_n >= 0 && z_n < get_nslices()) {
 
-            get_simulated_mag_phantom_slice(z_n, buffer);
+            _get_cached_mag_phantom_slice(z_n, buffer);
 
             // Weight the slice (w = 1)
             output_slice += buffer;
@@ -518,7 +696,7 @@ void Phantom::ideal_nn_slice_select(double z_centre,
       // Load simulated phantom slice into the buffer.
       if (z_stop >= 0 && z_stop < get_nslices()) {
 
-         get_simulated_mag_phantom_slice(z_stop, buffer);
+         _get_cached_mag_phantom_slice(z_stop, buffer);
 
          // Compute partial slice weight, and weight the slice.
          w = (z_max - z_stop + 0.5);
@@ -534,6 +712,236 @@ void Phantom::ideal_nn_slice_select(double z_centre,
 
 }
 
+//---------------------------------------------------------------------------
+// Phantom::use_z_integral
+// Turns on (or off) slice selection from an integral of the synthesized
+// phantom along z.  The integral holds nslices+1 double precision slices
+// and is built on first use for each pulse sequence, after which any
+// rectangular slice profile is computed from a fixed number of integral
+// slices, independent of the slice thickness.
+//---------------------------------------------------------------------------
+
+void Phantom::use_z_integral(int flag) {
+
+   MRI_Lock lock(_z_integral_mutex);
+   _z_integral_flag = flag;
+   if (!flag) {
+      _free_z_integral();
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::use_autotune
+// Turns on (or off) choosing the Fourier resampling method by timing
+// each candidate on the output geometry in initialize_chirp, rather
+// than by the cost model alone.
+//---------------------------------------------------------------------------
+
+void Phantom::use_autotune(int flag) {
+   _autotune_flag = flag;
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_build_z_integral
+// Synthesizes every phantom slice for the current pulse sequence and
+// accumulates them along z, unless this has already been done.
+// _z_integral[k] is the sum of phantom slices 0 to k-1, so the sum of
+// slices first to last is _z_integral[last+1] - _z_integral[first].
+//---------------------------------------------------------------------------
+
+void Phantom::_build_z_integral(void) {
+
+   MRI_Lock lock(_z_integral_mutex);
+
+   if ((_z_integral != NULL) && (_z_integral_serial == _pseq_serial)) {
+      return;
+   }
+
+   int nslices = get_nslices();
+   int nrows   = get_nrows();
+   int ncols   = get_ncols();
+
+   if (_z_integral == NULL) {
+      _z_integral = new MRI_Double_Matrix *[nslices+1];
+      int k;
+      for (k=0; k<=nslices; k++){
+         _z_integral[k] = new MRI_Double_Matrix(nrows, ncols);
+      }
+   }
+
+   Real_Slice buffer(nrows, ncols);
+   unsigned int n, len = buffer.get_nelements();
+
+   _z_integral[0]->zeros();
+   int k;
+   for (k=0; k<nslices; k++){
+      get_simulated_mag_phantom_slice(k, buffer);
+      const double *prev = *(_z_integral[k]);
+      double       *next = *(_z_integral[k+1]);
+      const float  *in   = buffer;
+      for (n=0; n<len; n++){
+         next[n] = prev[n] + in[n];
+      }
+   }
+
+   _z_integral_serial = _pseq_serial;
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_free_z_integral
+// Releases the z integral.
+//---------------------------------------------------------------------------
+
+void Phantom::_free_z_integral(void) {
+
+   if (_z_integral != NULL) {
+      int k;
+      for (k=0; k<=get_nslices(); k++){
+         delete _z_integral[k];
+      }
+      delete[] _z_integral;
+      _z_integral = NULL;
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_add_z_sum
+// Adds w times the sum of phantom slices first to last to sum, and w
+// for each of those slices to total_w.  Slices outside the phantom are
+// taken as zero and do not contribute to total_w.
+//---------------------------------------------------------------------------
+
+void Phantom::_add_z_sum(int first, int last, double w,
+                         MRI_Double_Matrix& sum, double& total_w) const {
+
+   if (first < 0) first = 0;
+   if (last >= get_nslices()) last = get_nslices()-1;
+   if (first > last || w == 0.0) return;
+
+   const double *hi = *(_z_integral[last+1]);
+   const double *lo = *(_z_integral[first]);
+   double       *out = sum;
+   unsigned int n, len = sum.get_nelements();
+
+   for (n=0; n<len; n++){
+      out[n] += w*(hi[n] - lo[n]);
+   }
+   total_w += w*(last - first + 1);
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_integral_lin_slice_select
+// As ideal_lin_slice_select, using the z integral.  The linear kernel
+// weights of the interior phantom slices are constant, so each output
+// slice needs at most six differences of integral slices.
+//---------------------------------------------------------------------------
+
+void Phantom::_integral_lin_slice_select(double z_min, double z_max,
+                                         Real_Slice& output_slice) {
+
+   _build_z_integral();
+
+   int z_start = (int)floor(z_min);
+   int z_stop  = (int)floor(z_max);
+
+   MRI_Double_Matrix sum(output_slice.get_nrows(), output_slice.get_ncols());
+   double u, v, w0, w1, total_w = 0;
+
+   if (z_start == z_stop){
+
+      // --- SPECIAL CASE: sub-slice interpolation of phantom --- //
+      u  = z_min - z_start; 
+      v  = z_max - z_min;
+      w0 = v * (u + 0.5 * v);
+      w1 = v - w0;
+      _add_z_sum(z_start, z_start, w0, sum, total_w);
+      _add_z_sum(z_start+1, z_start+1, w1, sum, total_w);
+
+   } else {
+
+      // --- FIRST PARTIAL SLICE --- //
+      u  = (z_start + 1) - z_min;
+      w0 = 0.5 * u * u;
+      w1 = u - w0;
+      _add_z_sum(z_start, z_start, w0, sum, total_w);
+      _add_z_sum(z_start+1, z_start+1, w1, sum, total_w);
+
+      // --- COMPLETE SLICES --- //
+      // Each complete slice adds half a weight to the phantom samples
+      // at both of its boundaries.
+      _add_z_sum(z_start+1, z_stop-1, 0.5, sum, total_w);
+      _add_z_sum(z_start+2, z_stop, 0.5, sum, total_w);
+
+      // --- LAST PARTIAL SLICE --- //
+      u  = z_max - z_stop;
+      w1 = 0.5 * u * u;
+      w0 = u - w1;
+      _add_z_sum(z_stop, z_stop, w0, sum, total_w);
+      _add_z_sum(z_stop+1, z_stop+1, w1, sum, total_w);
+
+   }
+
+   if (total_w > 0.0) {
+      sum *= (1.0/total_w);
+   }
+
+   float        *out = output_slice;
+   const double *in  = sum;
+   unsigned int n, len = output_slice.get_nelements();
+   for (n=0; n<len; n++){
+      out[n] = (float)in[n];
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_integral_nn_slice_select
+// As ideal_nn_slice_select, using the z integral.
+//---------------------------------------------------------------------------
+
+void Phantom::_integral_nn_slice_select(double z_min, double z_max,
+                                        Real_Slice& output_slice) {
+
+   _build_z_integral();
+
+   int z_start = (int)floor(z_min);
+   int z_stop  = (int)floor(z_max);
+
+   // z_start is rounded up at the half pixel
+   // z_stop is rounded down at the half pixel
+   if ((z_min - z_start) >= 0.5)
+      z_start = z_start + 1;
+   if ((z_max - z_stop) > 0.5)
+      z_stop  = z_stop + 1;
+
+   MRI_Double_Matrix sum(output_slice.get_nrows(), output_slice.get_ncols());
+   double total_w = 0;
+
+   if (z_start == z_stop){
+      _add_z_sum(z_start, z_start, z_max - z_min, sum, total_w);
+   } else {
+      _add_z_sum(z_start, z_start, z_start + 0.5 - z_min, sum, total_w);
+      _add_z_sum(z_start+1, z_stop-1, 1.0, sum, total_w);
+      _add_z_sum(z_stop, z_stop, z_max - z_stop + 0.5, sum, total_w);
+   }
+
+   if (total_w > 0.0) {
+      sum *= (1.0/total_w);
+   }
+
+   float        *out = output_slice;
+   const double *in  = sum;
+   unsigned int n, len = output_slice.get_nelements();
+   for (n=0; n<len; n++){
+      out[n] = (float)in[n];
+   }
+
+}
+
 //---------------------------------------------------------------------------
 // Phantom::compute_partial_volume
 // Computes intra-slice partial volume by weighting phantom voxels
@@ -711,45 +1119,12 @@ void Phantom::compute_partial_volume(const Real_Slice& phantom_slice,
 
 }
 
-//---------------------------------------------------------------------------
-// Phantom::_direct_fourier_resample
-// Resample the simulated slice's Fourier transform using direct evaluation.
-//---------------------------------------------------------------------------
-
-void Phantom::_direct_fourier_resample(const Complex_Slice& /*sim_slice*/,
-                                       Complex_Slice& /*raw_slice*/) {
-
-#ifdef DEBUG
-   // assert that raw_slice is the right size
-#endif
-
-   cerr << "Phantom::_direct_fourier_resample not implemented." << endl;
-
-}
-
-//---------------------------------------------------------------------------
-// Phantom::_fft_fourier_resample
-// Resample the simulated slice's Fourier transform using FFT evaluation.
-// Works only for power of two matrix sizes.
-// Does not work when image bandwidth is larger than the sampled phantom's
-// bandwidth.  In that case use Phantom::_direct_fourier_resample.
-//---------------------------------------------------------------------------
-
-void Phantom::_fft_fourier_resample(const Complex_Slice& /*sim_slice*/,
-                                    Complex_Slice& /*raw_slice*/) {
-
-#ifdef DEBUG
-   // assert that raw_slice is the right size
-#endif
-
-   cerr << "Phantom::_fft_fourier_resample not implemented." << endl;
-
-}
-
 //---------------------------------------------------------------------------
 // Phantom::initialize_chirp
-// Precomputes Chirp DFT filters required for the row-column decomposition
-// of the 2-D Chirp DFT.
+// Chooses how the 2-D DFT of the Fourier resampling is computed and
+// prepares its 1-D DFTs: the Chirp DFT filters from the shared
+// Chirp_Plan registry, or the FFT or direct DFTs.  Nothing is done if
+// the output geometry is unchanged, as for a batch of pulse sequences.
 //---------------------------------------------------------------------------
 
 void Phantom::initialize_chirp(unsigned int out_row_length,
@@ -757,6 +1132,18 @@ void Phantom::initialize_chirp(unsigned int out_row_length,
                                double out_row_fov,
                                double out_col_fov) {
 
+   if ((row_chirp != NULL || row_dft != NULL) &&
+       out_row_length == _chirp_row_length &&
+       out_col_length == _chirp_col_length &&
+       out_row_fov    == _chirp_row_fov &&
+       out_col_fov    == _chirp_col_fov) {
+      return;
+   }
+   _chirp_row_length = out_row_length;
+   _chirp_col_length = out_col_length;
+   _chirp_row_fov    = out_row_fov;
+   _chirp_col_fov    = out_col_fov;
+
    // The 2-D Chirp DFT is performed by a row-column decomposition of
    // 1-D Chirp DFTs.  A 1-D Chirp is performed on each row of the matrix
    // followed by a 1-D Chirp on each column of the matrix.
@@ -792,33 +1179,252 @@ void Phantom::initialize_chirp(unsigned int out_row_length,
    const double row_w_initial = -row_w_step*(double)out_row_length/2.0;
    const double col_w_initial = -col_w_step*(double)out_row_length/2.0;
 
-   // Precompute the Chirp DFT filters needed to compute 1-D transforms
-   // over row or col slices.   The 2-D Chirp DFT is formed by a
-   // row-column decomposition using the 1-D DFTs.
+   // --- Choose the resampling method --- //
+   // The estimated time of each method is that of the 1-D DFTs of the
+   // in_col_length real rows and of the out_row_length complex columns
+   // of the partial result.  The Chirp DFT also transposes the partial
+   // result and the output.  The FFT can only be used when the output
+   // frequencies are bins of a valid FFT length in both directions;
+   // the direct DFT wins for small output matrices.
+
+   double cost[RESAMPLE_NMETHODS];
+
+   cost[RESAMPLE_CHIRP] = in_col_length *
+                          Chirp_Algorithm::get_cost(in_row_length,
+                                                    out_row_length,
+                                                    row_w_initial, row_w_step,
+                                                    FALSE) +
+                          out_row_length *
+                          Chirp_Algorithm::get_cost(in_col_length,
+                                                    out_col_length,
+                                                    col_w_initial, col_w_step,
+                                                    TRUE) +
+                          FFT_COST_POINTWISE * out_row_length *
+                          (in_col_length + out_col_length);
+
+   const Resample_Method methods[2] = {RESAMPLE_FFT, RESAMPLE_DIRECT};
+   double row_cost, col_cost;
+   int n;
 
-   if (row_chirp != NULL) delete row_chirp;
-   row_chirp = new Chirp_Algorithm(in_row_length, out_row_length,
-                                   row_w_initial, row_w_step);
+   _resample_method = RESAMPLE_CHIRP;
+   for(n=0; n<2; n++){
+      row_cost = Resample_DFT::get_cost(methods[n],
+                                        in_row_length, out_row_length,
+                                        row_w_initial, row_w_step, FALSE);
+      col_cost = Resample_DFT::get_cost(methods[n],
+                                        in_col_length, out_col_length,
+                                        col_w_initial, col_w_step, TRUE);
+      cost[methods[n]] = ((row_cost < 0.0 || col_cost < 0.0) ? -1.0 :
+                          in_col_length*row_cost + out_row_length*col_cost);
+
+      if (cost[methods[n]] >= 0.0 &&
+          cost[methods[n]] < cost[_resample_method]) {
+         _resample_method = methods[n];
+      }
+   }
 
-   if (col_chirp != NULL) delete col_chirp;
-   col_chirp = new Chirp_Algorithm(in_col_length, out_col_length,
-                                   col_w_initial, col_w_step);
+   _row_w_initial = row_w_initial;
+   _row_w_step    = row_w_step;
+   _col_w_initial = col_w_initial;
+   _col_w_step    = col_w_step;
+
+   // --- Time the methods if tuning --- //
+   // The method found fastest is kept with the wisdom, keyed by the
+   // geometry and the processor, so that later runs skip the trials.
+
+   if (_autotune_flag) {
+      const unsigned int lengths[4] = {in_row_length,  in_col_length,
+                                       out_row_length, out_col_length};
+      const double       fovs[4]    = {in_row_fov,  in_col_fov,
+                                       out_row_fov, out_col_fov};
+      Resample_Method tuned;
+
+      if (!Chirp_Plan::find_method(lengths, fovs, tuned) ||
+          cost[tuned] < 0.0) {
+         tuned = _tune_resample_method(cost);
+         Chirp_Plan::add_method(lengths, fovs, tuned);
+      }
+      _resample_method = tuned;
+   }
+
+   _prepare_resample(_resample_method);
+
+   // Workspace for serial callers, including a temporary slice to store
+   // the partial result of the row-wise 1-D chirp DFT
 
-   if (row_weight != NULL) delete row_weight;
-   row_weight = new double[2*out_row_length];
-   _compute_chirp_weight(row_weight, in_row_length, out_row_length, 
-                         in_row_fov, out_row_fov);
+   if (workspace != NULL) delete workspace;
+   workspace = new_resample_workspace();
 
-   if (col_weight != NULL) delete col_weight;
-   col_weight = new double[2*out_col_length];
-   _compute_chirp_weight(col_weight, in_col_length, out_col_length, 
-                         in_col_fov, out_col_fov);
+}
 
-   // A temporary slice to store the partial result of the row-wise 
-   // 1-D chirp DFT
+//---------------------------------------------------------------------------
+// Phantom::_prepare_resample
+// Prepares the 1-D DFTs of a resampling method for the output geometry
+// given to initialize_chirp.
+//---------------------------------------------------------------------------
 
-   if (tmp_slice != NULL) delete tmp_slice;
-   tmp_slice = new Complex_Slice(in_row_length, out_col_length);
+void Phantom::_prepare_resample(Resample_Method method) {
+
+   const unsigned int in_row_length  = get_ncols();
+   const unsigned int in_col_length  = get_nrows();
+   const unsigned int out_row_length = _chirp_row_length;
+   const unsigned int out_col_length = _chirp_col_length;
+   const double in_row_fov  = in_row_length * get_voxel_step(COLUMN);
+   const double in_col_fov  = in_col_length * get_voxel_step(ROW);
+   const double out_row_fov = _chirp_row_fov;
+   const double out_col_fov = _chirp_col_fov;
+
+   row_chirp = NULL;
+   col_chirp = NULL;
+   if (row_dft != NULL) delete row_dft;
+   if (col_dft != NULL) delete col_dft;
+   row_dft   = NULL;
+   col_dft   = NULL;
+
+   if (method == RESAMPLE_CHIRP) {
+
+      // Look up the Chirp DFT filters needed to compute 1-D transforms
+      // over row or col slices.   The 2-D Chirp DFT is formed by a
+      // row-column decomposition using the 1-D DFTs.  The filters, with
+      // the resampling weights folded in, are shared by every phantom
+      // with the same geometry and may have been loaded from a wisdom
+      // file.
+
+      row_chirp = Chirp_Plan::get(in_row_length, out_row_length,
+                                  in_row_fov, out_row_fov,
+                                  _row_w_initial, _row_w_step)->get_chirp();
+
+      col_chirp = Chirp_Plan::get(in_col_length, out_col_length,
+                                  in_col_fov, out_col_fov,
+                                  _col_w_initial, _col_w_step)->get_chirp();
+
+   } else {
+
+      // The FFT and direct DFTs apply the same resampling weights as
+      // the Chirp filters
+
+      double *row_weight = new double[2*out_row_length];
+      double *col_weight = new double[2*out_col_length];
+
+      Chirp_Plan::compute_weight(row_weight, in_row_length, out_row_length,
+                                 in_row_fov, out_row_fov);
+      Chirp_Plan::compute_weight(col_weight, in_col_length, out_col_length,
+                                 in_col_fov, out_col_fov);
+
+      row_dft = new Resample_DFT(method,
+                                 in_row_length, out_row_length,
+                                 _row_w_initial, _row_w_step, row_weight);
+      col_dft = new Resample_DFT(method,
+                                 in_col_length, out_col_length,
+                                 _col_w_initial, _col_w_step, col_weight);
+
+      delete[] row_weight;
+      delete[] col_weight;
+
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_tune_resample_method
+// Times each usable resampling method on a slice of the phantom's size
+// and returns the fastest.  Methods whose estimated cost is more than
+// AUTOTUNE_COST_LIMIT times the cheapest estimate are not tried, so that
+// a slow direct DFT of a large matrix does not hold up the run.
+//---------------------------------------------------------------------------
+
+Resample_Method Phantom::_tune_resample_method(const double cost[]) {
+
+   int n, trial, row, col;
+   double cheapest = cost[RESAMPLE_CHIRP];
+
+   for(n=0; n<RESAMPLE_NMETHODS; n++){
+      if (cost[n] >= 0.0 && cost[n] < cheapest) cheapest = cost[n];
+   }
+
+   // Any slice will do: the time does not depend on the data
+
+   Real_Slice    sim_slice(get_nrows(), get_ncols());
+   Complex_Slice raw_slice(_chirp_col_length, _chirp_row_length);
+
+   for(row=0; row<get_nrows(); row++){
+      for(col=0; col<get_ncols(); col++){
+         sim_slice(row, col) = (float)((7*row + 13*col) % 17);
+      }
+   }
+
+   Resample_Method best = RESAMPLE_CHIRP;
+   double best_time = -1.0;
+   double start, elapsed, time;
+
+   for(n=0; n<RESAMPLE_NMETHODS; n++){
+      if (cost[n] < 0.0 || cost[n] > AUTOTUNE_COST_LIMIT*cheapest) {
+         continue;
+      }
+
+      _resample_method = (Resample_Method)n;
+      _prepare_resample(_resample_method);
+      Resample_Workspace *trial_workspace = new_resample_workspace();
+
+      // The first run builds any tables touched on first use
+      _fourier_resample(sim_slice, raw_slice, *trial_workspace);
+
+      time = -1.0;
+      for(trial=0; trial<AUTOTUNE_TRIALS; trial++){
+         start = MRI_Profile::now();
+         _fourier_resample(sim_slice, raw_slice, *trial_workspace);
+         elapsed = MRI_Profile::now() - start;
+         if (time < 0.0 || elapsed < time) time = elapsed;
+      }
+      delete trial_workspace;
+
+      if (best_time < 0.0 || time < best_time) {
+         best      = _resample_method;
+         best_time = time;
+      }
+   }
+
+   return best;
+
+}
+
+//---------------------------------------------------------------------------
+// Phantom::new_resample_workspace
+// Returns a new resampling workspace sized for the current resampling
+// method.  The workspace becomes the property of the caller.
+//---------------------------------------------------------------------------
+
+Resample_Workspace *Phantom::new_resample_workspace(void) const {
+
+   // The row-wise pass leaves one row of out_row_length frequency
+   // samples for each of the in_col_length phantom rows.
+
+   if (_resample_method != RESAMPLE_CHIRP) {
+
+#ifdef DEBUG
+      assert(row_dft != NULL);
+      assert(col_dft != NULL);
+#endif
+
+      return new Resample_Workspace(col_dft->get_input_length(),
+                                    col_dft->get_output_length(),
+                                    row_dft->get_output_length(),
+                                    row_dft->get_workspace_length(1),
+                                    col_dft->get_workspace_length(
+                                       row_dft->get_output_length()));
+   }
+
+#ifdef DEBUG
+   // Ensure that chirps have been initialized
+   assert(row_chirp != NULL);
+   assert(col_chirp != NULL);
+#endif
+
+   return new Resample_Workspace(col_chirp->get_input_length(),
+                                 col_chirp->get_output_length(),
+                                 row_chirp->get_output_length(),
+                                 row_chirp->get_batch_workspace_length(),
+                                 col_chirp->get_batch_workspace_length());
 
 }
 
@@ -827,17 +1433,17 @@ void Phantom::initialize_chirp(unsigned int out_row_length,
 // Resample the simulated slice's Fourier transform using a Chirp DFT.
 // Works for any arbitrary matrix size.
 // Does not work when image bandwidth is larger than the sampled phantom's
-// bandwidth.  In that case use Phantom::_direct_fourier_resample.
+// bandwidth.  In that case use the direct DFT.
 //---------------------------------------------------------------------------
 
 void Phantom::_chirp_fourier_resample(const Real_Slice& sim_slice,
-                                      Complex_Slice& raw_slice) {
+                                      Complex_Slice& raw_slice,
+                                      Resample_Workspace& workspace) const {
 
 #ifdef DEBUG
    // Ensure that chirps have been initialized
    assert(row_chirp != NULL);
    assert(col_chirp != NULL);
-   assert(tmp_slice != NULL);
 
    // assert that sim_slice is the right size
    assert(sim_slice.get_ncols() == row_chirp->get_input_length());
@@ -848,77 +1454,89 @@ void Phantom::_chirp_fourier_resample(const Real_Slice& sim_slice,
    assert(raw_slice.get_nrows() == col_chirp->get_output_length());
 #endif
 
-   unsigned int n;
-   for (n=0; n<sim_slice.get_nrows(); n++){
-      row_chirp->apply(FALSE, sim_slice.row_ptr(n), sim_slice.get_row_stride(),
-                       tmp_slice->row_ptr(n), tmp_slice->get_row_stride());
-//      _apply_weight(tmp_slice->row_ptr(n), tmp_slice->get_row_stride(),
-//                    row_weight, tmp_slice->get_row_length());
-   }
-   for (n=0; n<raw_slice.get_ncols(); n++){
-      col_chirp->apply(TRUE, tmp_slice->col_ptr(n), tmp_slice->get_col_stride(),
-                       raw_slice.col_ptr(n), raw_slice.get_col_stride());
-//      _apply_weight(raw_slice.col_ptr(n), raw_slice.get_col_stride(),
-//                    col_weight, raw_slice.get_col_length());
+   Complex_Slice& tmp_slice = workspace.tmp_slice;
+   Complex_Slice& tmp_trans = workspace.tmp_trans;
+   Complex_Slice& raw_trans = workspace.raw_trans;
+
+   // Rows are contiguous, so the row pass runs directly on the slices.
+   // The resampling weights are applied by the Chirp post-filters.
+   {
+      MRI_Profile_Timer timer(MRI_Profile::TIME_CHIRP_ROWS);
+      row_chirp->apply_rows(FALSE, sim_slice.get_nrows(),
+                            sim_slice.row_ptr(0), sim_slice.get_col_stride(),
+                            tmp_slice.row_ptr(0), tmp_slice.get_col_stride(),
+                            workspace.row_work);
    }
 
-   for (n=0; n<raw_slice.get_nrows(); n++){
-      _apply_weight(raw_slice.row_ptr(n), raw_slice.get_row_stride(),
-                    row_weight, raw_slice.get_row_length());
-   }
-   for (n=0; n<raw_slice.get_ncols(); n++){
-      _apply_weight(raw_slice.col_ptr(n), raw_slice.get_col_stride(),
-                    col_weight, raw_slice.get_col_length());
-   }
+   // The column pass transposes the partial result so that each column
+   // is contiguous, transforms the columns as rows and transposes back.
+   // Both transposes are cache-blocked.
+   MRI_Profile_Timer timer(MRI_Profile::TIME_CHIRP_COLS);
+
+   tmp_slice.transpose(tmp_trans);
+   col_chirp->apply_rows(TRUE, tmp_trans.get_nrows(),
+                         tmp_trans.row_ptr(0), tmp_trans.get_col_stride(),
+                         raw_trans.row_ptr(0), raw_trans.get_col_stride(),
+                         workspace.col_work);
+   raw_trans.transpose(raw_slice);
 
 }
 
 //---------------------------------------------------------------------------
-// Phantom::_compute_chirp_weight
+// Phantom::_dft_fourier_resample
+// Resample the simulated slice's Fourier transform using FFT or direct
+// 1-D DFTs.  The row pass transforms the real phantom rows; the column
+// pass works along the rows of the partial result, so neither pass
+// needs a transpose.
 //---------------------------------------------------------------------------
 
-void Phantom::_compute_chirp_weight(double weight[], 
-                                    unsigned int in_length, 
-                                    unsigned int out_length,
-                                    double in_fov, double out_fov) {
+void Phantom::_dft_fourier_resample(const Real_Slice& sim_slice,
+                                    Complex_Slice& raw_slice,
+                                    Resample_Workspace& workspace) const {
 
-   const double shift      = M_PI_2*(1.0 - (in_fov/out_fov)); 
-   const double voxel_size = in_fov/(double)in_length;
-   const double factor     = 0.5*voxel_size/out_fov;
- 
-   double angle, linear_comp;
+#ifdef DEBUG
+   // Ensure that the DFTs have been initialized
+   assert(row_dft != NULL);
+   assert(col_dft != NULL);
 
-   int n;
-   for (n=0; n<2*out_length; n+=2){
-      angle = shift*n;
-      linear_comp =  voxel_size * 
-                     _sinc(factor*(n-(double)out_length)) *
-                     _sinc(factor*(n-(double)out_length));
-      weight[n]   =  linear_comp*cos(angle);
-      weight[n+1] = -linear_comp*sin(angle);
+   // assert that sim_slice is the right size
+   assert(sim_slice.get_ncols() == row_dft->get_input_length());
+   assert(sim_slice.get_nrows() == col_dft->get_input_length());
+
+   // assert that raw_slice is the right size
+   assert(raw_slice.get_ncols() == row_dft->get_output_length());
+   assert(raw_slice.get_nrows() == col_dft->get_output_length());
+#endif
+
+   Complex_Slice& tmp_slice = workspace.tmp_slice;
+
+   {
+      MRI_Profile_Timer timer(MRI_Profile::TIME_CHIRP_ROWS);
+      row_dft->transform_rows(sim_slice.get_nrows(),
+                              sim_slice.row_ptr(0), sim_slice.get_col_stride(),
+                              tmp_slice.row_ptr(0), tmp_slice.get_col_stride(),
+                              workspace.row_work);
    }
 
+   MRI_Profile_Timer timer(MRI_Profile::TIME_CHIRP_COLS);
+   col_dft->transform_columns(tmp_slice.get_ncols(), tmp_slice.row_ptr(0),
+                              raw_slice.row_ptr(0), workspace.col_work);
+
 }
 
 //---------------------------------------------------------------------------
-// Phantom::_apply_weight
+// Phantom::get_resample_method_name
+// Returns the name of a resampling method, for messages.
 //---------------------------------------------------------------------------
 
-void Phantom::_apply_weight(Real_Scalar in[], unsigned int stride,
-                            double weight[], unsigned int nelements) {
-
-   int m, n;
-   double tempr, tempi, filtr, filti;
+const char *Phantom::get_resample_method_name(Resample_Method method) {
 
-   for(n=0, m=0; n<2*nelements; n+=2, m+=(2*stride)){
-      tempr = in[m];
-      tempi = in[m+1];
-      filtr = weight[n];
-      filti = weight[n+1];
-
-      in[m]   = (Real_Scalar)(tempr * filtr - tempi * filti);
-      in[m+1] = (Real_Scalar)(tempr * filti + tempi * filtr);
+   switch (method) {
+      case RESAMPLE_FFT:    return "FFT";
+      case RESAMPLE_DIRECT: return "direct DFT";
+      default:              return "Chirp DFT";
    }
+
 }
 
 //---------------------------------------------------------------------------
@@ -44,10 +44,13 @@
 #include <minc/mriimage.h>
 #include <minc/imincfile.h>
 #include <minc/omincfile.h>
-#include <minc/chirp.h>
 #include <signal/quickseq.h>
 #include <signal/customseq.h>
 #include <signal/tissue.h>
+#include "chirp_plan.h"
+#include "resample_dft.h"
+#include "slice_cache.h"
+#include "signal_cache.h"
 
 typedef Label Tissue_Label;
 typedef float Real_Scalar;
@@ -58,6 +61,32 @@ typedef MRI_FComplex_Matrix Complex_Slice;
 #define MAX_TISSUE_LABEL MAX_LABEL
 #endif
 
+//---------------------------------------------------------------------------
+// Resample_Workspace class
+// Scratch storage used by one caller of the Fourier resampling functions.
+// The Chirp filters in the Phantom are shared; each thread generating
+// raw data slices concurrently needs its own workspace.
+//---------------------------------------------------------------------------
+
+class Resample_Workspace {
+   public:
+      Resample_Workspace(unsigned int in_nrows, unsigned int out_nrows,
+                         unsigned int out_ncols,
+                         unsigned int row_work_length,
+                         unsigned int col_work_length);
+      virtual ~Resample_Workspace();
+
+      Complex_Slice tmp_slice;    // partial result of the row-wise DFT
+      Complex_Slice tmp_trans;    // tmp_slice transposed for the col DFT
+      Complex_Slice raw_trans;    // transposed result of the col DFT
+      double        *row_work;    // DFT work space for rows
+      double        *col_work;    // DFT work space for cols
+
+   private:
+      Resample_Workspace(const Resample_Workspace&);
+      Resample_Workspace& operator=(const Resample_Workspace&);
+};
+
 //---------------------------------------------------------------------------
 // Phantom class
 // Interface base class that stores spatial information about tissues and
@@ -80,6 +109,7 @@ class Phantom {
       // --- Pulse Sequence simulation --- //
       virtual void apply_pulse_sequence(Quick_Sequence *pseq) = 0;
       virtual void find_steady_state(Custom_Sequence *pseq) = 0;
+      void set_sequence_key(const char *sequence_key);
 
       // --- Image Formation --- //
       void ideal_lin_slice_select(double z_centre, 
@@ -90,13 +120,25 @@ class Phantom {
                               double slice_thickness,
                               Real_Slice& output_slice);
 
+      void set_slice_cache_size(unsigned long max_bytes);
+      void use_z_integral(int flag);
+      void use_autotune(int flag);
+
       void initialize_chirp(unsigned int out_row_length,
                               unsigned int out_col_length,
                               double out_row_fov,
                               double out_col_fov);
+      inline Resample_Method get_resample_method(void) const;
+      static const char *get_resample_method_name(Resample_Method method);
 
       inline void generate_raw_data_slice(const Real_Slice& sim_slice,
                               Complex_Slice& raw_slice);
+      inline void generate_raw_data_slice(const Real_Slice& sim_slice,
+                              Complex_Slice& raw_slice,
+                              Resample_Workspace& workspace) const;
+
+      Resample_Workspace *new_resample_workspace(void) const;
+      inline Resample_Workspace& get_resample_workspace(void) const;
 
       void compute_partial_volume(const Real_Slice& sim_slice,
                               double row_step, double col_step,
@@ -157,28 +199,32 @@ class Phantom {
    protected:
 
       // --- Internal member functions --- //
-      void _direct_fourier_resample(const Complex_Slice& sim_slice,
-                                    Complex_Slice& raw_slice);
+      inline void _fourier_resample(const Real_Slice& sim_slice,
+                                    Complex_Slice& raw_slice,
+                                    Resample_Workspace& workspace) const;
 
-      void _fft_fourier_resample(const Complex_Slice& sim_slice,
-                                 Complex_Slice& raw_slice);
+      void _dft_fourier_resample(const Real_Slice& sim_slice,
+                                 Complex_Slice& raw_slice,
+                                 Resample_Workspace& workspace) const;
 
       void _chirp_fourier_resample(const Real_Slice& sim_slice,
-                                   Complex_Slice& raw_slice);
+                                   Complex_Slice& raw_slice,
+                                   Resample_Workspace& workspace) const;
 
-      void _compute_chirp_weight(double weight[], 
-                                 unsigned int in_length,
-                                 unsigned int out_length,
-                                 double in_fov, double out_fov);
-
-      void _apply_weight(Real_Scalar in[], unsigned int stride, 
-                         double weight[], unsigned int nelements);
- 
       void _compensate_for_linear_kernel(Complex_Slice& raw_slice);
 
       // --- Pulse sequence simulation interface --- //
       inline double _get_i_sample(void) const;
       inline double _get_q_sample(void) const;
+      inline void   _pulse_sequence_changed(void);
+
+      int  _find_tissue_signal(Signal_Model model, unsigned int itissue,
+                               unsigned int nflip, const double flip_error[],
+                               double real[], double imag[]) const;
+      void _save_tissue_signal(Signal_Model model, unsigned int itissue,
+                               unsigned int nflip, const double flip_error[],
+                               const double real[],
+                               const double imag[]) const;
 
       double _min_real;   // minimum and maximum
       double _max_real;   // real channel signal
@@ -189,6 +235,9 @@ class Phantom {
 
       Pulse_Sequence *_pseq;          // Current pulse sequence used to
                                       // compute signal intensities
+      unsigned long  _pseq_serial;    // Incremented when it changes
+      char           *_sequence_key;  // Parameters of the next pulse
+                                      // sequence, for the signal cache
 
       // --- Internal data structures --- //
       unsigned int  _n_tissue_classes;
@@ -205,25 +254,49 @@ class Phantom {
       static double       _Q_sample;   // Quadrature channels
 
       // --- Fourier Resampling --- //
-      Chirp_Algorithm     *row_chirp;
-      Chirp_Algorithm     *col_chirp;
-      double              *row_weight;
-      double              *col_weight;
-      Complex_Slice       *tmp_slice;
+      Resample_Method     _resample_method;
+      const Chirp_Algorithm *row_chirp;    // shared, from Chirp_Plan
+      const Chirp_Algorithm *col_chirp;
+      Resample_DFT        *row_dft;        // FFT or direct DFTs
+      Resample_DFT        *col_dft;
+      Resample_Workspace  *workspace;      // for serial callers
+
+      unsigned int        _chirp_row_length;  // output geometry the
+      unsigned int        _chirp_col_length;  // Chirp filters were
+      double              _chirp_row_fov;     // computed for
+      double              _chirp_col_fov;
+      double              _row_w_initial;     // and its DFT
+      double              _row_w_step;        // frequencies
+      double              _col_w_initial;
+      double              _col_w_step;
+      int                 _autotune_flag;     // choose methods by timing
+
+      void _prepare_resample(Resample_Method method);
+      Resample_Method _tune_resample_method(const double cost[]);
+
+      // --- Synthesized slice cache --- //
+      Phantom_Slice_Cache *_slice_cache;
+
+      void _get_cached_mag_phantom_slice(int slice_num, Real_Slice& sim_slice);
+
+      // --- Z integral of the synthesized phantom --- //
+      int                 _z_integral_flag;
+      MRI_Double_Matrix   **_z_integral;   // _z_integral[k] = sum of
+                                           // slices 0..k-1
+      unsigned long       _z_integral_serial;
+      MRI_Mutex           _z_integral_mutex;
+
+      void _build_z_integral(void);
+      void _free_z_integral(void);
+      void _add_z_sum(int first, int last, double w,
+                      MRI_Double_Matrix& sum, double& total_w) const;
+      void _integral_lin_slice_select(double z_min, double z_max,
+                                      Real_Slice& output_slice);
+      void _integral_nn_slice_select(double z_min, double z_max,
+                                     Real_Slice& output_slice);
 
 };
 
-//---------------------------------------------------------------------------
-// _sinc
-// Computes the sinc function sin(PI x) / (PI x) handling the singularity at
-// (x == 0.0) correctly.
-//---------------------------------------------------------------------------
-
-inline
-double _sinc(double x) {
-   return ((x!=0.0) ? sin(M_PI*x)/(M_PI*x) : 1.0);
-}
-
 //---------------------------------------------------------------------------
 // Inline member functions
 //---------------------------------------------------------------------------
@@ -247,10 +320,64 @@ inline
 void Phantom::generate_raw_data_slice(const Real_Slice& sim_slice,
                                       Complex_Slice& raw_slice) {
 
-   _chirp_fourier_resample(sim_slice, raw_slice);
+   _fourier_resample(sim_slice, raw_slice, *workspace);
    //_compensate_for_linear_kernel(raw_slice);
 }
 
+//---------------------------------------------------------------------------
+// Phantom::generate_raw_data_slice
+// As above, using the caller's resampling workspace so that raw data
+// slices may be generated concurrently.
+//---------------------------------------------------------------------------
+
+inline
+void Phantom::generate_raw_data_slice(const Real_Slice& sim_slice,
+                                      Complex_Slice& raw_slice,
+                                      Resample_Workspace& workspace) const {
+
+   _fourier_resample(sim_slice, raw_slice, workspace);
+}
+
+//---------------------------------------------------------------------------
+// Phantom::get_resample_workspace
+// Returns the resampling workspace used by serial callers, once the
+// Chirp filters have been initialized.
+//---------------------------------------------------------------------------
+
+inline
+Resample_Workspace& Phantom::get_resample_workspace(void) const {
+   return *workspace;
+}
+
+//---------------------------------------------------------------------------
+// Phantom::get_resample_method
+// Returns the way the Fourier resampling is computed, as chosen by
+// initialize_chirp.
+//---------------------------------------------------------------------------
+
+inline
+Resample_Method Phantom::get_resample_method(void) const {
+   return _resample_method;
+}
+
+//---------------------------------------------------------------------------
+// Phantom::_fourier_resample
+// Resamples the simulated slice's Fourier transform by the method
+// chosen by initialize_chirp.
+//---------------------------------------------------------------------------
+
+inline
+void Phantom::_fourier_resample(const Real_Slice& sim_slice,
+                                Complex_Slice& raw_slice,
+                                Resample_Workspace& workspace) const {
+
+   if (_resample_method == RESAMPLE_CHIRP) {
+      _chirp_fourier_resample(sim_slice, raw_slice, workspace);
+   } else {
+      _dft_fourier_resample(sim_slice, raw_slice, workspace);
+   }
+}
+
 //---------------------------------------------------------------------------
 // Phantom::get_safe_simulated_phantom_slice
 // Generates a coloured phantom slice from labelled phantom data.
@@ -480,5 +607,24 @@ double Phantom::_get_q_sample(void) const {
    return Phantom::_Q_sample;
 }
 
+//---------------------------------------------------------------------------
+// Phantom::_pulse_sequence_changed
+// Called by subclasses when a new pulse sequence is applied, so that
+// slices synthesized for the previous sequence are no longer used.
+// Clears the signal max/min before the new intensities are computed.
+//---------------------------------------------------------------------------
+
+inline
+void Phantom::_pulse_sequence_changed(void) {
+   _pseq_serial++;
+
+   _max_real = DBL_MIN;
+   _max_imag = DBL_MIN;
+   _max_mag  = DBL_MIN;
+   _min_real = DBL_MAX;
+   _min_imag = DBL_MAX;
+   _min_mag  = DBL_MAX;
+}
+
 #endif
 
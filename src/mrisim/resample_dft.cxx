@@ -0,0 +1,361 @@
+//==========================================================================
+// RESAMPLE_DFT.CXX
+// Resample_DFT class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <minc/mriprofile.h>
+#include "resample_dft.h"
+
+// Longest FFT considered for resampling
+#define RESAMPLE_MAX_FFT_LENGTH 16777216.0
+
+//--------------------------------------------------------------------------
+// Resample_DFT constructor
+// weight holds out_length complex output weights, or is NULL for none.
+// A RESAMPLE_FFT DFT must only be made if get_fft_length is not 0.
+//--------------------------------------------------------------------------
+
+Resample_DFT::Resample_DFT(Resample_Method method,
+                           unsigned int in_length, unsigned int out_length,
+                           double w_initial, double w_step,
+                           const double weight[])
+   : _method(method), _in_length(in_length), _out_length(out_length) {
+
+#ifdef DEBUG
+   assert(method == RESAMPLE_FFT || method == RESAMPLE_DIRECT);
+#endif
+
+   unsigned int n, k;
+
+   _weight = new double[2*out_length];
+   for(k=0; k<2*out_length; k+=2){
+      _weight[k]   = ((weight != NULL) ? weight[k]   : 1.0);
+      _weight[k+1] = ((weight != NULL) ? weight[k+1] : 0.0);
+   }
+
+   _fft_plan  = NULL;
+   _first_bin = 0;
+   _matrix    = NULL;
+
+   if (method == RESAMPLE_FFT) {
+
+      // Output k is bin _first_bin + k, modulo the FFT length
+
+      const unsigned int length = get_fft_length(w_initial, w_step);
+      long first = (long)floor(w_initial/w_step + 0.5) % (long)length;
+      if (first < 0) first += length;
+
+      _fft_plan  = MRI_FFT_Plan::get(length);
+      _first_bin = (unsigned int)first;
+
+   } else {
+
+      // D[k][n] = weight[k] * exp(-j*(w_initial + k*w_step)*n),
+      // stored by input sample n
+
+      double angle, tempr, tempi, *row;
+
+      _matrix = new double[2*in_length*out_length];
+      for(n=0; n<in_length; n++){
+         row = &(_matrix[2*n*out_length]);
+         for(k=0; k<out_length; k++){
+            angle = (w_initial + k*w_step)*(double)n;
+            tempr =  cos(angle);
+            tempi = -sin(angle);
+            row[2*k]   = _weight[2*k] * tempr - _weight[2*k+1] * tempi;
+            row[2*k+1] = _weight[2*k] * tempi + _weight[2*k+1] * tempr;
+         }
+      }
+
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT destructor
+//--------------------------------------------------------------------------
+
+Resample_DFT::~Resample_DFT() {
+   delete[] _weight;
+   if (_matrix != NULL) delete[] _matrix;
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::get_fft_length
+// The frequencies w_initial + k*w_step are bins of a DFT of length
+// M = 2*pi/w_step if M is a whole number and w_initial a whole number
+// of steps.  Returns M if it is also a valid FFT length, 0 otherwise.
+//--------------------------------------------------------------------------
+
+unsigned int Resample_DFT::get_fft_length(double w_initial, double w_step) {
+
+   if (w_step <= 0.0) return 0;
+
+   const double length = 2.0*M_PI/w_step;
+   const double first  = w_initial/w_step;
+
+   if (length < 1.0 || length > RESAMPLE_MAX_FFT_LENGTH ||
+       fabs(length - floor(length + 0.5)) > 1.0e-9*length ||
+       fabs(first  - floor(first  + 0.5)) > 1.0e-9*length) {
+      return 0;
+   }
+
+   const unsigned int m = (unsigned int)floor(length + 0.5);
+   return (MRI_FFT_Plan::is_valid_length(m) ? m : 0);
+
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::get_cost
+// Estimated time of the DFT of one vector: one FFT and the fold and
+// weighting passes, or the multiply-adds of the direct DFT.  Real
+// vectors cost half as much, as FFTs of real vectors are done in pairs
+// and the direct DFT of a real vector is half the arithmetic.
+//--------------------------------------------------------------------------
+
+double Resample_DFT::get_cost(Resample_Method method,
+                              unsigned int in_length,
+                              unsigned int out_length,
+                              double w_initial, double w_step,
+                              int complex_input) {
+
+   double cost;
+   unsigned int length;
+
+   switch (method) {
+      case RESAMPLE_FFT:
+         if ((length = get_fft_length(w_initial, w_step)) == 0) {
+            return -1.0;
+         }
+         cost = MRI_FFT_Plan::get_cost(length) +
+                FFT_COST_POINTWISE*(in_length + out_length);
+         break;
+      case RESAMPLE_DIRECT:
+         cost = RESAMPLE_COST_DIRECT*in_length*out_length;
+         break;
+      default:
+         return -1.0;
+   }
+
+   return (complex_input ? cost : 0.5*cost);
+
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::transform_rows
+// Computes the DFTs of nvec real vectors.
+//--------------------------------------------------------------------------
+
+void Resample_DFT::transform_rows(unsigned int nvec,
+                                  const float in[], unsigned int in_dist,
+                                  float out[], unsigned int out_dist,
+                                  double work[]) const {
+
+   if (_method == RESAMPLE_FFT) {
+      _fft_rows(nvec, in, in_dist, out, out_dist, work);
+   } else {
+      _direct_rows(nvec, in, in_dist, out, out_dist, work);
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::transform_columns
+// Computes the DFTs of the columns of a complex matrix.
+//--------------------------------------------------------------------------
+
+void Resample_DFT::transform_columns(unsigned int ncols,
+                                     const float in[], float out[],
+                                     double work[]) const {
+
+   if (_method == RESAMPLE_FFT) {
+      _fft_columns(ncols, in, out, work);
+   } else {
+      _direct_columns(ncols, in, out, work);
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::_fft_rows
+// Real vectors are transformed in pairs: vector 2m is the real part and
+// vector 2m+1 the imaginary part of one complex vector.  With Y the FFT
+// of a + j*b and Z[i] = conj(Y[M-i]), the FFTs are A = (Y + Z)/2 and
+// B = (Y - Z)/(2j).  Each pair is folded modulo the FFT length, so
+// inputs longer than the FFT alias exactly as the DFT samples do.
+//--------------------------------------------------------------------------
+
+void Resample_DFT::_fft_rows(unsigned int nvec,
+                             const float in[], unsigned int in_dist,
+                             float out[], unsigned int out_dist,
+                             double work[]) const {
+
+   const unsigned int length = _fft_plan->get_length();
+
+   unsigned int v, n, m, k, i, j;
+   double yr, yi, zr, zi, ar, ai, br, bi, filtr, filti;
+
+   for(v=0; v<nvec; v+=2){
+      const float *a = &(in[v*in_dist]);
+      const float *b = ((v+1 < nvec) ? &(in[(v+1)*in_dist]) : NULL);
+      float *out_a   = &(out[2*v*out_dist]);
+      float *out_b   = ((b != NULL) ? &(out[2*(v+1)*out_dist]) : NULL);
+
+      memset(work, 0, 2*length*sizeof(double));
+      for(n=0, m=0; n<_in_length; n++){
+         work[2*m]   += a[n];
+         work[2*m+1] += ((b != NULL) ? b[n] : 0.0);
+         if (++m == length) m = 0;
+      }
+
+      _fft_plan->forward(work);
+
+      for(k=0, i=_first_bin; k<_out_length; k++){
+         j  = ((i == 0) ? 0 : length-i);
+         yr =  work[2*i];
+         yi =  work[2*i+1];
+         zr =  work[2*j];
+         zi = -work[2*j+1];
+
+         filtr = _weight[2*k];
+         filti = _weight[2*k+1];
+
+         ar = 0.5*(yr + zr);
+         ai = 0.5*(yi + zi);
+         out_a[2*k]   = ar * filtr - ai * filti;
+         out_a[2*k+1] = ar * filti + ai * filtr;
+
+         if (out_b != NULL) {
+            br = 0.5*(yi - zi);
+            bi = 0.5*(zr - yr);
+            out_b[2*k]   = br * filtr - bi * filti;
+            out_b[2*k+1] = br * filti + bi * filtr;
+         }
+
+         if (++i == length) i = 0;
+      }
+   }
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, (nvec+1)/2);
+
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::_fft_columns
+// FFT_COLUMN_BLOCK columns at a time are folded modulo the FFT length
+// into contiguous vectors, transformed as one batch, and the output
+// bins weighted into the output rows.
+//--------------------------------------------------------------------------
+
+void Resample_DFT::_fft_columns(unsigned int ncols,
+                                const float in[], float out[],
+                                double work[]) const {
+
+   const unsigned int length = _fft_plan->get_length();
+
+   unsigned int c0, nb, b, n, m, k, i;
+   double tempr, tempi, filtr, filti;
+
+   for(c0=0; c0<ncols; c0+=FFT_COLUMN_BLOCK){
+      nb = ((ncols-c0 < FFT_COLUMN_BLOCK) ? ncols-c0 : FFT_COLUMN_BLOCK);
+
+      memset(work, 0, 2*length*nb*sizeof(double));
+      for(n=0, m=0; n<_in_length; n++){
+         const float *src = &(in[2*(n*ncols+c0)]);
+         for(b=0; b<nb; b++){
+            work[2*(b*length+m)]   += src[2*b];
+            work[2*(b*length+m)+1] += src[2*b+1];
+         }
+         if (++m == length) m = 0;
+      }
+
+      _fft_plan->transform_rows(work, nb, length, MRI_FFT_Plan::FORWARD);
+
+      for(k=0, i=_first_bin; k<_out_length; k++){
+         float *dst = &(out[2*(k*ncols+c0)]);
+         filtr = _weight[2*k];
+         filti = _weight[2*k+1];
+         for(b=0; b<nb; b++){
+            tempr = work[2*(b*length+i)];
+            tempi = work[2*(b*length+i)+1];
+            dst[2*b]   = tempr * filtr - tempi * filti;
+            dst[2*b+1] = tempr * filti + tempi * filtr;
+         }
+         if (++i == length) i = 0;
+      }
+   }
+   MRI_Profile::count(MRI_Profile::FFT_CALLS, ncols);
+
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::_direct_rows
+// Forms the DFT of each real vector as the sum of the rows of the DFT
+// matrix times the input samples, so that the inner loop runs along
+// contiguous outputs.
+//--------------------------------------------------------------------------
+
+void Resample_DFT::_direct_rows(unsigned int nvec,
+                                const float in[], unsigned int in_dist,
+                                float out[], unsigned int out_dist,
+                                double work[]) const {
+
+   unsigned int v, n, k;
+   double sample;
+
+   for(v=0; v<nvec; v++){
+      const float *x = &(in[v*in_dist]);
+
+      memset(work, 0, 2*_out_length*sizeof(double));
+      for(n=0; n<_in_length; n++){
+         const double *row = &(_matrix[2*n*_out_length]);
+         sample = x[n];
+         for(k=0; k<2*_out_length; k++){
+            work[k] += row[k] * sample;
+         }
+      }
+
+      float *dst = &(out[2*v*out_dist]);
+      for(k=0; k<2*_out_length; k++){
+         dst[k] = work[k];
+      }
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::_direct_columns
+// Forms each output row as the sum of the input rows times one column
+// of the DFT matrix, so that every pass runs along contiguous rows.
+//--------------------------------------------------------------------------
+
+void Resample_DFT::_direct_columns(unsigned int ncols,
+                                   const float in[], float out[],
+                                   double work[]) const {
+
+   unsigned int k, n, c;
+   double filtr, filti;
+
+   for(k=0; k<_out_length; k++){
+      memset(work, 0, 2*ncols*sizeof(double));
+      for(n=0; n<_in_length; n++){
+         const float *src = &(in[2*n*ncols]);
+         filtr = _matrix[2*(n*_out_length+k)];
+         filti = _matrix[2*(n*_out_length+k)+1];
+         for(c=0; c<2*ncols; c+=2){
+            work[c]   += src[c] * filtr - src[c+1] * filti;
+            work[c+1] += src[c] * filti + src[c+1] * filtr;
+         }
+      }
+
+      float *dst = &(out[2*k*ncols]);
+      for(c=0; c<2*ncols; c++){
+         dst[c] = work[c];
+      }
+   }
+
+}
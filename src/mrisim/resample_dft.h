@@ -0,0 +1,157 @@
+#ifndef __RESAMPLE_DFT_H
+#define __RESAMPLE_DFT_H
+
+//==========================================================================
+// RESAMPLE_DFT.H
+// Resample_DFT class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <minc/mrifft.h>
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+// Relative time of one complex multiply-add of a direct DFT, in the
+// units of MRI_FFT_Plan::get_cost
+#define RESAMPLE_COST_DIRECT 1.6
+
+// Ways of computing the Fourier resampling of a phantom slice
+enum Resample_Method {RESAMPLE_CHIRP = 0, RESAMPLE_FFT = 1,
+                      RESAMPLE_DIRECT = 2, RESAMPLE_NMETHODS = 3};
+
+//--------------------------------------------------------------------------
+// Resample_DFT class
+// Weighted 1-D DFT at the out_length frequencies w_initial + k*w_step of
+// an input of in_length samples, the same transform as a weighted
+// Chirp_Algorithm, computed in one of two cheaper ways:
+//
+// RESAMPLE_FFT:    when the frequencies are bins of a DFT of length
+//                  M = 2*pi/w_step, and M is a valid FFT length.  The
+//                  input is folded modulo M (or zero-padded) and the
+//                  output bins are picked from one FFT of length M.
+//                  This is the case when the output FOV is a whole
+//                  number of phantom voxels.
+// RESAMPLE_DIRECT: by a precomputed out_length x in_length matrix, for
+//                  small output matrices.
+//--------------------------------------------------------------------------
+
+class Resample_DFT {
+   public:
+      Resample_DFT(Resample_Method method,
+                   unsigned int in_length, unsigned int out_length,
+                   double w_initial, double w_step,
+                   const double weight[]);
+      ~Resample_DFT();
+
+      // get_fft_length: M if the frequencies are bins of a valid FFT
+      // length, 0 otherwise
+      // get_cost: estimated time per vector, in the units of
+      // MRI_FFT_Plan::get_cost, or -1 if the method cannot be used
+      static unsigned int get_fft_length(double w_initial, double w_step);
+      static double get_cost(Resample_Method method,
+                             unsigned int in_length,
+                             unsigned int out_length,
+                             double w_initial, double w_step,
+                             int complex_input);
+
+      inline Resample_Method get_method(void) const;
+      inline unsigned int get_input_length(void) const;
+      inline unsigned int get_output_length(void) const;
+      inline unsigned int get_workspace_length(unsigned int ncols) const;
+
+      // transform_rows:    nvec real vectors of contiguous elements,
+      //                    in_dist elements apart, to complex vectors
+      //                    out_dist complex elements apart
+      // transform_columns: the ncols complex columns of an in_length
+      //                    x ncols matrix to an out_length x ncols matrix
+      // The work space must hold get_workspace_length(ncols) doubles.
+      void transform_rows(unsigned int nvec,
+                          const float in[], unsigned int in_dist,
+                          float out[], unsigned int out_dist,
+                          double work[]) const;
+      void transform_columns(unsigned int ncols,
+                             const float in[], float out[],
+                             double work[]) const;
+
+   private:
+      Resample_Method     _method;
+      unsigned int        _in_length;
+      unsigned int        _out_length;
+      double             *_weight;       // output weights
+      const MRI_FFT_Plan *_fft_plan;     // RESAMPLE_FFT: plan of length M
+      unsigned int        _first_bin;    // FFT bin of output 0
+      double             *_matrix;       // RESAMPLE_DIRECT: weighted DFT
+                                         // matrix, in_length rows
+
+      void _fft_rows(unsigned int nvec,
+                     const float in[], unsigned int in_dist,
+                     float out[], unsigned int out_dist,
+                     double work[]) const;
+      void _fft_columns(unsigned int ncols, const float in[], float out[],
+                        double work[]) const;
+      void _direct_rows(unsigned int nvec,
+                        const float in[], unsigned int in_dist,
+                        float out[], unsigned int out_dist,
+                        double work[]) const;
+      void _direct_columns(unsigned int ncols, const float in[],
+                           float out[], double work[]) const;
+
+      Resample_DFT(const Resample_DFT&);
+      Resample_DFT& operator=(const Resample_DFT&);
+};
+
+//--------------------------------------------------------------------------
+// Inline member functions
+//--------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------
+// Resample_DFT::get_method
+// Returns the way the DFT is computed.
+//--------------------------------------------------------------------------
+
+inline
+Resample_Method Resample_DFT::get_method(void) const {
+   return _method;
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::get_input_length
+// Returns the input vector length.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Resample_DFT::get_input_length(void) const {
+   return _in_length;
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::get_output_length
+// Returns the output vector length.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Resample_DFT::get_output_length(void) const {
+   return _out_length;
+}
+
+//--------------------------------------------------------------------------
+// Resample_DFT::get_workspace_length
+// Returns the number of doubles of work space needed by the transforms
+// of a matrix of ncols columns, or of rows.  The FFT folds
+// FFT_COLUMN_BLOCK vectors at a time; the direct DFT accumulates one
+// output row or vector.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Resample_DFT::get_workspace_length(unsigned int ncols) const {
+   if (_method == RESAMPLE_FFT) {
+      return 2*_fft_plan->get_length()*FFT_COLUMN_BLOCK;
+   }
+   return 2*((ncols > _out_length) ? ncols : _out_length);
+}
+
+#endif
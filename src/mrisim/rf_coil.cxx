@@ -32,6 +32,7 @@
 //==========================================================================
 
 #include "rf_coil.h"
+#include <minc/mrisimd.h>
 
 //---------------------------------------------------------------------------
 // RF_Coil constructor
@@ -238,22 +239,34 @@ void RF_Coil::display_coil_info(ostream& stream) const {
 // RF_Coil::add_noise_to_real_image
 // Returns a modified image with noise added according to the
 // pulse sequence parameters.
+// Each row's noise is generated in one batch, pairing columns 2k and
+// 2k+1, and added with a single scaled add.
 //---------------------------------------------------------------------------
 
-void RF_Coil::add_noise_to_real_image(Real_Slice& image_slice){
-   double noise_real, noise_imag;
+void RF_Coil::add_noise_to_real_image(Real_Slice& image_slice,
+                                      const Noise_Stream& stream) const {
 
    if (_noise_variance == 0.0)
       return;  // do nothing and return
 
+   const unsigned int nrows   = image_slice.get_nrows();
+   const unsigned int ncols   = image_slice.get_ncols();
+   const double       std_dev = sqrt(_noise_variance);
+   double *noise = new double[ncols+1];
+
    // Add Gaussian noise to the image
-   unsigned int m,n;
-   for(m=0; m<image_slice.get_nrows(); m++){
-      for(n=0; n<image_slice.get_ncols(); n++){
-         _generate_gaussian_noise(noise_real, noise_imag);
-         image_slice(m,n) = image_slice(m,n) + noise_real;
-      } 
+   unsigned int counter[4];
+   unsigned int m;
+   counter[0] = 0;
+   counter[2] = stream.slice;
+   counter[3] = stream.realization;
+   for(m=0; m<nrows; m++){
+      counter[1] = m;
+      _random.gaussian_fill(counter, (ncols+1)/2, noise);
+      MRI_SIMD::add_scaled(image_slice.row_ptr(m), std_dev, noise, ncols);
    }
+
+   delete[] noise;
 }
 
 //---------------------------------------------------------------------------
@@ -262,23 +275,34 @@ void RF_Coil::add_noise_to_real_image(Real_Slice& image_slice){
 // pulse sequence parameters.
 //---------------------------------------------------------------------------
 
-void RF_Coil::add_noise_to_modulus_image(Real_Slice& image_slice) {
-
-   double noise_real, noise_imag;
+void RF_Coil::add_noise_to_modulus_image(Real_Slice& image_slice,
+                                         const Noise_Stream& stream) const {
 
    if (_noise_variance == 0.0)
       return;  // do nothing and return
 
+   const unsigned int nrows   = image_slice.get_nrows();
+   const unsigned int ncols   = image_slice.get_ncols();
+   const double       std_dev = sqrt(_noise_variance);
+   double *noise = new double[2*ncols];
+
    // Add Gaussian noise to inphase and quadrature channels
+   unsigned int counter[4];
    unsigned int m,n;
-   for(m=0; m<image_slice.get_nrows(); m++){
-      for(n=0; n<image_slice.get_ncols(); n++){
-         _generate_gaussian_noise(noise_real, noise_imag);
-         image_slice(m,n) = hypotf( image_slice(m,n) + noise_real,
-                                    noise_imag );
+   counter[0] = 0;
+   counter[2] = stream.slice;
+   counter[3] = stream.realization;
+   for(m=0; m<nrows; m++){
+      counter[1] = m;
+      _random.gaussian_fill(counter, ncols, noise);
+      float *row = image_slice.row_ptr(m);
+      for(n=0; n<ncols; n++){
+         row[n] = hypotf( row[n] + std_dev*noise[2*n],
+                          std_dev*noise[2*n+1] );
       } 
    }
-   
+
+   delete[] noise;
 }
 
 //---------------------------------------------------------------------------
@@ -287,50 +311,48 @@ void RF_Coil::add_noise_to_modulus_image(Real_Slice& image_slice) {
 // pulse sequence parameters.
 //---------------------------------------------------------------------------
 
-void RF_Coil::add_noise_to_complex_image(Complex_Slice& image_slice) {
-
-   double noise_real, noise_imag;
+void RF_Coil::add_noise_to_complex_image(Complex_Slice& image_slice,
+                                         const Noise_Stream& stream) const {
 
    if (_noise_variance == 0.0)
       return;  // do nothing and return
 
-   // Add Gaussian noise to inphase and quadrature channels
-   unsigned int m,n;
-   for(m=0; m<image_slice.get_nrows(); m++){
-      for(n=0; n<image_slice.get_ncols(); n++){
-         _generate_gaussian_noise(noise_real, noise_imag);
-         image_slice.real(m,n) += noise_real;
-         image_slice.imag(m,n) += noise_imag;
-      } 
-   }
-
+   _add_complex_noise(image_slice, stream, sqrt(_noise_variance));
 }
 
 //---------------------------------------------------------------------------
 // RF_Coil::add_noise_to_raw_slice
 // Adds Gaussian noise to real and imaginary parts of a Complex_Matrix
 // with variance according to the pulse sequence parameters.
+// The noise of each sample is drawn from the counter-based generator at
+// (column, row, slice, realization) of the given stream.
 //---------------------------------------------------------------------------
 
-void RF_Coil::add_noise_to_raw_slice(Complex_Slice& raw_slice) {
+void RF_Coil::add_noise_to_raw_slice(Complex_Slice& raw_slice,
+                                     const Noise_Stream& stream) const {
+
+   if (_noise_variance == 0.0)
+      return;  // do nothing and return
 
-   double noise_real, noise_imag;
    const double std_fft_scale = sqrt(raw_slice.get_nrows()*
                                      raw_slice.get_ncols());
+   const double std_dev       = sqrt(_noise_variance);
 
-   if (_noise_variance == 0.0)
-      return;  // do nothing and return
+   _add_complex_noise(raw_slice, stream, std_fft_scale*std_dev);
+}
 
-   // Add Gaussian noise to inphase and quadrature channels
-   unsigned int m,n;
-   for(m=0; m<raw_slice.get_nrows(); m++){
-      for(n=0; n<raw_slice.get_ncols(); n++){
-         _generate_gaussian_noise(noise_real, noise_imag);
-         raw_slice.real(m,n) += std_fft_scale*noise_real;
-         raw_slice.imag(m,n) += std_fft_scale*noise_imag;
-      } 
-   }
+//---------------------------------------------------------------------------
+// RF_Coil::init_noise_stream
+// Initializes the noise stream of a slice.  The noise depends only on
+// the random seed, the slice number and the noise realization, and any
+// slice can be generated without generating the slices before it.
+// Realization 0 is the usual single image.
+//---------------------------------------------------------------------------
 
+void RF_Coil::init_noise_stream(int slice_num, Noise_Stream& stream,
+                                int realization) const {
+   stream.slice       = (unsigned int)slice_num;
+   stream.realization = (unsigned int)realization;
 }
 
 //---------------------------------------------------------------------------
@@ -346,32 +368,31 @@ void RF_Coil::_compute_variance(const Phantom &/*phantom*/){
 }
 
 //---------------------------------------------------------------------------
-// RF_Coil::_generate_gaussian_noise
-// Returns two Gaussian distributed zero mean random numbers with
-// the variance calculated for the current pulse sequence and scanner.
-//
-// Uses the Box-Muller method.
-// Reference:  Press, William A. et al.  Numerical Recipes in C,
-//             Second Edition, Cambridge Univ. Press, 1992, pp 288-290.
+// RF_Coil::_add_complex_noise
+// Adds noise of the given standard deviation to the real and imaginary
+// parts of a complex slice.  The normals for a row are generated in one
+// batch, already interleaved like the row, and added with a single
+// scaled add.
 //---------------------------------------------------------------------------
 
-void RF_Coil::_generate_gaussian_noise(double& n1, double& n2){
-   double v1, v2;
-   double R_squared, factor;
-
-   do {
-
-#ifdef NO_DRAND
-      v1 = 2.0*rand()-1.0;
-      v2 = 2.0*rand()-1.0;
-#else
-      v1 = 2.0*drand48()-1.0;
-      v2 = 2.0*drand48()-1.0;
-#endif
-      R_squared = v1*v1 + v2*v2;
-   } while (R_squared >= 1.0 || R_squared == 0.0);
+void RF_Coil::_add_complex_noise(Complex_Slice& slice,
+                                 const Noise_Stream& stream,
+                                 double std_dev) const {
+
+   const unsigned int nrows = slice.get_nrows();
+   const unsigned int ncols = slice.get_ncols();
+   double *noise = new double[2*ncols];
+
+   unsigned int counter[4];
+   unsigned int m;
+   counter[0] = 0;
+   counter[2] = stream.slice;
+   counter[3] = stream.realization;
+   for(m=0; m<nrows; m++){
+      counter[1] = m;
+      _random.gaussian_fill(counter, ncols, noise);
+      MRI_SIMD::add_scaled(slice.row_ptr(m), std_dev, noise, 2*ncols);
+   }
 
-   factor = sqrt(-2.0*log(R_squared)*_noise_variance/R_squared);
-   n1 = v1*factor;
-   n2 = v2*factor;
+   delete[] noise;
 }
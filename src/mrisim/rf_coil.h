@@ -38,11 +38,25 @@
 #include <minc/mrimatrix.h>
 #include <minc/mriimage.h>
 #include <minc/imincfile.h>
+#include <minc/mrirandom.h>
 
 // For local time based random seeds
 #include <sys/types.h>
 #include <time.h>
 
+//--------------------------------------------------------------------------
+// Noise_Stream structure
+// Selects the noise of one raw data or image slice.  Each sample's noise is
+// computed directly from the random seed, the stream and the sample's
+// row and column by a counter-based generator, so it does not depend on
+// the number of threads or the order slices are computed.
+//--------------------------------------------------------------------------
+
+struct Noise_Stream {
+   unsigned int slice;
+   unsigned int realization;
+};
+
 //--------------------------------------------------------------------------
 // RF_Coil class
 //--------------------------------------------------------------------------
@@ -59,6 +73,8 @@ class RF_Coil {
 
       inline long set_random_seed(long seed = 0);
       inline long get_random_seed(void) const;
+      void init_noise_stream(int slice_num, Noise_Stream& stream,
+                             int realization = 0) const;
 
       inline void set_noise_variance(double variance);
       inline void set_noise_mean(double mean);
@@ -91,11 +107,15 @@ class RF_Coil {
 
       // --- Noise simulation --- //
 
-      void add_noise_to_real_image(Real_Slice& image_slice);
-      void add_noise_to_modulus_image(Real_Slice& image_slice);
+      void add_noise_to_real_image(Real_Slice& image_slice,
+                                   const Noise_Stream& stream) const;
+      void add_noise_to_modulus_image(Real_Slice& image_slice,
+                                      const Noise_Stream& stream) const;
 
-      void add_noise_to_complex_image(Complex_Slice& image_slice);
-      void add_noise_to_raw_slice(Complex_Slice& raw_slice);
+      void add_noise_to_complex_image(Complex_Slice& image_slice,
+                                      const Noise_Stream& stream) const;
+      void add_noise_to_raw_slice(Complex_Slice& raw_slice,
+                                  const Noise_Stream& stream) const;
 
       virtual void _compute_variance(const Phantom &phantom);
       
@@ -106,12 +126,15 @@ class RF_Coil {
       double _noise_mean;       // mean of the noise
       double _noise_variance;   // variance of the noise
       long   _seed;             // random number generator seed
+      MRI_Random _random;       // raw data noise generator, keyed by _seed
       double _coil_gain;        // real gain level for the coil
 
    private:
 
       // --- Internal member functions --- //
-      void _generate_gaussian_noise(double& n1, double& n2);
+      void _add_complex_noise(Complex_Slice& slice,
+                              const Noise_Stream& stream,
+                              double std_dev) const;
 
       // --- Signal inhomogeneity maps --- //
 
@@ -143,12 +166,7 @@ long RF_Coil::set_random_seed(long seed){
       (void)time((time_t *)&seed);
    }
    _seed = seed;
-
-#ifdef NO_DRAND
-   srand(_seed);
-#else
-   srand48(_seed);
-#endif
+   _random.set_key((unsigned long long)_seed);
 
    return _seed;
 }
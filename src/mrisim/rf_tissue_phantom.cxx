@@ -22,6 +22,26 @@
 #include <signal/quick_model.h>
 #include <signal/isochromat_model.h>
 #include <signal/fast_iso_model.h>
+#include <minc/mrisimd.h>
+
+//---------------------------------------------------------------------------
+// Flip_Error_Map constructor
+//---------------------------------------------------------------------------
+
+Flip_Error_Map::Flip_Error_Map(unsigned int nelements) {
+   this->nelements = nelements;
+   index  = new unsigned int[nelements];
+   weight = new double[nelements];
+}
+
+//---------------------------------------------------------------------------
+// Flip_Error_Map destructor
+//---------------------------------------------------------------------------
+
+Flip_Error_Map::~Flip_Error_Map() {
+   delete[] index;
+   delete[] weight;
+}
 
 //---------------------------------------------------------------------------
 // RF_Tissue_Phantom constructor
@@ -109,8 +129,15 @@ void RF_Tissue_Phantom::apply_pulse_sequence(Quick_Sequence *pseq) {
    Quick_Model  *model;
    double       real, imag, mag;
 
+   // Signals of a tissue without flip angle error and then with each
+   // flip angle error, as kept in the signal cache
+   unsigned int nflip       = uses_tx_map() ? _n_flip_angles : 0;
+   double       *real_signal = new double[nflip+1];
+   double       *imag_signal = new double[nflip+1];
+
       // Save pointer to current pulse sequence
    _pseq = pseq;
+   _pulse_sequence_changed();
 
    // For each tissue class installed, apply the pulse sequence
    // and store the signal intensity.  Tissue classes which are
@@ -120,11 +147,29 @@ void RF_Tissue_Phantom::apply_pulse_sequence(Quick_Sequence *pseq) {
    for(itissue=0; itissue<_n_tissues_installed; itissue++){
       if (_tissue[itissue]->get_NH() != 0) {
 
-         model = new Quick_Model(*_tissue[itissue]);
+         if (!_find_tissue_signal(SIGNAL_QUICK_MODEL, itissue, nflip,
+                                  _flip_error, real_signal, imag_signal)) {
+
+            model = new Quick_Model(*_tissue[itissue]);
+
+            pseq->apply(*model);
+            real_signal[0] = _get_i_sample();
+            imag_signal[0] = _get_q_sample();
+
+            for (iflip=0; iflip<nflip; iflip++){
+               model->set_flip_error(_flip_error[iflip]);
+               pseq->apply(*model);
+               real_signal[iflip+1] = _get_i_sample();
+               imag_signal[iflip+1] = _get_q_sample();
+            }
+
+            delete model;
+            _save_tissue_signal(SIGNAL_QUICK_MODEL, itissue, nflip,
+                                _flip_error, real_signal, imag_signal);
+         }
 
-         pseq->apply(*model);
-         real = _get_i_sample();
-         imag = _get_q_sample();
+         real = real_signal[0];
+         imag = imag_signal[0];
          _no_error_real[itissue] = real;
          _no_error_imag[itissue] = imag;
          mag = hypot(real, imag);
@@ -139,13 +184,11 @@ void RF_Tissue_Phantom::apply_pulse_sequence(Quick_Sequence *pseq) {
          if (uses_tx_map()){
 
             for (iflip=0; iflip<_n_flip_angles; iflip++){
-               model->set_flip_error(_flip_error[iflip]);
-               pseq->apply(*model);
-               real = _get_i_sample();
-               imag = _get_q_sample();
+               real = real_signal[iflip+1];
+               imag = imag_signal[iflip+1];
                _lookup_real_intensity(itissue, iflip) = real;
                _lookup_imag_intensity(itissue, iflip) = imag;
-               mag  = hypot(real, imag);                                      
+               mag  = hypot(real, imag);
 
                if (real >= _max_real) _max_real = real;
                if (real <  _min_real) _min_real = real;
@@ -156,8 +199,6 @@ void RF_Tissue_Phantom::apply_pulse_sequence(Quick_Sequence *pseq) {
 
             }
          }
- 
-         delete model;
 
       } else {
 
@@ -188,6 +229,9 @@ void RF_Tissue_Phantom::apply_pulse_sequence(Quick_Sequence *pseq) {
       }
    }
 
+   delete[] real_signal;
+   delete[] imag_signal;
+
 }
 
 //---------------------------------------------------------------------------
@@ -201,8 +245,15 @@ void RF_Tissue_Phantom::find_steady_state(Custom_Sequence *pseq) {
    Fast_Isochromat_Model *model;
    double                real, imag, mag;
 
+   // Signals of a tissue without flip angle error and then with each
+   // flip angle error, as kept in the signal cache
+   unsigned int          nflip       = uses_tx_map() ? _n_flip_angles : 0;
+   double                *real_signal = new double[nflip+1];
+   double                *imag_signal = new double[nflip+1];
+
    // Save pointer to current pulse sequence
    _pseq = pseq;
+   _pulse_sequence_changed();
 
    // For each tissue class installed, apply the pulse sequence
    // to steady state and store the signal intensity.  Tissue classes 
@@ -213,12 +264,31 @@ void RF_Tissue_Phantom::find_steady_state(Custom_Sequence *pseq) {
 
       if (_tissue[itissue]->get_NH() != 0) {
 
-         model = new Fast_Isochromat_Model(*_tissue[itissue]);
+         if (!_find_tissue_signal(SIGNAL_ISOCHROMAT_MODEL, itissue, nflip,
+                                  _flip_error, real_signal, imag_signal)) {
+
+            model = new Fast_Isochromat_Model(*_tissue[itissue]);
+
+            pseq->initialize_sequence(*model);
+            pseq->apply_to_steady_state(*model);
+            real_signal[0] = _get_i_sample();
+            imag_signal[0] = _get_q_sample();
 
-         pseq->initialize_sequence(*model);
-         pseq->apply_to_steady_state(*model);
-         real = _get_i_sample();
-         imag = _get_q_sample();
+            for (iflip=0; iflip<nflip; iflip++){
+               model->set_flip_error(_flip_error[iflip]);
+               pseq->initialize_sequence(*model);
+               pseq->apply_to_steady_state(*model);
+               real_signal[iflip+1] = _get_i_sample();
+               imag_signal[iflip+1] = _get_q_sample();
+            }
+
+            delete model;
+            _save_tissue_signal(SIGNAL_ISOCHROMAT_MODEL, itissue, nflip,
+                                _flip_error, real_signal, imag_signal);
+         }
+
+         real = real_signal[0];
+         imag = imag_signal[0];
          _no_error_real[itissue] = real;
          _no_error_imag[itissue] = imag;
          mag  = hypot(real, imag);
@@ -232,15 +302,10 @@ void RF_Tissue_Phantom::find_steady_state(Custom_Sequence *pseq) {
 
          if (uses_tx_map()) {
             for (iflip=0; iflip<_n_flip_angles; iflip++){
-               model->set_flip_error(_flip_error[iflip]);
-               pseq->initialize_sequence(*model);
-               pseq->apply_to_steady_state(*model);
 
                // Store the steady state magnetization
-               real = _get_i_sample();
-               imag = _get_q_sample();
-               //_real_intensity[itissue*_n_flip_angles+iflip] = real;
-               //_imag_intensity[itissue*_n_flip_angles+iflip] = imag;
+               real = real_signal[iflip+1];
+               imag = imag_signal[iflip+1];
                _lookup_real_intensity(itissue, iflip) = real;
                _lookup_imag_intensity(itissue, iflip) = imag;
                mag  = hypot(real, imag);
@@ -253,8 +318,6 @@ void RF_Tissue_Phantom::find_steady_state(Custom_Sequence *pseq) {
                if (mag <  _min_mag) _min_mag = mag;
             }
          }
-         
-         delete model;
 
       } else {
 
@@ -289,6 +352,9 @@ void RF_Tissue_Phantom::find_steady_state(Custom_Sequence *pseq) {
       } 
    }
 
+   delete[] real_signal;
+   delete[] imag_signal;
+
 }
 
 //---------------------------------------------------------------------------
@@ -363,6 +429,95 @@ void RF_Tissue_Phantom::get_signal_map(unsigned int tissue_index,
    }
 }
 
+//---------------------------------------------------------------------------
+// RF_Tissue_Phantom::_get_flip_error_map
+// Finds the flip angle error table position of each voxel of a transmit
+// map slice.  Flip errors outside the table are extrapolated from the
+// first or last pair of entries.
+//---------------------------------------------------------------------------
+
+void RF_Tissue_Phantom::_get_flip_error_map(const Real_Slice& tx_map,
+                                            Flip_Error_Map& flip_map) const {
+#ifdef DEBUG
+   assert(flip_map.nelements == tx_map.get_nelements());
+   assert(_n_flip_angles > 1);
+#endif
+
+   const float *fe = tx_map.row_ptr(0);
+   const int   n_max = (int)_n_flip_angles - 2;
+   unsigned int i;
+   int          n;
+
+   for(i=0; i<flip_map.nelements; i++){
+      n = (int)floor((fe[i] - _flip_error[0]) / _flip_error_step);
+      if (n < 0)     n = 0;
+      if (n > n_max) n = n_max;
+      flip_map.index[i]  = n;
+      flip_map.weight[i] = (fe[i] - _flip_error[n]) / _flip_error_step;
+   }
+
+}
+
+//---------------------------------------------------------------------------
+// RF_Tissue_Phantom::_interp_intensities
+// Interpolates the real and imaginary intensities of one tissue at count
+// voxels of a flip error map, starting at voxel start.  imag may be NULL
+// if only the real part is needed.
+//---------------------------------------------------------------------------
+
+void RF_Tissue_Phantom::_interp_intensities(unsigned int tissue_index,
+                                            const Flip_Error_Map& flip_map,
+                                            unsigned int start,
+                                            unsigned int count,
+                                            double real[],
+                                            double imag[]) const {
+#ifdef DEBUG
+   assert(start + count <= flip_map.nelements);
+#endif
+
+   const unsigned int offset = tissue_index*_n_flip_angles;
+
+   MRI_SIMD::lerp(real, _real_intensity + offset, flip_map.index + start,
+                  flip_map.weight + start, count);
+   if (imag != NULL)
+      MRI_SIMD::lerp(imag, _imag_intensity + offset, flip_map.index + start,
+                     flip_map.weight + start, count);
+
+}
+
+//---------------------------------------------------------------------------
+// RF_Tissue_Phantom::_interp_intensities
+// Interpolates the real and imaginary intensities of every voxel of a
+// discrete label slice.  imag may be NULL if only the real part is needed.
+//---------------------------------------------------------------------------
+
+void RF_Tissue_Phantom::_interp_intensities(const MRI_Label& label,
+                                            const Flip_Error_Map& flip_map,
+                                            double real[],
+                                            double imag[]) const {
+#ifdef DEBUG
+   assert(flip_map.nelements == label.get_nelements());
+#endif
+
+   // Fold each voxel's tissue into its table index
+   unsigned int *index = new unsigned int[flip_map.nelements];
+   const Label  *l     = label.row_ptr(0);
+   unsigned int i;
+
+   for(i=0; i<flip_map.nelements; i++){
+      index[i] = get_tissue_index(l[i])*_n_flip_angles + flip_map.index[i];
+   }
+
+   MRI_SIMD::lerp(real, _real_intensity, index, flip_map.weight,
+                  flip_map.nelements);
+   if (imag != NULL)
+      MRI_SIMD::lerp(imag, _imag_intensity, index, flip_map.weight,
+                     flip_map.nelements);
+
+   delete[] index;
+
+}
+
 //---------------------------------------------------------------------------
 // RF_Tissue_Phantom::_setup_flip_errors
 //---------------------------------------------------------------------------
@@ -30,6 +30,28 @@
 #include <signal/customseq.h>
 #include <signal/tissue.h>
 
+//---------------------------------------------------------------------------
+// Flip_Error_Map class
+// The position of each voxel of a slice in the flip angle error table:
+// the table entry at or below the voxel's flip error, and the weight of
+// the entry above it.  The map depends only on the transmit map, so it is
+// computed once per slice and shared by every tissue.
+//---------------------------------------------------------------------------
+
+class Flip_Error_Map {
+   public:
+      Flip_Error_Map(unsigned int nelements);
+      virtual ~Flip_Error_Map();
+
+      unsigned int nelements;
+      unsigned int *index;        // flip error table entry below each voxel
+      double       *weight;       // interpolation weight of entry index+1
+
+   private:
+      Flip_Error_Map(const Flip_Error_Map&);
+      Flip_Error_Map& operator=(const Flip_Error_Map&);
+};
+
 //---------------------------------------------------------------------------
 // RF_Tissue_Phantom class
 // Implementation base class that stores information about tissue types
@@ -77,6 +99,17 @@ class RF_Tissue_Phantom : virtual public Phantom {
 
       void _setup_flip_errors(double min, double max);
 
+      // --- Flip error interpolation over a slice --- //
+      void _get_flip_error_map(const Real_Slice& tx_map,
+                               Flip_Error_Map& flip_map) const;
+      void _interp_intensities(unsigned int tissue_index,
+                               const Flip_Error_Map& flip_map,
+                               unsigned int start, unsigned int count,
+                               double real[], double imag[]) const;
+      void _interp_intensities(const MRI_Label& label,
+                               const Flip_Error_Map& flip_map,
+                               double real[], double imag[]) const;
+
       // --- RF Coil interface --- //
       RF_Coil       *_rf_coil;
 
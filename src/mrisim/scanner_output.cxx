@@ -40,8 +40,74 @@
 //==========================================================================
 
 #include <fstream>
+#include <stdio.h>
+#include <minc/mrithread.h>
+#include <minc/mriprofile.h>
 #include "scanner_output.h"
 
+//--------------------------------------------------------------------------
+// Slice_Pool structure
+// State shared by the worker threads of Scanner_Output::save_images.
+// Workers claim slices in order and leave each finished slice in one of
+// a ring of result slots; the main thread writes the slots back in slice
+// order.  A worker may not run more than window slices ahead of the
+// writer, which bounds the memory held by finished slices.
+//--------------------------------------------------------------------------
+
+struct Slice_Slot {
+   MRI_Image **images;          // reconstructed image of each realization
+   MRI_Image *raw_real;         // raw data, real part (or NULL)
+   MRI_Image *raw_imag;         // raw data, imaginary part (or NULL)
+   int       ready;             // TRUE when the slice is finished
+};
+
+struct Slice_Pool {
+   Scanner_Output *output;
+   MRI_Scanner    *scanner;
+   int            nslices;
+   int            next_slice;   // next slice to be claimed by a worker
+   int            written;      // number of slices written so far
+   int            window;       // number of result slots
+   Slice_Slot     *slots;
+   MRI_Mutex      mutex;
+   MRI_Condition  ready;        // signalled when a slot is finished
+   MRI_Condition  space;        // signalled when a slot is written
+};
+
+//--------------------------------------------------------------------------
+// Slice_Pipeline structure
+// State shared by the stage threads of Scanner_Output::save_images in 
+// -pipeline mode.  Each stage runs in its own thread and passes
+// Pipeline_Slice objects to the next stage through a bounded queue, so
+// reading phantom data for one slice overlaps with resampling and 
+// reconstruction of the slices before it.  A NULL item marks the end of
+// the slices.
+//--------------------------------------------------------------------------
+
+// Number of slices that may wait between two stages
+#define PIPELINE_DEPTH 2
+
+struct Pipeline_Slice {
+   int           islice;
+   Real_Slice    *phantom_slice;  // slice selected phantom data
+   Complex_Slice *raw_slice;      // raw data, then reconstructed image
+   MRI_Image     **images;        // output image of each realization
+   MRI_Image     *raw_real;       // raw data, real part (or NULL)
+   MRI_Image     *raw_imag;       // raw data, imaginary part (or NULL)
+};
+
+struct Slice_Pipeline {
+   Slice_Pipeline() : selected(PIPELINE_DEPTH), resampled(PIPELINE_DEPTH),
+                      reconstructed(PIPELINE_DEPTH) {}
+
+   Scanner_Output *output;
+   MRI_Scanner    *scanner;
+   int            nslices;
+   MRI_Queue      selected;       // select stage -> resample stage
+   MRI_Queue      resampled;      // resample stage -> recon stage
+   MRI_Queue      reconstructed;  // recon stage -> writer
+};
+
 //--------------------------------------------------------------------------
 // Scanner_Output constructor
 //--------------------------------------------------------------------------
@@ -72,9 +138,37 @@ Scanner_Output::Scanner_Output(const mrisimArgs &args,
    }
 
    // Set up reconstructed output files
-   if (!create_output_file(args.outputFile, args.clobberFlag, 
-                           time_stamp, scanner, _output)){
-      _good = FALSE;
+   // With several noise realizations, each is written to its own file
+   // named <output>_r<n>.mnc
+   _nrealizations      = args.nrealizations;
+   _realization_output = NULL;
+
+   if (_nrealizations == 1) {
+      if (!create_output_file(args.outputFile, args.clobberFlag, 
+                              time_stamp, scanner, _output)){
+         _good = FALSE;
+      }
+   } else {
+      _realization_output = new O_MINC_File[_nrealizations-1];
+
+      int  width = 1, ir;
+      char suffix[32];
+      for (ir=_nrealizations-1; ir>=10; ir/=10) width++;
+
+      for (ir=0; ir<_nrealizations && _good; ir++){
+         if (snprintf(suffix, sizeof(suffix), "_r%0*d", width, ir) >=
+             (int)sizeof(suffix)) {
+            _good = FALSE;
+            break;
+         }
+         char *file_name = extend_path(args.outputFile, 4, suffix);
+         if (!create_output_file(file_name, args.clobberFlag, time_stamp,
+                                 scanner, (ir == 0) ? _output :
+                                 _realization_output[ir-1])){
+            _good = FALSE;
+         }
+         delete[] file_name;
+      }
    }
 
    // Set up raw data files
@@ -99,7 +193,9 @@ Scanner_Output::Scanner_Output(const mrisimArgs &args,
 // Scanner_Output destructor
 //--------------------------------------------------------------------------
 
-Scanner_Output::~Scanner_Output() {}
+Scanner_Output::~Scanner_Output() {
+   if (_realization_output != NULL) delete[] _realization_output;
+}
 
 //--------------------------------------------------------------------------
 // Scanner_Output::create_output_file
@@ -176,6 +272,26 @@ void Scanner_Output::display_info(const mrisimArgs &args,
 void Scanner_Output::save_images(const mrisimArgs &args, 
                                  MRI_Scanner &scanner) {
 
+   // The resampling method depends only on the output geometry, so it
+   // is chosen once for every path below
+   if (!args.oldpvFlag) {
+      scanner.initialize_chirp_resample();
+      if (args.verboseFlag)
+         cout << "Fourier resampling by "
+              << scanner.get_resample_method_name() << "." << endl;
+
+      // A 3-D scan may be encoded along z as a whole slab, after which
+      // the partitions are only noise, reconstruction and output
+      if (args.kspace3dFlag && scanner.get_scan_mode() == SCAN_MODE_3D) {
+         scanner.encode_slab();
+         const Slab_Encoder *encoder = scanner.get_slab_encoder();
+         if (args.verboseFlag && encoder != NULL)
+            cout << "Encoded " << encoder->get_output_length()
+                 << " partitions from " << encoder->get_input_length()
+                 << " phantom slices." << endl;
+      }
+   }
+
    if (args.verboseFlag)
       cout << "Saving slices";
 
@@ -191,57 +307,457 @@ void Scanner_Output::save_images(const mrisimArgs &args,
             cout << "." << flush;
       }
 
+   } else if (args.nthreads > 1) {
+
+      _save_images_threaded(args, scanner);
+
+   } else if (args.pipelineFlag && !scanner.has_encoded_slab()) {
+
+      _save_images_pipelined(args, scanner);
+
    } else {
 
-      scanner.initialize_chirp_resample();
+      // The noiseless raw data of each slice is computed once, and the
+      // noise of each realization added to it
+      Resample_Workspace *workspace = scanner.new_resample_workspace();
       Complex_Slice raw_slice(scanner.get_matrix_size(ROW), 
                               scanner.get_matrix_size(COLUMN));
+      MRI_Image raw_real(_image.get_nrows(), _image.get_ncols());
+      MRI_Image raw_imag(_image.get_nrows(), _image.get_ncols());
+      MRI_Image **images = new MRI_Image *[_nrealizations];
+      int ir;
+      for (ir=0; ir<_nrealizations; ir++){
+         images[ir] = new MRI_Image(_image.get_nrows(), _image.get_ncols());
+      }
 
       for(islice=0; islice<_output.get_nslices(); islice++){
-         scanner.get_raw_data_slice(islice, raw_slice);
-
+         scanner.get_noiseless_raw_data_slice(islice, raw_slice, *workspace);
          if (scanner.save_raw_data()){
-            scanner.get_real_image(raw_slice, _image);
-            _real_raw_data.save_slice(islice, _image);
-            scanner.get_imag_image(raw_slice, _image);
-            _imag_raw_data.save_slice(islice, _image);
-         }
-
-         // --- Save reconstructed image --- //
-
-         scanner.reconstruct_raw_data_slice(raw_slice);
-         switch(_output_type) {
-            case IMAGE_R:
-               scanner.get_real_image(raw_slice, _image);
-               break;
-            case IMAGE_I:
-               scanner.get_imag_image(raw_slice, _image);
-               break;
-            case IMAGE_P:
-               scanner.get_angle_image(raw_slice, _image);
-               break;
-            case IMAGE_M:
-            default:
-               scanner.get_abs_image(raw_slice, _image);
-               break;
+            _extract_realizations(scanner, islice, raw_slice, images,
+                                  &raw_real, &raw_imag);
+            _real_raw_data.save_slice(islice, raw_real);
+            _imag_raw_data.save_slice(islice, raw_imag);
+         } else {
+            _extract_realizations(scanner, islice, raw_slice, images,
+                                  NULL, NULL);
          }
-
-	 // [CC, 11.06.2003] 
-	 // multiplication with gain doesn't make sense for the phase 
-	 if (_output_type != IMAGE_P) 
-	   _image.scale(scanner.get_signal_gain());
-
-         _output.save_slice(islice, _image);
+         _save_realizations(islice, images);
          if (args.verboseFlag)
             cout << "." << flush;
       }
 
+      for (ir=0; ir<_nrealizations; ir++){
+         delete images[ir];
+      }
+      delete[] images;
+      delete workspace;
+
    }
 
    cout << endl;
 
 }
 
+//--------------------------------------------------------------------------
+// Scanner_Output::_extract_image
+// Reconstructs a raw data slice in place and extracts the output image
+// type, scaled by the scanner gain.
+//--------------------------------------------------------------------------
+
+void Scanner_Output::_extract_image(MRI_Scanner &scanner, 
+                                    Complex_Slice &raw_slice,
+                                    MRI_Image &image) const {
+
+   scanner.reconstruct_raw_data_slice(raw_slice);
+   switch(_output_type) {
+      case IMAGE_R:
+         scanner.get_real_image(raw_slice, image);
+         break;
+      case IMAGE_I:
+         scanner.get_imag_image(raw_slice, image);
+         break;
+      case IMAGE_P:
+         scanner.get_angle_image(raw_slice, image);
+         break;
+      case IMAGE_M:
+      default:
+         scanner.get_abs_image(raw_slice, image);
+         break;
+   }
+
+   // [CC, 11.06.2003] 
+   // multiplication with gain doesn't make sense for the phase 
+   if (_output_type != IMAGE_P) {
+     MRI_Profile_Timer timer(MRI_Profile::TIME_QUANTIZE);
+     image.scale(scanner.get_signal_gain());
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Scanner_Output::_extract_realizations
+// Adds each noise realization to a noiseless raw data slice and extracts
+// the output image of each into images.  If raw_real and raw_imag are
+// given, they receive the noisy raw data of the first realization.
+// raw_slice is overwritten.
+//--------------------------------------------------------------------------
+
+void Scanner_Output::_extract_realizations(MRI_Scanner &scanner, int islice,
+                                           Complex_Slice &raw_slice,
+                                           MRI_Image **images,
+                                           MRI_Image *raw_real,
+                                           MRI_Image *raw_imag) const {
+
+   // All but the last realization work on a copy of the noiseless data
+   Complex_Slice *noisy_slice = NULL;
+   if (_nrealizations > 1) {
+      noisy_slice = new Complex_Slice(raw_slice.get_nrows(), 
+                                      raw_slice.get_ncols());
+   }
+
+   int ir;
+   for (ir=0; ir<_nrealizations; ir++){
+      Complex_Slice &slice = (ir < _nrealizations-1) ? *noisy_slice 
+                                                     : raw_slice;
+      if (ir < _nrealizations-1) {
+         slice = raw_slice;
+      }
+      scanner.add_noise_to_raw_data_slice(islice, slice, ir);
+
+      if (ir == 0 && raw_real != NULL) {
+         scanner.get_real_image(slice, *raw_real);
+         scanner.get_imag_image(slice, *raw_imag);
+      }
+      _extract_image(scanner, slice, *images[ir]);
+   }
+
+   if (noisy_slice != NULL) delete noisy_slice;
+
+}
+
+//--------------------------------------------------------------------------
+// Scanner_Output::_save_realizations
+// Writes the output image of each realization of a slice to its file.
+//--------------------------------------------------------------------------
+
+void Scanner_Output::_save_realizations(int islice, MRI_Image **images) {
+   int ir;
+   for (ir=0; ir<_nrealizations; ir++){
+      if (ir == 0) {
+         _output.save_slice(islice, *images[ir]);
+      } else {
+         _realization_output[ir-1].save_slice(islice, *images[ir]);
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+// Scanner_Output::_save_images_threaded
+// As save_images, but slices are generated by args.nthreads worker
+// threads.  Slices are still written to the output files in order, from
+// this thread.
+//--------------------------------------------------------------------------
+
+void Scanner_Output::_save_images_threaded(const mrisimArgs &args,
+                                           MRI_Scanner &scanner) {
+
+   Slice_Pool pool;
+   pool.output     = this;
+   pool.scanner    = &scanner;
+   pool.nslices    = _output.get_nslices();
+   pool.next_slice = 0;
+   pool.written    = 0;
+   pool.window     = 2*args.nthreads;
+   pool.slots      = new Slice_Slot[pool.window];
+
+   int islot;
+   for (islot=0; islot<pool.window; islot++){
+      Slice_Slot &slot = pool.slots[islot];
+      slot.images = new MRI_Image *[_nrealizations];
+      int ir;
+      for (ir=0; ir<_nrealizations; ir++){
+         slot.images[ir] = new MRI_Image(_image.get_nrows(), 
+                                         _image.get_ncols());
+      }
+      if (scanner.save_raw_data()){
+         slot.raw_real = new MRI_Image(_image.get_nrows(),_image.get_ncols());
+         slot.raw_imag = new MRI_Image(_image.get_nrows(),_image.get_ncols());
+      } else {
+         slot.raw_real = NULL;
+         slot.raw_imag = NULL;
+      }
+      slot.ready = FALSE;
+   }
+
+   // --- Start the workers --- //
+
+   pthread_t *threads = new pthread_t[args.nthreads];
+   int ithread;
+   for (ithread=0; ithread<args.nthreads; ithread++){
+      if (pthread_create(&threads[ithread], NULL, 
+                         Scanner_Output::_slice_worker, &pool) != 0){
+         cerr << endl << "FATAL ERROR: Could not create worker thread." 
+              << endl;
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   // --- Write finished slices in order --- //
+
+   int islice;
+   for (islice=0; islice<pool.nslices; islice++){
+      Slice_Slot &slot = pool.slots[islice % pool.window];
+
+      pool.mutex.lock();
+      while (!slot.ready) 
+         pool.ready.wait(pool.mutex);
+      pool.mutex.unlock();
+
+      if (slot.raw_real != NULL){
+         _real_raw_data.save_slice(islice, *slot.raw_real);
+         _imag_raw_data.save_slice(islice, *slot.raw_imag);
+      }
+      _save_realizations(islice, slot.images);
+
+      pool.mutex.lock();
+      slot.ready = FALSE;
+      pool.written++;
+      pool.space.broadcast();
+      pool.mutex.unlock();
+
+      if (args.verboseFlag)
+         cout << "." << flush;
+   }
+
+   for (ithread=0; ithread<args.nthreads; ithread++){
+      (void)pthread_join(threads[ithread], NULL);
+   }
+   delete[] threads;
+
+   for (islot=0; islot<pool.window; islot++){
+      int ir;
+      for (ir=0; ir<_nrealizations; ir++){
+         delete pool.slots[islot].images[ir];
+      }
+      delete[] pool.slots[islot].images;
+      if (pool.slots[islot].raw_real != NULL) {
+         delete pool.slots[islot].raw_real;
+         delete pool.slots[islot].raw_imag;
+      }
+   }
+   delete[] pool.slots;
+
+}
+
+//--------------------------------------------------------------------------
+// Scanner_Output::_slice_worker
+// Worker thread for _save_images_threaded.  Repeatedly claims the next
+// slice, generates it with a private resampling workspace and leaves 
+// the result in the slice's slot.
+//--------------------------------------------------------------------------
+
+void *Scanner_Output::_slice_worker(void *arg) {
+
+   Slice_Pool &pool = *(Slice_Pool *)arg;
+   MRI_Scanner &scanner = *pool.scanner;
+
+   Resample_Workspace *workspace = scanner.new_resample_workspace();
+   Complex_Slice raw_slice(scanner.get_matrix_size(ROW), 
+                           scanner.get_matrix_size(COLUMN));
+
+   int islice;
+   for (;;) {
+
+      // Claim the next slice once its slot has been written
+      pool.mutex.lock();
+      while (pool.next_slice < pool.nslices &&
+             pool.next_slice >= pool.written + pool.window)
+         pool.space.wait(pool.mutex);
+      islice = pool.next_slice++;
+      pool.mutex.unlock();
+
+      if (islice >= pool.nslices) break;
+
+      Slice_Slot &slot = pool.slots[islice % pool.window];
+
+      scanner.get_noiseless_raw_data_slice(islice, raw_slice, *workspace);
+      pool.output->_extract_realizations(scanner, islice, raw_slice,
+                                         slot.images, slot.raw_real,
+                                         slot.raw_imag);
+
+      pool.mutex.lock();
+      slot.ready = TRUE;
+      pool.ready.broadcast();
+      pool.mutex.unlock();
+   }
+
+   delete workspace;
+   return NULL;
+
+}
+
+//--------------------------------------------------------------------------
+// Scanner_Output::_save_images_pipelined
+// As save_images, but slice selection (including reading the phantom),
+// resampling to raw data, and noise and reconstruction each run in their
+// own thread, while this thread writes the finished slices.  The noise 
+// of each slice depends only on the seed and slice number, so the output
+// is the same as that of save_images.
+//--------------------------------------------------------------------------
+
+void Scanner_Output::_save_images_pipelined(const mrisimArgs &args,
+                                            MRI_Scanner &scanner) {
+
+   Slice_Pipeline pipeline;
+   pipeline.output  = this;
+   pipeline.scanner = &scanner;
+   pipeline.nslices = _output.get_nslices();
+
+   // --- Start the stages --- //
+
+   void *(*stages[3])(void *) = { Scanner_Output::_select_stage,
+                                  Scanner_Output::_resample_stage,
+                                  Scanner_Output::_recon_stage };
+   pthread_t threads[3];
+   int istage;
+   for (istage=0; istage<3; istage++){
+      if (pthread_create(&threads[istage], NULL, 
+                         stages[istage], &pipeline) != 0){
+         cerr << endl << "FATAL ERROR: Could not create pipeline thread." 
+              << endl;
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   // --- Write finished slices in order --- //
+
+   Pipeline_Slice *item;
+   while ((item = (Pipeline_Slice *)pipeline.reconstructed.get()) != NULL){
+      if (item->raw_real != NULL){
+         _real_raw_data.save_slice(item->islice, *item->raw_real);
+         _imag_raw_data.save_slice(item->islice, *item->raw_imag);
+         delete item->raw_real;
+         delete item->raw_imag;
+      }
+      _save_realizations(item->islice, item->images);
+      int ir;
+      for (ir=0; ir<_nrealizations; ir++){
+         delete item->images[ir];
+      }
+      delete[] item->images;
+      delete item;
+
+      if (args.verboseFlag)
+         cout << "." << flush;
+   }
+
+   for (istage=0; istage<3; istage++){
+      (void)pthread_join(threads[istage], NULL);
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Scanner_Output::_select_stage
+// First pipeline stage: reads the phantom and computes the slice 
+// selected phantom slice for each output slice in turn.
+//--------------------------------------------------------------------------
+
+void *Scanner_Output::_select_stage(void *arg) {
+
+   Slice_Pipeline &pipeline = *(Slice_Pipeline *)arg;
+   const Phantom  *phantom  = pipeline.scanner->get_attached_phantom();
+
+   int islice;
+   for (islice=0; islice<pipeline.nslices; islice++){
+      Pipeline_Slice *item = new Pipeline_Slice;
+      item->islice        = islice;
+      item->phantom_slice = new Real_Slice(phantom->get_nrows(), 
+                                           phantom->get_ncols());
+      item->raw_slice     = NULL;
+      item->images        = NULL;
+      item->raw_real      = NULL;
+      item->raw_imag      = NULL;
+
+      pipeline.scanner->select_phantom_slice(islice, *item->phantom_slice);
+      pipeline.selected.put(item);
+   }
+   pipeline.selected.put(NULL);
+
+   return NULL;
+
+}
+
+//--------------------------------------------------------------------------
+// Scanner_Output::_resample_stage
+// Second pipeline stage: Fourier resamples each phantom slice to 
+// noiseless raw data.
+//--------------------------------------------------------------------------
+
+void *Scanner_Output::_resample_stage(void *arg) {
+
+   Slice_Pipeline &pipeline = *(Slice_Pipeline *)arg;
+   MRI_Scanner    &scanner  = *pipeline.scanner;
+
+   Resample_Workspace *workspace = scanner.new_resample_workspace();
+
+   Pipeline_Slice *item;
+   while ((item = (Pipeline_Slice *)pipeline.selected.get()) != NULL){
+      item->raw_slice = new Complex_Slice(scanner.get_matrix_size(ROW),
+                                          scanner.get_matrix_size(COLUMN));
+      scanner.generate_raw_data_slice(*item->phantom_slice, 
+                                      *item->raw_slice, *workspace);
+      delete item->phantom_slice;
+      item->phantom_slice = NULL;
+      pipeline.resampled.put(item);
+   }
+   pipeline.resampled.put(NULL);
+
+   delete workspace;
+   return NULL;
+
+}
+
+//--------------------------------------------------------------------------
+// Scanner_Output::_recon_stage
+// Third pipeline stage: adds noise to each raw data slice, reconstructs
+// it and extracts the output images.
+//--------------------------------------------------------------------------
+
+void *Scanner_Output::_recon_stage(void *arg) {
+
+   Slice_Pipeline &pipeline = *(Slice_Pipeline *)arg;
+   MRI_Scanner    &scanner  = *pipeline.scanner;
+   const int      nrows     = pipeline.output->_image.get_nrows();
+   const int      ncols     = pipeline.output->_image.get_ncols();
+   const int      nrealizations = pipeline.output->_nrealizations;
+
+   Pipeline_Slice *item;
+   int            ir;
+   while ((item = (Pipeline_Slice *)pipeline.resampled.get()) != NULL){
+
+      if (scanner.save_raw_data()){
+         item->raw_real = new MRI_Image(nrows, ncols);
+         item->raw_imag = new MRI_Image(nrows, ncols);
+      }
+      item->images = new MRI_Image *[nrealizations];
+      for (ir=0; ir<nrealizations; ir++){
+         item->images[ir] = new MRI_Image(nrows, ncols);
+      }
+
+      pipeline.output->_extract_realizations(scanner, item->islice,
+                                             *item->raw_slice, item->images,
+                                             item->raw_real, item->raw_imag);
+      delete item->raw_slice;
+      item->raw_slice = NULL;
+      pipeline.reconstructed.put(item);
+   }
+   pipeline.reconstructed.put(NULL);
+
+   return NULL;
+
+}
+
 //--------------------------------------------------------------------------
 // Scanner_Output::file_exists
 // Returns TRUE if a file exists.
@@ -59,6 +59,24 @@ class Scanner_Output {
 
 
    private:
+
+      // --- Image generation --- //
+
+      void _extract_image(MRI_Scanner &scanner, Complex_Slice &raw_slice,
+                          MRI_Image &image) const;
+      void _extract_realizations(MRI_Scanner &scanner, int islice,
+                                 Complex_Slice &raw_slice, MRI_Image **images,
+                                 MRI_Image *raw_real,
+                                 MRI_Image *raw_imag) const;
+      void _save_realizations(int islice, MRI_Image **images);
+      void _save_images_threaded(const mrisimArgs &args, 
+                                 MRI_Scanner &scanner);
+      static void *_slice_worker(void *pool);
+      void _save_images_pipelined(const mrisimArgs &args,
+                                  MRI_Scanner &scanner);
+      static void *_select_stage(void *pipeline);
+      static void *_resample_stage(void *pipeline);
+      static void *_recon_stage(void *pipeline);
       
       // --- Reconstructed image information --- //
 
@@ -66,6 +84,11 @@ class Scanner_Output {
       O_MINC_File _output;
       Output_Type  _output_type;
 
+      // --- Noise realizations --- //
+
+      int         _nrealizations;
+      O_MINC_File *_realization_output;  // realizations 1.._nrealizations-1
+
       // --- Raw data information --- //
 
       O_MINC_File _real_raw_data;
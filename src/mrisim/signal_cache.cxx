@@ -0,0 +1,285 @@
+//==========================================================================
+// SIGNAL_CACHE.CXX
+// Tissue_Signal_Cache class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "signal_cache.h"
+
+// First bytes of a signal cache file, followed by a byte order check word
+static const char         SIGNAL_CACHE_MAGIC[] = "MRISIM SIGNAL CACHE 1\n";
+static const unsigned int SIGNAL_CACHE_ORDER   = 0x01020304U;
+
+// Most signals of one entry read from a file
+#define SIGNAL_CACHE_MAX_VALUES 1048576
+
+// 64 bit FNV-1a hash constants
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME        0x00000100000001b3ULL
+
+Tissue_Signal_Cache::Entry *Tissue_Signal_Cache::_entries = NULL;
+int       Tissue_Signal_Cache::_changed = FALSE;
+MRI_Mutex Tissue_Signal_Cache::_mutex;
+
+//--------------------------------------------------------------------------
+// hash_bytes
+// Adds bytes to a 64 bit FNV-1a hash.
+//--------------------------------------------------------------------------
+
+static void hash_bytes(unsigned long long& hash, const void *data,
+                       unsigned int nbytes) {
+
+   const unsigned char *byte = (const unsigned char *)data;
+   unsigned int n;
+   for (n=0; n<nbytes; n++){
+      hash ^= byte[n];
+      hash *= FNV_PRIME;
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache::make_key
+// Returns the key of the signals of a tissue for a pulse sequence.
+// sequence_key must describe every parameter of the pulse sequence; the
+// tissue parameters are hashed as doubles, with the flip angle errors
+// the signals are simulated for, if any.
+//--------------------------------------------------------------------------
+
+unsigned long long Tissue_Signal_Cache::make_key(const char *sequence_key,
+                                                 Signal_Model model,
+                                                 const Tissue& tissue,
+                                                 unsigned int nflip,
+                                                 const double flip_error[]) {
+
+   unsigned long long hash      = FNV_OFFSET_BASIS;
+   const int          id        = (int)model;
+   const double       params[4] = {tissue.get_T1(), tissue.get_T2(),
+                                   tissue.get_T2s(), tissue.get_NH()};
+
+   hash_bytes(hash, &id, sizeof(id));
+   hash_bytes(hash, sequence_key, strlen(sequence_key) + 1);
+   hash_bytes(hash, params, sizeof(params));
+   hash_bytes(hash, &nflip, sizeof(nflip));
+   if (nflip > 0) {
+      hash_bytes(hash, flip_error, nflip*sizeof(double));
+   }
+
+   return hash;
+
+}
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache::find
+// Copies the signals of an entry into real and imag.  Returns FALSE if
+// there is no entry of the key with nvalues signals.
+//--------------------------------------------------------------------------
+
+int Tissue_Signal_Cache::find(unsigned long long key, unsigned int nvalues,
+                              double real[], double imag[]) {
+
+   MRI_Lock lock(_mutex);
+
+   Entry *entry = _find(key, nvalues);
+   if (entry == NULL) {
+      return FALSE;
+   }
+
+   memcpy(real, entry->real, nvalues*sizeof(double));
+   memcpy(imag, entry->imag, nvalues*sizeof(double));
+   return TRUE;
+
+}
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache::add
+// Adds the signals of a key to the registry, unless it already has them.
+//--------------------------------------------------------------------------
+
+void Tissue_Signal_Cache::add(unsigned long long key, unsigned int nvalues,
+                              const double real[], const double imag[]) {
+
+   MRI_Lock lock(_mutex);
+
+   if (_find(key, nvalues) == NULL) {
+      _add(key, nvalues, real, imag);
+      _changed = TRUE;
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache::changed
+// Returns TRUE if entries have been added since the signal cache file
+// was loaded or saved.
+//--------------------------------------------------------------------------
+
+int Tissue_Signal_Cache::changed(void) {
+
+   MRI_Lock lock(_mutex);
+   return _changed;
+
+}
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache::load
+// Adds the entries saved in a signal cache file to the registry.
+// Entries already in the registry are kept.  A file written on a machine
+// with another byte order or word size is ignored; a truncated file
+// gives the entries before the damaged record.
+//--------------------------------------------------------------------------
+
+int Tissue_Signal_Cache::load(const char *path) {
+
+   FILE *fp;
+   if ((fp = fopen(path, "rb")) == NULL) {
+      return -1;
+   }
+
+   char         magic[sizeof(SIGNAL_CACHE_MAGIC)];
+   unsigned int order;
+   unsigned int sizes[2];
+
+   if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+       memcmp(magic, SIGNAL_CACHE_MAGIC, sizeof(magic)) != 0 ||
+       fread(&order, sizeof(order), 1, fp) != 1 ||
+       fread(sizes, sizeof(unsigned int), 2, fp) != 2 ||
+       order != SIGNAL_CACHE_ORDER ||
+       sizes[0] != sizeof(unsigned long long) ||
+       sizes[1] != sizeof(double)) {
+      fclose(fp);
+      return -1;
+   }
+
+   MRI_Lock lock(_mutex);
+
+   int                nentries = 0;
+   unsigned long long key;
+   unsigned int       nvalues;
+   double             *real = NULL;
+   double             *imag = NULL;
+
+   while (fread(&key, sizeof(key), 1, fp) == 1 &&
+          fread(&nvalues, sizeof(nvalues), 1, fp) == 1 &&
+          nvalues > 0 && nvalues <= SIGNAL_CACHE_MAX_VALUES) {
+
+      real = new double[nvalues];
+      imag = new double[nvalues];
+      if (fread(real, sizeof(double), nvalues, fp) != nvalues ||
+          fread(imag, sizeof(double), nvalues, fp) != nvalues) {
+         delete[] real;
+         delete[] imag;
+         break;
+      }
+
+      if (_find(key, nvalues) == NULL) {
+         _add(key, nvalues, real, imag);
+         nentries++;
+      }
+      delete[] real;
+      delete[] imag;
+   }
+
+   fclose(fp);
+   _changed = FALSE;
+
+   return nentries;
+
+}
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache::save
+// Writes every entry in the registry to a signal cache file.  The file
+// is written under a temporary name and renamed, so that concurrent jobs
+// sharing one file never read a partly written file.
+//--------------------------------------------------------------------------
+
+int Tissue_Signal_Cache::save(const char *path) {
+
+   char *tmp_path = new char[strlen(path) + 32];
+   sprintf(tmp_path, "%s.%ld", path, (long)getpid());
+
+   FILE *fp;
+   if ((fp = fopen(tmp_path, "wb")) == NULL) {
+      delete[] tmp_path;
+      return FALSE;
+   }
+
+   MRI_Lock lock(_mutex);
+
+   const unsigned int order    = SIGNAL_CACHE_ORDER;
+   const unsigned int sizes[2] = {sizeof(unsigned long long),
+                                  sizeof(double)};
+
+   int ok = (fwrite(SIGNAL_CACHE_MAGIC, 1, sizeof(SIGNAL_CACHE_MAGIC), fp) ==
+                sizeof(SIGNAL_CACHE_MAGIC) &&
+             fwrite(&order, sizeof(order), 1, fp) == 1 &&
+             fwrite(sizes, sizeof(unsigned int), 2, fp) == 2);
+
+   Entry *entry;
+   for (entry=_entries; ok && entry!=NULL; entry=entry->next){
+      ok = (fwrite(&entry->key, sizeof(entry->key), 1, fp) == 1 &&
+            fwrite(&entry->nvalues, sizeof(entry->nvalues), 1, fp) == 1 &&
+            fwrite(entry->real, sizeof(double), entry->nvalues, fp) ==
+               entry->nvalues &&
+            fwrite(entry->imag, sizeof(double), entry->nvalues, fp) ==
+               entry->nvalues);
+   }
+
+   ok = (fclose(fp) == 0) && ok;
+   ok = ok && (rename(tmp_path, path) == 0);
+   if (!ok) {
+      remove(tmp_path);
+   } else {
+      _changed = FALSE;
+   }
+   delete[] tmp_path;
+
+   return ok;
+
+}
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache::_find
+// Returns the entry of a key with nvalues signals, or NULL.  The caller
+// must hold _mutex.
+//--------------------------------------------------------------------------
+
+Tissue_Signal_Cache::Entry *Tissue_Signal_Cache::_find(unsigned long long key,
+                                                       unsigned int nvalues) {
+
+   Entry *entry;
+   for (entry=_entries; entry!=NULL; entry=entry->next){
+      if (entry->key == key && entry->nvalues == nvalues) {
+         return entry;
+      }
+   }
+   return NULL;
+
+}
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache::_add
+// Adds a copy of the signals of a key to the registry.  The caller must
+// hold _mutex.
+//--------------------------------------------------------------------------
+
+void Tissue_Signal_Cache::_add(unsigned long long key, unsigned int nvalues,
+                               const double real[], const double imag[]) {
+
+   Entry *entry   = new Entry;
+   entry->key     = key;
+   entry->nvalues = nvalues;
+   entry->real    = new double[nvalues];
+   entry->imag    = new double[nvalues];
+   memcpy(entry->real, real, nvalues*sizeof(double));
+   memcpy(entry->imag, imag, nvalues*sizeof(double));
+
+   entry->next = _entries;
+   _entries    = entry;
+
+}
@@ -0,0 +1,77 @@
+#ifndef __SIGNAL_CACHE_H
+#define __SIGNAL_CACHE_H
+
+//==========================================================================
+// SIGNAL_CACHE.H
+// Tissue_Signal_Cache class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <minc/mrithread.h>
+#include <signal/tissue.h>
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+// Signal models whose tissue signals are cached
+enum Signal_Model {SIGNAL_QUICK_MODEL = 0, SIGNAL_ISOCHROMAT_MODEL = 1};
+
+//--------------------------------------------------------------------------
+// Tissue_Signal_Cache class
+// A registry of simulated tissue signals, so that a tissue is simulated
+// once for each pulse sequence.  An entry holds the I and Q signals of
+// one tissue without flip angle error followed by one for each flip
+// angle error of the transmit lookup tables, and is found by a hash of
+// everything the signals depend on: the pulse sequence parameters, the
+// signal model, T1, T2, T2*, NH and the flip angle errors.
+//
+// Like the Chirp wisdom, the registry can be saved to and loaded from a
+// file of raw doubles in the native byte order, only read on a machine
+// of the same kind, so that repeated and batch runs skip the spin
+// simulations.
+//--------------------------------------------------------------------------
+
+class Tissue_Signal_Cache {
+   public:
+      static unsigned long long make_key(const char *sequence_key,
+                                         Signal_Model model,
+                                         const Tissue& tissue,
+                                         unsigned int nflip,
+                                         const double flip_error[]);
+
+      // nvalues signals of each channel; find returns FALSE if there is
+      // no entry of the key with nvalues signals.
+      static int  find(unsigned long long key, unsigned int nvalues,
+                       double real[], double imag[]);
+      static void add(unsigned long long key, unsigned int nvalues,
+                      const double real[], const double imag[]);
+
+      // --- Signal cache files --- //
+      // load returns the number of entries read, or -1 if the file
+      // could not be read.  save returns FALSE (0) on failure.
+      static int load(const char *path);
+      static int save(const char *path);
+      static int changed(void);
+
+   private:
+      struct Entry {
+         unsigned long long key;
+         unsigned int       nvalues;
+         double             *real;
+         double             *imag;
+         Entry              *next;
+      };
+
+      static Entry     *_entries;
+      static int       _changed;      // entries added since the last load
+      static MRI_Mutex _mutex;
+
+      static Entry *_find(unsigned long long key, unsigned int nvalues);
+      static void   _add(unsigned long long key, unsigned int nvalues,
+                         const double real[], const double imag[]);
+};
+
+#endif
@@ -0,0 +1,174 @@
+//==========================================================================
+// SLAB_ENCODER.CXX
+// Slab_Encoder class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <assert.h>
+#include <math.h>
+#include "chirp_plan.h"
+#include "slab_encoder.h"
+
+//--------------------------------------------------------------------------
+// Slab_Encoder constructor
+// Positions and steps are in the same units (mm along z).
+//--------------------------------------------------------------------------
+
+Slab_Encoder::Slab_Encoder(unsigned int in_length, double in_start,
+                           double in_step, unsigned int out_length,
+                           double out_start, double out_step)
+   : _in_length(in_length), _out_length(out_length) {
+
+#ifdef DEBUG
+   assert(in_length > 0 && out_length > 0);
+   assert(in_step > 0.0 && out_step > 0.0);
+#endif
+
+   const double       fov  = out_length*out_step;
+   const unsigned int half = out_length/2;
+
+   double *weight = new double[2*out_length];
+   double kz, amplitude, angle, w_initial;
+   unsigned int m, q;
+
+   _chirp[ENCODE] = _chirp[DECODE] = NULL;
+   _dft[ENCODE]   = _dft[DECODE]   = NULL;
+
+   // --- Encode --- //
+   // S[m] = sum_n x[n] exp(-j*2*pi*kz[m]*z[n]) in_step/FOV sinc^2(kz*in_step)
+   // The weight also carries the phase of the first slice position and
+   // the scale that makes a uniform object give its own value back.
+
+   for(m=0; m<out_length; m++){
+      kz        = ((double)m - (double)half)/fov;
+      amplitude = in_step/fov *
+                  _sinc(kz*in_step) * _sinc(kz*in_step);
+      angle     = -2.0*M_PI*kz*in_start;
+      weight[2*m]   = amplitude*cos(angle);
+      weight[2*m+1] = amplitude*sin(angle);
+   }
+
+   const double encode_w_step = 2.0*M_PI*in_step/fov;
+   _prepare(ENCODE, in_length, out_length,
+            -encode_w_step*(double)half, encode_w_step, weight);
+
+   // --- Decode --- //
+   // y[p] = sum_m S[m] exp(+j*2*pi*kz[m]*z[p]).  With q = out_length-1-p
+   // this is a forward DFT at w = 2*pi*(out_step - out_start)/FOV +
+   // q*2*pi/out_length (mod 2*pi), weighted by the phase of the first
+   // kz sample.
+
+   for(q=0; q<out_length; q++){
+      angle = -2.0*M_PI*(double)half *
+              (out_start + (out_length-1-q)*out_step)/fov;
+      weight[2*q]   = cos(angle);
+      weight[2*q+1] = sin(angle);
+   }
+
+   w_initial = 2.0*M_PI*(out_step - out_start)/fov;
+   w_initial -= 2.0*M_PI*floor((w_initial + M_PI)/(2.0*M_PI));
+   _prepare(DECODE, out_length, out_length,
+            w_initial, 2.0*M_PI/(double)out_length, weight);
+
+   delete[] weight;
+
+}
+
+//--------------------------------------------------------------------------
+// Slab_Encoder destructor
+//--------------------------------------------------------------------------
+
+Slab_Encoder::~Slab_Encoder() {
+   int pass;
+   for(pass=0; pass<NPASSES; pass++){
+      if (_chirp[pass] != NULL) delete _chirp[pass];
+      if (_dft[pass]   != NULL) delete _dft[pass];
+   }
+}
+
+//--------------------------------------------------------------------------
+// Slab_Encoder::_prepare
+// Chooses the cheapest way of computing a pass and builds its DFT.
+//--------------------------------------------------------------------------
+
+void Slab_Encoder::_prepare(Pass pass, unsigned int in_length,
+                            unsigned int out_length,
+                            double w_initial, double w_step,
+                            const double weight[]) {
+
+   const Resample_Method methods[2] = {RESAMPLE_FFT, RESAMPLE_DIRECT};
+
+   double best_cost = Chirp_Algorithm::get_cost(in_length, out_length,
+                                                w_initial, w_step, TRUE);
+   double cost;
+   int n;
+
+   _method[pass] = RESAMPLE_CHIRP;
+   for(n=0; n<2; n++){
+      cost = Resample_DFT::get_cost(methods[n], in_length, out_length,
+                                    w_initial, w_step, TRUE);
+      if (cost >= 0.0 && cost < best_cost) {
+         _method[pass] = methods[n];
+         best_cost     = cost;
+      }
+   }
+
+   if (_method[pass] == RESAMPLE_CHIRP) {
+      _chirp[pass] = new Chirp_Algorithm(in_length, out_length,
+                                         w_initial, w_step, weight);
+   } else {
+      _dft[pass] = new Resample_DFT(_method[pass], in_length, out_length,
+                                    w_initial, w_step, weight);
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Slab_Encoder::get_workspace_length
+// Returns the number of doubles of work space needed by encode for a
+// slab of ncols columns.
+//--------------------------------------------------------------------------
+
+unsigned int Slab_Encoder::get_workspace_length(unsigned int ncols) const {
+
+   unsigned int length, max_length = 0;
+   int pass;
+
+   for(pass=0; pass<NPASSES; pass++){
+      length = ((_chirp[pass] != NULL) ?
+                _chirp[pass]->get_batch_workspace_length() :
+                _dft[pass]->get_workspace_length(ncols));
+      if (length > max_length) max_length = length;
+   }
+
+   return max_length;
+
+}
+
+//--------------------------------------------------------------------------
+// Slab_Encoder::encode
+//--------------------------------------------------------------------------
+
+void Slab_Encoder::encode(unsigned int ncols, float data[], float kz[],
+                          double work[]) const {
+   _transform(ENCODE, ncols, data, kz,   work);
+   _transform(DECODE, ncols, kz,   data, work);
+}
+
+//--------------------------------------------------------------------------
+// Slab_Encoder::_transform
+// Applies the DFT of one pass to the columns of a matrix.
+//--------------------------------------------------------------------------
+
+void Slab_Encoder::_transform(Pass pass, unsigned int ncols,
+                              const float in[], float out[],
+                              double work[]) const {
+
+   if (_chirp[pass] != NULL) {
+      _chirp[pass]->apply_columns(ncols, in, out, work);
+   } else {
+      _dft[pass]->transform_columns(ncols, in, out, work);
+   }
+
+}
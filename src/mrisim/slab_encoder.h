@@ -0,0 +1,117 @@
+#ifndef __SLAB_ENCODER_H
+#define __SLAB_ENCODER_H
+
+//==========================================================================
+// SLAB_ENCODER.H
+// Slab_Encoder class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <minc/chirp.h>
+#include "resample_dft.h"
+
+//--------------------------------------------------------------------------
+// Slab_Encoder class
+// Phase encoding along z of a 3-D slab.  The input is the in-plane raw
+// data of in_length phantom slices, at z = in_start + n*in_step; the
+// output is the raw data of out_length partitions, at z = out_start +
+// p*out_step, as reconstructed by an inverse DFT along kz.  It is
+// computed in two passes over the columns of the slab (one column for
+// each in-plane k-space sample):
+//
+// encode: the DFT of the linearly interpolated phantom at the kz
+//         samples (m - out_length/2)/FOV, FOV = out_length*out_step,
+//         weighted by the transform of the interpolation kernel.
+// decode: the inverse DFT along kz back to the partitions.
+//
+// Each pass is a Chirp DFT, an FFT or a direct DFT, whichever has the
+// lowest estimated cost.  The decode pass produces the partitions in
+// reverse order; get_partition_row gives the row of each.
+//--------------------------------------------------------------------------
+
+class Slab_Encoder {
+   public:
+      enum Pass {ENCODE = 0, DECODE = 1, NPASSES = 2};
+
+      Slab_Encoder(unsigned int in_length, double in_start, double in_step,
+                   unsigned int out_length, double out_start,
+                   double out_step);
+      ~Slab_Encoder();
+
+      inline unsigned int get_input_length(void) const;
+      inline unsigned int get_output_length(void) const;
+      inline Resample_Method get_method(Pass pass) const;
+      inline unsigned int get_partition_row(unsigned int partition) const;
+      unsigned int get_workspace_length(unsigned int ncols) const;
+
+      // Encodes the slab in place.  On entry, data holds the in_length x
+      // ncols complex input; on exit, the out_length x ncols partitions.
+      // data must have room for the larger of the two, and kz for an
+      // out_length x ncols complex matrix.  The work space must hold
+      // get_workspace_length(ncols) doubles.
+      void encode(unsigned int ncols, float data[], float kz[],
+                  double work[]) const;
+
+   private:
+      unsigned int     _in_length;
+      unsigned int     _out_length;
+      Resample_Method  _method[NPASSES];
+      Chirp_Algorithm *_chirp[NPASSES];   // RESAMPLE_CHIRP passes
+      Resample_DFT    *_dft[NPASSES];     // FFT or direct passes
+
+      void _prepare(Pass pass, unsigned int in_length,
+                    unsigned int out_length,
+                    double w_initial, double w_step, const double weight[]);
+      void _transform(Pass pass, unsigned int ncols,
+                      const float in[], float out[], double work[]) const;
+
+      Slab_Encoder(const Slab_Encoder&);
+      Slab_Encoder& operator=(const Slab_Encoder&);
+};
+
+//--------------------------------------------------------------------------
+// Inline member functions
+//--------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------
+// Slab_Encoder::get_input_length
+// Returns the number of phantom slices in the slab.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Slab_Encoder::get_input_length(void) const {
+   return _in_length;
+}
+
+//--------------------------------------------------------------------------
+// Slab_Encoder::get_output_length
+// Returns the number of partitions.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Slab_Encoder::get_output_length(void) const {
+   return _out_length;
+}
+
+//--------------------------------------------------------------------------
+// Slab_Encoder::get_method
+// Returns the way a pass is computed.
+//--------------------------------------------------------------------------
+
+inline
+Resample_Method Slab_Encoder::get_method(Pass pass) const {
+   return _method[pass];
+}
+
+//--------------------------------------------------------------------------
+// Slab_Encoder::get_partition_row
+// Returns the row of the encoded data that holds a partition.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Slab_Encoder::get_partition_row(unsigned int partition) const {
+   return _out_length-1-partition;
+}
+
+#endif
@@ -0,0 +1,125 @@
+//==========================================================================
+// SLICE_CACHE.CXX
+// Phantom_Slice_Cache class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include "slice_cache.h"
+
+//--------------------------------------------------------------------------
+// Phantom_Slice_Cache constructor
+// Creates a cache holding as many nrows x ncols slices as fit in 
+// max_bytes.
+//--------------------------------------------------------------------------
+
+Phantom_Slice_Cache::Phantom_Slice_Cache(unsigned int nrows, 
+                                         unsigned int ncols,
+                                         unsigned long max_bytes) {
+
+   const unsigned long slice_bytes = 
+      (unsigned long)nrows * ncols * sizeof(float);
+
+   _capacity = (slice_bytes > 0) ? (unsigned int)(max_bytes / slice_bytes) : 0;
+   _clock    = 0;
+   _entries  = (_capacity > 0) ? new Entry[_capacity] : (Entry *)NULL;
+
+   unsigned int n;
+   for (n=0; n<_capacity; n++){
+      _entries[n].slice_num   = -1;
+      _entries[n].pseq_serial = 0;
+      _entries[n].last_use    = 0;
+      _entries[n].slice       = new MRI_Float_Matrix(nrows, ncols);
+   }
+
+}
+
+//--------------------------------------------------------------------------
+// Phantom_Slice_Cache destructor
+//--------------------------------------------------------------------------
+
+Phantom_Slice_Cache::~Phantom_Slice_Cache() {
+
+   unsigned int n;
+   for (n=0; n<_capacity; n++){
+      delete _entries[n].slice;
+   }
+   if (_entries != NULL) delete[] _entries;
+
+}
+
+//--------------------------------------------------------------------------
+// Phantom_Slice_Cache::get
+// Copies a cached slice into slice and returns TRUE, or returns FALSE if
+// the slice is not in the cache.
+//--------------------------------------------------------------------------
+
+int Phantom_Slice_Cache::get(int slice_num, unsigned long pseq_serial,
+                             MRI_Float_Matrix& slice) {
+
+   MRI_Lock lock(_mutex);
+
+   unsigned int n;
+   for (n=0; n<_capacity; n++){
+      if (_entries[n].slice_num == slice_num &&
+          _entries[n].pseq_serial == pseq_serial) {
+         _entries[n].last_use = ++_clock;
+         slice = *(_entries[n].slice);
+         return TRUE;
+      }
+   }
+
+   return FALSE;
+
+}
+
+//--------------------------------------------------------------------------
+// Phantom_Slice_Cache::put
+// Stores a copy of a slice in the cache, replacing the least recently
+// used slice if the cache is full.
+//--------------------------------------------------------------------------
+
+void Phantom_Slice_Cache::put(int slice_num, unsigned long pseq_serial,
+                              const MRI_Float_Matrix& slice) {
+
+   MRI_Lock lock(_mutex);
+
+   if (_capacity == 0) return;
+
+   // Find the slice if another thread has already stored it, otherwise
+   // the least recently used (or an unused) entry
+   unsigned int n, victim = 0;
+   for (n=0; n<_capacity; n++){
+      if (_entries[n].slice_num == slice_num &&
+          _entries[n].pseq_serial == pseq_serial) {
+         _entries[n].last_use = ++_clock;
+         return;
+      }
+      if (_entries[n].last_use < _entries[victim].last_use) {
+         victim = n;
+      }
+   }
+
+   *(_entries[victim].slice)    = slice;
+   _entries[victim].slice_num   = slice_num;
+   _entries[victim].pseq_serial = pseq_serial;
+   _entries[victim].last_use    = ++_clock;
+
+}
+
+//--------------------------------------------------------------------------
+// Phantom_Slice_Cache::clear
+// Removes all slices from the cache.
+//--------------------------------------------------------------------------
+
+void Phantom_Slice_Cache::clear(void) {
+
+   MRI_Lock lock(_mutex);
+
+   unsigned int n;
+   for (n=0; n<_capacity; n++){
+      _entries[n].slice_num = -1;
+      _entries[n].last_use  = 0;
+   }
+
+}
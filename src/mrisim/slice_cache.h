@@ -0,0 +1,67 @@
+#ifndef __SLICE_CACHE_H
+#define __SLICE_CACHE_H
+
+//==========================================================================
+// SLICE_CACHE.H
+// Phantom_Slice_Cache class.
+// Inherits from:
+// Base class to:
+//==========================================================================
+
+#include <minc/mrimatrix.h>
+#include <minc/mrithread.h>
+
+//--------------------------------------------------------------------------
+// Phantom_Slice_Cache class
+// A bounded cache of synthesized phantom slices, keyed by slice number
+// and the serial number of the pulse sequence they were synthesized for.
+// When full, the least recently used slice is replaced.  The cache may
+// be shared by several threads.
+//--------------------------------------------------------------------------
+
+class Phantom_Slice_Cache {
+   public:
+      Phantom_Slice_Cache(unsigned int nrows, unsigned int ncols,
+                          unsigned long max_bytes);
+      virtual ~Phantom_Slice_Cache();
+
+      int  get(int slice_num, unsigned long pseq_serial,
+               MRI_Float_Matrix& slice);
+      void put(int slice_num, unsigned long pseq_serial,
+               const MRI_Float_Matrix& slice);
+      void clear(void);
+
+      inline unsigned int get_capacity(void) const;
+
+   private:
+      struct Entry {
+         int              slice_num;  // -1 if the entry is unused
+         unsigned long    pseq_serial;
+         unsigned long    last_use;
+         MRI_Float_Matrix *slice;
+      };
+
+      Entry         *_entries;
+      unsigned int  _capacity;
+      unsigned long _clock;           // incremented on each access
+      MRI_Mutex     _mutex;
+
+      Phantom_Slice_Cache(const Phantom_Slice_Cache&);
+      Phantom_Slice_Cache& operator=(const Phantom_Slice_Cache&);
+};
+
+//--------------------------------------------------------------------------
+// Inline member functions
+//--------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------
+// Phantom_Slice_Cache::get_capacity
+// Returns the number of slices the cache can hold.
+//--------------------------------------------------------------------------
+
+inline
+unsigned int Phantom_Slice_Cache::get_capacity(void) const {
+   return _capacity;
+}
+
+#endif
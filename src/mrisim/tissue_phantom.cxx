@@ -94,6 +94,7 @@ void Tissue_Phantom::apply_pulse_sequence(Quick_Sequence *pseq) {
 
       // Save pointer to current pulse sequence
    _pseq = pseq;
+   _pulse_sequence_changed();
 
    // For each tissue class installed, apply the pulse sequence
    // and store the signal intensity.  Tissue classes which are
@@ -104,14 +105,22 @@ void Tissue_Phantom::apply_pulse_sequence(Quick_Sequence *pseq) {
 
       if (_tissue[itissue]->get_NH() != 0){
 
-         model = new Quick_Model(*_tissue[itissue]);
-         pseq->apply(*model);
+         if (!_find_tissue_signal(SIGNAL_QUICK_MODEL, itissue, 0, NULL,
+                                  &real, &imag)) {
+            model = new Quick_Model(*_tissue[itissue]);
+            pseq->apply(*model);
 
-         real = _real_intensity[itissue] = _get_i_sample();
-         imag = _imag_intensity[itissue] = _get_q_sample();
-         mag  = hypot(real, imag);
+            real = _get_i_sample();
+            imag = _get_q_sample();
+
+            delete model;
+            _save_tissue_signal(SIGNAL_QUICK_MODEL, itissue, 0, NULL,
+                                &real, &imag);
+         }
 
-         delete model;
+         _real_intensity[itissue] = real;
+         _imag_intensity[itissue] = imag;
+         mag  = hypot(real, imag);
 
       } else {
 
@@ -145,6 +154,7 @@ void Tissue_Phantom::find_steady_state(Custom_Sequence *pseq) {
 
    // Save pointer to current pulse sequence
    _pseq = pseq;
+   _pulse_sequence_changed();
 
    // For each tissue class installed, apply the pulse sequence
    // to steady state and store the signal intensity.  Tissue classes 
@@ -154,17 +164,26 @@ void Tissue_Phantom::find_steady_state(Custom_Sequence *pseq) {
    for(itissue=0; itissue<_n_tissues_installed; itissue++){
       if (_tissue[itissue]->get_NH() != 0){
 
-         // Instantiate a new magnetization system and run
-         // the first repetition of the pulse sequence.
-         model = new Fast_Isochromat_Model(*_tissue[itissue]);
-         pseq->initialize_sequence(*model);
-         pseq->apply_to_steady_state(*model);
+         if (!_find_tissue_signal(SIGNAL_ISOCHROMAT_MODEL, itissue, 0, NULL,
+                                  &real, &imag)) {
+
+            // Instantiate a new magnetization system and run
+            // the first repetition of the pulse sequence.
+            model = new Fast_Isochromat_Model(*_tissue[itissue]);
+            pseq->initialize_sequence(*model);
+            pseq->apply_to_steady_state(*model);
+
+            real = _get_i_sample();
+            imag = _get_q_sample();
+            delete model;
+            _save_tissue_signal(SIGNAL_ISOCHROMAT_MODEL, itissue, 0, NULL,
+                                &real, &imag);
+         }
 
          // Store the steady state magnetization
-         real = _real_intensity[itissue] = _get_i_sample();
-         imag = _imag_intensity[itissue] = _get_q_sample();
+         _real_intensity[itissue] = real;
+         _imag_intensity[itissue] = imag;
          mag  = hypot(real, imag);
-         delete model;
 
       } else {
 